@@ -1,4 +1,5 @@
 using System;
+using System.Runtime.InteropServices;
 
 namespace Akarin.Interface
 {
@@ -8,6 +9,114 @@ namespace Akarin.Interface
         IDeviceSelectionFilter CreateDeviceSelectionFilter();
         IDeviceSelector OpenDeviceSelection(IDeviceSelectionFilter filter);
         IWindow CreateWindow(WindowCreateInfo createInfo);
+        ICommandStream CreateCommandStream(uint capacity = 1 << 16);
+        ulong GetLiveObjectCount(NativeObjectType type);
+        void StartRenderThread();
+        void StopRenderThread();
+        RenderThreadStats GetRenderThreadStats();
+        HostAllocatorStats GetHostAllocatorStats();
+        // Best instruction set of this CPU, native kernels pick theirs at runtime
+        SimdLevel SimdLevel { get; }
+        // Batches run on the job system, `threads` caps how many threads work on one, the caller included; 0 uses
+        // every job system worker
+        ITessellator CreateTessellator(uint threads = 0);
+        // RGBA8 or BGRA8 pixels, source and destination are the same span or do not overlap
+        void ConvertPixels(ReadOnlySpan<byte> source, Span<byte> destination, PixelConversion conversion);
+        // Gigabytes per second of the scalar path and of the best level of this CPU
+        PixelConvertBenchmark BenchmarkPixelConversion(PixelConversion conversion, ulong pixels = 1 << 22,
+            uint iterations = 10);
+        // Native workers shared with the native subsystems, started with the defaults on first use otherwise. 0 workers
+        // leaves one hardware thread to the caller. Returns false if it is running already.
+        bool StartJobSystem(uint workers = 0, bool pinWorkers = false);
+        IJobCounter CreateJobCounter();
+        // job(0..count-1) on the workers, started once `after` reached zero. Exceptions are rethrown by Wait on
+        // `counter`, without one they are lost.
+        void RunJobs(JobAction job, uint count, IJobCounter counter = null, IJobCounter after = null);
+        JobSystemStats GetJobSystemStats();
+        // One entry per worker count: per job overhead of empty jobs and throughput of equally sized ones
+        JobBenchmark[] BenchmarkJobSystem(uint jobs = 1 << 16, uint iterations = 10);
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct RenderThreadStats
+    {
+        public ulong Frames;
+        public ulong LastLatencyMicroseconds;
+        public ulong AverageLatencyMicroseconds;
+        public ulong MaxLatencyMicroseconds;
+        public ulong DroppedInputs;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct HostScopeStats
+    {
+        public ulong Bytes;
+        public ulong PeakBytes;
+        public ulong Allocations;
+        public ulong TotalAllocations;
+        public ulong InternalBytes;
+    }
+
+    // Driver host memory, one entry per allocation scope
+    [StructLayout(LayoutKind.Sequential)]
+    public struct HostAllocatorStats
+    {
+        public HostScopeStats Command;
+        public HostScopeStats Object;
+        public HostScopeStats Cache;
+        public HostScopeStats Device;
+        public HostScopeStats Instance;
+        public ulong PooledAllocations;
+        public ulong SystemAllocations;
+        public ulong ReservedBytes;
+    }
+
+    [Flags]
+    public enum TraceReplayFlags : uint
+    {
+        // Replays as fast as possible with hidden windows
+        None = 0,
+        RealTime = 1,
+        Visible = 2
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TraceReplayStats
+    {
+        public ulong Calls;
+        public ulong Events;
+        public ulong Skipped;
+        public ulong Frames;
+        public ulong RecordedFrames;
+        public ulong DurationMicroseconds;
+        public ulong RecordedDurationMicroseconds;
+        public ulong MinFrameMicroseconds;
+        public ulong AverageFrameMicroseconds;
+        public ulong P50FrameMicroseconds;
+        public ulong P95FrameMicroseconds;
+        public ulong P99FrameMicroseconds;
+        public ulong MaxFrameMicroseconds;
+    }
+
+    public enum NativeObjectType
+    {
+        Application = 1,
+        Window,
+        DisplaySurface,
+        DeviceSelectionFilter,
+        DeviceSelector,
+        CommandStream,
+        Device,
+        DisplayContext,
+        TexturePool,
+        Texture,
+        ComputeContext,
+        ComputePipeline,
+        ComputeBuffer,
+        Scene,
+        Tessellator,
+        Capture,
+        JobCounter
     }
 
     public struct WindowCreateInfo
@@ -29,6 +138,17 @@ namespace Akarin.Interface
         IDisplaySurface CreateDisplaySurface();
     }
 
+    public interface ICommandStream : IDisposable
+    {
+        void Show(IWindow window);
+        void Hide(IWindow window);
+        void Minimize(IWindow window);
+        void Maximize(IWindow window);
+        // Writes a host visible compute buffer of the first device opened, like IComputeBuffer.Write
+        void UpdateBuffer(IComputeBuffer buffer, ulong offset, ReadOnlySpan<byte> data);
+        void Submit();
+    }
+
     public interface IDeviceSelectionFilter : IDisposable
     {
         ulong MemoryLowerLimit { get; set; }
@@ -46,11 +166,386 @@ namespace Akarin.Interface
     }
 
     public interface IDeviceSelector : IDisposable {
+        IDevice OpenDevice();
     }
 
     public interface IDevice : IDisposable
     {
         IDisplayContext CreateDisplayContext(IWindow window = null);
+        // Renders and presents every display context of the device once, only when no render thread is running
+        bool RenderFrame();
+        // When set, nothing is drawn or presented until a display context is damaged
+        bool RenderOnDemand { get; set; }
+        void GetPresentResults(ReadOnlySpan<IDisplayContext> contexts, Span<int> results);
+        ITexturePool CreateTexturePool();
+        // Block compressed families the device samples, pick the texture variants to ship or load from this
+        TextureCompression SupportedTextureCompression { get; }
+        // The Vulkan version the instance and the device agreed on
+        Version ApiVersion { get; }
+        DeviceFeatures Features { get; }
+        ShaderCacheStats GetShaderCacheStats();
+        PipelineCacheStats GetPipelineCacheStats();
+        // All zero without DeviceFeatures.DescriptorIndexing
+        TextureTableStats GetTextureTableStats();
+        // Framebuffers stay at zero with DeviceFeatures.DynamicRendering
+        RenderPassCacheStats GetRenderPassCacheStats();
+        // Drops unused cached objects and texture detail like a low memory event does, returns what was released
+        DeviceTrimStats Trim();
+        // Summed over every trim, low memory events included
+        DeviceTrimStats GetTrimStats();
+        MemoryHeapStats[] GetMemoryHeapStats();
+        MemoryTypeStats[] GetMemoryTypeStats();
+        // Fractions of each heap's budget; the callback gets the number of thresholds reached whenever it changes,
+        // after the next frame on a native worker thread, and may call back into the device. An empty list turns
+        // notifications off.
+        void SetMemoryThresholds(ReadOnlySpan<float> fractions, MemoryThresholdCallback callback);
+        // Runs on the async compute queue when the device has one
+        IComputeContext CreateComputeContext();
+    }
+
+    public delegate void MemoryThresholdCallback(uint heap, uint level, ulong usage, ulong budget);
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct MemoryHeapStats
+    {
+        public ulong Size;
+        public ulong Budget;
+        public ulong Usage;
+        public ulong Allocated;
+        public uint Flags;
+        public uint ThresholdLevel;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct MemoryTypeStats
+    {
+        public ulong Allocated;
+        public ulong Used;
+        public ulong Blocks;
+        public ulong Allocations;
+        public uint Heap;
+        public uint Flags;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ShaderCacheStats
+    {
+        public ulong Modules;
+        public ulong ReferencedModules;
+        public ulong CodeBytes;
+        public ulong Requests;
+        public ulong Hits;
+        public ulong FileMaps;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct PipelineCacheStats
+    {
+        public ulong Pipelines;
+        public ulong ReferencedPipelines;
+        public ulong Layouts;
+        public ulong Requests;
+        public ulong Hits;
+        public ulong Created;
+        public ulong Binds;
+        // Binds skipped because the pipeline was still bound
+        public ulong SkippedBinds;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TextureTableStats
+    {
+        public ulong Capacity;
+        public ulong Indices;
+        public ulong Writes;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct RenderPassCacheStats
+    {
+        public ulong RenderPasses;
+        public ulong Framebuffers;
+        public ulong ReferencedFramebuffers;
+        public ulong Requests;
+        public ulong Hits;
+        public ulong Evictions;
+    }
+
+    // Objects by count, device memory in bytes
+    [StructLayout(LayoutKind.Sequential)]
+    public struct DeviceTrimStats
+    {
+        public ulong Trims;
+        public ulong Shaders;
+        public ulong Pipelines;
+        public ulong Framebuffers;
+        // Freed by the texture pool shortly after the trim, unless the textures are used again
+        public ulong ScheduledTextureBytes;
+        public ulong ScheduledStagingBytes;
+    }
+
+    [Flags]
+    public enum TextureCompression
+    {
+        None = 0,
+        BC = 1,
+        ETC2 = 2,
+        ASTC = 4
+    }
+
+    [Flags]
+    public enum DeviceFeatures
+    {
+        None = 0,
+        TimelineSemaphore = 1,
+        DescriptorIndexing = 2,
+        DynamicRendering = 4
+    }
+
+    public interface ITexturePool : IDisposable
+    {
+        // Bytes of resident texels, 0 uses half of the memory budget the driver reports for video memory
+        ulong Budget { set; }
+        TexturePoolStats GetStats();
+        ITexture CreateTexture(uint width, uint height, ReadOnlySpan<byte> rgba8Pixels);
+        // Converts while copying the pixels in, e.g. BGRA or straight alpha from an image decoder
+        ITexture CreateTexture(uint width, uint height, ReadOnlySpan<byte> pixels, PixelConversion conversion);
+        // Maps a KTX2 file and streams its levels as they are, the format must be sampleable on the device
+        ITexture LoadTexture(string path);
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TexturePoolStats
+    {
+        public ulong Budget;
+        public ulong ResidentBytes;
+        public ulong Textures;
+        public ulong ResidentLevels;
+        public ulong Uploads;
+        public ulong UploadedBytes;
+        public ulong Evictions;
+        public ulong EvictedBytes;
+        public ulong PendingUploads;
+    }
+
+    public interface ITexture : IDisposable
+    {
+        uint LevelCount { get; }
+        // Finest mip level on the GPU, LevelCount while nothing is resident yet
+        uint ResidentLevel { get; }
+        // Size the texture is drawn at, streams in the levels needed for it
+        void RequestSize(uint width, uint height);
+        // Stable index into the device's texture table to pass as instance data, uint.MaxValue without
+        // DeviceFeatures.DescriptorIndexing
+        uint TableIndex { get; }
+    }
+
+    // Not thread safe, drive each context from a single thread
+    public interface IComputeContext : IDisposable
+    {
+        // SPIR-V whose buffers are storage buffers 0..bufferCount-1 of set 0
+        IComputePipeline CreatePipeline(ReadOnlySpan<byte> spirv, uint bufferCount, uint constantSize = 0);
+        IComputePipeline LoadPipeline(string path, uint bufferCount, uint constantSize = 0);
+        IComputeBuffer CreateBuffer(ulong size, ComputeBufferFlags flags = ComputeBufferFlags.None);
+        // Appends to the open batch; buffer and constant ranges of each dispatch index into the spans
+        void Record(ReadOnlySpan<ComputeDispatch> dispatches, ReadOnlySpan<ulong> buffers,
+            ReadOnlySpan<byte> constants);
+        // Returns the timeline value signalled once the batch completed
+        ulong Submit();
+        // The next rendered frame waits on the GPU until the value was reached
+        void SyncGraphics(ulong value);
+        bool Wait(ulong value, ulong timeoutNanoseconds = ulong.MaxValue);
+        ulong CompletedValue { get; }
+        ComputeStats GetStats();
+    }
+
+    public interface IComputePipeline : IDisposable
+    {
+        ulong Handle { get; }
+    }
+
+    public interface IComputeBuffer : IDisposable
+    {
+        ulong Handle { get; }
+        ulong Size { get; }
+        // Host visible buffers only
+        void Write(ulong offset, ReadOnlySpan<byte> data);
+        // Converts 8 bit pixels straight into the buffer
+        void WritePixels(ulong offset, ReadOnlySpan<byte> pixels, PixelConversion conversion);
+        void Read(ulong offset, Span<byte> data);
+    }
+
+    [Flags]
+    public enum ComputeBufferFlags : uint
+    {
+        None = 0,
+        HostVisible = 1
+    }
+
+    [Flags]
+    public enum ComputeDispatchFlags : uint
+    {
+        None = 0,
+        // Skips the barrier after the previous dispatch, for dispatches touching disjoint data
+        Concurrent = 1
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ComputeDispatch
+    {
+        public ulong Pipeline;
+        public uint FirstBuffer;
+        public uint BufferCount;
+        public uint ConstantOffset;
+        public uint ConstantSize;
+        public uint GroupCountX;
+        public uint GroupCountY;
+        public uint GroupCountZ;
+        public ComputeDispatchFlags Flags;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ComputeStats
+    {
+        public ulong SubmittedValue;
+        public ulong CompletedValue;
+        public ulong Batches;
+        public ulong Dispatches;
+        public ulong Pipelines;
+        public ulong Buffers;
+        public uint DedicatedQueue;
+    }
+
+    public enum SimdLevel : uint
+    {
+        Scalar = 0,
+        SSE2,
+        AVX2,
+        NEON
+    }
+
+    // Builds triangle lists for UI primitives on the CPU, splitting large batches across job system workers. Not thread
+    // safe, drive a tessellator from one thread at a time.
+    public interface ITessellator : IDisposable
+    {
+        // Defaults to the best level of the CPU, setting an unsupported level throws
+        SimdLevel Level { get; set; }
+        TessellateResult Measure(ReadOnlySpan<TessellatePrimitive> primitives);
+        // Path primitives index into `points`, x and y pairs. Indices are offset by baseVertex.
+        TessellateResult Tessellate(ReadOnlySpan<TessellatePrimitive> primitives, ReadOnlySpan<float> points,
+            Span<TessellateVertex> vertices, Span<uint> indices, uint baseVertex = 0);
+        // Writes straight into host visible buffers, offsets in bytes
+        TessellateResult Tessellate(ReadOnlySpan<TessellatePrimitive> primitives, ReadOnlySpan<float> points,
+            IComputeBuffer vertices, ulong vertexOffset, IComputeBuffer indices, ulong indexOffset,
+            uint baseVertex = 0);
+        // Primitives per millisecond of the scalar path, the selected level, and the selected level on all threads
+        TessellateBenchmark Benchmark(ulong primitiveCount = 100000, uint iterations = 10);
+    }
+
+    public enum TessellatePrimitiveType : uint
+    {
+        RoundedRect = 0,
+        Border,
+        Line,
+        Path
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TessellatePrimitive
+    {
+        public TessellatePrimitiveType Type;
+        // RGBA8
+        public uint Color;
+        // Rectangles and borders: x, y, width, height. Lines: both end points
+        public float X0;
+        public float Y0;
+        public float X1;
+        public float Y1;
+        public float Radius;
+        // Border thickness, stroke width of lines and paths
+        public float Width;
+        public uint FirstPoint;
+        public uint PointCount;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TessellateVertex
+    {
+        public float X;
+        public float Y;
+        public uint Color;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TessellateResult
+    {
+        public ulong Vertices;
+        public ulong Indices;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TessellateBenchmark
+    {
+        public ulong Primitives;
+        public uint Threads;
+        public SimdLevel Level;
+        public double ScalarPerMillisecond;
+        public double SimdPerMillisecond;
+        public double ParallelPerMillisecond;
+    }
+
+    // Applied in the order: SrgbToLinear, Premultiply, LinearToSrgb. Alpha is never changed.
+    [Flags]
+    public enum PixelConversion : uint
+    {
+        None = 0,
+        // RGBA <-> BGRA
+        SwapRedBlue = 1,
+        Premultiply = 2,
+        SrgbToLinear = 4,
+        LinearToSrgb = 8
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct PixelConvertBenchmark
+    {
+        public ulong Pixels;
+        public PixelConversion Conversion;
+        public SimdLevel Level;
+        public double ScalarGigabytesPerSecond;
+        public double SimdGigabytesPerSecond;
+    }
+
+    public delegate void JobAction(uint index);
+
+    // Jobs still to finish. Disposing waits for them; Wait helps running queued jobs rather than blocking a thread.
+    public interface IJobCounter : IDisposable
+    {
+        uint Value { get; }
+        void Wait();
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct JobSystemStats
+    {
+        public uint Workers;
+        public uint PinnedWorkers;
+        public ulong Jobs;
+        public ulong Steals;
+        // Jobs run by threads waiting for a counter
+        public ulong HelpedJobs;
+        public ulong Sleeps;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct JobBenchmark
+    {
+        public uint Workers;
+        public uint Jobs;
+        public double OverheadNanoseconds;
+        public double JobsPerMillisecond;
+        // Relative to the first entry
+        public double Speedup;
     }
 
     public interface IContext : IDisposable
@@ -58,8 +553,104 @@ namespace Akarin.Interface
     }
     
     public interface IDisplayContext : IContext {
+        // VkResult of the last present, negative once the swapchain is out of date or lost
+        int LastPresentResult { get; }
+        // Marks regions for redraw, in drawable pixels
+        void AddDamage(ReadOnlySpan<DamageRect> rects);
+        void DamageAll();
         IPipeline CreatePipeline(PipelineCreateInfo createInfo);
         IRenderer CreateRenderer(RendererCreateInfo createInfo);
+        // Replaces the scene drawn so far. The vertex shader reads instance gl_InstanceIndex from storage buffer 0 of
+        // set 0 and expands it into a 4 vertex triangle strip, the viewport size is a vec2 push constant. With
+        // descriptor indexing set 1 holds a sampler at binding 0 and every texture at binding 1, see TableIndex.
+        IScene CreateScene(ReadOnlySpan<byte> vertexSpirv, ReadOnlySpan<byte> fragmentSpirv, uint instanceSize);
+        IScene LoadScene(string vertexPath, string fragmentPath, uint instanceSize);
+        // Replaces the running capture. Frames larger than the limits are downscaled on the GPU, 0 means no limit.
+        ICapture CreateCapture(uint maxWidth = 0, uint maxHeight = 0, CaptureFormat format = CaptureFormat.Native,
+            uint slots = 0);
+    }
+
+    // Copies every presented frame into a ring of host visible buffers without stalling the GPU. Frames become
+    // available a few frames after they were presented; release them, a full ring drops new frames.
+    public interface ICapture : IDisposable
+    {
+        bool TryAcquireFrame(out CaptureFrame frame);
+        void ReleaseFrame(in CaptureFrame frame);
+        CaptureStats GetStats();
+    }
+
+    // Values are VkFormat
+    public enum CaptureFormat : uint
+    {
+        Native = 0,
+        RGBA8 = 37,
+        BGRA8 = 44
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct CaptureFrame
+    {
+        // Counts every capture attempt, gaps are dropped frames
+        public ulong Frame;
+        public IntPtr Data;
+        public ulong Size;
+        public uint Slot;
+        public uint Width;
+        public uint Height;
+        public uint RowPitch;
+        public CaptureFormat Format;
+
+        // Valid until the frame is released
+        public unsafe ReadOnlySpan<byte> Pixels => new ReadOnlySpan<byte>((void*) Data, (int) Size);
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct CaptureStats
+    {
+        public ulong Captured;
+        public ulong Delivered;
+        public ulong Dropped;
+        public uint Slots;
+        public uint InFlight;
+        public uint Ready;
+    }
+
+    // Nodes keep their instance resident on the GPU, edits upload only the bytes that changed. Edits damage the
+    // display context: only the bounds of a node that has them, the whole context for a node without.
+    public interface IScene : IDisposable
+    {
+        uint InstanceSize { get; }
+        // Instances are InstanceSize bytes each, one node per instance
+        void CreateNodes(ReadOnlySpan<byte> instances, Span<uint> nodes);
+        uint CreateNode(ReadOnlySpan<byte> instance);
+        // Overwrites part of the node's instance starting at `offset`
+        void UpdateNode(uint node, uint offset, ReadOnlySpan<byte> data);
+        void DestroyNodes(ReadOnlySpan<uint> nodes);
+        // Area in pixels the node draws to, set again whenever an edit moves or resizes it
+        void SetNodeBounds(uint node, DamageRect bounds);
+        SceneStats GetStats();
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct SceneStats
+    {
+        public ulong Nodes;
+        public ulong Slots;
+        public ulong Capacity;
+        public ulong DirtyRanges;
+        public ulong Uploads;
+        public ulong UploadedBytes;
+        public ulong LastUploadedBytes;
+        public ulong Frames;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct DamageRect
+    {
+        public int X;
+        public int Y;
+        public uint Width;
+        public uint Height;
     }
 
     public interface IMemoryResource : IDisposable
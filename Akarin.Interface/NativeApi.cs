@@ -0,0 +1,205 @@
+using System;
+using System.Runtime.InteropServices;
+
+namespace Akarin.Interface
+{
+    // Mirror of the native ApiTable, entries are in the same order and only ever appended. Calls go straight through
+    // the function pointers without marshalling: bool is a byte and strings are null terminated UTF-8.
+    [StructLayout(LayoutKind.Sequential)]
+    internal unsafe struct NativeApi
+    {
+        public const uint Version = 7;
+
+        public uint TableVersion;
+        public uint Size;
+
+        // Application
+        public delegate* unmanaged[Cdecl]<ulong> AkAppInit;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkAppControlHandOver;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkAppStop;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkAppStartRenderThread;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkAppStopRenderThread;
+        public delegate* unmanaged[Cdecl]<ulong, RenderThreadStats*, void> AkAppGetRenderThreadStats;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkAppFinalize;
+
+        // Windows
+        public delegate* unmanaged[Cdecl]<byte*, int, int, int, int, int, ulong> AkCreateWindow;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkShowWindow;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkHideWindow;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkMinimizeWindow;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkMaximizeWindow;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyWindow;
+        public delegate* unmanaged[Cdecl]<ulong*, uint, void> AkDestroyWindows;
+
+        // Command streams
+        public delegate* unmanaged[Cdecl]<uint, ulong> AkCreateCommandStream;
+        public delegate* unmanaged[Cdecl]<ulong, UIntPtr> AkGetCommandStreamData;
+        public delegate* unmanaged[Cdecl]<ulong, uint> AkGetCommandStreamCapacity;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, uint, uint> AkSubmitCommandStream;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyCommandStream;
+
+        // Display surfaces
+        public delegate* unmanaged[Cdecl]<ulong, ulong, ulong> AkCreateDisplaySurface;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, void> AkDestroyDisplaySurface;
+        public delegate* unmanaged[Cdecl]<ulong, ulong*, uint, void> AkDestroyDisplaySurfaces;
+
+        // Device selection
+        public delegate* unmanaged[Cdecl]<ulong> AkCreateDeviceSelectorFilter;
+        public delegate* unmanaged[Cdecl]<ulong, int, byte, void> AkDeviceSelectorFilterSetBool;
+        public delegate* unmanaged[Cdecl]<ulong, int, uint, void> AkDeviceSelectorFilterSetUInt;
+        public delegate* unmanaged[Cdecl]<ulong, int, ulong, void> AkDeviceSelectorFilterSetUInt64;
+        public delegate* unmanaged[Cdecl]<ulong, int, double, void> AkDeviceSelectorFilterSetDouble;
+        public delegate* unmanaged[Cdecl]<ulong, int, ulong, void> AkDeviceSelectorFilterSetHandle;
+        public delegate* unmanaged[Cdecl]<ulong, int, byte> AkDeviceSelectorFilterGetBool;
+        public delegate* unmanaged[Cdecl]<ulong, int, uint> AkDeviceSelectorFilterGetUInt;
+        public delegate* unmanaged[Cdecl]<ulong, int, ulong> AkDeviceSelectorFilterGetUInt64;
+        public delegate* unmanaged[Cdecl]<ulong, int, double> AkDeviceSelectorFilterGetDouble;
+        public delegate* unmanaged[Cdecl]<ulong, int, ulong> AkDeviceSelectorFilterGetHandle;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyDeviceSelectorFilter;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, ulong> AkFilterDevices;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, ulong> AkOpenDevice;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkReleaseDeviceFilterResults;
+
+        // Devices
+        public delegate* unmanaged[Cdecl]<ulong, void> AkCloseDevice;
+        public delegate* unmanaged[Cdecl]<ulong, byte> AkDeviceRenderFrame;
+        public delegate* unmanaged[Cdecl]<ulong, byte, void> AkDeviceSetRenderOnDemand;
+        public delegate* unmanaged[Cdecl]<ulong, byte> AkDeviceGetRenderOnDemand;
+        public delegate* unmanaged[Cdecl]<ulong, uint> AkDeviceGetTextureCompression;
+        public delegate* unmanaged[Cdecl]<ulong, uint> AkDeviceGetApiVersion;
+        public delegate* unmanaged[Cdecl]<ulong, uint> AkDeviceGetFeatures;
+
+        // Device memory
+        public delegate* unmanaged[Cdecl]<ulong, MemoryHeapStats*, uint, uint> AkDeviceGetMemoryHeapStats;
+        public delegate* unmanaged[Cdecl]<ulong, MemoryTypeStats*, uint, uint> AkDeviceGetMemoryTypeStats;
+        public delegate* unmanaged[Cdecl]<ulong, float*, uint, IntPtr, IntPtr, byte> AkDeviceSetMemoryThresholds;
+
+        // Shaders
+        public delegate* unmanaged[Cdecl]<ulong, ShaderCacheStats*, void> AkDeviceGetShaderStats;
+        public delegate* unmanaged[Cdecl]<ulong, ulong> AkDeviceTrimShaders;
+
+        // Host allocations
+        public delegate* unmanaged[Cdecl]<HostAllocatorStats*, void> AkGetHostAllocatorStats;
+
+        // Display contexts
+        public delegate* unmanaged[Cdecl]<ulong, ulong, ulong> AkCreateDisplayContext;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, void> AkDestroyDisplayContext;
+        public delegate* unmanaged[Cdecl]<ulong, DamageRect*, uint, void> AkDisplayContextAddDamage;
+        public delegate* unmanaged[Cdecl]<ulong, int> AkDisplayContextGetPresentResult;
+        public delegate* unmanaged[Cdecl]<ulong*, int*, uint, void> AkDisplayContextGetPresentResults;
+
+        // Textures
+        public delegate* unmanaged[Cdecl]<ulong, ulong> AkCreateTexturePool;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyTexturePool;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, void> AkTexturePoolSetBudget;
+        public delegate* unmanaged[Cdecl]<ulong, TexturePoolStats*, void> AkTexturePoolGetStats;
+        public delegate* unmanaged[Cdecl]<ulong, uint, uint, byte*, uint, ulong> AkCreateTextureRGBA8Converted;
+        public delegate* unmanaged[Cdecl]<ulong, uint, uint, byte*, ulong> AkCreateTextureRGBA8;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyTexture;
+        public delegate* unmanaged[Cdecl]<ulong, uint, uint, void> AkTextureRequestSize;
+        public delegate* unmanaged[Cdecl]<ulong, uint> AkTextureGetLevelCount;
+        public delegate* unmanaged[Cdecl]<ulong, uint> AkTextureGetResidentLevel;
+        public delegate* unmanaged[Cdecl]<ulong, byte*, ulong> AkCreateTextureKTX2;
+
+        // Scenes
+        public delegate* unmanaged[Cdecl]<ulong, byte*, UIntPtr, byte*, UIntPtr, uint, ulong> AkCreateScene;
+        public delegate* unmanaged[Cdecl]<ulong, byte*, byte*, uint, ulong> AkLoadScene;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyScene;
+        public delegate* unmanaged[Cdecl]<ulong, byte*, uint, uint*, byte> AkSceneCreateNodes;
+        public delegate* unmanaged[Cdecl]<ulong, uint, uint, byte*, uint, byte> AkSceneUpdateNode;
+        public delegate* unmanaged[Cdecl]<ulong, uint*, uint, void> AkSceneDestroyNodes;
+        public delegate* unmanaged[Cdecl]<ulong, SceneStats*, void> AkSceneGetStats;
+
+        // Compute
+        public delegate* unmanaged[Cdecl]<ulong, ulong> AkCreateComputeContext;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyComputeContext;
+        public delegate* unmanaged[Cdecl]<ulong, byte*, UIntPtr, uint, uint, ulong> AkCreateComputePipeline;
+        public delegate* unmanaged[Cdecl]<ulong, byte*, uint, uint, ulong> AkLoadComputePipeline;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyComputePipeline;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, ComputeBufferFlags, ulong> AkCreateComputeBuffer;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyComputeBuffer;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, byte*, ulong, byte> AkComputeBufferWrite;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, byte*, ulong, uint, byte> AkComputeBufferWritePixels;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, byte*, ulong, byte> AkComputeBufferRead;
+        public delegate* unmanaged[Cdecl]<ulong, TessellatePrimitive*, ulong, float*, ulong, ulong, ulong, ulong, ulong,
+            uint, TessellateResult*, byte> AkTessellateToComputeBuffers;
+        public delegate* unmanaged[Cdecl]<ulong, ComputeDispatch*, uint, ulong*, uint, byte*, uint,
+            byte> AkComputeRecord;
+        public delegate* unmanaged[Cdecl]<ulong, ulong*, byte> AkComputeSubmit;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, void> AkComputeSyncGraphics;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, ulong, byte> AkComputeWait;
+        public delegate* unmanaged[Cdecl]<ulong, ulong> AkComputeGetCompletedValue;
+        public delegate* unmanaged[Cdecl]<ulong, ComputeStats*, void> AkComputeGetStats;
+
+        // Tessellation
+        public delegate* unmanaged[Cdecl]<uint, ulong> AkCreateTessellator;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyTessellator;
+        public delegate* unmanaged[Cdecl]<ulong, uint> AkTessellatorGetLevel;
+        public delegate* unmanaged[Cdecl]<ulong, uint, byte> AkTessellatorSetLevel;
+        public delegate* unmanaged[Cdecl]<TessellatePrimitive*, ulong, TessellateResult*, void> AkTessellateMeasure;
+        public delegate* unmanaged[Cdecl]<ulong, TessellatePrimitive*, ulong, float*, ulong, TessellateVertex*, ulong,
+            uint*, ulong, uint, TessellateResult*, byte> AkTessellate;
+        public delegate* unmanaged[Cdecl]<ulong, ulong, uint, TessellateBenchmark*, byte> AkTessellatorBenchmark;
+
+        // Capture
+        public delegate* unmanaged[Cdecl]<ulong, CaptureCreateInfo*, ulong> AkCreateCapture;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyCapture;
+        public delegate* unmanaged[Cdecl]<ulong, CaptureFrame*, byte> AkCaptureAcquireFrame;
+        public delegate* unmanaged[Cdecl]<ulong, uint, void> AkCaptureReleaseFrame;
+        public delegate* unmanaged[Cdecl]<ulong, CaptureStats*, void> AkCaptureGetStats;
+
+        // Pixel conversion
+        public delegate* unmanaged[Cdecl]<byte*, byte*, ulong, uint, void> AkConvertPixels;
+        public delegate* unmanaged[Cdecl]<ulong, uint, uint, PixelConvertBenchmark*, byte> AkPixelConversionBenchmark;
+
+        // Diagnostics
+        public delegate* unmanaged[Cdecl]<uint> AkGetSimdLevel;
+        public delegate* unmanaged[Cdecl]<int, ulong> AkGetLiveObjectCount;
+        public delegate* unmanaged[Cdecl]<ulong> AkGetPendingDeletionCount;
+
+        // Traces
+        public delegate* unmanaged[Cdecl]<byte*, byte> AkTraceStart;
+        public delegate* unmanaged[Cdecl]<ulong> AkTraceStop;
+        public delegate* unmanaged[Cdecl]<byte*, uint, byte*, byte*, TraceReplayStats*, byte> AkReplayTrace;
+
+        // Version 2
+        public delegate* unmanaged[Cdecl]<ulong, PipelineCacheStats*, void> AkDeviceGetPipelineStats;
+        public delegate* unmanaged[Cdecl]<ulong, ulong> AkDeviceTrimPipelines;
+
+        // Version 3
+        public delegate* unmanaged[Cdecl]<ulong, uint> AkTextureGetTableIndex;
+        public delegate* unmanaged[Cdecl]<ulong, TextureTableStats*, void> AkDeviceGetTextureTableStats;
+
+        // Version 4
+        public delegate* unmanaged[Cdecl]<ulong, RenderPassCacheStats*, void> AkDeviceGetRenderPassStats;
+
+        // Version 5
+        public delegate* unmanaged[Cdecl]<ulong, DeviceTrimStats*, void> AkDeviceTrim;
+        public delegate* unmanaged[Cdecl]<ulong, DeviceTrimStats*, void> AkDeviceGetTrimStats;
+
+        // Version 6
+        public delegate* unmanaged[Cdecl]<uint, byte, byte> AkJobSystemStart;
+        public delegate* unmanaged[Cdecl]<JobSystemStats*, void> AkJobSystemGetStats;
+        public delegate* unmanaged[Cdecl]<ulong> AkCreateJobCounter;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkDestroyJobCounter;
+        public delegate* unmanaged[Cdecl]<ulong, uint> AkJobCounterGetValue;
+        public delegate* unmanaged[Cdecl]<ulong, void> AkJobCounterWait;
+        public delegate* unmanaged[Cdecl]<IntPtr, IntPtr, uint, ulong, ulong, byte> AkJobSystemRun;
+        public delegate* unmanaged[Cdecl]<uint, uint, JobBenchmark*, uint, uint> AkJobSystemBenchmark;
+
+        // Version 7
+        public delegate* unmanaged[Cdecl]<ulong, uint, DamageRect*, byte> AkSceneSetNodeBounds;
+    }
+
+    // Callbacks are for native consumers, managed captures poll
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct CaptureCreateInfo
+    {
+        public uint Slots;
+        public uint MaxWidth;
+        public uint MaxHeight;
+        public CaptureFormat Format;
+        public IntPtr Callback;
+        public IntPtr User;
+    }
+}
\ No newline at end of file
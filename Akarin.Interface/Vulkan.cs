@@ -1,29 +1,83 @@
 using System;
+using System.Text;
+using System.Threading;
+using System.Collections.Generic;
 using System.Runtime.InteropServices;
 
 namespace Akarin.Interface
 {
-    public class Vulkan : IApplication
+    public unsafe class Vulkan : IApplication
     {
         private const string NativeLib = "AkarinNative";
 
-        private static UIntPtr instanceHandle;
+        [DllImport(NativeLib, EntryPoint = "akGetApiTable", CallingConvention = CallingConvention.Cdecl)]
+        private static extern NativeApi* AkGetApiTable(uint version);
 
-        [DllImport(NativeLib, EntryPoint = "akAppInit", CallingConvention = CallingConvention.Cdecl)]
-        private static extern UIntPtr AkAppInit();
+        // The only symbol looked up, every other call goes through the table
+        private static readonly NativeApi* Api = LoadApi();
 
-        [DllImport(NativeLib, EntryPoint = "akAppControlHandOver", CallingConvention = CallingConvention.Cdecl)]
-        private static extern void AkAppControlHandOver(UIntPtr handle);
+        private static ulong instanceHandle;
 
-        [DllImport(NativeLib, EntryPoint = "akAppStop", CallingConvention = CallingConvention.Cdecl)]
-        private static extern void AkAppStop(UIntPtr handle);
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        private delegate void NativeJobFunction(IntPtr context, uint index);
 
-        [DllImport(NativeLib, EntryPoint = "akAppFinalize", CallingConvention = CallingConvention.Cdecl)]
-        private static extern void AkAppFinalize(UIntPtr handle);
+        // Every managed batch goes through the same callback, so it lives as long as the process
+        private static readonly NativeJobFunction JobCallback = RunJob;
+        private static readonly IntPtr JobCallbackPointer = Marshal.GetFunctionPointerForDelegate(JobCallback);
+
+        private static NativeApi* LoadApi()
+        {
+            var api = AkGetApiTable(NativeApi.Version);
+            if (api == null)
+                throw new InvalidOperationException($"native library does not provide API version {NativeApi.Version}");
+            return api;
+        }
+
+        // Null terminated UTF-8 in `buffer` if it fits, null stays null
+        private static Span<byte> Utf8(string value, Span<byte> buffer)
+        {
+            if (value == null)
+                return Span<byte>.Empty;
+            var size = Encoding.UTF8.GetByteCount(value) + 1;
+            var bytes = size <= buffer.Length ? buffer.Slice(0, size) : new byte[size];
+            bytes[Encoding.UTF8.GetBytes(value, bytes)] = 0;
+            return bytes;
+        }
+
+        // Records events and API calls until StopTrace, start it before creating the application
+        public static void StartTrace(string path)
+        {
+            byte ok;
+            fixed (byte* pathData = Utf8(path, stackalloc byte[256]))
+                ok = Api->AkTraceStart(pathData);
+            if (ok == 0)
+                throw new InvalidOperationException("Failed to start trace");
+        }
+
+        // Returns the number of records written
+        public static ulong StopTrace()
+        {
+            return Api->AkTraceStop();
+        }
+
+        // Replays a trace in place of an application, driverFiles picks the Vulkan driver, e.g. a software one
+        public static TraceReplayStats ReplayTrace(string path, TraceReplayFlags flags = TraceReplayFlags.None,
+            string driverFiles = null, string videoDriver = null)
+        {
+            TraceReplayStats stats;
+            byte ok;
+            fixed (byte* pathData = Utf8(path, stackalloc byte[256]))
+            fixed (byte* driverData = Utf8(driverFiles, stackalloc byte[256]))
+            fixed (byte* videoData = Utf8(videoDriver, stackalloc byte[32]))
+                ok = Api->AkReplayTrace(pathData, (uint) flags, driverData, videoData, &stats);
+            if (ok == 0)
+                throw new InvalidOperationException("Failed to replay trace");
+            return stats;
+        }
 
         public Vulkan()
         {
-            instanceHandle = AkAppInit();
+            instanceHandle = Api->AkAppInit();
         }
         
         ~Vulkan()
@@ -33,14 +87,13 @@ namespace Akarin.Interface
         
         public void Dispose()
         {
-            GC.Collect(); // This class contains critical context info. just making sure everything is released
             GC.SuppressFinalize(this);
-            AkAppFinalize(instanceHandle);
+            Api->AkAppFinalize(instanceHandle);
         }
 
         public void ResumeControl()
         {
-            AkAppControlHandOver(instanceHandle);
+            Api->AkAppControlHandOver(instanceHandle);
         }
 
         public IDeviceSelectionFilter CreateDeviceSelectionFilter()
@@ -58,31 +111,190 @@ namespace Akarin.Interface
             return new SDLWindow(createInfo);
         }
 
-        private class SDLWindow : IWindow
+        public ICommandStream CreateCommandStream(uint capacity)
         {
-            [DllImport(NativeLib, EntryPoint = "akCreateWindow", CallingConvention = CallingConvention.Cdecl)]
-            private static extern UIntPtr AkCreateWindow([MarshalAs(UnmanagedType.LPStr)] string caption, int display,
-                int positionX, int positionY, int width, int height);
+            return new NativeCommandStream(capacity);
+        }
 
-            [DllImport(NativeLib, EntryPoint = "akShowWindow", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkShowWindow(UIntPtr handle);
+        public ulong GetLiveObjectCount(NativeObjectType type)
+        {
+            return Api->AkGetLiveObjectCount((int) type);
+        }
 
-            [DllImport(NativeLib, EntryPoint = "akHideWindow", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkHideWindow(UIntPtr handle);
+        public void StartRenderThread()
+        {
+            Api->AkAppStartRenderThread(instanceHandle);
+        }
 
-            [DllImport(NativeLib, EntryPoint = "akMinimizeWindow", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkMinimizeWindow(UIntPtr handle);
+        public void StopRenderThread()
+        {
+            Api->AkAppStopRenderThread(instanceHandle);
+        }
 
-            [DllImport(NativeLib, EntryPoint = "akMaximizeWindow", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkMaximizeWindow(UIntPtr handle);
+        public RenderThreadStats GetRenderThreadStats()
+        {
+            RenderThreadStats stats;
+            Api->AkAppGetRenderThreadStats(instanceHandle, &stats);
+            return stats;
+        }
 
-            [DllImport(NativeLib, EntryPoint = "akDestroyWindow", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkDestroyWindow(UIntPtr handle);
-            
+        public HostAllocatorStats GetHostAllocatorStats()
+        {
+            HostAllocatorStats stats;
+            Api->AkGetHostAllocatorStats(&stats);
+            return stats;
+        }
+
+        public SimdLevel SimdLevel => (SimdLevel) Api->AkGetSimdLevel();
+
+        public ITessellator CreateTessellator(uint threads)
+        {
+            return new NativeTessellator(threads);
+        }
+
+        public unsafe void ConvertPixels(ReadOnlySpan<byte> source, Span<byte> destination, PixelConversion conversion)
+        {
+            if (destination.Length < source.Length)
+                throw new ArgumentException("destination is smaller than the source", nameof(destination));
+            fixed (byte* sourceData = source)
+            fixed (byte* destinationData = destination)
+                Api->AkConvertPixels(sourceData, destinationData, (ulong) source.Length / 4, (uint) conversion);
+        }
+
+        public PixelConvertBenchmark BenchmarkPixelConversion(PixelConversion conversion, ulong pixels,
+            uint iterations)
+        {
+            PixelConvertBenchmark result;
+            if (Api->AkPixelConversionBenchmark(pixels, (uint) conversion, iterations, &result) == 0)
+                throw new InvalidOperationException("pixel conversion benchmark failed");
+            return result;
+        }
+
+        public bool StartJobSystem(uint workers, bool pinWorkers)
+        {
+            return Api->AkJobSystemStart(workers, pinWorkers ? (byte) 1 : (byte) 0) != 0;
+        }
+
+        public IJobCounter CreateJobCounter()
+        {
+            return new NativeJobCounter();
+        }
+
+        public void RunJobs(JobAction job, uint count, IJobCounter counter, IJobCounter after)
+        {
+            if (job == null)
+                throw new ArgumentNullException(nameof(job));
+            if (count == 0)
+                return;
+            var batch = new JobBatch {Job = job, Counter = counter as NativeJobCounter, Remaining = count};
+            batch.Handle = GCHandle.Alloc(batch);
+            var ok = Api->AkJobSystemRun(JobCallbackPointer, GCHandle.ToIntPtr(batch.Handle), count,
+                batch.Counter?.Handle ?? 0, (after as NativeJobCounter)?.Handle ?? 0);
+            if (ok == 0)
+            {
+                batch.Handle.Free();
+                throw new InvalidOperationException("failed to queue jobs");
+            }
+        }
+
+        public JobSystemStats GetJobSystemStats()
+        {
+            JobSystemStats stats;
+            Api->AkJobSystemGetStats(&stats);
+            return stats;
+        }
+
+        public JobBenchmark[] BenchmarkJobSystem(uint jobs, uint iterations)
+        {
+            var results = new JobBenchmark[64];
+            uint count;
+            fixed (JobBenchmark* data = results)
+                count = Api->AkJobSystemBenchmark(jobs, iterations, data, (uint) results.Length);
+            if (count == 0)
+                throw new InvalidOperationException("job system benchmark failed");
+            Array.Resize(ref results, (int) count);
+            return results;
+        }
+
+        // Runs on a native worker, an exception must not unwind into it
+        private static void RunJob(IntPtr context, uint index)
+        {
+            var batch = (JobBatch) GCHandle.FromIntPtr(context).Target;
+            try
+            {
+                batch.Job(index);
+            }
+            catch (Exception e)
+            {
+                batch.Counter?.AddException(e);
+            }
+            if (Interlocked.Decrement(ref batch.Remaining) == 0)
+                batch.Handle.Free();
+        }
+
+        private class JobBatch
+        {
+            public JobAction Job;
+            // Keeps the counter alive while jobs still count on it
+            public NativeJobCounter Counter;
+            public long Remaining;
+            public GCHandle Handle;
+        }
+
+        private class NativeJobCounter : IJobCounter
+        {
+            public NativeJobCounter()
+            {
+                Handle = Api->AkCreateJobCounter();
+                if (Handle == 0)
+                    throw new InvalidOperationException("failed to create a job counter");
+            }
+
+            ~NativeJobCounter()
+            {
+                Dispose();
+            }
+
+            public void Dispose()
+            {
+                Api->AkDestroyJobCounter(Handle);
+                GC.SuppressFinalize(this);
+            }
+
+            public ulong Handle { get; }
+
+            public uint Value => Api->AkJobCounterGetValue(Handle);
+
+            public void Wait()
+            {
+                Api->AkJobCounterWait(Handle);
+                Exception[] exceptions;
+                lock (_exceptions)
+                {
+                    if (_exceptions.Count == 0)
+                        return;
+                    exceptions = _exceptions.ToArray();
+                    _exceptions.Clear();
+                }
+                throw new AggregateException(exceptions);
+            }
+
+            public void AddException(Exception exception)
+            {
+                lock (_exceptions)
+                    _exceptions.Add(exception);
+            }
+
+            private readonly List<Exception> _exceptions = new List<Exception>();
+        }
+
+        private class SDLWindow : IWindow
+        {
             public SDLWindow(WindowCreateInfo createInfo)
             {
-                _handle = AkCreateWindow(createInfo.Caption, createInfo.Display, createInfo.PositionX,
-                    createInfo.PositionY, createInfo.Width, createInfo.Height);
+                fixed (byte* caption = Utf8(createInfo.Caption, stackalloc byte[256]))
+                    _handle = Api->AkCreateWindow(caption, createInfo.Display, createInfo.PositionX,
+                        createInfo.PositionY, createInfo.Width, createInfo.Height);
             }
 
             ~SDLWindow()
@@ -93,27 +305,27 @@ namespace Akarin.Interface
             public void Dispose()
             {
                 GC.SuppressFinalize(this);
-                AkDestroyWindow(_handle);
+                Api->AkDestroyWindow(_handle);
             }
 
             public void Show()
             {
-                AkShowWindow(_handle);
+                Api->AkShowWindow(_handle);
             }
 
             public void Hide()
             {
-                AkHideWindow(_handle);
+                Api->AkHideWindow(_handle);
             }
 
             public void Minimize()
             {
-                AkMinimizeWindow(_handle);
+                Api->AkMinimizeWindow(_handle);
             }
 
             public void Maximize()
             {
-                AkMaximizeWindow(_handle);
+                Api->AkMaximizeWindow(_handle);
             }
 
             public IDisplaySurface CreateDisplaySurface()
@@ -121,82 +333,131 @@ namespace Akarin.Interface
                 return new SDLVkDisplaySurface(_handle);
             }
 
-            private readonly UIntPtr _handle;
+            public ulong GetNative()
+            {
+                return _handle;
+            }
+
+            private readonly ulong _handle;
         }
 
-        private class SDLVkDisplaySurface : IDisplaySurface
+        private unsafe class NativeCommandStream : ICommandStream
         {
-            [DllImport(NativeLib, EntryPoint = "akCreateDisplaySurface", CallingConvention = CallingConvention.Cdecl)]
-            private static extern UIntPtr AkCreateDisplaySurface(UIntPtr application, UIntPtr window);
+            private enum Op : uint
+            {
+                WindowShow = 0x100,
+                WindowHide,
+                WindowMinimize,
+                WindowMaximize,
+                BufferUpdate = 0x200
+            }
 
-            [DllImport(NativeLib, EntryPoint = "akDestroyDisplaySurface", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkDestroyDisplaySurface(UIntPtr application, UIntPtr surface);
+            private const uint HeaderSize = 8;
+            private const uint Alignment = 8;
 
-            public SDLVkDisplaySurface(UIntPtr window)
+            public NativeCommandStream(uint capacity)
             {
-                _handle = AkCreateDisplaySurface(instanceHandle, window);
+                _handle = Api->AkCreateCommandStream(capacity);
+                _data = (byte*) Api->AkGetCommandStreamData(_handle);
+                _capacity = Api->AkGetCommandStreamCapacity(_handle);
             }
 
-            ~SDLVkDisplaySurface()
+            ~NativeCommandStream()
             {
                 Dispose();
             }
 
             public void Dispose()
             {
-                AkDestroyDisplaySurface(instanceHandle, _handle);
+                Api->AkDestroyCommandStream(_handle);
                 GC.SuppressFinalize(this);
             }
 
-            public UIntPtr GetNative()
-            {
-                return _handle;
-            }
-            
-            private readonly UIntPtr _handle;
-        }
+            public void Show(IWindow window) => WriteWindow(Op.WindowShow, window);
 
-        private class VkDeviceSelectionFilter : IDeviceSelectionFilter
-        {
-            [DllImport(NativeLib, EntryPoint = "akCreateDeviceSelectorFilter", CallingConvention = CallingConvention.Cdecl)]
-            private static extern UIntPtr AkCreateDeviceSelectorFilter();
+            public void Hide(IWindow window) => WriteWindow(Op.WindowHide, window);
 
-            [DllImport(NativeLib, EntryPoint = "akDeviceSelectorFilterSetBool", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkDeviceSelectorFilterSetBool(UIntPtr handle, int name, bool value);
+            public void Minimize(IWindow window) => WriteWindow(Op.WindowMinimize, window);
 
-            [DllImport(NativeLib, EntryPoint = "akDeviceSelectorFilterSetUInt", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkDeviceSelectorFilterSetUInt(UIntPtr handle, int name, uint value);
+            public void Maximize(IWindow window) => WriteWindow(Op.WindowMaximize, window);
 
-            [DllImport(NativeLib, EntryPoint = "akDeviceSelectorFilterSetUInt64", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkDeviceSelectorFilterSetUInt64(UIntPtr handle, int name, ulong value);
+            public void UpdateBuffer(IComputeBuffer buffer, ulong offset, ReadOnlySpan<byte> data)
+            {
+                var payload = Reserve(Op.BufferUpdate, 24 + (uint) data.Length);
+                *(ulong*) payload = buffer.Handle;
+                *(ulong*) (payload + 8) = offset;
+                *(uint*) (payload + 16) = (uint) data.Length;
+                *(uint*) (payload + 20) = 0;
+                data.CopyTo(new Span<byte>(payload + 24, data.Length));
+            }
 
-            [DllImport(NativeLib, EntryPoint = "akDeviceSelectorFilterSetDouble", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkDeviceSelectorFilterSetDouble(UIntPtr handle, int name, double value);
+            public void Submit()
+            {
+                if (_size == 0) return;
+                Api->AkSubmitCommandStream(instanceHandle, _handle, _size);
+                _size = 0;
+            }
 
-            [DllImport(NativeLib, EntryPoint = "akDeviceSelectorFilterSetHandle", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkDeviceSelectorFilterSetHandle(UIntPtr handle, int name, UIntPtr value);
+            private void WriteWindow(Op op, IWindow window)
+            {
+                *(ulong*) Reserve(op, 8) = ((SDLWindow) window).GetNative();
+            }
 
-            [DllImport(NativeLib, EntryPoint = "akDeviceSelectorFilterGetBool", CallingConvention = CallingConvention.Cdecl)]
-            private static extern bool AkDeviceSelectorFilterGetBool(UIntPtr handle, int name);
+            // Returns the payload address of a new record, flushing the stream first when it is full
+            private byte* Reserve(Op op, uint payloadSize)
+            {
+                var size = (HeaderSize + payloadSize + Alignment - 1) & ~(Alignment - 1);
+                if (_size + size > _capacity)
+                {
+                    Submit();
+                    if (size > _capacity)
+                        throw new ArgumentOutOfRangeException(nameof(payloadSize), "command exceeds stream capacity");
+                }
 
-            [DllImport(NativeLib, EntryPoint = "akDeviceSelectorFilterGetUInt", CallingConvention = CallingConvention.Cdecl)]
-            private static extern uint AkDeviceSelectorFilterGetUInt(UIntPtr handle, int name);
+                var record = _data + _size;
+                *(uint*) record = (uint) op;
+                *(uint*) (record + 4) = size;
+                _size += size;
+                return record + HeaderSize;
+            }
 
-            [DllImport(NativeLib, EntryPoint = "akDeviceSelectorFilterGetUInt64", CallingConvention = CallingConvention.Cdecl)]
-            private static extern ulong AkDeviceSelectorFilterGetUInt64(UIntPtr handle, int name);
+            private readonly ulong _handle;
+            private readonly byte* _data;
+            private readonly uint _capacity;
+            private uint _size;
+        }
 
-            [DllImport(NativeLib, EntryPoint = "akDeviceSelectorFilterGetDouble", CallingConvention = CallingConvention.Cdecl)]
-            private static extern double AkDeviceSelectorFilterGetDouble(UIntPtr handle, int name);
+        private class SDLVkDisplaySurface : IDisplaySurface
+        {
+            public SDLVkDisplaySurface(ulong window)
+            {
+                _handle = Api->AkCreateDisplaySurface(instanceHandle, window);
+            }
 
-            [DllImport(NativeLib, EntryPoint = "akDeviceSelectorFilterGetHandle", CallingConvention = CallingConvention.Cdecl)]
-            private static extern UIntPtr AkDeviceSelectorFilterGetHandle(UIntPtr handle, int name);
+            ~SDLVkDisplaySurface()
+            {
+                Dispose();
+            }
 
-            [DllImport(NativeLib, EntryPoint = "akDestroyDeviceSelectorFilter", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkDestroyDeviceSelectorFilter(UIntPtr handle);
+            public void Dispose()
+            {
+                Api->AkDestroyDisplaySurface(instanceHandle, _handle);
+                GC.SuppressFinalize(this);
+            }
 
+            public ulong GetNative()
+            {
+                return _handle;
+            }
+            
+            private readonly ulong _handle;
+        }
+
+        private class VkDeviceSelectionFilter : IDeviceSelectionFilter
+        {
             public VkDeviceSelectionFilter()
             {
-                _handle = AkCreateDeviceSelectorFilter();
+                _handle = Api->AkCreateDeviceSelectorFilter();
             }
             
 
@@ -207,7 +468,7 @@ namespace Akarin.Interface
             
             public void Dispose()
             {
-                AkDestroyDeviceSelectorFilter(_handle);
+                Api->AkDestroyDeviceSelectorFilter(_handle);
                 GC.SuppressFinalize(this);
             }
 
@@ -225,71 +486,74 @@ namespace Akarin.Interface
             
             public ulong MemoryLowerLimit
             {
-                get => AkDeviceSelectorFilterGetUInt64(_handle, (int) Names.MemoryLowerLimit);
-                set => AkDeviceSelectorFilterSetUInt64(_handle, (int) Names.MemoryLowerLimit, value);
+                get => Api->AkDeviceSelectorFilterGetUInt64(_handle, (int) Names.MemoryLowerLimit);
+                set => Api->AkDeviceSelectorFilterSetUInt64(_handle, (int) Names.MemoryLowerLimit, value);
             }
 
             public uint Texture1DMaxDimension 
             {
-                get => AkDeviceSelectorFilterGetUInt(_handle, (int) Names.Texture1DMaxDimension);
-                set => AkDeviceSelectorFilterSetUInt(_handle, (int) Names.Texture1DMaxDimension, value);
+                get => Api->AkDeviceSelectorFilterGetUInt(_handle, (int) Names.Texture1DMaxDimension);
+                set => Api->AkDeviceSelectorFilterSetUInt(_handle, (int) Names.Texture1DMaxDimension, value);
             }
             
             public uint Texture2DMaxDimension 
             {
-                get => AkDeviceSelectorFilterGetUInt(_handle, (int) Names.Texture2DMaxDimension);
-                set => AkDeviceSelectorFilterSetUInt(_handle, (int) Names.Texture2DMaxDimension, value);
+                get => Api->AkDeviceSelectorFilterGetUInt(_handle, (int) Names.Texture2DMaxDimension);
+                set => Api->AkDeviceSelectorFilterSetUInt(_handle, (int) Names.Texture2DMaxDimension, value);
             }
             
             public uint Texture3DMaxDimension 
             {
-                get => AkDeviceSelectorFilterGetUInt(_handle, (int) Names.Texture3DMaxDimension);
-                set => AkDeviceSelectorFilterSetUInt(_handle, (int) Names.Texture3DMaxDimension, value);
+                get => Api->AkDeviceSelectorFilterGetUInt(_handle, (int) Names.Texture3DMaxDimension);
+                set => Api->AkDeviceSelectorFilterSetUInt(_handle, (int) Names.Texture3DMaxDimension, value);
             }
             
             public bool RequireSwapChainAndPresent 
             {
-                get => AkDeviceSelectorFilterGetBool(_handle, (int) Names.RequireSwapChainAndPresent);
-                set => AkDeviceSelectorFilterSetBool(_handle, (int) Names.RequireSwapChainAndPresent, value);
+                get => Api->AkDeviceSelectorFilterGetBool(_handle, (int) Names.RequireSwapChainAndPresent) != 0;
+                set => Api->AkDeviceSelectorFilterSetBool(_handle, (int) Names.RequireSwapChainAndPresent,
+                    (byte) (value ? 1 : 0));
             }
 
             public bool RequireGraphics
             {
-                get => AkDeviceSelectorFilterGetBool(_handle, (int) Names.RequireGraphics);
-                set => AkDeviceSelectorFilterSetBool(_handle, (int) Names.RequireGraphics, value);
+                get => Api->AkDeviceSelectorFilterGetBool(_handle, (int) Names.RequireGraphics) != 0;
+                set => Api->AkDeviceSelectorFilterSetBool(_handle, (int) Names.RequireGraphics, (byte) (value ? 1 : 0));
             }
             
             public bool RequireCompute 
             {
-                get => AkDeviceSelectorFilterGetBool(_handle, (int) Names.RequireCompute);
-                set => AkDeviceSelectorFilterSetBool(_handle, (int) Names.RequireCompute, value);
+                get => Api->AkDeviceSelectorFilterGetBool(_handle, (int) Names.RequireCompute) != 0;
+                set => Api->AkDeviceSelectorFilterSetBool(_handle, (int) Names.RequireCompute, (byte) (value ? 1 : 0));
             }
             
             public IDisplaySurface SurfaceAttachment 
             {
-                set => AkDeviceSelectorFilterSetHandle(_handle, (int) Names.SurfaceAttachment, 
-                    (value as SDLVkDisplaySurface)?.GetNative() ?? UIntPtr.Zero);
+                set => Api->AkDeviceSelectorFilterSetHandle(_handle, (int) Names.SurfaceAttachment, 
+                    (value as SDLVkDisplaySurface)?.GetNative() ?? 0);
             }
 
-            public UIntPtr GetNative()
+            public ulong GetNative()
             {
                 return _handle;
             }
             
-            private readonly UIntPtr _handle;
+            private readonly ulong _handle;
         }
 
         private class VkDeviceSelector : IDeviceSelector
         {
-            [DllImport(NativeLib, EntryPoint = "akFilterDevices", CallingConvention = CallingConvention.Cdecl)]
-            private static extern UIntPtr AkFilterDevices(UIntPtr appHandle, UIntPtr filter);
-            
-            [DllImport(NativeLib, EntryPoint = "akReleaseDeviceFilterResults", CallingConvention = CallingConvention.Cdecl)]
-            private static extern void AkReleaseDeviceFilterResults(UIntPtr handle);
-            
             public VkDeviceSelector(VkDeviceSelectionFilter filters)
             {
-                _handle = AkFilterDevices(instanceHandle, filters.GetNative());
+                _handle = Api->AkFilterDevices(instanceHandle, filters.GetNative());
+            }
+
+            public IDevice OpenDevice()
+            {
+                var device = Api->AkOpenDevice(instanceHandle, _handle);
+                if (device == 0)
+                    throw new InvalidOperationException("failed to open a device");
+                return new VkDevice(device);
             }
             
             ~VkDeviceSelector()
@@ -299,11 +563,740 @@ namespace Akarin.Interface
             
             public void Dispose()
             {
-                AkReleaseDeviceFilterResults(_handle);
+                Api->AkReleaseDeviceFilterResults(_handle);
                 GC.SuppressFinalize(this);
             }
             
-            private readonly UIntPtr _handle;
+            private readonly ulong _handle;
+        }
+    
+        private class VkDevice : IDevice
+        {
+            [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+            private delegate void NativeMemoryThresholdCallback(uint heap, uint level, ulong usage, ulong budget,
+                IntPtr user);
+
+            public VkDevice(ulong handle)
+            {
+                _handle = handle;
+            }
+
+            ~VkDevice()
+            {
+                Dispose();
+            }
+
+            public void Dispose()
+            {
+                Api->AkCloseDevice(_handle);
+                GC.SuppressFinalize(this);
+            }
+
+            public IDisplayContext CreateDisplayContext(IWindow window)
+            {
+                if (window == null)
+                    throw new ArgumentNullException(nameof(window));
+                return new VkDisplayContext(_handle, ((SDLWindow) window).GetNative());
+            }
+
+            public bool RenderFrame()
+            {
+                return Api->AkDeviceRenderFrame(_handle) != 0;
+            }
+
+            public bool RenderOnDemand
+            {
+                get => Api->AkDeviceGetRenderOnDemand(_handle) != 0;
+                set => Api->AkDeviceSetRenderOnDemand(_handle, (byte) (value ? 1 : 0));
+            }
+
+            public unsafe void GetPresentResults(ReadOnlySpan<IDisplayContext> contexts, Span<int> results)
+            {
+                if (results.Length < contexts.Length)
+                    throw new ArgumentException("result span is shorter than the context list", nameof(results));
+                var handles = stackalloc ulong[contexts.Length];
+                for (var i = 0; i < contexts.Length; ++i)
+                    handles[i] = ((VkDisplayContext) contexts[i]).GetNative();
+                fixed (int* output = results)
+                    Api->AkDisplayContextGetPresentResults(handles, output, (uint) contexts.Length);
+            }
+
+            public ITexturePool CreateTexturePool()
+            {
+                return new VkTexturePool(_handle);
+            }
+
+            public IComputeContext CreateComputeContext()
+            {
+                return new VkComputeContext(_handle);
+            }
+
+            public TextureCompression SupportedTextureCompression =>
+                (TextureCompression) Api->AkDeviceGetTextureCompression(_handle);
+
+            public Version ApiVersion
+            {
+                get
+                {
+                    var version = Api->AkDeviceGetApiVersion(_handle);
+                    return new Version((int) (version >> 22), (int) ((version >> 12) & 0x3ff), (int) (version & 0xfff));
+                }
+            }
+
+            public DeviceFeatures Features => (DeviceFeatures) Api->AkDeviceGetFeatures(_handle);
+
+            public ShaderCacheStats GetShaderCacheStats()
+            {
+                ShaderCacheStats stats;
+                Api->AkDeviceGetShaderStats(_handle, &stats);
+                return stats;
+            }
+
+            public PipelineCacheStats GetPipelineCacheStats()
+            {
+                PipelineCacheStats stats;
+                Api->AkDeviceGetPipelineStats(_handle, &stats);
+                return stats;
+            }
+
+            public TextureTableStats GetTextureTableStats()
+            {
+                TextureTableStats stats;
+                Api->AkDeviceGetTextureTableStats(_handle, &stats);
+                return stats;
+            }
+
+            public RenderPassCacheStats GetRenderPassCacheStats()
+            {
+                RenderPassCacheStats stats;
+                Api->AkDeviceGetRenderPassStats(_handle, &stats);
+                return stats;
+            }
+
+            public DeviceTrimStats Trim()
+            {
+                DeviceTrimStats stats;
+                Api->AkDeviceTrim(_handle, &stats);
+                return stats;
+            }
+
+            public DeviceTrimStats GetTrimStats()
+            {
+                DeviceTrimStats stats;
+                Api->AkDeviceGetTrimStats(_handle, &stats);
+                return stats;
+            }
+
+            public unsafe MemoryHeapStats[] GetMemoryHeapStats()
+            {
+                var stats = new MemoryHeapStats[Api->AkDeviceGetMemoryHeapStats(_handle, null, 0)];
+                fixed (MemoryHeapStats* data = stats)
+                    Api->AkDeviceGetMemoryHeapStats(_handle, data, (uint) stats.Length);
+                return stats;
+            }
+
+            public unsafe MemoryTypeStats[] GetMemoryTypeStats()
+            {
+                var stats = new MemoryTypeStats[Api->AkDeviceGetMemoryTypeStats(_handle, null, 0)];
+                fixed (MemoryTypeStats* data = stats)
+                    Api->AkDeviceGetMemoryTypeStats(_handle, data, (uint) stats.Length);
+                return stats;
+            }
+
+            public unsafe void SetMemoryThresholds(ReadOnlySpan<float> fractions, MemoryThresholdCallback callback)
+            {
+                NativeMemoryThresholdCallback native = null;
+                if (callback != null)
+                    native = (heap, level, usage, budget, user) => callback(heap, level, usage, budget);
+                // A replaced callback may still be running on a native thread, so none is ever released early
+                lock (_thresholdCallbacks)
+                {
+                    if (native != null)
+                        _thresholdCallbacks.Add(native);
+                    fixed (float* data = fractions)
+                        Api->AkDeviceSetMemoryThresholds(_handle, data, native == null ? 0 : (uint) fractions.Length,
+                            native == null ? IntPtr.Zero : Marshal.GetFunctionPointerForDelegate(native), IntPtr.Zero);
+                }
+            }
+
+            private readonly ulong _handle;
+            private readonly List<NativeMemoryThresholdCallback> _thresholdCallbacks =
+                new List<NativeMemoryThresholdCallback>();
+        }
+
+        private class VkTexturePool : ITexturePool
+        {
+            public VkTexturePool(ulong device)
+            {
+                _handle = Api->AkCreateTexturePool(device);
+                if (_handle == 0)
+                    throw new InvalidOperationException("failed to create a texture pool");
+            }
+
+            ~VkTexturePool()
+            {
+                Dispose();
+            }
+
+            public void Dispose()
+            {
+                Api->AkDestroyTexturePool(_handle);
+                GC.SuppressFinalize(this);
+            }
+
+            public ulong Budget
+            {
+                set => Api->AkTexturePoolSetBudget(_handle, value);
+            }
+
+            public TexturePoolStats GetStats()
+            {
+                TexturePoolStats stats;
+                Api->AkTexturePoolGetStats(_handle, &stats);
+                return stats;
+            }
+
+            public ITexture CreateTexture(uint width, uint height, ReadOnlySpan<byte> rgba8Pixels)
+            {
+                return CreateTexture(width, height, rgba8Pixels, PixelConversion.None);
+            }
+
+            public ITexture CreateTexture(uint width, uint height, ReadOnlySpan<byte> pixels,
+                PixelConversion conversion)
+            {
+                if ((ulong) pixels.Length < (ulong) width * height * 4)
+                    throw new ArgumentException("pixel data is smaller than the texture", nameof(pixels));
+                return VkTexture.CreateRGBA8(_handle, width, height, pixels, conversion);
+            }
+
+            public ITexture LoadTexture(string path)
+            {
+                if (path == null)
+                    throw new ArgumentNullException(nameof(path));
+                return VkTexture.LoadKTX2(_handle, path);
+            }
+
+            private readonly ulong _handle;
+        }
+
+        private class VkComputeContext : IComputeContext
+        {
+            public VkComputeContext(ulong device)
+            {
+                _handle = Api->AkCreateComputeContext(device);
+                if (_handle == 0)
+                    throw new InvalidOperationException("failed to create a compute context");
+            }
+
+            ~VkComputeContext()
+            {
+                Dispose();
+            }
+
+            public void Dispose()
+            {
+                Api->AkDestroyComputeContext(_handle);
+                GC.SuppressFinalize(this);
+            }
+
+            public unsafe IComputePipeline CreatePipeline(ReadOnlySpan<byte> spirv, uint bufferCount,
+                uint constantSize)
+            {
+                ulong handle;
+                fixed (byte* code = spirv)
+                    handle = Api->AkCreateComputePipeline(_handle, code, (UIntPtr) spirv.Length, bufferCount,
+                        constantSize);
+                if (handle == 0)
+                    throw new InvalidOperationException("failed to create a compute pipeline");
+                return new VkComputePipeline(handle);
+            }
+
+            public IComputePipeline LoadPipeline(string path, uint bufferCount, uint constantSize)
+            {
+                if (path == null)
+                    throw new ArgumentNullException(nameof(path));
+                ulong handle;
+                fixed (byte* pathData = Utf8(path, stackalloc byte[256]))
+                    handle = Api->AkLoadComputePipeline(_handle, pathData, bufferCount, constantSize);
+                if (handle == 0)
+                    throw new InvalidOperationException("failed to load a compute pipeline");
+                return new VkComputePipeline(handle);
+            }
+
+            public IComputeBuffer CreateBuffer(ulong size, ComputeBufferFlags flags)
+            {
+                var handle = Api->AkCreateComputeBuffer(_handle, size, flags);
+                if (handle == 0)
+                    throw new InvalidOperationException("failed to create a compute buffer");
+                return new VkComputeBuffer(handle, size);
+            }
+
+            public unsafe void Record(ReadOnlySpan<ComputeDispatch> dispatches, ReadOnlySpan<ulong> buffers,
+                ReadOnlySpan<byte> constants)
+            {
+                bool recorded;
+                fixed (ComputeDispatch* dispatchData = dispatches)
+                fixed (ulong* bufferData = buffers)
+                fixed (byte* constantData = constants)
+                    recorded = Api->AkComputeRecord(_handle, dispatchData, (uint) dispatches.Length, bufferData,
+                        (uint) buffers.Length, constantData, (uint) constants.Length) != 0;
+                if (!recorded)
+                    throw new InvalidOperationException("failed to record compute dispatches");
+            }
+
+            public ulong Submit()
+            {
+                ulong value;
+                if (Api->AkComputeSubmit(_handle, &value) == 0)
+                    throw new InvalidOperationException("failed to submit compute dispatches");
+                return value;
+            }
+
+            public void SyncGraphics(ulong value)
+            {
+                Api->AkComputeSyncGraphics(_handle, value);
+            }
+
+            public bool Wait(ulong value, ulong timeoutNanoseconds)
+            {
+                return Api->AkComputeWait(_handle, value, timeoutNanoseconds) != 0;
+            }
+
+            public ulong CompletedValue => Api->AkComputeGetCompletedValue(_handle);
+
+            public ComputeStats GetStats()
+            {
+                ComputeStats stats;
+                Api->AkComputeGetStats(_handle, &stats);
+                return stats;
+            }
+
+            private readonly ulong _handle;
+        }
+
+        private class VkComputePipeline : IComputePipeline
+        {
+            public VkComputePipeline(ulong handle)
+            {
+                Handle = handle;
+            }
+
+            ~VkComputePipeline()
+            {
+                Dispose();
+            }
+
+            public void Dispose()
+            {
+                Api->AkDestroyComputePipeline(Handle);
+                GC.SuppressFinalize(this);
+            }
+
+            public ulong Handle { get; }
+        }
+
+        private class VkComputeBuffer : IComputeBuffer
+        {
+            public VkComputeBuffer(ulong handle, ulong size)
+            {
+                Handle = handle;
+                Size = size;
+            }
+
+            ~VkComputeBuffer()
+            {
+                Dispose();
+            }
+
+            public void Dispose()
+            {
+                Api->AkDestroyComputeBuffer(Handle);
+                GC.SuppressFinalize(this);
+            }
+
+            public ulong Handle { get; }
+
+            public ulong Size { get; }
+
+            public unsafe void Write(ulong offset, ReadOnlySpan<byte> data)
+            {
+                bool written;
+                fixed (byte* source = data)
+                    written = Api->AkComputeBufferWrite(Handle, offset, source, (ulong) data.Length) != 0;
+                if (!written)
+                    throw new InvalidOperationException("buffer is not host visible or the range is out of bounds");
+            }
+
+            public unsafe void WritePixels(ulong offset, ReadOnlySpan<byte> pixels, PixelConversion conversion)
+            {
+                bool written;
+                fixed (byte* source = pixels)
+                    written = Api->AkComputeBufferWritePixels(Handle, offset, source, (ulong) pixels.Length / 4,
+                        (uint) conversion) != 0;
+                if (!written)
+                    throw new InvalidOperationException("buffer is not host visible or the range is out of bounds");
+            }
+
+            public unsafe void Read(ulong offset, Span<byte> data)
+            {
+                bool read;
+                fixed (byte* destination = data)
+                    read = Api->AkComputeBufferRead(Handle, offset, destination, (ulong) data.Length) != 0;
+                if (!read)
+                    throw new InvalidOperationException("buffer is not host visible or the range is out of bounds");
+            }
+        }
+
+        private class VkTexture : ITexture
+        {
+            public static unsafe VkTexture CreateRGBA8(ulong pool, uint width, uint height, ReadOnlySpan<byte> pixels,
+                PixelConversion conversion)
+            {
+                ulong handle;
+                fixed (byte* data = pixels)
+                    handle = Api->AkCreateTextureRGBA8Converted(pool, width, height, data, (uint) conversion);
+                if (handle == 0)
+                    throw new InvalidOperationException("failed to create a texture");
+                return new VkTexture(handle);
+            }
+
+            public static VkTexture LoadKTX2(ulong pool, string path)
+            {
+                ulong handle;
+                fixed (byte* pathData = Utf8(path, stackalloc byte[256]))
+                    handle = Api->AkCreateTextureKTX2(pool, pathData);
+                if (handle == 0)
+                    throw new InvalidOperationException($"failed to load texture {path}");
+                return new VkTexture(handle);
+            }
+
+            public VkTexture(ulong handle)
+            {
+                _handle = handle;
+            }
+
+            ~VkTexture()
+            {
+                Dispose();
+            }
+
+            public void Dispose()
+            {
+                Api->AkDestroyTexture(_handle);
+                GC.SuppressFinalize(this);
+            }
+
+            public uint LevelCount => Api->AkTextureGetLevelCount(_handle);
+
+            public uint ResidentLevel => Api->AkTextureGetResidentLevel(_handle);
+
+            public uint TableIndex => Api->AkTextureGetTableIndex(_handle);
+
+            public void RequestSize(uint width, uint height)
+            {
+                Api->AkTextureRequestSize(_handle, width, height);
+            }
+
+            private readonly ulong _handle;
+        }
+
+        private class VkDisplayContext : IDisplayContext
+        {
+            public VkDisplayContext(ulong device, ulong window)
+            {
+                _device = device;
+                _handle = Api->AkCreateDisplayContext(device, window);
+                if (_handle == 0)
+                    throw new InvalidOperationException("failed to create a display context");
+            }
+
+            ~VkDisplayContext()
+            {
+                Dispose();
+            }
+
+            public void Dispose()
+            {
+                Api->AkDestroyDisplayContext(_device, _handle);
+                GC.SuppressFinalize(this);
+            }
+
+            public int LastPresentResult => Api->AkDisplayContextGetPresentResult(_handle);
+
+            public unsafe void AddDamage(ReadOnlySpan<DamageRect> rects)
+            {
+                if (rects.IsEmpty) return;
+                fixed (DamageRect* data = rects)
+                    Api->AkDisplayContextAddDamage(_handle, data, (uint) rects.Length);
+            }
+
+            public unsafe void DamageAll()
+            {
+                Api->AkDisplayContextAddDamage(_handle, null, 0);
+            }
+
+            public IPipeline CreatePipeline(PipelineCreateInfo createInfo)
+            {
+                throw new NotSupportedException();
+            }
+
+            public IRenderer CreateRenderer(RendererCreateInfo createInfo)
+            {
+                throw new NotSupportedException();
+            }
+
+            public IScene CreateScene(ReadOnlySpan<byte> vertexSpirv, ReadOnlySpan<byte> fragmentSpirv,
+                uint instanceSize)
+            {
+                return VkScene.Create(_handle, vertexSpirv, fragmentSpirv, instanceSize);
+            }
+
+            public IScene LoadScene(string vertexPath, string fragmentPath, uint instanceSize)
+            {
+                if (vertexPath == null)
+                    throw new ArgumentNullException(nameof(vertexPath));
+                if (fragmentPath == null)
+                    throw new ArgumentNullException(nameof(fragmentPath));
+                return VkScene.Load(_handle, vertexPath, fragmentPath, instanceSize);
+            }
+
+            public ICapture CreateCapture(uint maxWidth, uint maxHeight, CaptureFormat format, uint slots)
+            {
+                return new VkCapture(_handle, maxWidth, maxHeight, format, slots);
+            }
+
+            public ulong GetNative()
+            {
+                return _handle;
+            }
+
+            private readonly ulong _device;
+            private readonly ulong _handle;
+        }
+
+        private class VkScene : IScene
+        {
+            public static unsafe VkScene Create(ulong context, ReadOnlySpan<byte> vertexSpirv,
+                ReadOnlySpan<byte> fragmentSpirv, uint instanceSize)
+            {
+                ulong handle;
+                fixed (byte* vertex = vertexSpirv)
+                fixed (byte* fragment = fragmentSpirv)
+                    handle = Api->AkCreateScene(context, vertex, (UIntPtr) vertexSpirv.Length, fragment,
+                        (UIntPtr) fragmentSpirv.Length, instanceSize);
+                if (handle == 0)
+                    throw new InvalidOperationException("failed to create a scene");
+                return new VkScene(handle, instanceSize);
+            }
+
+            public static VkScene Load(ulong context, string vertexPath, string fragmentPath, uint instanceSize)
+            {
+                ulong handle;
+                fixed (byte* vertexData = Utf8(vertexPath, stackalloc byte[256]))
+                fixed (byte* fragmentData = Utf8(fragmentPath, stackalloc byte[256]))
+                    handle = Api->AkLoadScene(context, vertexData, fragmentData, instanceSize);
+                if (handle == 0)
+                    throw new InvalidOperationException("failed to load a scene");
+                return new VkScene(handle, instanceSize);
+            }
+
+            private VkScene(ulong handle, uint instanceSize)
+            {
+                _handle = handle;
+                InstanceSize = instanceSize;
+            }
+
+            ~VkScene()
+            {
+                Dispose();
+            }
+
+            public void Dispose()
+            {
+                Api->AkDestroyScene(_handle);
+                GC.SuppressFinalize(this);
+            }
+
+            public uint InstanceSize { get; }
+
+            public unsafe void CreateNodes(ReadOnlySpan<byte> instances, Span<uint> nodes)
+            {
+                if ((ulong) instances.Length != (ulong) nodes.Length * InstanceSize)
+                    throw new ArgumentException("instance data does not match the node count", nameof(instances));
+                bool created;
+                fixed (byte* data = instances)
+                fixed (uint* ids = nodes)
+                    created = Api->AkSceneCreateNodes(_handle, data, (uint) nodes.Length, ids) != 0;
+                if (!created)
+                    throw new InvalidOperationException("failed to create scene nodes");
+            }
+
+            public uint CreateNode(ReadOnlySpan<byte> instance)
+            {
+                Span<uint> node = stackalloc uint[1];
+                CreateNodes(instance, node);
+                return node[0];
+            }
+
+            public unsafe void UpdateNode(uint node, uint offset, ReadOnlySpan<byte> data)
+            {
+                bool updated;
+                fixed (byte* source = data)
+                    updated = Api->AkSceneUpdateNode(_handle, node, offset, source, (uint) data.Length) != 0;
+                if (!updated)
+                    throw new ArgumentException("node is destroyed or the range is outside its instance");
+            }
+
+            public unsafe void DestroyNodes(ReadOnlySpan<uint> nodes)
+            {
+                fixed (uint* ids = nodes)
+                    Api->AkSceneDestroyNodes(_handle, ids, (uint) nodes.Length);
+            }
+
+            public unsafe void SetNodeBounds(uint node, DamageRect bounds)
+            {
+                if (Api->AkSceneSetNodeBounds(_handle, node, &bounds) == 0)
+                    throw new ArgumentException("node is destroyed", nameof(node));
+            }
+
+            public SceneStats GetStats()
+            {
+                SceneStats stats;
+                Api->AkSceneGetStats(_handle, &stats);
+                return stats;
+            }
+
+            private readonly ulong _handle;
+        }
+
+        private class VkCapture : ICapture
+        {
+            public unsafe VkCapture(ulong context, uint maxWidth, uint maxHeight, CaptureFormat format, uint slots)
+            {
+                var info = new CaptureCreateInfo
+                {
+                    Slots = slots, MaxWidth = maxWidth, MaxHeight = maxHeight, Format = format
+                };
+                _handle = Api->AkCreateCapture(context, &info);
+                if (_handle == 0)
+                    throw new InvalidOperationException("failed to start capturing");
+            }
+
+            ~VkCapture()
+            {
+                Dispose();
+            }
+
+            public void Dispose()
+            {
+                Api->AkDestroyCapture(_handle);
+                GC.SuppressFinalize(this);
+            }
+
+            public bool TryAcquireFrame(out CaptureFrame frame)
+            {
+                CaptureFrame acquired;
+                var result = Api->AkCaptureAcquireFrame(_handle, &acquired) != 0;
+                frame = acquired;
+                return result;
+            }
+
+            public void ReleaseFrame(in CaptureFrame frame)
+            {
+                Api->AkCaptureReleaseFrame(_handle, frame.Slot);
+            }
+
+            public CaptureStats GetStats()
+            {
+                CaptureStats stats;
+                Api->AkCaptureGetStats(_handle, &stats);
+                return stats;
+            }
+
+            private readonly ulong _handle;
+        }
+
+        private class NativeTessellator : ITessellator
+        {
+            public NativeTessellator(uint threads)
+            {
+                _handle = Api->AkCreateTessellator(threads);
+                if (_handle == 0)
+                    throw new InvalidOperationException("failed to create a tessellator");
+            }
+
+            ~NativeTessellator()
+            {
+                Dispose();
+            }
+
+            public void Dispose()
+            {
+                Api->AkDestroyTessellator(_handle);
+                GC.SuppressFinalize(this);
+            }
+
+            public SimdLevel Level
+            {
+                get => (SimdLevel) Api->AkTessellatorGetLevel(_handle);
+                set
+                {
+                    if (Api->AkTessellatorSetLevel(_handle, (uint) value) == 0)
+                        throw new InvalidOperationException($"{value} is not supported by this CPU");
+                }
+            }
+
+            public unsafe TessellateResult Measure(ReadOnlySpan<TessellatePrimitive> primitives)
+            {
+                TessellateResult result;
+                fixed (TessellatePrimitive* source = primitives)
+                    Api->AkTessellateMeasure(source, (ulong) primitives.Length, &result);
+                return result;
+            }
+
+            public unsafe TessellateResult Tessellate(ReadOnlySpan<TessellatePrimitive> primitives,
+                ReadOnlySpan<float> points, Span<TessellateVertex> vertices, Span<uint> indices, uint baseVertex)
+            {
+                bool done;
+                TessellateResult result;
+                fixed (TessellatePrimitive* source = primitives)
+                fixed (float* pointData = points)
+                fixed (TessellateVertex* vertexData = vertices)
+                fixed (uint* indexData = indices)
+                    done = Api->AkTessellate(_handle, source, (ulong) primitives.Length, pointData,
+                        (ulong) points.Length / 2, vertexData, (ulong) vertices.Length, indexData,
+                        (ulong) indices.Length, baseVertex, &result) != 0;
+                if (!done)
+                    throw new InvalidOperationException("output is too small or a path is out of range");
+                return result;
+            }
+
+            public unsafe TessellateResult Tessellate(ReadOnlySpan<TessellatePrimitive> primitives,
+                ReadOnlySpan<float> points, IComputeBuffer vertices, ulong vertexOffset, IComputeBuffer indices,
+                ulong indexOffset, uint baseVertex)
+            {
+                bool done;
+                TessellateResult result;
+                fixed (TessellatePrimitive* source = primitives)
+                fixed (float* pointData = points)
+                    done = Api->AkTessellateToComputeBuffers(_handle, source, (ulong) primitives.Length, pointData,
+                        (ulong) points.Length / 2, vertices.Handle, vertexOffset, indices.Handle, indexOffset,
+                        baseVertex, &result) != 0;
+                if (!done)
+                    throw new InvalidOperationException(
+                        "buffers are not host visible, too small, or a path is out of range");
+                return result;
+            }
+
+            public TessellateBenchmark Benchmark(ulong primitiveCount, uint iterations)
+            {
+                TessellateBenchmark result;
+                if (Api->AkTessellatorBenchmark(_handle, primitiveCount, iterations, &result) == 0)
+                    throw new InvalidOperationException("tessellator benchmark failed");
+                return result;
+            }
+
+            private readonly ulong _handle;
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,531 @@
+#include "Config.h"
+#include "Trace.h"
+#include "JobSystem.h"
+#include "Tessellator.h"
+#include "RenderThread.h"
+#include "PixelConvert.h"
+#include "Vulkan/Scene.h"
+#include "Vulkan/Memory.h"
+#include "Vulkan/Capture.h"
+#include "Vulkan/Compute.h"
+#include "Vulkan/TexturePool.h"
+#include "Vulkan/HostAllocator.h"
+#include "Vulkan/ShaderRegistry.h"
+#include "Vulkan/PipelineRegistry.h"
+#include "Vulkan/TextureTable.h"
+#include "Vulkan/RenderPassCache.h"
+#include "Vulkan/Device.h"
+
+// Application
+AK_PUBLIC uint64_t AK_CALL akAppInit() noexcept;
+AK_PUBLIC void AK_CALL akAppControlHandOver(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akAppStop(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akAppStartRenderThread(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akAppStopRenderThread(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akAppGetRenderThreadStats(uint64_t handle, RenderThreadStats* stats) noexcept;
+AK_PUBLIC void AK_CALL akAppFinalize(uint64_t handle) noexcept;
+
+// Windows
+AK_PUBLIC uint64_t AK_CALL akCreateWindow(const char* caption, int32_t display, int32_t positionX, int32_t positionY,
+        int32_t width, int32_t height) noexcept;
+AK_PUBLIC void AK_CALL akShowWindow(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akHideWindow(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akMinimizeWindow(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akMaximizeWindow(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akDestroyWindow(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akDestroyWindows(const uint64_t* handles, uint32_t count) noexcept;
+
+// Command streams
+AK_PUBLIC uint64_t AK_CALL akCreateCommandStream(uint32_t capacity) noexcept;
+AK_PUBLIC uintptr_t AK_CALL akGetCommandStreamData(uint64_t stream) noexcept;
+AK_PUBLIC uint32_t AK_CALL akGetCommandStreamCapacity(uint64_t stream) noexcept;
+AK_PUBLIC uint32_t AK_CALL akSubmitCommandStream(uint64_t app, uint64_t stream, uint32_t size) noexcept;
+AK_PUBLIC void AK_CALL akDestroyCommandStream(uint64_t stream) noexcept;
+
+// Display surfaces
+AK_PUBLIC uint64_t AK_CALL akCreateDisplaySurface(uint64_t app, uint64_t window);
+AK_PUBLIC void AK_CALL akDestroyDisplaySurface(uint64_t app, uint64_t surface);
+AK_PUBLIC void AK_CALL akDestroyDisplaySurfaces(uint64_t app, const uint64_t* surfaces, uint32_t count);
+
+// Device selection
+AK_PUBLIC uint64_t AK_CALL akCreateDeviceSelectorFilter();
+AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetBool(uint64_t handle, int name, bool value);
+AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetUInt(uint64_t handle, int name, uint32_t value);
+AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetUInt64(uint64_t handle, int name, uint64_t value);
+AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetDouble(uint64_t handle, int name, double value);
+AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetHandle(uint64_t handle, int name, uint64_t value);
+AK_PUBLIC bool AK_CALL akDeviceSelectorFilterGetBool(uint64_t handle, int name);
+AK_PUBLIC uint32_t AK_CALL akDeviceSelectorFilterGetUInt(uint64_t handle, int name);
+AK_PUBLIC uint64_t AK_CALL akDeviceSelectorFilterGetUInt64(uint64_t handle, int name);
+AK_PUBLIC double AK_CALL akDeviceSelectorFilterGetDouble(uint64_t handle, int name);
+AK_PUBLIC uint64_t AK_CALL akDeviceSelectorFilterGetHandle(uint64_t handle, int name);
+AK_PUBLIC void AK_CALL akDestroyDeviceSelectorFilter(uint64_t handle);
+AK_PUBLIC uint64_t AK_CALL akFilterDevices(uint64_t appHandle, uint64_t filter);
+AK_PUBLIC uint64_t AK_CALL akOpenDevice(uint64_t appHandle, uint64_t selectorHandle) noexcept;
+AK_PUBLIC void AK_CALL akReleaseDeviceFilterResults(uint64_t handle);
+
+// Devices
+AK_PUBLIC void AK_CALL akCloseDevice(uint64_t handle) noexcept;
+AK_PUBLIC bool AK_CALL akDeviceRenderFrame(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akDeviceSetRenderOnDemand(uint64_t handle, bool enable) noexcept;
+AK_PUBLIC bool AK_CALL akDeviceGetRenderOnDemand(uint64_t handle) noexcept;
+AK_PUBLIC uint32_t AK_CALL akDeviceGetTextureCompression(uint64_t handle) noexcept;
+AK_PUBLIC uint32_t AK_CALL akDeviceGetApiVersion(uint64_t handle) noexcept;
+AK_PUBLIC uint32_t AK_CALL akDeviceGetFeatures(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akDeviceTrim(uint64_t handle, DeviceTrimStats* stats) noexcept;
+AK_PUBLIC void AK_CALL akDeviceGetTrimStats(uint64_t handle, DeviceTrimStats* stats) noexcept;
+
+// Device memory
+AK_PUBLIC uint32_t AK_CALL akDeviceGetMemoryHeapStats(uint64_t handle, MemoryHeapStats* stats,
+        uint32_t capacity) noexcept;
+AK_PUBLIC uint32_t AK_CALL akDeviceGetMemoryTypeStats(uint64_t handle, MemoryTypeStats* stats,
+        uint32_t capacity) noexcept;
+AK_PUBLIC bool AK_CALL akDeviceSetMemoryThresholds(uint64_t handle, const float* fractions, uint32_t count,
+        MemoryThresholdCallback callback, void* user) noexcept;
+
+// Shaders
+AK_PUBLIC void AK_CALL akDeviceGetShaderStats(uint64_t handle, ShaderRegistryStats* stats) noexcept;
+AK_PUBLIC uint64_t AK_CALL akDeviceTrimShaders(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akDeviceGetPipelineStats(uint64_t handle, PipelineRegistryStats* stats) noexcept;
+AK_PUBLIC uint64_t AK_CALL akDeviceTrimPipelines(uint64_t handle) noexcept;
+
+// Host allocations
+AK_PUBLIC void AK_CALL akGetHostAllocatorStats(HostAllocatorStats* stats) noexcept;
+
+// Display contexts
+AK_PUBLIC uint64_t AK_CALL akCreateDisplayContext(uint64_t deviceHandle, uint64_t windowHandle) noexcept;
+AK_PUBLIC void AK_CALL akDestroyDisplayContext(uint64_t deviceHandle, uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akDisplayContextAddDamage(uint64_t handle, const VkRect2D* rects, uint32_t count) noexcept;
+AK_PUBLIC int32_t AK_CALL akDisplayContextGetPresentResult(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akDisplayContextGetPresentResults(const uint64_t* handles, int32_t* results,
+        uint32_t count) noexcept;
+
+// Textures
+AK_PUBLIC uint64_t AK_CALL akCreateTexturePool(uint64_t deviceHandle) noexcept;
+AK_PUBLIC void AK_CALL akDestroyTexturePool(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akTexturePoolSetBudget(uint64_t handle, uint64_t bytes) noexcept;
+AK_PUBLIC void AK_CALL akTexturePoolGetStats(uint64_t handle, TexturePoolStats* stats) noexcept;
+AK_PUBLIC uint64_t AK_CALL akCreateTextureRGBA8Converted(uint64_t poolHandle, uint32_t width, uint32_t height,
+        const void* pixels, uint32_t conversion) noexcept;
+AK_PUBLIC uint64_t AK_CALL akCreateTextureRGBA8(uint64_t poolHandle, uint32_t width, uint32_t height,
+        const void* pixels) noexcept;
+AK_PUBLIC void AK_CALL akDestroyTexture(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akTextureRequestSize(uint64_t handle, uint32_t width, uint32_t height) noexcept;
+AK_PUBLIC uint32_t AK_CALL akTextureGetLevelCount(uint64_t handle) noexcept;
+AK_PUBLIC uint32_t AK_CALL akTextureGetResidentLevel(uint64_t handle) noexcept;
+AK_PUBLIC uint32_t AK_CALL akTextureGetTableIndex(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akDeviceGetTextureTableStats(uint64_t handle, TextureTableStats* stats) noexcept;
+AK_PUBLIC void AK_CALL akDeviceGetRenderPassStats(uint64_t handle, RenderPassCacheStats* stats) noexcept;
+AK_PUBLIC uint64_t AK_CALL akCreateTextureKTX2(uint64_t poolHandle, const char* path) noexcept;
+
+// Scenes
+AK_PUBLIC uint64_t AK_CALL akCreateScene(uint64_t contextHandle, const uint32_t* vertexCode, size_t vertexSize,
+        const uint32_t* fragmentCode, size_t fragmentSize, uint32_t instanceSize) noexcept;
+AK_PUBLIC uint64_t AK_CALL akLoadScene(uint64_t contextHandle, const char* vertexPath, const char* fragmentPath,
+        uint32_t instanceSize) noexcept;
+AK_PUBLIC void AK_CALL akDestroyScene(uint64_t handle) noexcept;
+AK_PUBLIC bool AK_CALL akSceneCreateNodes(uint64_t handle, const void* data, uint32_t count, uint32_t* nodes) noexcept;
+AK_PUBLIC bool AK_CALL akSceneUpdateNode(uint64_t handle, uint32_t node, uint32_t offset, const void* data,
+        uint32_t size) noexcept;
+AK_PUBLIC void AK_CALL akSceneDestroyNodes(uint64_t handle, const uint32_t* nodes, uint32_t count) noexcept;
+AK_PUBLIC bool AK_CALL akSceneSetNodeBounds(uint64_t handle, uint32_t node, const VkRect2D* bounds) noexcept;
+AK_PUBLIC void AK_CALL akSceneGetStats(uint64_t handle, SceneStats* stats) noexcept;
+
+// Compute
+AK_PUBLIC uint64_t AK_CALL akCreateComputeContext(uint64_t deviceHandle) noexcept;
+AK_PUBLIC void AK_CALL akDestroyComputeContext(uint64_t handle) noexcept;
+AK_PUBLIC uint64_t AK_CALL akCreateComputePipeline(uint64_t contextHandle, const uint32_t* code, size_t size,
+        uint32_t bufferCount, uint32_t constantSize) noexcept;
+AK_PUBLIC uint64_t AK_CALL akLoadComputePipeline(uint64_t contextHandle, const char* path, uint32_t bufferCount,
+        uint32_t constantSize) noexcept;
+AK_PUBLIC void AK_CALL akDestroyComputePipeline(uint64_t handle) noexcept;
+AK_PUBLIC uint64_t AK_CALL akCreateComputeBuffer(uint64_t contextHandle, uint64_t size, uint32_t flags) noexcept;
+AK_PUBLIC void AK_CALL akDestroyComputeBuffer(uint64_t handle) noexcept;
+AK_PUBLIC bool AK_CALL akComputeBufferWrite(uint64_t handle, uint64_t offset, const void* data, uint64_t size) noexcept;
+AK_PUBLIC bool AK_CALL akComputeBufferWritePixels(uint64_t handle, uint64_t offset, const void* pixels, uint64_t count,
+        uint32_t conversion) noexcept;
+AK_PUBLIC bool AK_CALL akComputeBufferRead(uint64_t handle, uint64_t offset, void* data, uint64_t size) noexcept;
+AK_PUBLIC bool AK_CALL akTessellateToComputeBuffers(uint64_t tessellatorHandle, const TessellatePrimitive* primitives,
+        uint64_t count, const float* points, uint64_t pointCount, uint64_t vertexHandle, uint64_t vertexOffset,
+        uint64_t indexHandle, uint64_t indexOffset, uint32_t baseVertex, TessellateResult* result) noexcept;
+AK_PUBLIC bool AK_CALL akComputeRecord(uint64_t handle, const ComputeDispatch* dispatches, uint32_t count,
+        const uint64_t* buffers, uint32_t bufferCount, const void* constants, uint32_t constantSize) noexcept;
+AK_PUBLIC bool AK_CALL akComputeSubmit(uint64_t handle, uint64_t* value) noexcept;
+AK_PUBLIC void AK_CALL akComputeSyncGraphics(uint64_t handle, uint64_t value) noexcept;
+AK_PUBLIC bool AK_CALL akComputeWait(uint64_t handle, uint64_t value, uint64_t timeout) noexcept;
+AK_PUBLIC uint64_t AK_CALL akComputeGetCompletedValue(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akComputeGetStats(uint64_t handle, ComputeStats* stats) noexcept;
+
+// Tessellation
+AK_PUBLIC uint64_t AK_CALL akCreateTessellator(uint32_t threads) noexcept;
+AK_PUBLIC void AK_CALL akDestroyTessellator(uint64_t handle) noexcept;
+AK_PUBLIC uint32_t AK_CALL akTessellatorGetLevel(uint64_t handle) noexcept;
+AK_PUBLIC bool AK_CALL akTessellatorSetLevel(uint64_t handle, uint32_t level) noexcept;
+AK_PUBLIC void AK_CALL akTessellateMeasure(const TessellatePrimitive* primitives, uint64_t count,
+        TessellateResult* result) noexcept;
+AK_PUBLIC bool AK_CALL akTessellate(uint64_t handle, const TessellatePrimitive* primitives, uint64_t count,
+        const float* points, uint64_t pointCount, TessellateVertex* vertices, uint64_t vertexCapacity,
+        uint32_t* indices, uint64_t indexCapacity, uint32_t baseVertex, TessellateResult* result) noexcept;
+AK_PUBLIC bool AK_CALL akTessellatorBenchmark(uint64_t handle, uint64_t primitiveCount, uint32_t iterations,
+        TessellateBenchmark* result) noexcept;
+
+// Capture
+AK_PUBLIC uint64_t AK_CALL akCreateCapture(uint64_t contextHandle, const CaptureCreateInfo* info) noexcept;
+AK_PUBLIC void AK_CALL akDestroyCapture(uint64_t handle) noexcept;
+AK_PUBLIC bool AK_CALL akCaptureAcquireFrame(uint64_t handle, CaptureFrame* frame) noexcept;
+AK_PUBLIC void AK_CALL akCaptureReleaseFrame(uint64_t handle, uint32_t slot) noexcept;
+AK_PUBLIC void AK_CALL akCaptureGetStats(uint64_t handle, CaptureStats* stats) noexcept;
+
+// Job system
+AK_PUBLIC bool AK_CALL akJobSystemStart(uint32_t workers, bool pin) noexcept;
+AK_PUBLIC void AK_CALL akJobSystemGetStats(JobSystemStats* stats) noexcept;
+AK_PUBLIC uint64_t AK_CALL akCreateJobCounter() noexcept;
+AK_PUBLIC void AK_CALL akDestroyJobCounter(uint64_t handle) noexcept;
+AK_PUBLIC uint32_t AK_CALL akJobCounterGetValue(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akJobCounterWait(uint64_t handle) noexcept;
+AK_PUBLIC bool AK_CALL akJobSystemRun(JobFunction function, void* context, uint32_t count, uint64_t counterHandle,
+        uint64_t afterHandle) noexcept;
+AK_PUBLIC uint32_t AK_CALL akJobSystemBenchmark(uint32_t jobs, uint32_t iterations, JobBenchmark* results,
+        uint32_t capacity) noexcept;
+
+// Pixel conversion
+AK_PUBLIC void AK_CALL akConvertPixels(const void* source, void* destination, uint64_t count,
+        uint32_t conversion) noexcept;
+AK_PUBLIC bool AK_CALL akPixelConversionBenchmark(uint64_t pixels, uint32_t conversion, uint32_t iterations,
+        PixelConvertBenchmark* result) noexcept;
+
+// Diagnostics
+AK_PUBLIC uint32_t AK_CALL akGetSimdLevel() noexcept;
+AK_PUBLIC uint64_t AK_CALL akGetLiveObjectCount(int type) noexcept;
+AK_PUBLIC uint64_t AK_CALL akGetPendingDeletionCount() noexcept;
+
+// Traces
+AK_PUBLIC bool AK_CALL akTraceStart(const char* path) noexcept;
+AK_PUBLIC uint64_t AK_CALL akTraceStop() noexcept;
+AK_PUBLIC bool AK_CALL akReplayTrace(const char* path, uint32_t flags, const char* driverFiles, const char* videoDriver,
+        TraceReplayStats* stats) noexcept;
+
+namespace {
+    constexpr uint32_t ApiVersion = 7;
+}
+
+// Every export as one table, so bindings resolve a single symbol and call through plain function pointers. The layout
+// is part of the ABI: entries are only ever appended and bump ApiVersion, a table is always a valid table of every
+// older version. Arguments are blittable, bool is one byte and strings are null terminated UTF-8 owned by the caller.
+struct ApiTable {
+    uint32_t version;
+    // Bytes, including both header fields
+    uint32_t size;
+
+    // Application
+    decltype(&::akAppInit) akAppInit;
+    decltype(&::akAppControlHandOver) akAppControlHandOver;
+    decltype(&::akAppStop) akAppStop;
+    decltype(&::akAppStartRenderThread) akAppStartRenderThread;
+    decltype(&::akAppStopRenderThread) akAppStopRenderThread;
+    decltype(&::akAppGetRenderThreadStats) akAppGetRenderThreadStats;
+    decltype(&::akAppFinalize) akAppFinalize;
+
+    // Windows
+    decltype(&::akCreateWindow) akCreateWindow;
+    decltype(&::akShowWindow) akShowWindow;
+    decltype(&::akHideWindow) akHideWindow;
+    decltype(&::akMinimizeWindow) akMinimizeWindow;
+    decltype(&::akMaximizeWindow) akMaximizeWindow;
+    decltype(&::akDestroyWindow) akDestroyWindow;
+    decltype(&::akDestroyWindows) akDestroyWindows;
+
+    // Command streams
+    decltype(&::akCreateCommandStream) akCreateCommandStream;
+    decltype(&::akGetCommandStreamData) akGetCommandStreamData;
+    decltype(&::akGetCommandStreamCapacity) akGetCommandStreamCapacity;
+    decltype(&::akSubmitCommandStream) akSubmitCommandStream;
+    decltype(&::akDestroyCommandStream) akDestroyCommandStream;
+
+    // Display surfaces
+    decltype(&::akCreateDisplaySurface) akCreateDisplaySurface;
+    decltype(&::akDestroyDisplaySurface) akDestroyDisplaySurface;
+    decltype(&::akDestroyDisplaySurfaces) akDestroyDisplaySurfaces;
+
+    // Device selection
+    decltype(&::akCreateDeviceSelectorFilter) akCreateDeviceSelectorFilter;
+    decltype(&::akDeviceSelectorFilterSetBool) akDeviceSelectorFilterSetBool;
+    decltype(&::akDeviceSelectorFilterSetUInt) akDeviceSelectorFilterSetUInt;
+    decltype(&::akDeviceSelectorFilterSetUInt64) akDeviceSelectorFilterSetUInt64;
+    decltype(&::akDeviceSelectorFilterSetDouble) akDeviceSelectorFilterSetDouble;
+    decltype(&::akDeviceSelectorFilterSetHandle) akDeviceSelectorFilterSetHandle;
+    decltype(&::akDeviceSelectorFilterGetBool) akDeviceSelectorFilterGetBool;
+    decltype(&::akDeviceSelectorFilterGetUInt) akDeviceSelectorFilterGetUInt;
+    decltype(&::akDeviceSelectorFilterGetUInt64) akDeviceSelectorFilterGetUInt64;
+    decltype(&::akDeviceSelectorFilterGetDouble) akDeviceSelectorFilterGetDouble;
+    decltype(&::akDeviceSelectorFilterGetHandle) akDeviceSelectorFilterGetHandle;
+    decltype(&::akDestroyDeviceSelectorFilter) akDestroyDeviceSelectorFilter;
+    decltype(&::akFilterDevices) akFilterDevices;
+    decltype(&::akOpenDevice) akOpenDevice;
+    decltype(&::akReleaseDeviceFilterResults) akReleaseDeviceFilterResults;
+
+    // Devices
+    decltype(&::akCloseDevice) akCloseDevice;
+    decltype(&::akDeviceRenderFrame) akDeviceRenderFrame;
+    decltype(&::akDeviceSetRenderOnDemand) akDeviceSetRenderOnDemand;
+    decltype(&::akDeviceGetRenderOnDemand) akDeviceGetRenderOnDemand;
+    decltype(&::akDeviceGetTextureCompression) akDeviceGetTextureCompression;
+    decltype(&::akDeviceGetApiVersion) akDeviceGetApiVersion;
+    decltype(&::akDeviceGetFeatures) akDeviceGetFeatures;
+
+    // Device memory
+    decltype(&::akDeviceGetMemoryHeapStats) akDeviceGetMemoryHeapStats;
+    decltype(&::akDeviceGetMemoryTypeStats) akDeviceGetMemoryTypeStats;
+    decltype(&::akDeviceSetMemoryThresholds) akDeviceSetMemoryThresholds;
+
+    // Shaders
+    decltype(&::akDeviceGetShaderStats) akDeviceGetShaderStats;
+    decltype(&::akDeviceTrimShaders) akDeviceTrimShaders;
+
+    // Host allocations
+    decltype(&::akGetHostAllocatorStats) akGetHostAllocatorStats;
+
+    // Display contexts
+    decltype(&::akCreateDisplayContext) akCreateDisplayContext;
+    decltype(&::akDestroyDisplayContext) akDestroyDisplayContext;
+    decltype(&::akDisplayContextAddDamage) akDisplayContextAddDamage;
+    decltype(&::akDisplayContextGetPresentResult) akDisplayContextGetPresentResult;
+    decltype(&::akDisplayContextGetPresentResults) akDisplayContextGetPresentResults;
+
+    // Textures
+    decltype(&::akCreateTexturePool) akCreateTexturePool;
+    decltype(&::akDestroyTexturePool) akDestroyTexturePool;
+    decltype(&::akTexturePoolSetBudget) akTexturePoolSetBudget;
+    decltype(&::akTexturePoolGetStats) akTexturePoolGetStats;
+    decltype(&::akCreateTextureRGBA8Converted) akCreateTextureRGBA8Converted;
+    decltype(&::akCreateTextureRGBA8) akCreateTextureRGBA8;
+    decltype(&::akDestroyTexture) akDestroyTexture;
+    decltype(&::akTextureRequestSize) akTextureRequestSize;
+    decltype(&::akTextureGetLevelCount) akTextureGetLevelCount;
+    decltype(&::akTextureGetResidentLevel) akTextureGetResidentLevel;
+    decltype(&::akCreateTextureKTX2) akCreateTextureKTX2;
+
+    // Scenes
+    decltype(&::akCreateScene) akCreateScene;
+    decltype(&::akLoadScene) akLoadScene;
+    decltype(&::akDestroyScene) akDestroyScene;
+    decltype(&::akSceneCreateNodes) akSceneCreateNodes;
+    decltype(&::akSceneUpdateNode) akSceneUpdateNode;
+    decltype(&::akSceneDestroyNodes) akSceneDestroyNodes;
+    decltype(&::akSceneGetStats) akSceneGetStats;
+
+    // Compute
+    decltype(&::akCreateComputeContext) akCreateComputeContext;
+    decltype(&::akDestroyComputeContext) akDestroyComputeContext;
+    decltype(&::akCreateComputePipeline) akCreateComputePipeline;
+    decltype(&::akLoadComputePipeline) akLoadComputePipeline;
+    decltype(&::akDestroyComputePipeline) akDestroyComputePipeline;
+    decltype(&::akCreateComputeBuffer) akCreateComputeBuffer;
+    decltype(&::akDestroyComputeBuffer) akDestroyComputeBuffer;
+    decltype(&::akComputeBufferWrite) akComputeBufferWrite;
+    decltype(&::akComputeBufferWritePixels) akComputeBufferWritePixels;
+    decltype(&::akComputeBufferRead) akComputeBufferRead;
+    decltype(&::akTessellateToComputeBuffers) akTessellateToComputeBuffers;
+    decltype(&::akComputeRecord) akComputeRecord;
+    decltype(&::akComputeSubmit) akComputeSubmit;
+    decltype(&::akComputeSyncGraphics) akComputeSyncGraphics;
+    decltype(&::akComputeWait) akComputeWait;
+    decltype(&::akComputeGetCompletedValue) akComputeGetCompletedValue;
+    decltype(&::akComputeGetStats) akComputeGetStats;
+
+    // Tessellation
+    decltype(&::akCreateTessellator) akCreateTessellator;
+    decltype(&::akDestroyTessellator) akDestroyTessellator;
+    decltype(&::akTessellatorGetLevel) akTessellatorGetLevel;
+    decltype(&::akTessellatorSetLevel) akTessellatorSetLevel;
+    decltype(&::akTessellateMeasure) akTessellateMeasure;
+    decltype(&::akTessellate) akTessellate;
+    decltype(&::akTessellatorBenchmark) akTessellatorBenchmark;
+
+    // Capture
+    decltype(&::akCreateCapture) akCreateCapture;
+    decltype(&::akDestroyCapture) akDestroyCapture;
+    decltype(&::akCaptureAcquireFrame) akCaptureAcquireFrame;
+    decltype(&::akCaptureReleaseFrame) akCaptureReleaseFrame;
+    decltype(&::akCaptureGetStats) akCaptureGetStats;
+
+    // Pixel conversion
+    decltype(&::akConvertPixels) akConvertPixels;
+    decltype(&::akPixelConversionBenchmark) akPixelConversionBenchmark;
+
+    // Diagnostics
+    decltype(&::akGetSimdLevel) akGetSimdLevel;
+    decltype(&::akGetLiveObjectCount) akGetLiveObjectCount;
+    decltype(&::akGetPendingDeletionCount) akGetPendingDeletionCount;
+
+    // Traces
+    decltype(&::akTraceStart) akTraceStart;
+    decltype(&::akTraceStop) akTraceStop;
+    decltype(&::akReplayTrace) akReplayTrace;
+
+    // Version 2
+    decltype(&::akDeviceGetPipelineStats) akDeviceGetPipelineStats;
+    decltype(&::akDeviceTrimPipelines) akDeviceTrimPipelines;
+
+    // Version 3
+    decltype(&::akTextureGetTableIndex) akTextureGetTableIndex;
+    decltype(&::akDeviceGetTextureTableStats) akDeviceGetTextureTableStats;
+
+    // Version 4
+    decltype(&::akDeviceGetRenderPassStats) akDeviceGetRenderPassStats;
+
+    // Version 5
+    decltype(&::akDeviceTrim) akDeviceTrim;
+    decltype(&::akDeviceGetTrimStats) akDeviceGetTrimStats;
+
+    // Version 6
+    decltype(&::akJobSystemStart) akJobSystemStart;
+    decltype(&::akJobSystemGetStats) akJobSystemGetStats;
+    decltype(&::akCreateJobCounter) akCreateJobCounter;
+    decltype(&::akDestroyJobCounter) akDestroyJobCounter;
+    decltype(&::akJobCounterGetValue) akJobCounterGetValue;
+    decltype(&::akJobCounterWait) akJobCounterWait;
+    decltype(&::akJobSystemRun) akJobSystemRun;
+    decltype(&::akJobSystemBenchmark) akJobSystemBenchmark;
+
+    // Version 7
+    decltype(&::akSceneSetNodeBounds) akSceneSetNodeBounds;
+};
+
+namespace {
+    const ApiTable Api {
+        ApiVersion,
+        sizeof(ApiTable),
+        akAppInit,
+        akAppControlHandOver,
+        akAppStop,
+        akAppStartRenderThread,
+        akAppStopRenderThread,
+        akAppGetRenderThreadStats,
+        akAppFinalize,
+        akCreateWindow,
+        akShowWindow,
+        akHideWindow,
+        akMinimizeWindow,
+        akMaximizeWindow,
+        akDestroyWindow,
+        akDestroyWindows,
+        akCreateCommandStream,
+        akGetCommandStreamData,
+        akGetCommandStreamCapacity,
+        akSubmitCommandStream,
+        akDestroyCommandStream,
+        akCreateDisplaySurface,
+        akDestroyDisplaySurface,
+        akDestroyDisplaySurfaces,
+        akCreateDeviceSelectorFilter,
+        akDeviceSelectorFilterSetBool,
+        akDeviceSelectorFilterSetUInt,
+        akDeviceSelectorFilterSetUInt64,
+        akDeviceSelectorFilterSetDouble,
+        akDeviceSelectorFilterSetHandle,
+        akDeviceSelectorFilterGetBool,
+        akDeviceSelectorFilterGetUInt,
+        akDeviceSelectorFilterGetUInt64,
+        akDeviceSelectorFilterGetDouble,
+        akDeviceSelectorFilterGetHandle,
+        akDestroyDeviceSelectorFilter,
+        akFilterDevices,
+        akOpenDevice,
+        akReleaseDeviceFilterResults,
+        akCloseDevice,
+        akDeviceRenderFrame,
+        akDeviceSetRenderOnDemand,
+        akDeviceGetRenderOnDemand,
+        akDeviceGetTextureCompression,
+        akDeviceGetApiVersion,
+        akDeviceGetFeatures,
+        akDeviceGetMemoryHeapStats,
+        akDeviceGetMemoryTypeStats,
+        akDeviceSetMemoryThresholds,
+        akDeviceGetShaderStats,
+        akDeviceTrimShaders,
+        akGetHostAllocatorStats,
+        akCreateDisplayContext,
+        akDestroyDisplayContext,
+        akDisplayContextAddDamage,
+        akDisplayContextGetPresentResult,
+        akDisplayContextGetPresentResults,
+        akCreateTexturePool,
+        akDestroyTexturePool,
+        akTexturePoolSetBudget,
+        akTexturePoolGetStats,
+        akCreateTextureRGBA8Converted,
+        akCreateTextureRGBA8,
+        akDestroyTexture,
+        akTextureRequestSize,
+        akTextureGetLevelCount,
+        akTextureGetResidentLevel,
+        akCreateTextureKTX2,
+        akCreateScene,
+        akLoadScene,
+        akDestroyScene,
+        akSceneCreateNodes,
+        akSceneUpdateNode,
+        akSceneDestroyNodes,
+        akSceneGetStats,
+        akCreateComputeContext,
+        akDestroyComputeContext,
+        akCreateComputePipeline,
+        akLoadComputePipeline,
+        akDestroyComputePipeline,
+        akCreateComputeBuffer,
+        akDestroyComputeBuffer,
+        akComputeBufferWrite,
+        akComputeBufferWritePixels,
+        akComputeBufferRead,
+        akTessellateToComputeBuffers,
+        akComputeRecord,
+        akComputeSubmit,
+        akComputeSyncGraphics,
+        akComputeWait,
+        akComputeGetCompletedValue,
+        akComputeGetStats,
+        akCreateTessellator,
+        akDestroyTessellator,
+        akTessellatorGetLevel,
+        akTessellatorSetLevel,
+        akTessellateMeasure,
+        akTessellate,
+        akTessellatorBenchmark,
+        akCreateCapture,
+        akDestroyCapture,
+        akCaptureAcquireFrame,
+        akCaptureReleaseFrame,
+        akCaptureGetStats,
+        akConvertPixels,
+        akPixelConversionBenchmark,
+        akGetSimdLevel,
+        akGetLiveObjectCount,
+        akGetPendingDeletionCount,
+        akTraceStart,
+        akTraceStop,
+        akReplayTrace,
+        akDeviceGetPipelineStats,
+        akDeviceTrimPipelines,
+        akTextureGetTableIndex,
+        akDeviceGetTextureTableStats,
+        akDeviceGetRenderPassStats,
+        akDeviceTrim,
+        akDeviceGetTrimStats,
+        akJobSystemStart,
+        akJobSystemGetStats,
+        akCreateJobCounter,
+        akDestroyJobCounter,
+        akJobCounterGetValue,
+        akJobCounterWait,
+        akJobSystemRun,
+        akJobSystemBenchmark,
+        akSceneSetNodeBounds
+    };
+}
+
+// Returns nullptr for versions newer than this library, the returned table may be newer than requested
+AK_PUBLIC const ApiTable* AK_CALL akGetApiTable(uint32_t version) noexcept {
+    return version && version<=ApiVersion ? &Api : nullptr;
+}
@@ -1,16 +1,59 @@
 #include "Application.h"
+#include "DeletionQueue.h"
+#include "JobSystem.h"
+#include "RenderThread.h"
+#include "Trace.h"
 #include "SDL2/SDL.h"
 #include <atomic>
+#include <algorithm>
 
 namespace {
-    std::atomic_bool running = false, shouldRun = false;
+    std::atomic_bool running = false, shouldRun = false, wakePending = false;
+    std::atomic<Uint32> wakeEvent = static_cast<Uint32>(-1);
+
+    // Wakes the event loop so deferred deletions queued from other threads get collected
+    void ApplicationWake() noexcept {
+        const auto type = wakeEvent.load();
+        if (running && type!=static_cast<Uint32>(-1) && !wakePending.exchange(true)) {
+            SDL_Event event {};
+            event.type = type;
+            SDL_PushEvent(&event);
+        }
+    }
 
     void ApplicationWaitEvents(SDL_Event& event) noexcept {
         SDL_WaitEvent(&event);
     }
 
-    void ApplicationProcessEvent(const SDL_Event& event) noexcept {
+    bool IsRenderInput(const SDL_Event& event) noexcept {
         switch (event.type) {
+        case SDL_WINDOWEVENT:
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_TEXTEDITING:
+        case SDL_TEXTINPUT:
+        case SDL_MOUSEMOTION:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+        case SDL_MOUSEWHEEL:
+        case SDL_FINGERDOWN:
+        case SDL_FINGERUP:
+        case SDL_FINGERMOTION:
+        case SDL_DOLLARGESTURE:
+        case SDL_MULTIGESTURE:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    void ApplicationProcessEvent(Application& application, const SDL_Event& event) noexcept {
+        TraceEvent(event);
+        switch (event.type) {
+            /* Window events */
+        case SDL_WINDOWEVENT:            /**< Window state change */
+            application.DispatchWindowEvent(event.window);
+            break;
             /* Application events */
         case SDL_QUIT: /**< User-requested quit */
             /* These application events have special meaning on iOS, see README-ios.md for details */
@@ -20,6 +63,7 @@ namespace {
               Called on Android in onDestroy()
             */
             shouldRun = false;
+            break;
         case SDL_APP_LOWMEMORY:
             /**< The application is low on memory, free memory if possible.
               Called on iOS in applicationDidReceiveMemoryWarning()
@@ -45,8 +89,9 @@ namespace {
               Called on iOS in applicationDidBecomeActive()
               Called on Android in onResume()
             */
+            application.DispatchApplicationEvent(event.type);
+            break;
             /* Window events */
-        case SDL_WINDOWEVENT:            /**< Window state change */
         case SDL_SYSWMEVENT:             /**< System specific event */
 
             /* Keyboard events */
@@ -92,8 +137,14 @@ namespace {
 
 }
 
+Application::Application() noexcept = default;
+
+Application::~Application() = default;
+
 void Application::Init() noexcept {
     SDL_Init(SDL_INIT_VIDEO);
+    wakeEvent = SDL_RegisterEvents(1);
+    DeferredDeletions.SetNotify(ApplicationWake);
 }
 
 void Application::ControlHandOver() noexcept {
@@ -101,15 +152,78 @@ void Application::ControlHandOver() noexcept {
     SDL_Event event;
     while (shouldRun) {
         ApplicationWaitEvents(event);
-        ApplicationProcessEvent(event);
+        ProcessEvent(event);
+        wakePending = false;
+        DeferredDeletions.Collect();
     }
     running = false;
 }
 
+void Application::ProcessEvent(const SDL_Event& event) noexcept {
+    ApplicationProcessEvent(*this, event);
+    if (renderThread && IsRenderInput(event))
+        renderThread->PushInput(event);
+}
+
 void Application::Stop() noexcept {
     shouldRun = false;
 }
 
+void Application::StartRenderThread() {
+    if (!renderThread) {
+        renderThread = std::make_unique<RenderThread>(*this);
+        renderThread->SetFrameHandler(frameHandler);
+    }
+}
+
+void Application::SetFrameHandler(FrameHandler* handler) noexcept {
+    frameHandler = handler;
+    if (renderThread)
+        renderThread->SetFrameHandler(handler);
+}
+
+void Application::AddWindowListener(WindowListener* listener) {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    windowListeners.push_back(listener);
+}
+
+void Application::RemoveWindowListener(WindowListener* listener) noexcept {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    windowListeners.erase(std::remove(windowListeners.begin(), windowListeners.end(), listener),
+            windowListeners.end());
+}
+
+void Application::DispatchWindowEvent(const SDL_WindowEvent& event) noexcept {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    for (auto listener : windowListeners)
+        listener->OnWindowEvent(event);
+}
+
+void Application::AddApplicationListener(ApplicationListener* listener) {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    applicationListeners.push_back(listener);
+}
+
+void Application::RemoveApplicationListener(ApplicationListener* listener) noexcept {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    applicationListeners.erase(std::remove(applicationListeners.begin(), applicationListeners.end(), listener),
+            applicationListeners.end());
+}
+
+void Application::DispatchApplicationEvent(uint32_t type) noexcept {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    for (auto listener : applicationListeners)
+        listener->OnApplicationEvent(type);
+}
+
+void Application::StopRenderThread() noexcept {
+    renderThread.reset();
+}
+
 void Application::Finalize() noexcept {
+    StopRenderThread();
+    Jobs.Stop();
+    DeferredDeletions.SetNotify(nullptr);
+    DeferredDeletions.Flush();
     SDL_Quit();
 }
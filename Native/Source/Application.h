@@ -1,13 +1,62 @@
 #pragma once
 
 #include "Config.h"
+#include <mutex>
+#include <memory>
+#include <vector>
 #include <cstdint>
 #include <cstddef>
 
+union SDL_Event;
+struct SDL_WindowEvent;
+class CommandSink;
+class FrameHandler;
+class RenderThread;
+
+// Receives window state changes (resize, show, hide...) on the event thread
+class WindowListener {
+public:
+    virtual ~WindowListener() = default;
+    virtual void OnWindowEvent(const SDL_WindowEvent& event) noexcept = 0;
+};
+
+// Receives application lifecycle events on the event thread: one of the SDL_APP_* types other than termination
+class ApplicationListener {
+public:
+    virtual ~ApplicationListener() = default;
+    virtual void OnApplicationEvent(uint32_t type) noexcept = 0;
+};
+
 class Application {
 public:
+    Application() noexcept;
+    ~Application();
     void Init() noexcept;
     void ControlHandOver() noexcept;
+    // One pass of the event loop, also used to feed recorded events back in
+    void ProcessEvent(const SDL_Event& event) noexcept;
     void Stop() noexcept;
     void Finalize() noexcept;
+    void SetCommandSink(CommandSink* sink) noexcept { commandSink = sink; }
+    CommandSink* GetCommandSink() const noexcept { return commandSink; }
+    // The render thread can only be started or stopped while ControlHandOver is not running
+    void StartRenderThread();
+    void StopRenderThread() noexcept;
+    RenderThread* GetRenderThread() const noexcept { return renderThread.get(); }
+    // Drives frames on the render thread when it is running
+    void SetFrameHandler(FrameHandler* handler) noexcept;
+    FrameHandler* GetFrameHandler() const noexcept { return frameHandler; }
+    void AddWindowListener(WindowListener* listener);
+    void RemoveWindowListener(WindowListener* listener) noexcept;
+    void DispatchWindowEvent(const SDL_WindowEvent& event) noexcept;
+    void AddApplicationListener(ApplicationListener* listener);
+    void RemoveApplicationListener(ApplicationListener* listener) noexcept;
+    void DispatchApplicationEvent(uint32_t type) noexcept;
+private:
+    CommandSink* commandSink = nullptr;
+    FrameHandler* frameHandler = nullptr;
+    std::unique_ptr<RenderThread> renderThread;
+    std::mutex listenerMutex;
+    std::vector<WindowListener*> windowListeners;
+    std::vector<ApplicationListener*> applicationListeners;
 };
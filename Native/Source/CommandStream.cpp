@@ -0,0 +1,138 @@
+#include "CommandStream.h"
+#include "Vulkan.h"
+#include "RenderThread.h"
+#include "Trace.h"
+#include <cstring>
+
+namespace {
+    template <class T>
+    bool ReadPayload(const uint8_t* record, uint32_t size, T& payload) noexcept {
+        if (size < sizeof(CommandHeader) + sizeof(T))
+            return false;
+        memcpy(&payload, record + sizeof(CommandHeader), sizeof(T));
+        return true;
+    }
+
+    bool ExecuteWindowCommand(CommandOp op, const uint8_t* record, uint32_t size) noexcept {
+        CommandWindow command;
+        if (!ReadPayload(record, size, command))
+            return false;
+        const auto window = WindowHandles.Lookup(command.window);
+        if (!window || TraceIsHeadless())
+            return true;
+        switch (op) {
+        case CommandOp::WindowShow: SDL_ShowWindow(window); break;
+        case CommandOp::WindowHide: SDL_HideWindow(window); break;
+        case CommandOp::WindowMinimize: SDL_MinimizeWindow(window); break;
+        case CommandOp::WindowMaximize: SDL_MaximizeWindow(window); break;
+        default: break;
+        }
+        return true;
+    }
+
+    bool Selected(CommandRecords records, CommandRecords kind) noexcept {
+        return static_cast<uint32_t>(records) & static_cast<uint32_t>(kind);
+    }
+
+    bool ExecuteCommand(const uint8_t* record, uint32_t size, CommandSink* sink, CommandRecords records) noexcept {
+        const auto op = static_cast<CommandOp>(reinterpret_cast<const CommandHeader*>(record)->op);
+        switch (op) {
+        case CommandOp::Nop:
+            return true;
+        case CommandOp::WindowShow:
+        case CommandOp::WindowHide:
+        case CommandOp::WindowMinimize:
+        case CommandOp::WindowMaximize:
+            return !Selected(records, CommandRecords::Window) || ExecuteWindowCommand(op, record, size);
+        case CommandOp::BufferUpdate: {
+            CommandBufferUpdate command;
+            if (!ReadPayload(record, size, command) || command.size > size-sizeof(CommandHeader)-sizeof(command))
+                return false;
+            if (sink && Selected(records, CommandRecords::Resource))
+                sink->UpdateBuffer(command.buffer, command.offset,
+                        record+sizeof(CommandHeader)+sizeof(command), command.size);
+            return true;
+        }
+        default:
+            return true; // unknown records are skipped
+        }
+    }
+
+    // Replays what managed code wrote into a stream before submitting it, handles in the records are remapped
+    void WriteCommandStream(uint64_t stream, const uint64_t* records, uint32_t size) noexcept {
+        const auto commandStream = CommandStreamHandles.Lookup(stream);
+        if (commandStream && records && size<=commandStream->Capacity())
+            memcpy(commandStream->Data(), records, size);
+    }
+}
+
+CommandStream::CommandStream(uint32_t capacity)
+        :storage(new uint64_t[(capacity+CommandAlignment-1)/CommandAlignment]),
+         capacity((capacity+CommandAlignment-1)/CommandAlignment*CommandAlignment) {}
+
+uint32_t CommandStream::Execute(uint32_t size, CommandSink* sink, CommandRecords records) const noexcept {
+    const auto data = Data();
+    if (size > capacity)
+        size = capacity;
+    uint32_t offset = 0, executed = 0;
+    while (size-offset >= sizeof(CommandHeader)) {
+        const auto record = data+offset;
+        const auto recordSize = reinterpret_cast<const CommandHeader*>(record)->size;
+        if (recordSize < sizeof(CommandHeader) || recordSize%CommandAlignment || recordSize > size-offset)
+            break;
+        if (!ExecuteCommand(record, recordSize, sink, records))
+            break;
+        offset += recordSize;
+        ++executed;
+    }
+    return executed;
+}
+
+HandleTable<CommandStream*, HandleType::CommandStream> CommandStreamHandles;
+
+AK_PUBLIC uint64_t AK_CALL akCreateCommandStream(uint32_t capacity) noexcept {
+    AK_TRACE(akCreateCommandStream, capacity);
+    const auto stream = new CommandStream(capacity);
+    const auto handle = CommandStreamHandles.Insert(stream);
+    if (!handle)
+        delete stream;
+    return handle;
+}
+
+AK_PUBLIC uintptr_t AK_CALL akGetCommandStreamData(uint64_t stream) noexcept {
+    const auto commandStream = CommandStreamHandles.Lookup(stream);
+    return commandStream ? reinterpret_cast<uintptr_t>(commandStream->Data()) : 0;
+}
+
+AK_PUBLIC uint32_t AK_CALL akGetCommandStreamCapacity(uint64_t stream) noexcept {
+    const auto commandStream = CommandStreamHandles.Lookup(stream);
+    return commandStream ? commandStream->Capacity() : 0;
+}
+
+AK_PUBLIC uint32_t AK_CALL akSubmitCommandStream(uint64_t app, uint64_t stream, uint32_t size) noexcept {
+    const auto application = ApplicationHandles.Lookup(app);
+    const auto commandStream = CommandStreamHandles.Lookup(stream);
+    if (commandStream && size<=commandStream->Capacity()) {
+        // Records are 8 byte aligned, so the stream is stored as words
+        AK_TRACE(WriteCommandStream, stream,
+                TraceIn(reinterpret_cast<const uint64_t*>(commandStream->Data()), (size_t(size)+7)/8), size);
+    }
+    AK_TRACE(akSubmitCommandStream, app, stream, size);
+    if (!application || !commandStream)
+        return 0;
+    // With a render thread only the window records run here, the stream is copied and its resource records are
+    // executed there, so the caller can reuse the buffer at once
+    if (const auto renderThread = application->GetRenderThread()) {
+        const auto executed = commandStream->Execute(size, nullptr, CommandRecords::Window);
+        renderThread->Submit(*commandStream, size);
+        return executed;
+    }
+    return commandStream->Execute(size, application->GetCommandSink());
+}
+
+AK_PUBLIC void AK_CALL akDestroyCommandStream(uint64_t stream) noexcept {
+    AK_TRACE(akDestroyCommandStream, stream);
+    CommandStream* commandStream;
+    if (CommandStreamHandles.Erase(stream, &commandStream))
+        delete commandStream;
+}
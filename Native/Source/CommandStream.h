@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Config.h"
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// A command stream is a run of 8-byte aligned records. Each record starts with a
+// CommandHeader whose size covers the header and the inline payload that follows it,
+// so the decoder can skip opcodes it does not know about.
+enum class CommandOp : uint32_t {
+    Nop = 0,
+    WindowShow = 0x100,
+    WindowHide,
+    WindowMinimize,
+    WindowMaximize,
+    // 0x300 and up are left for draw records, which need graphics pipeline handles first
+    BufferUpdate = 0x200
+};
+
+struct CommandHeader {
+    uint32_t op;
+    uint32_t size;
+};
+
+struct CommandWindow {
+    uint64_t window;
+};
+
+// Followed by `size` bytes of data
+struct CommandBufferUpdate {
+    uint64_t buffer;
+    uint64_t offset;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+constexpr uint32_t CommandAlignment = 8;
+
+// Selects which records Execute runs, the rest are skipped. Window records go to SDL and must stay on the submitting
+// thread, resource records may be handed to the render thread.
+enum class CommandRecords : uint32_t {
+    Window = 1,
+    Resource = 2,
+    All = Window | Resource
+};
+
+// Receives the resource records of a stream, installed by the first device opened. Window records are handled by
+// the decoder itself.
+class CommandSink {
+public:
+    virtual ~CommandSink() = default;
+    virtual void UpdateBuffer(uint64_t buffer, uint64_t offset, const void* data, uint32_t size) noexcept = 0;
+};
+
+class CommandStream {
+public:
+    explicit CommandStream(uint32_t capacity);
+    uint8_t* Data() const noexcept { return reinterpret_cast<uint8_t*>(storage.get()); }
+    uint32_t Capacity() const noexcept { return capacity; }
+    // Returns the number of records executed. Decoding stops at the first malformed record.
+    uint32_t Execute(uint32_t size, CommandSink* sink, CommandRecords records = CommandRecords::All) const noexcept;
+private:
+    std::unique_ptr<uint64_t[]> storage;
+    uint32_t capacity;
+};
@@ -0,0 +1,111 @@
+#include "DeletionQueue.h"
+#include "Config.h"
+#include <algorithm>
+
+DeletionQueue DeferredDeletions;
+
+void DeletionQueue::Enqueue(Release release) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry entry {{}, std::move(release)};
+        entry.tags.reserve(timelines.size());
+        // Timelines with nothing in flight have nothing to wait for
+        for (const auto& timeline : timelines) {
+            if (timeline.recording>timeline.completed)
+                entry.tags.push_back({timeline.serial, timeline.recording});
+        }
+        entries.push_back(std::move(entry));
+        pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (const auto callback = notify.load(std::memory_order_acquire))
+        callback();
+}
+
+void DeletionQueue::AddTimeline(const void* owner) {
+    std::lock_guard<std::mutex> lock(mutex);
+    timelines.push_back({owner, nextSerial++, 0, 0});
+}
+
+void DeletionQueue::RemoveTimeline(const void* owner) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto found = std::find_if(timelines.begin(), timelines.end(),
+                [owner](const Timeline& timeline) noexcept { return timeline.owner==owner; });
+        if (found==timelines.end())
+            return;
+        timelines.erase(found);
+    }
+    if (Pending()) {
+        if (const auto callback = notify.load(std::memory_order_acquire))
+            callback();
+    }
+}
+
+void DeletionQueue::BeginFrame(const void* owner, uint64_t value) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& timeline : timelines) {
+        if (timeline.owner==owner)
+            timeline.recording = std::max(timeline.recording, value);
+    }
+}
+
+void DeletionQueue::Retire(const void* owner, uint64_t value) noexcept {
+    auto advanced = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& timeline : timelines) {
+            if (timeline.owner==owner && value>timeline.completed) {
+                timeline.completed = value;
+                advanced = true;
+            }
+        }
+    }
+    if (!advanced || !Pending())
+        return;
+    if (const auto callback = notify.load(std::memory_order_acquire))
+        callback();
+}
+
+size_t DeletionQueue::Collect() {
+    return CollectUntil(false);
+}
+
+size_t DeletionQueue::Flush() {
+    return CollectUntil(true);
+}
+
+bool DeletionQueue::IsRetired(const Entry& entry) const noexcept {
+    for (const auto& tag : entry.tags) {
+        const auto found = std::find_if(timelines.begin(), timelines.end(),
+                [&tag](const Timeline& timeline) noexcept { return timeline.serial==tag.serial; });
+        if (found!=timelines.end() && found->completed<tag.value)
+            return false;
+    }
+    return true;
+}
+
+size_t DeletionQueue::CollectUntil(bool all) {
+    std::vector<Entry> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Every retired entry goes, wherever it is queued; the batch and what stays keep their queue order
+        size_t kept = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (all || IsRetired(entries[i]))
+                batch.push_back(std::move(entries[i]));
+            else if (kept++ != i)
+                entries[kept - 1] = std::move(entries[i]);
+        }
+        if (batch.empty())
+            return 0;
+        entries.resize(kept);
+        pending.fetch_sub(batch.size(), std::memory_order_relaxed);
+    }
+    for (auto&& x : batch)
+        x.release();
+    return batch.size();
+}
+
+AK_PUBLIC uint64_t AK_CALL akGetPendingDeletionCount() noexcept {
+    return DeferredDeletions.Pending();
+}
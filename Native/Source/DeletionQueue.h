@@ -0,0 +1,64 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+// Defers destruction of native objects until the GPU work that may still reference them has retired.
+// Releases can be queued from any thread (including the managed finalizer thread). Every source of such work, one
+// per device's presenter, registers a timeline of its own; a release waits for the value each timeline was recording
+// when it was queued, so frame counters of different devices are never compared. The owning thread runs them in
+// batches from Collect. Compute contexts hold their releases back until their own submits retired before queuing them.
+class DeletionQueue {
+public:
+    using Release = std::function<void()>;
+    using Notify = void (*)() noexcept;
+
+    void Enqueue(Release release);
+    void AddTimeline(const void* owner);
+    // Releases stop waiting for it, only valid once its work is idle
+    void RemoveTimeline(const void* owner) noexcept;
+    // Value the frame `owner` records next signals on completion
+    void BeginFrame(const void* owner, uint64_t value) noexcept;
+    // Highest value of `owner` known to have completed on the GPU, wakes the owning thread if releases are waiting
+    void Retire(const void* owner, uint64_t value) noexcept;
+    // Runs every release whose frames have retired, returns the number of objects released
+    size_t Collect();
+    // Runs everything still queued, only valid once the devices are idle or gone
+    size_t Flush();
+    size_t Pending() const noexcept { return pending.load(std::memory_order_relaxed); }
+    // Called after each Enqueue so the owning thread can be woken up to collect
+    void SetNotify(Notify callback) noexcept { notify.store(callback, std::memory_order_release); }
+private:
+    struct Timeline {
+        const void* owner;
+        // Never reused, so releases tagged with a removed timeline do not wait for its successor
+        uint64_t serial;
+        uint64_t recording, completed;
+    };
+
+    struct Tag {
+        uint64_t serial;
+        uint64_t value;
+    };
+
+    struct Entry {
+        std::vector<Tag> tags;
+        Release release;
+    };
+
+    bool IsRetired(const Entry& entry) const noexcept;
+    size_t CollectUntil(bool all);
+
+    mutable std::mutex mutex;
+    std::vector<Timeline> timelines;
+    uint64_t nextSerial = 1;
+    std::vector<Entry> entries;
+    std::atomic<size_t> pending {0};
+    std::atomic<Notify> notify {nullptr};
+};
+
+extern DeletionQueue DeferredDeletions;
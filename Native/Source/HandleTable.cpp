@@ -0,0 +1,31 @@
+#include "HandleTable.h"
+#include "Config.h"
+#include <array>
+
+thread_local HeldHandleSlots HeldHandles;
+
+namespace {
+    auto& Registry() noexcept {
+        static std::array<std::atomic<const HandleTableBase*>, static_cast<size_t>(HandleType::Count)> tables {};
+        return tables;
+    }
+}
+
+HandleTableBase::HandleTableBase(HandleType type) noexcept : type(type) {
+    Registry()[static_cast<size_t>(type)].store(this);
+}
+
+HandleTableBase::~HandleTableBase() {
+    Registry()[static_cast<size_t>(type)].store(nullptr);
+}
+
+size_t HandleTableBase::LiveObjects(HandleType type) noexcept {
+    const auto table = Registry()[static_cast<size_t>(type)].load();
+    return table ? table->Size() : 0;
+}
+
+AK_PUBLIC uint64_t AK_CALL akGetLiveObjectCount(int type) noexcept {
+    if (type<=0 || type>=static_cast<int>(HandleType::Count))
+        return 0;
+    return HandleTableBase::LiveObjects(static_cast<HandleType>(type));
+}
@@ -0,0 +1,381 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+// Handles given out to managed code are [type:8][generation:24][index:32].
+// A handle of the wrong type, or one whose slot has been reused, fails validation instead of crashing.
+enum class HandleType : uint8_t {
+    Invalid = 0,
+    Application,
+    Window,
+    Surface,
+    DeviceFilter,
+    DeviceSelector,
+    CommandStream,
+    Device,
+    DisplayContext,
+    TexturePool,
+    Texture,
+    ComputeContext,
+    ComputePipeline,
+    ComputeBuffer,
+    Scene,
+    Tessellator,
+    Capture,
+    JobCounter,
+    Count
+};
+
+// Set while a trace is recorded or replayed, handles created meanwhile are noted so replays can map them
+extern std::atomic_bool HandleTracing;
+void TraceHandleCreated(uint64_t handle) noexcept;
+
+// Reader counts of the slots the calling thread holds a HandleRef on. Erasing one of them from the same thread only
+// waits for the other threads, the caller is responsible for its own references then.
+struct HeldHandleSlots {
+    static constexpr uint32_t Capacity = 32;
+    const std::atomic<uint32_t>* readers[Capacity];
+    uint32_t count;
+};
+
+extern thread_local HeldHandleSlots HeldHandles;
+
+// A looked up value that stays valid until the reference is gone: Erase waits for every reference to its slot
+// before it hands the value to the caller to destroy. Converts to the value, so it is used like the plain pointer.
+template <class T>
+class HandleRef {
+public:
+    HandleRef() noexcept = default;
+    HandleRef(T value, std::atomic<uint32_t>* readers) noexcept : value(value), readers(readers) {
+        auto& held = HeldHandles;
+        tracked = held.count<HeldHandleSlots::Capacity;
+        if (tracked)
+            held.readers[held.count++] = readers;
+    }
+    HandleRef(HandleRef&& other) noexcept : value(other.value), readers(other.readers), tracked(other.tracked) {
+        other.readers = nullptr;
+    }
+    HandleRef& operator=(HandleRef&& other) noexcept {
+        if (this!=&other) {
+            Release();
+            value = other.value;
+            readers = other.readers;
+            tracked = other.tracked;
+            other.readers = nullptr;
+        }
+        return *this;
+    }
+    HandleRef(const HandleRef&) = delete;
+    HandleRef& operator=(const HandleRef&) = delete;
+    ~HandleRef() { Release(); }
+    operator T() const noexcept { return value; }
+    T operator->() const noexcept { return value; }
+    T Get() const noexcept { return value; }
+private:
+    void Release() noexcept {
+        if (!readers)
+            return;
+        if (tracked) {
+            auto& held = HeldHandles;
+            for (auto i = held.count; i>0; --i) {
+                if (held.readers[i-1]==readers) {
+                    held.readers[i-1] = held.readers[--held.count];
+                    break;
+                }
+            }
+        }
+        readers->fetch_sub(1, std::memory_order_release);
+        readers = nullptr;
+    }
+
+    T value {};
+    std::atomic<uint32_t>* readers = nullptr;
+    bool tracked = false;
+};
+
+class HandleTableBase {
+public:
+    explicit HandleTableBase(HandleType type) noexcept;
+    virtual ~HandleTableBase();
+    virtual size_t Size() const noexcept = 0;
+    static size_t LiveObjects(HandleType type) noexcept;
+private:
+    HandleType type;
+};
+
+// Generational slot map. Values are kept densely packed so iteration over live objects walks contiguous memory,
+// the slots only map handles onto the packed array. Storage grows in pages that are never moved, which lets Get run
+// without taking the lock; writers bump a sequence counter so readers retry across a concurrent swap-remove.
+template <class T, HandleType Type>
+class HandleTable : public HandleTableBase {
+    static_assert(std::is_trivially_copyable_v<T>, "handle table values are read without locking");
+    static constexpr uint32_t PageBits = 10;
+    static constexpr uint32_t PageSize = 1u << PageBits;
+    static constexpr uint32_t PageMask = PageSize-1;
+    static constexpr uint32_t MaxPages = 1024;
+    static constexpr uint32_t GenerationMask = 0xFFFFFF;
+    static constexpr uint32_t NoSlot = UINT32_MAX;
+
+    struct Slot {
+        std::atomic<uint32_t> generation {0}; // odd while the slot is live
+        std::atomic<uint32_t> dense {NoSlot}; // index into the packed values, or next free slot
+        // HandleRefs to the slot, of whichever generation
+        mutable std::atomic<uint32_t> readers {0};
+    };
+
+    struct Entry {
+        std::atomic<T> value;
+        uint32_t slot;
+    };
+
+    struct Page {
+        Slot slots[PageSize];
+        Entry entries[PageSize];
+    };
+public:
+    HandleTable() noexcept : HandleTableBase(Type) {}
+
+    ~HandleTable() override {
+        for (auto& page : pages)
+            delete page.load(std::memory_order_relaxed);
+    }
+
+    HandleTable(const HandleTable&) = delete;
+    HandleTable& operator=(const HandleTable&) = delete;
+
+    // 0 once the table is full or a page can not be allocated, the caller still owns `value` then
+    uint64_t Insert(T value) noexcept {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t index;
+        if (freeHead!=NoSlot) {
+            index = freeHead;
+            freeHead = SlotAt(index).dense.load(std::memory_order_relaxed);
+        }
+        else {
+            index = slotCount;
+            if (!EnsurePage(index))
+                return 0;
+            ++slotCount;
+        }
+        auto& slot = SlotAt(index);
+        const auto dense = count.load(std::memory_order_relaxed);
+        auto& entry = EntryAt(dense);
+        const auto generation = (slot.generation.load(std::memory_order_relaxed)+1) & GenerationMask;
+        BeginWrite();
+        entry.value.store(value, std::memory_order_relaxed);
+        entry.slot = index;
+        slot.dense.store(dense, std::memory_order_relaxed);
+        slot.generation.store(generation, std::memory_order_relaxed);
+        count.store(dense+1, std::memory_order_relaxed);
+        EndWrite();
+        const auto handle = Encode(index, generation);
+        if (HandleTracing.load(std::memory_order_relaxed))
+            TraceHandleCreated(handle);
+        return handle;
+    }
+
+    bool Get(uint64_t handle, T& out) const noexcept {
+        uint32_t index, generation;
+        if (!Decode(handle, index, generation))
+            return false;
+        const auto page = pages[index >> PageBits].load(std::memory_order_acquire);
+        if (!page)
+            return false;
+        const auto& slot = page->slots[index & PageMask];
+        for (;;) {
+            const auto begin = sequence.load(std::memory_order_acquire);
+            if (!(begin & 1)) {
+                const auto live = slot.generation.load(std::memory_order_relaxed)==generation;
+                T value {};
+                if (live) {
+                    const auto dense = slot.dense.load(std::memory_order_relaxed);
+                    const auto entries = dense>>PageBits < MaxPages ?
+                            pages[dense >> PageBits].load(std::memory_order_acquire) : nullptr;
+                    if (entries)
+                        value = entries->entries[dense & PageMask].value.load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence.load(std::memory_order_relaxed)==begin) {
+                    if (live)
+                        out = value;
+                    return live;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    // Empty for an invalid handle. Hold the reference for as long as the value is used, see HandleRef.
+    HandleRef<T> Lookup(uint64_t handle) const noexcept {
+        const auto slot = FindSlot(handle);
+        if (!slot)
+            return {};
+        // Counted before the generation is checked, so an Erase that missed the reader made Get fail
+        slot->readers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        T value;
+        if (!Get(handle, value)) {
+            slot->readers.fetch_sub(1, std::memory_order_release);
+            return {};
+        }
+        return HandleRef<T>(value, &slot->readers);
+    }
+
+    bool Contains(uint64_t handle) const noexcept {
+        T value;
+        return Get(handle, value);
+    }
+
+    // Returns once no other thread holds a reference to the value anymore, so the caller may destroy it
+    bool Erase(uint64_t handle, T* out = nullptr) noexcept {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!EraseLocked(handle, out))
+                return false;
+        }
+        WaitForReaders(*FindSlot(handle));
+        return true;
+    }
+
+    // Removes every valid handle under a single lock acquisition, then hands the values to `release`
+    template <class Fn>
+    size_t EraseBatch(const uint64_t* handles, size_t handleCount, Fn&& release) {
+        std::vector<T> erased;
+        erased.reserve(handleCount);
+        std::vector<const Slot*> slots;
+        slots.reserve(handleCount);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            T value;
+            for (size_t i = 0; i<handleCount; ++i) {
+                if (EraseLocked(handles[i], &value)) {
+                    erased.push_back(value);
+                    slots.push_back(FindSlot(handles[i]));
+                }
+            }
+        }
+        for (const auto slot : slots)
+            WaitForReaders(*slot);
+        for (auto&& x : erased)
+            release(x);
+        return erased.size();
+    }
+
+    template <class Fn>
+    void ForEach(Fn&& fn) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto size = count.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i<size; ++i)
+            fn(EntryAt(i).value.load(std::memory_order_relaxed));
+    }
+
+    size_t Size() const noexcept override { return count.load(std::memory_order_relaxed); }
+private:
+    static uint64_t Encode(uint32_t index, uint32_t generation) noexcept {
+        return (static_cast<uint64_t>(Type) << 56) | (static_cast<uint64_t>(generation) << 32) | index;
+    }
+
+    static bool Decode(uint64_t handle, uint32_t& index, uint32_t& generation) noexcept {
+        index = static_cast<uint32_t>(handle);
+        generation = static_cast<uint32_t>(handle >> 32) & GenerationMask;
+        return (handle >> 56)==static_cast<uint64_t>(Type) && (generation & 1) && (index >> PageBits)<MaxPages;
+    }
+
+    // Only checks that the handle names a slot that exists, not that it is live
+    const Slot* FindSlot(uint64_t handle) const noexcept {
+        uint32_t index, generation;
+        if (!Decode(handle, index, generation))
+            return nullptr;
+        const auto page = pages[index >> PageBits].load(std::memory_order_acquire);
+        return page ? &page->slots[index & PageMask] : nullptr;
+    }
+
+    // The slot may already be reused, references to the new value are waited for too; they are short lived
+    static void WaitForReaders(const Slot& slot) noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t own = 0;
+        const auto& held = HeldHandles;
+        for (uint32_t i = 0; i<held.count; ++i) {
+            if (held.readers[i]==&slot.readers)
+                ++own;
+        }
+        for (uint32_t spins = 0; slot.readers.load(std::memory_order_acquire)>own; ++spins) {
+            if (spins<64)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    Slot& SlotAt(uint32_t index) const noexcept {
+        return pages[index >> PageBits].load(std::memory_order_relaxed)->slots[index & PageMask];
+    }
+
+    Entry& EntryAt(uint32_t index) const noexcept {
+        return pages[index >> PageBits].load(std::memory_order_relaxed)->entries[index & PageMask];
+    }
+
+    bool EnsurePage(uint32_t index) noexcept {
+        const auto page = index >> PageBits;
+        if (page>=MaxPages)
+            return false;
+        if (!pages[page].load(std::memory_order_relaxed)) {
+            const auto created = new(std::nothrow) Page();
+            if (!created)
+                return false;
+            pages[page].store(created, std::memory_order_release);
+        }
+        return true;
+    }
+
+    bool EraseLocked(uint64_t handle, T* out) noexcept {
+        uint32_t index, generation;
+        if (!Decode(handle, index, generation) || index>=slotCount)
+            return false;
+        auto& slot = SlotAt(index);
+        if (slot.generation.load(std::memory_order_relaxed)!=generation)
+            return false;
+        const auto dense = slot.dense.load(std::memory_order_relaxed);
+        const auto last = count.load(std::memory_order_relaxed)-1;
+        auto& entry = EntryAt(dense);
+        if (out)
+            *out = entry.value.load(std::memory_order_relaxed);
+        BeginWrite();
+        if (dense!=last) {
+            auto& moved = EntryAt(last);
+            entry.value.store(moved.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            entry.slot = moved.slot;
+            SlotAt(moved.slot).dense.store(dense, std::memory_order_relaxed);
+        }
+        slot.generation.store((generation+1) & GenerationMask, std::memory_order_relaxed);
+        slot.dense.store(freeHead, std::memory_order_relaxed);
+        count.store(last, std::memory_order_relaxed);
+        EndWrite();
+        freeHead = index;
+        return true;
+    }
+
+    void BeginWrite() noexcept {
+        sequence.store(sequence.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void EndWrite() noexcept {
+        sequence.store(sequence.load(std::memory_order_relaxed)+1, std::memory_order_release);
+    }
+
+    mutable std::mutex mutex;
+    std::atomic<uint32_t> sequence {0};
+    std::atomic<uint32_t> count {0};
+    std::atomic<Page*> pages[MaxPages] {};
+    uint32_t slotCount = 0;
+    uint32_t freeHead = NoSlot;
+};
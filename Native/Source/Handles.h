@@ -0,0 +1,11 @@
+#pragma once
+
+#include "HandleTable.h"
+
+struct SDL_Window;
+class CommandStream;
+class VulkanApplication;
+
+extern HandleTable<VulkanApplication*, HandleType::Application> ApplicationHandles;
+extern HandleTable<SDL_Window*, HandleType::Window> WindowHandles;
+extern HandleTable<CommandStream*, HandleType::CommandStream> CommandStreamHandles;
@@ -0,0 +1,533 @@
+#include "JobSystem.h"
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+#elif defined(__linux__)
+#  include <sched.h>
+#endif
+
+namespace {
+    // Integer work per job of the scaling benchmark
+    constexpr uint32_t BenchmarkWork = 2048;
+
+    // Victim selection for threads outside the system
+    thread_local uint32_t externalRandom = 0x9E3779B9u;
+
+    uint32_t NextRandom(uint32_t& state) noexcept {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    bool PinCurrentThread(uint32_t core) noexcept {
+        core %= std::max(std::thread::hardware_concurrency(), 1u);
+#if defined(_WIN32)
+        // Beyond the first processor group a mask cannot name the core
+        if (core>=8*sizeof(DWORD_PTR))
+            return false;
+        return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core)!=0;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        return sched_setaffinity(0, sizeof(set), &set)==0;
+#else
+        // Apple platforms only take affinity hints
+        return false;
+#endif
+    }
+
+    void AK_CALL EmptyJob(void*, uint32_t) {}
+
+    void AK_CALL BenchmarkJob(void* context, uint32_t index) {
+        auto value = index+1u;
+        for (uint32_t i = 0; i<BenchmarkWork; ++i)
+            value = value*1664525u + 1013904223u;
+        // Written out so the loop is not optimized away
+        static_cast<uint32_t*>(context)[index] = value;
+    }
+}
+
+JobSystem Jobs;
+HandleTable<JobCounter*, HandleType::JobCounter> JobCounterHandles;
+
+thread_local const JobSystem* JobSystem::currentSystem = nullptr;
+thread_local JobSystem::Worker* JobSystem::currentWorker = nullptr;
+
+void JobSystem::Deque::Store(int64_t position, const Job& job) noexcept {
+    auto& slot = slots[position & (DequeCapacity-1)];
+    slot.function.store(job.function, std::memory_order_relaxed);
+    slot.context.store(job.context, std::memory_order_relaxed);
+    slot.counter.store(job.counter, std::memory_order_relaxed);
+    slot.index.store(job.index, std::memory_order_relaxed);
+}
+
+void JobSystem::Deque::Load(int64_t position, Job& job) const noexcept {
+    const auto& slot = slots[position & (DequeCapacity-1)];
+    job.function = slot.function.load(std::memory_order_relaxed);
+    job.context = slot.context.load(std::memory_order_relaxed);
+    job.counter = slot.counter.load(std::memory_order_relaxed);
+    job.index = slot.index.load(std::memory_order_relaxed);
+}
+
+bool JobSystem::Deque::Push(const Job& job) noexcept {
+    const auto b = bottom.load(std::memory_order_relaxed);
+    const auto t = top.load(std::memory_order_acquire);
+    if (b-t>=int64_t(DequeCapacity))
+        return false;
+    Store(b, job);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b+1, std::memory_order_relaxed);
+    return true;
+}
+
+bool JobSystem::Deque::Pop(Job& job) noexcept {
+    const auto b = bottom.load(std::memory_order_relaxed)-1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = top.load(std::memory_order_relaxed);
+    if (t>b) {
+        bottom.store(b+1, std::memory_order_relaxed);
+        return false;
+    }
+    Load(b, job);
+    if (t<b)
+        return true;
+    // Last job, thieves may be after it as well
+    const auto won = top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    bottom.store(b+1, std::memory_order_relaxed);
+    return won;
+}
+
+bool JobSystem::Deque::Steal(Job& job) noexcept {
+    auto t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const auto b = bottom.load(std::memory_order_acquire);
+    if (t>=b)
+        return false;
+    Load(t, job);
+    return top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+bool JobSystem::Deque::Empty() const noexcept {
+    return bottom.load(std::memory_order_relaxed)<=top.load(std::memory_order_relaxed);
+}
+
+JobSystem::~JobSystem() {
+    Stop();
+}
+
+bool JobSystem::Start(uint32_t count, bool pin) {
+    std::lock_guard<std::mutex> control(controlMutex);
+    if (running.load(std::memory_order_relaxed))
+        return false;
+    if (!count)
+        count = std::max(std::thread::hardware_concurrency(), 2u)-1;
+    count = std::min(count, MaxWorkers);
+    for (uint32_t i = 0; i<count; ++i) {
+        if (!workers[i]) {
+            workers[i] = std::make_unique<Worker>();
+            workers[i]->random = 2654435761u*(i+1);
+        }
+        auto& worker = *workers[i];
+        worker.jobs.store(0, std::memory_order_relaxed);
+        worker.steals.store(0, std::memory_order_relaxed);
+        worker.sleeps.store(0, std::memory_order_relaxed);
+    }
+    workerCount.store(count, std::memory_order_release);
+    try {
+        for (uint32_t i = 0; i<count; ++i)
+            workers[i]->thread = std::thread([this, i, pin]() noexcept { Work(i, pin); });
+    }
+    catch (const std::system_error&) {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (uint32_t i = 0; i<count; ++i) {
+            if (workers[i]->thread.joinable())
+                workers[i]->thread.join();
+        }
+        workerCount.store(0, std::memory_order_release);
+        stopping = false;
+        throw std::runtime_error("failed to start job system workers!");
+    }
+    running.store(true, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::Stop() noexcept {
+    std::lock_guard<std::mutex> control(controlMutex);
+    if (!running.load(std::memory_order_relaxed))
+        return;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    const auto count = GetWorkerCount();
+    for (uint32_t i = 0; i<count; ++i)
+        workers[i]->thread.join();
+    // Everything queued still runs so counters reach zero
+    Job job;
+    while (Find(nullptr, job))
+        Execute(job, nullptr);
+    workerCount.store(0, std::memory_order_release);
+    pinnedWorkers.store(0, std::memory_order_relaxed);
+    stopping = false;
+    running.store(false, std::memory_order_release);
+}
+
+void JobSystem::Run(JobFunction function, void* context, uint32_t count, JobCounter* counter, JobCounter* after) {
+    if (!count)
+        return;
+    if (!IsRunning())
+        Start(0, false);
+    if (after) {
+        std::unique_lock<std::mutex> lock(after->mutex);
+        if (after->value.load(std::memory_order_acquire)) {
+            // Reserved first so nothing was counted if it throws
+            after->waiting.reserve(after->waiting.size()+count);
+            if (counter)
+                counter->value.fetch_add(count, std::memory_order_relaxed);
+            for (uint32_t i = 0; i<count; ++i)
+                after->waiting.push_back({function, context, counter, i});
+            return;
+        }
+    }
+    if (counter)
+        counter->value.fetch_add(count, std::memory_order_relaxed);
+    const auto self = GetCurrentWorker();
+    constexpr uint32_t ChunkSize = 64;
+    Job chunk[ChunkSize];
+    for (uint32_t first = 0; first<count; first += ChunkSize) {
+        const auto size = std::min(ChunkSize, count-first);
+        for (uint32_t i = 0; i<size; ++i)
+            chunk[i] = {function, context, counter, first+i};
+        Queue(chunk, size, self);
+    }
+}
+
+void JobSystem::Wait(JobCounter& counter) noexcept {
+    const auto self = GetCurrentWorker();
+    Job job;
+    while (counter.value.load(std::memory_order_acquire)) {
+        if (Find(self, job)) {
+            Execute(job, self);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping.fetch_add(1, std::memory_order_seq_cst);
+        wake.wait(lock, [&]() noexcept { return !counter.value.load(std::memory_order_seq_cst) || HasWork(); });
+        sleeping.fetch_sub(1, std::memory_order_relaxed);
+    }
+    // Whoever brought it to zero may still hold it
+    std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+JobSystemStats JobSystem::GetStats() noexcept {
+    std::lock_guard<std::mutex> control(controlMutex);
+    JobSystemStats stats = {};
+    stats.workers = GetWorkerCount();
+    stats.pinnedWorkers = pinnedWorkers.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i<stats.workers; ++i) {
+        const auto& worker = *workers[i];
+        stats.jobs += worker.jobs.load(std::memory_order_relaxed);
+        stats.steals += worker.steals.load(std::memory_order_relaxed);
+        stats.sleeps += worker.sleeps.load(std::memory_order_relaxed);
+    }
+    stats.helpedJobs = helpedJobs.load(std::memory_order_relaxed);
+    stats.jobs += stats.helpedJobs;
+    return stats;
+}
+
+void JobSystem::Work(uint32_t index, bool pin) noexcept {
+    auto& self = *workers[index];
+    currentSystem = this;
+    currentWorker = &self;
+    // Core 0 is left to the threads that queue
+    if (pin && PinCurrentThread(index+1))
+        pinnedWorkers.fetch_add(1, std::memory_order_relaxed);
+    Job job;
+    for (;;) {
+        auto found = Find(&self, job);
+        for (uint32_t spin = 0; !found && spin<SpinCount; ++spin) {
+            std::this_thread::yield();
+            found = Find(&self, job);
+        }
+        if (found) {
+            Execute(job, &self);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        if (stopping)
+            break;
+        sleeping.fetch_add(1, std::memory_order_seq_cst);
+        if (!HasWork()) {
+            self.sleeps.fetch_add(1, std::memory_order_relaxed);
+            wake.wait(lock, [this]() noexcept { return stopping || HasWork(); });
+        }
+        sleeping.fetch_sub(1, std::memory_order_relaxed);
+        if (stopping)
+            break;
+    }
+    currentSystem = nullptr;
+    currentWorker = nullptr;
+}
+
+void JobSystem::Queue(const Job* jobs, size_t count, Worker* self) noexcept {
+    size_t pushed = 0;
+    if (self) {
+        while (pushed<count && self->deque.Push(jobs[pushed]))
+            ++pushed;
+    }
+    if (pushed<count)
+        Inject(jobs+pushed, count-pushed, self);
+    Notify(count);
+}
+
+void JobSystem::Inject(const Job* jobs, size_t count, Worker* self) noexcept {
+    size_t queued = 0;
+    {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        try {
+            for (; queued<count; ++queued)
+                injected.push_back(jobs[queued]);
+        }
+        catch (const std::bad_alloc&) {
+        }
+        injectedCount.fetch_add(queued, std::memory_order_seq_cst);
+    }
+    // Out of memory, what did not fit runs right here
+    for (auto i = queued; i<count; ++i)
+        Execute(jobs[i], self);
+}
+
+bool JobSystem::Find(Worker* self, Job& job) noexcept {
+    if (self && self->deque.Pop(job))
+        return true;
+    if (TakeInjected(self, job))
+        return true;
+    const auto count = GetWorkerCount();
+    if (!count)
+        return false;
+    const auto start = NextRandom(self ? self->random : externalRandom);
+    for (size_t i = 0; i<count; ++i) {
+        const auto& victim = workers[(start+i)%count];
+        if (victim.get()==self || !victim->deque.Steal(job))
+            continue;
+        if (self)
+            self->steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+bool JobSystem::TakeInjected(Worker* self, Job& job) noexcept {
+    if (!injectedCount.load(std::memory_order_relaxed))
+        return false;
+    size_t moved = 0;
+    {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        if (injected.empty())
+            return false;
+        job = injected.front();
+        injected.pop_front();
+        // A fair share of the rest goes to the own deque, where others can still steal it
+        if (self) {
+            const auto share = std::min(InjectionBatch, injected.size()/std::max(GetWorkerCount(), 1u));
+            while (moved<share && self->deque.Push(injected.front())) {
+                injected.pop_front();
+                ++moved;
+            }
+        }
+        injectedCount.fetch_sub(moved+1, std::memory_order_relaxed);
+    }
+    if (moved)
+        Notify(moved);
+    return true;
+}
+
+bool JobSystem::HasWork() const noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (injectedCount.load(std::memory_order_relaxed))
+        return true;
+    const auto count = GetWorkerCount();
+    for (uint32_t i = 0; i<count; ++i) {
+        if (!workers[i]->deque.Empty())
+            return true;
+    }
+    return false;
+}
+
+void JobSystem::Execute(const Job& job, Worker* self) noexcept {
+    job.function(job.context, job.index);
+    if (self)
+        self->jobs.fetch_add(1, std::memory_order_relaxed);
+    else
+        helpedJobs.fetch_add(1, std::memory_order_relaxed);
+    if (job.counter)
+        Finish(*job.counter);
+}
+
+void JobSystem::Finish(JobCounter& counter) noexcept {
+    auto value = counter.value.load(std::memory_order_relaxed);
+    while (value>1) {
+        if (counter.value.compare_exchange_weak(value, value-1, std::memory_order_release,
+                std::memory_order_relaxed))
+            return;
+    }
+    std::vector<Job> released;
+    {
+        std::lock_guard<std::mutex> lock(counter.mutex);
+        if (counter.value.fetch_sub(1, std::memory_order_seq_cst)==1)
+            released.swap(counter.waiting);
+    }
+    if (!released.empty())
+        Queue(released.data(), released.size(), GetCurrentWorker());
+    // Waiters sleep with the workers
+    if (sleeping.load(std::memory_order_seq_cst)) {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_all();
+    }
+}
+
+void JobSystem::Notify(size_t count) noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!sleeping.load(std::memory_order_relaxed))
+        return;
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    if (count>1)
+        wake.notify_all();
+    else
+        wake.notify_one();
+}
+
+std::vector<JobBenchmark> BenchmarkJobSystem(uint32_t jobs, uint32_t iterations) {
+    jobs = std::max(jobs, 1u);
+    const auto maxWorkers = std::max(std::thread::hardware_concurrency(), 2u)-1;
+    std::vector<uint32_t> counts;
+    for (uint32_t workers = 1; workers<maxWorkers; workers *= 2)
+        counts.push_back(workers);
+    counts.push_back(maxWorkers);
+    std::vector<uint32_t> output(jobs);
+    std::vector<JobBenchmark> results;
+    for (const auto workers : counts) {
+        JobSystem system;
+        system.Start(workers, false);
+        const auto run = [&](JobFunction function, void* context) {
+            auto best = std::chrono::steady_clock::duration::max();
+            for (uint32_t i = 0; i<std::max(iterations, 1u); ++i) {
+                JobCounter counter;
+                const auto start = std::chrono::steady_clock::now();
+                system.Run(function, context, jobs, &counter);
+                system.Wait(counter);
+                best = std::min(best, std::chrono::steady_clock::now()-start);
+            }
+            return std::chrono::duration<double, std::milli>(best).count();
+        };
+        JobBenchmark result = {};
+        result.workers = workers;
+        result.jobs = jobs;
+        result.overheadNanoseconds = 1e6*run(EmptyJob, nullptr)/jobs;
+        const auto milliseconds = run(BenchmarkJob, output.data());
+        result.jobsPerMillisecond = milliseconds>0 ? jobs/milliseconds : 0.0;
+        result.speedup = results.empty() || results.front().jobsPerMillisecond<=0 ? 1.0 :
+                result.jobsPerMillisecond/results.front().jobsPerMillisecond;
+        results.push_back(result);
+    }
+    return results;
+}
+
+// Not traced: jobs call back into the process that queued them, a replay has nothing to run
+
+AK_PUBLIC bool AK_CALL akJobSystemStart(uint32_t workers, bool pin) noexcept {
+    try {
+        return Jobs.Start(workers, pin);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "job system: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+AK_PUBLIC void AK_CALL akJobSystemGetStats(JobSystemStats* stats) noexcept {
+    if (!stats)
+        return;
+    *stats = Jobs.GetStats();
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateJobCounter() noexcept {
+    try {
+        auto counter = std::make_unique<JobCounter>();
+        const auto handle = JobCounterHandles.Insert(counter.get());
+        if (handle)
+            counter.release();
+        return handle;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "job system: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+// Jobs still counting on it finish first
+AK_PUBLIC void AK_CALL akDestroyJobCounter(uint64_t handle) noexcept {
+    JobCounter* counter;
+    if (!JobCounterHandles.Erase(handle, &counter))
+        return;
+    Jobs.Wait(*counter);
+    delete counter;
+}
+
+AK_PUBLIC uint32_t AK_CALL akJobCounterGetValue(uint64_t handle) noexcept {
+    const auto counter = JobCounterHandles.Lookup(handle);
+    return counter ? counter->GetValue() : 0;
+}
+
+AK_PUBLIC void AK_CALL akJobCounterWait(uint64_t handle) noexcept {
+    const auto counter = JobCounterHandles.Lookup(handle);
+    if (counter)
+        Jobs.Wait(*counter);
+}
+
+AK_PUBLIC bool AK_CALL akJobSystemRun(JobFunction function, void* context, uint32_t count, uint64_t counterHandle,
+        uint64_t afterHandle) noexcept {
+    if (!function)
+        return false;
+    const auto counter = JobCounterHandles.Lookup(counterHandle);
+    const auto after = JobCounterHandles.Lookup(afterHandle);
+    if ((counterHandle && !counter) || (afterHandle && !after))
+        return false;
+    try {
+        Jobs.Run(function, context, count, counter, after);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "job system: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+AK_PUBLIC uint32_t AK_CALL akJobSystemBenchmark(uint32_t jobs, uint32_t iterations, JobBenchmark* results,
+        uint32_t capacity) noexcept {
+    try {
+        const auto benchmarks = BenchmarkJobSystem(jobs, iterations);
+        const auto count = std::min(capacity, static_cast<uint32_t>(benchmarks.size()));
+        std::copy_n(benchmarks.begin(), count, results);
+        return count;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "job system: " << e.what() << std::endl;
+        return 0;
+    }
+}
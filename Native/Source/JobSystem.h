@@ -0,0 +1,165 @@
+#pragma once
+
+#include "Config.h"
+#include "HandleTable.h"
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <condition_variable>
+
+class JobCounter;
+
+// Called once for every index of the batch it was queued with
+using JobFunction = void (AK_CALL*)(void* context, uint32_t index);
+
+struct Job {
+    JobFunction function;
+    void* context;
+    JobCounter* counter;
+    uint32_t index;
+};
+
+struct JobSystemStats {
+    uint32_t workers;
+    uint32_t pinnedWorkers;
+    uint64_t jobs;
+    // Jobs a worker took from another worker's deque
+    uint64_t steals;
+    // Jobs run by threads outside the system while they waited for a counter
+    uint64_t helpedJobs;
+    uint64_t sleeps;
+};
+
+struct JobBenchmark {
+    uint32_t workers;
+    uint32_t jobs;
+    // Queueing, running and waiting for a batch of empty jobs, per job
+    double overheadNanoseconds;
+    // A batch of equally sized jobs, and its throughput relative to the first entry
+    double jobsPerMillisecond;
+    double speedup;
+};
+
+// Number of jobs still to finish. Jobs can be queued to start once a counter reached zero, a counter is reused by
+// queuing more jobs on it after that.
+class JobCounter {
+public:
+    JobCounter() noexcept = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+    uint32_t GetValue() const noexcept { return value.load(std::memory_order_acquire); }
+private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> value {0};
+    // Taken for the transition to zero, so whoever saw zero under it may destroy the counter
+    std::mutex mutex;
+    std::vector<Job> waiting;
+};
+
+// Work-stealing scheduler shared by everything that runs native work in parallel, managed code included. Every worker
+// owns a Chase-Lev deque: it pushes and pops at the bottom, idle workers steal from the top of the others. Threads
+// outside the system queue into a shared injection queue that workers drain in small batches, and help with jobs
+// while they wait for a counter. Idle workers spin briefly before they sleep.
+class JobSystem {
+public:
+    static constexpr uint32_t DequeCapacity = 4096;
+    static constexpr uint32_t SpinCount = 64;
+    // Most jobs a worker moves from the injection queue to its own deque at once
+    static constexpr size_t InjectionBatch = 32;
+    static constexpr uint32_t MaxWorkers = 256;
+
+    JobSystem() noexcept = default;
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    // 0 workers leaves one hardware thread to the caller, at most MaxWorkers are started. Pinned workers are bound
+    // to one core each, starting after the first. Returns false if the system is running already.
+    bool Start(uint32_t workers, bool pin);
+    // Runs whatever is still queued on the calling thread, nothing may queue jobs meanwhile
+    void Stop() noexcept;
+    bool IsRunning() const noexcept { return running.load(std::memory_order_acquire); }
+    uint32_t GetWorkerCount() const noexcept { return workerCount.load(std::memory_order_acquire); }
+    // Queues function(context, 0..count-1), starting the system with the defaults if it is not running. Every job
+    // counts on `counter`; with `after` they are only queued once that counter reached zero.
+    void Run(JobFunction function, void* context, uint32_t count, JobCounter* counter = nullptr,
+            JobCounter* after = nullptr);
+    // Runs queued jobs until the counter reached zero, sleeps when there is nothing left to help with
+    void Wait(JobCounter& counter) noexcept;
+    JobSystemStats GetStats() noexcept;
+private:
+    class Deque {
+    public:
+        bool Push(const Job& job) noexcept;
+        bool Pop(Job& job) noexcept;
+        bool Steal(Job& job) noexcept;
+        bool Empty() const noexcept;
+    private:
+        // Read by thieves while the owner may overwrite them, so every field is atomic
+        struct Slot {
+            std::atomic<JobFunction> function {nullptr};
+            std::atomic<void*> context {nullptr};
+            std::atomic<JobCounter*> counter {nullptr};
+            std::atomic<uint32_t> index {0};
+        };
+
+        void Store(int64_t position, const Job& job) noexcept;
+        void Load(int64_t position, Job& job) const noexcept;
+
+        alignas(64) std::atomic<int64_t> top {0};
+        alignas(64) std::atomic<int64_t> bottom {0};
+        alignas(64) Slot slots[DequeCapacity];
+    };
+
+    struct Worker {
+        Deque deque;
+        std::thread thread;
+        uint32_t random = 0;
+        alignas(64) std::atomic<uint64_t> jobs {0}, steals {0}, sleeps {0};
+    };
+
+    void Work(uint32_t index, bool pin) noexcept;
+    Worker* GetCurrentWorker() const noexcept { return currentSystem==this ? currentWorker : nullptr; }
+    // Onto the calling worker's deque if there is one, what does not fit goes to the injection queue
+    void Queue(const Job* jobs, size_t count, Worker* self) noexcept;
+    void Inject(const Job* jobs, size_t count, Worker* self) noexcept;
+    bool Find(Worker* self, Job& job) noexcept;
+    bool TakeInjected(Worker* self, Job& job) noexcept;
+    bool HasWork() const noexcept;
+    void Execute(const Job& job, Worker* self) noexcept;
+    void Finish(JobCounter& counter) noexcept;
+    void Notify(size_t count) noexcept;
+
+    std::mutex controlMutex;
+    std::atomic_bool running {false};
+    // Threads outside the system steal from the workers while it may be stopped or started, so a worker is never
+    // freed before the system and a slot never changes once filled; later starts reuse them. Slots below
+    // workerCount are filled.
+    std::unique_ptr<Worker> workers[MaxWorkers];
+    std::atomic<uint32_t> workerCount {0};
+    std::atomic<uint32_t> pinnedWorkers {0};
+    std::mutex injectionMutex;
+    std::deque<Job> injected;
+    std::atomic<size_t> injectedCount {0};
+    // Workers and waiters sleep on the same condition, it is signalled for new jobs and for counters reaching zero
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<uint32_t> sleeping {0};
+    bool stopping = false;
+    std::atomic<uint64_t> helpedJobs {0};
+
+    static thread_local const JobSystem* currentSystem;
+    static thread_local Worker* currentWorker;
+};
+
+// One entry per worker count, 1, 2, 4... up to one less than the hardware threads, each on a system of its own. The
+// calling thread queues the batches and helps while it waits, like a managed caller would.
+std::vector<JobBenchmark> BenchmarkJobSystem(uint32_t jobs, uint32_t iterations);
+
+extern JobSystem Jobs;
+extern HandleTable<JobCounter*, HandleType::JobCounter> JobCounterHandles;
@@ -0,0 +1,75 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+
+MappedFile::MappedFile(const char* path) {
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file==INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("failed to open file!");
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw std::runtime_error("failed to query file size!");
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+    if (!size)
+        return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping)
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!data) {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("failed to map file!");
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    CloseHandle(file);
+}
+
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+
+MappedFile::MappedFile(const char* path) {
+    const auto fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd<0) {
+        throw std::runtime_error("failed to open file!");
+    }
+    struct stat status {};
+    if (fstat(fd, &status)!=0) {
+        close(fd);
+        throw std::runtime_error("failed to query file size!");
+    }
+    size = static_cast<size_t>(status.st_size);
+    if (size) {
+        const auto address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address==MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("failed to map file!");
+        }
+        data = static_cast<const uint8_t*>(address);
+    }
+    // The mapping keeps its own reference to the file
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data)
+        munmap(const_cast<uint8_t*>(data), size);
+}
+
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Read-only view of a whole file through the page cache. Pages are only faulted in when touched, so copying a
+// region out of the mapping reads exactly that region from disk.
+class MappedFile {
+public:
+    explicit MappedFile(const char* path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    const uint8_t* GetData() const noexcept { return data; }
+    size_t GetSize() const noexcept { return size; }
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#if defined(_WIN32)
+    void* file;
+    void* mapping = nullptr;
+#endif
+};
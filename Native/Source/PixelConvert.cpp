@@ -0,0 +1,319 @@
+#include "PixelConvert.h"
+#include "Config.h"
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+    struct Tables {
+        alignas(64) uint8_t toLinear[256];
+        alignas(64) uint8_t toSrgb[256];
+        // Gathers load 32 bit elements
+        alignas(64) uint32_t toLinear32[256];
+        alignas(64) uint32_t toSrgb32[256];
+
+        Tables() noexcept {
+            for (uint32_t i = 0; i<256; ++i) {
+                const auto x = i/255.0;
+                const auto linear = x<=0.04045 ? x/12.92 : std::pow((x+0.055)/1.055, 2.4);
+                const auto srgb = x<=0.0031308 ? x*12.92 : 1.055*std::pow(x, 1/2.4)-0.055;
+                toLinear32[i] = toLinear[i] = static_cast<uint8_t>(std::lround(linear*255));
+                toSrgb32[i] = toSrgb[i] = static_cast<uint8_t>(std::lround(srgb*255));
+            }
+        }
+    };
+
+    const Tables& GetTables() noexcept {
+        static const Tables tables;
+        return tables;
+    }
+
+    using Kernel = void (*)(const uint8_t* source, uint8_t* destination, size_t count, uint32_t conversion);
+
+    // c*a/255 rounded to nearest
+    inline uint32_t Multiply(uint32_t c, uint32_t a) noexcept {
+        const auto t = c*a+128;
+        return (t+(t >> 8)) >> 8;
+    }
+
+    // Red in the low byte, pixels are stored little endian
+    inline uint32_t ConvertPixel(uint32_t pixel, uint32_t conversion, const Tables& tables) noexcept {
+        uint32_t r = pixel & 0xFF, g = (pixel >> 8) & 0xFF, b = (pixel >> 16) & 0xFF;
+        const auto a = pixel >> 24;
+        if (conversion & PixelSrgbToLinear) {
+            r = tables.toLinear[r];
+            g = tables.toLinear[g];
+            b = tables.toLinear[b];
+        }
+        if (conversion & PixelPremultiply) {
+            r = Multiply(r, a);
+            g = Multiply(g, a);
+            b = Multiply(b, a);
+        }
+        if (conversion & PixelLinearToSrgb) {
+            r = tables.toSrgb[r];
+            g = tables.toSrgb[g];
+            b = tables.toSrgb[b];
+        }
+        if (conversion & PixelSwapRedBlue)
+            std::swap(r, b);
+        return r | g << 8 | b << 16 | a << 24;
+    }
+
+    void ConvertScalar(const uint8_t* source, uint8_t* destination, size_t count, uint32_t conversion) noexcept {
+        const auto& tables = GetTables();
+        for (size_t i = 0; i<count; ++i) {
+            uint32_t pixel;
+            memcpy(&pixel, source+4*i, 4);
+            pixel = ConvertPixel(pixel, conversion, tables);
+            memcpy(destination+4*i, &pixel, 4);
+        }
+    }
+
+#if defined(AK_SIMD_SSE2)
+    // SSE2 has no byte shuffle, the tables are applied lane by lane
+    inline __m128i LookupSSE2(__m128i pixels, const uint8_t* table) noexcept {
+        alignas(16) uint8_t bytes[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(bytes), pixels);
+        for (uint32_t i = 0; i<16; i += 4) {
+            bytes[i] = table[bytes[i]];
+            bytes[i+1] = table[bytes[i+1]];
+            bytes[i+2] = table[bytes[i+2]];
+        }
+        return _mm_load_si128(reinterpret_cast<const __m128i*>(bytes));
+    }
+
+    // Four 16 bit channels per pixel, the alpha lanes are multiplied by 255, which leaves them unchanged
+    inline __m128i ScaleSSE2(__m128i x) noexcept {
+        const auto colors = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+        const auto alphaOne = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+        auto alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        alpha = _mm_or_si128(_mm_and_si128(alpha, colors), alphaOne);
+        const auto t = _mm_add_epi16(_mm_mullo_epi16(x, alpha), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    inline __m128i PremultiplySSE2(__m128i pixels) noexcept {
+        const auto zero = _mm_setzero_si128();
+        return _mm_packus_epi16(ScaleSSE2(_mm_unpacklo_epi8(pixels, zero)), ScaleSSE2(_mm_unpackhi_epi8(pixels, zero)));
+    }
+
+    inline __m128i SwapRedBlueSSE2(__m128i pixels) noexcept {
+        const auto greenAlpha = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+        const auto redBlue = _mm_andnot_si128(greenAlpha, pixels);
+        return _mm_or_si128(_mm_and_si128(pixels, greenAlpha),
+                _mm_or_si128(_mm_srli_epi32(redBlue, 16), _mm_slli_epi32(redBlue, 16)));
+    }
+
+    void ConvertSSE2(const uint8_t* source, uint8_t* destination, size_t count, uint32_t conversion) noexcept {
+        const auto& tables = GetTables();
+        size_t i = 0;
+        for (; i+4<=count; i += 4) {
+            auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source+4*i));
+            if (conversion & PixelSrgbToLinear)
+                pixels = LookupSSE2(pixels, tables.toLinear);
+            if (conversion & PixelPremultiply)
+                pixels = PremultiplySSE2(pixels);
+            if (conversion & PixelLinearToSrgb)
+                pixels = LookupSSE2(pixels, tables.toSrgb);
+            if (conversion & PixelSwapRedBlue)
+                pixels = SwapRedBlueSSE2(pixels);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination+4*i), pixels);
+        }
+        ConvertScalar(source+4*i, destination+4*i, count-i, conversion);
+    }
+
+    AK_TARGET_AVX2 inline __m256i LookupAVX2(__m256i pixels, const uint32_t* table) noexcept {
+        const auto base = reinterpret_cast<const int*>(table);
+        const auto byte = _mm256_set1_epi32(0xFF);
+        const auto r = _mm256_i32gather_epi32(base, _mm256_and_si256(pixels, byte), 4);
+        const auto g = _mm256_i32gather_epi32(base, _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byte), 4);
+        const auto b = _mm256_i32gather_epi32(base, _mm256_and_si256(_mm256_srli_epi32(pixels, 16), byte), 4);
+        const auto alpha = _mm256_and_si256(pixels, _mm256_set1_epi32(static_cast<int>(0xFF000000)));
+        return _mm256_or_si256(_mm256_or_si256(alpha, r),
+                _mm256_or_si256(_mm256_slli_epi32(g, 8), _mm256_slli_epi32(b, 16)));
+    }
+
+    AK_TARGET_AVX2 inline __m256i ScaleAVX2(__m256i x) noexcept {
+        const auto colors = _mm256_set1_epi64x(0x0000FFFFFFFFFFFF);
+        const auto alphaOne = _mm256_set1_epi64x(0x00FF000000000000);
+        auto alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3)),
+                _MM_SHUFFLE(3, 3, 3, 3));
+        alpha = _mm256_or_si256(_mm256_and_si256(alpha, colors), alphaOne);
+        const auto t = _mm256_add_epi16(_mm256_mullo_epi16(x, alpha), _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+    }
+
+    AK_TARGET_AVX2 inline __m256i PremultiplyAVX2(__m256i pixels) noexcept {
+        // Unpacking and packing both work within 128 bit lanes, so the pixel order survives
+        const auto zero = _mm256_setzero_si256();
+        return _mm256_packus_epi16(ScaleAVX2(_mm256_unpacklo_epi8(pixels, zero)),
+                ScaleAVX2(_mm256_unpackhi_epi8(pixels, zero)));
+    }
+
+    AK_TARGET_AVX2 void ConvertAVX2(const uint8_t* source, uint8_t* destination, size_t count,
+            uint32_t conversion) noexcept {
+        const auto& tables = GetTables();
+        const auto swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        size_t i = 0;
+        for (; i+8<=count; i += 8) {
+            auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source+4*i));
+            if (conversion & PixelSrgbToLinear)
+                pixels = LookupAVX2(pixels, tables.toLinear32);
+            if (conversion & PixelPremultiply)
+                pixels = PremultiplyAVX2(pixels);
+            if (conversion & PixelLinearToSrgb)
+                pixels = LookupAVX2(pixels, tables.toSrgb32);
+            if (conversion & PixelSwapRedBlue)
+                pixels = _mm256_shuffle_epi8(pixels, swap);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination+4*i), pixels);
+        }
+        ConvertScalar(source+4*i, destination+4*i, count-i, conversion);
+    }
+#endif
+
+#if defined(AK_SIMD_NEON)
+    struct TableNEON {
+#  if defined(__aarch64__) || defined(_M_ARM64)
+        uint8x16x4_t parts[4];
+
+        explicit TableNEON(const uint8_t* table) noexcept {
+            for (uint32_t i = 0; i<4; ++i)
+                for (uint32_t j = 0; j<4; ++j)
+                    parts[i].val[j] = vld1q_u8(table+64*i+16*j);
+        }
+
+        // Indices past a 64 byte part leave the lane unchanged, so the four lookups combine
+        uint8x16_t Lookup(uint8x16_t index) const noexcept {
+            auto result = vqtbl4q_u8(parts[0], index);
+            result = vqtbx4q_u8(result, parts[1], vsubq_u8(index, vdupq_n_u8(64)));
+            result = vqtbx4q_u8(result, parts[2], vsubq_u8(index, vdupq_n_u8(128)));
+            return vqtbx4q_u8(result, parts[3], vsubq_u8(index, vdupq_n_u8(192)));
+        }
+#  else
+        const uint8_t* table;
+
+        explicit TableNEON(const uint8_t* table) noexcept : table(table) {}
+
+        // 32 bit NEON only looks up 32 bytes at a time
+        uint8x16_t Lookup(uint8x16_t index) const noexcept {
+            uint8_t bytes[16];
+            vst1q_u8(bytes, index);
+            for (auto& x : bytes)
+                x = table[x];
+            return vld1q_u8(bytes);
+        }
+#  endif
+    };
+
+    inline uint8x16_t MultiplyNEON(uint8x16_t c, uint8x16_t a) noexcept {
+        // (t + ((t+128) >> 8) + 128) >> 8, the same rounding as the scalar path
+        const auto low = vmull_u8(vget_low_u8(c), vget_low_u8(a));
+        const auto high = vmull_u8(vget_high_u8(c), vget_high_u8(a));
+        return vcombine_u8(vraddhn_u16(low, vrshrq_n_u16(low, 8)), vraddhn_u16(high, vrshrq_n_u16(high, 8)));
+    }
+
+    void ConvertNEON(const uint8_t* source, uint8_t* destination, size_t count, uint32_t conversion) noexcept {
+        const auto& tables = GetTables();
+        const TableNEON toLinear(tables.toLinear), toSrgb(tables.toSrgb);
+        size_t i = 0;
+        for (; i+16<=count; i += 16) {
+            // One register per channel
+            auto pixels = vld4q_u8(source+4*i);
+            if (conversion & PixelSrgbToLinear) {
+                for (uint32_t c = 0; c<3; ++c)
+                    pixels.val[c] = toLinear.Lookup(pixels.val[c]);
+            }
+            if (conversion & PixelPremultiply) {
+                for (uint32_t c = 0; c<3; ++c)
+                    pixels.val[c] = MultiplyNEON(pixels.val[c], pixels.val[3]);
+            }
+            if (conversion & PixelLinearToSrgb) {
+                for (uint32_t c = 0; c<3; ++c)
+                    pixels.val[c] = toSrgb.Lookup(pixels.val[c]);
+            }
+            if (conversion & PixelSwapRedBlue)
+                std::swap(pixels.val[0], pixels.val[2]);
+            vst4q_u8(destination+4*i, pixels);
+        }
+        ConvertScalar(source+4*i, destination+4*i, count-i, conversion);
+    }
+#endif
+
+    Kernel GetKernel(SimdLevel level) noexcept {
+        switch (level) {
+#if defined(AK_SIMD_SSE2)
+        case SimdLevel::SSE2:
+            return ConvertSSE2;
+        case SimdLevel::AVX2:
+            return ConvertAVX2;
+#endif
+#if defined(AK_SIMD_NEON)
+        case SimdLevel::NEON:
+            return ConvertNEON;
+#endif
+        default:
+            return ConvertScalar;
+        }
+    }
+}
+
+void ConvertPixels(const void* source, void* destination, size_t count, uint32_t conversion) noexcept {
+    ConvertPixels(source, destination, count, conversion, GetSimdLevel());
+}
+
+void ConvertPixels(const void* source, void* destination, size_t count, uint32_t conversion,
+        SimdLevel level) noexcept {
+    if (!conversion) {
+        if (source!=destination)
+            memcpy(destination, source, 4*count);
+        return;
+    }
+    const auto kernel = SupportsSimdLevel(level) ? GetKernel(level) : ConvertScalar;
+    kernel(static_cast<const uint8_t*>(source), static_cast<uint8_t*>(destination), count, conversion);
+}
+
+PixelConvertBenchmark BenchmarkPixelConversion(size_t count, uint32_t conversion, uint32_t iterations) {
+    std::vector<uint32_t> source(count), destination(count);
+    uint32_t seed = 0x2545F491;
+    for (auto& pixel : source) {
+        seed = seed*1664525u + 1013904223u;
+        pixel = seed;
+    }
+    const auto run = [&](SimdLevel level) {
+        auto best = std::chrono::steady_clock::duration::max();
+        for (uint32_t i = 0; i<std::max(iterations, 1u); ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            ConvertPixels(source.data(), destination.data(), count, conversion, level);
+            best = std::min(best, std::chrono::steady_clock::now()-start);
+        }
+        const auto seconds = std::chrono::duration<double>(best).count();
+        return seconds>0 ? 4.0*count/seconds/1e9 : 0.0;
+    };
+    const auto level = GetSimdLevel();
+    return {count, conversion, static_cast<uint32_t>(level), run(SimdLevel::Scalar), run(level)};
+}
+
+AK_PUBLIC void AK_CALL akConvertPixels(const void* source, void* destination, uint64_t count,
+        uint32_t conversion) noexcept {
+    ConvertPixels(source, destination, count, conversion);
+}
+
+AK_PUBLIC bool AK_CALL akPixelConversionBenchmark(uint64_t pixels, uint32_t conversion, uint32_t iterations,
+        PixelConvertBenchmark* result) noexcept {
+    if (!result)
+        return false;
+    *result = {};
+    try {
+        *result = BenchmarkPixelConversion(pixels, conversion, iterations);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "pixels: " << e.what() << std::endl;
+        return false;
+    }
+}
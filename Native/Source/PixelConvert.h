@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Simd.h"
+#include <cstddef>
+
+enum PixelConversion : uint32_t {
+    // RGBA <-> BGRA
+    PixelSwapRedBlue = 1,
+    PixelPremultiply = 2,
+    PixelSrgbToLinear = 4,
+    PixelLinearToSrgb = 8
+};
+
+struct PixelConvertBenchmark {
+    uint64_t pixels;
+    uint32_t conversion;
+    uint32_t level;
+    // Source bytes converted per second, in units of 10^9
+    double scalarGigabytesPerSecond;
+    double simdGigabytesPerSecond;
+};
+
+// Converts 8 bit RGBA or BGRA pixels in a single pass. Colors are decoded from sRGB first, then multiplied by alpha,
+// then encoded to sRGB; swapping red and blue combines with any of them, alpha is never changed. Results are exact
+// at every level. `source` and `destination` are either the same or do not overlap; the destination is only
+// written, so it can be write combined memory such as a staging buffer.
+void ConvertPixels(const void* source, void* destination, size_t count, uint32_t conversion) noexcept;
+void ConvertPixels(const void* source, void* destination, size_t count, uint32_t conversion,
+        SimdLevel level) noexcept;
+// Best of `iterations` runs over generated pixels, scalar and at the best level of this CPU
+PixelConvertBenchmark BenchmarkPixelConversion(size_t count, uint32_t conversion, uint32_t iterations);
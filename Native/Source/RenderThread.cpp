@@ -0,0 +1,167 @@
+#include "RenderThread.h"
+#include "Application.h"
+#include "CommandStream.h"
+#include "Trace.h"
+#include <cstring>
+#include <algorithm>
+
+RenderThread::RenderThread(Application& application)
+        :application(application), thread([this]() noexcept { Run(); }) {}
+
+RenderThread::~RenderThread() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running = false;
+        wakeRequested = true;
+    }
+    wakeCondition.notify_one();
+    thread.join();
+    QueuedStream queued;
+    while (commands.TryPop(queued))
+        delete queued.stream;
+    CommandStream* stream;
+    while (recycled.TryPop(stream))
+        delete stream;
+}
+
+void RenderThread::PushInput(const SDL_Event& event) noexcept {
+    if (!input.TryPush({event, RenderClock::now()}))
+        droppedInputs.fetch_add(1, std::memory_order_relaxed);
+    Wake();
+}
+
+void RenderThread::Submit(const CommandStream& stream, uint32_t size) {
+    size = std::min(size, stream.Capacity());
+    std::lock_guard<std::mutex> lock(submitMutex);
+    CommandStream* copy = nullptr;
+    if (!recycled.TryPop(copy) || copy->Capacity()<size) {
+        delete copy;
+        copy = new CommandStream(size);
+    }
+    memcpy(copy->Data(), stream.Data(), size);
+    while (!commands.TryPush({copy, size})) {
+        Wake();
+        std::this_thread::yield();
+    }
+    Wake();
+}
+
+void RenderThread::SetFrameHandler(FrameHandler* handler) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        frameHandler = handler;
+    }
+    Wake();
+}
+
+RenderThreadStats RenderThread::GetStats() const noexcept {
+    return {
+            frames.load(std::memory_order_relaxed),
+            lastLatency.load(std::memory_order_relaxed),
+            averageLatency.load(std::memory_order_relaxed),
+            maxLatency.load(std::memory_order_relaxed),
+            droppedInputs.load(std::memory_order_relaxed)
+    };
+}
+
+void RenderThread::Run() noexcept {
+    while (running.load(std::memory_order_acquire)) {
+        SampleInput();
+        ExecuteCommands();
+        if (!RunFrame()) {
+            ClearInput();
+            WaitForWork();
+        }
+    }
+}
+
+bool RenderThread::RunFrame() noexcept {
+    std::lock_guard<std::mutex> lock(frameMutex);
+    if (!frameHandler || !frameHandler->BeginFrame(inputState))
+        return false;
+    SampleInput();
+    ExecuteCommands();
+    frameHandler->RecordFrame(inputState);
+    frameHandler->PresentFrame();
+    TraceFrame();
+    frames.fetch_add(1, std::memory_order_relaxed);
+    RecordLatency();
+    ClearInput();
+    return true;
+}
+
+// Always recorded: frame handlers wake for damage or state changes the thread can not see from the queues, and one
+// arriving between their check and the wait must not be lost
+void RenderThread::Wake() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeRequested = true;
+    }
+    wakeCondition.notify_one();
+}
+
+void RenderThread::WakeAt(RenderClock::time_point time) noexcept {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    wakeDeadline = std::min(wakeDeadline, time);
+}
+
+void RenderThread::WaitForWork() noexcept {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    // A wake since the frame was skipped may have brought work, the frame handler checks again
+    const auto woken = [this]() noexcept { return wakeRequested || !running; };
+    if (wakeDeadline==RenderClock::time_point::max())
+        wakeCondition.wait(lock, woken);
+    else
+        wakeCondition.wait_until(lock, wakeDeadline, woken);
+    wakeRequested = false;
+    wakeDeadline = RenderClock::time_point::max();
+}
+
+void RenderThread::SampleInput() noexcept {
+    InputEvent item;
+    while (input.TryPop(item)) {
+        if (inputState.events.empty())
+            inputState.oldestEvent = item.received;
+        const auto& event = item.event;
+        switch (event.type) {
+        case SDL_MOUSEMOTION:
+            inputState.mouseX = event.motion.x;
+            inputState.mouseY = event.motion.y;
+            inputState.mouseButtons = event.motion.state;
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+            inputState.mouseButtons |= 1u << (event.button.button-1);
+            break;
+        case SDL_MOUSEBUTTONUP:
+            inputState.mouseButtons &= ~(1u << (event.button.button-1));
+            break;
+        default:break;
+        }
+        inputState.events.push_back(event);
+    }
+}
+
+void RenderThread::ClearInput() noexcept {
+    inputState.events.clear();
+}
+
+void RenderThread::ExecuteCommands() noexcept {
+    QueuedStream queued;
+    while (commands.TryPop(queued)) {
+        queued.stream->Execute(queued.size, application.GetCommandSink(), CommandRecords::Resource);
+        if (!recycled.TryPush(queued.stream))
+            delete queued.stream;
+    }
+}
+
+void RenderThread::RecordLatency() noexcept {
+    if (inputState.events.empty())
+        return;
+    const auto latency = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            RenderClock::now()-inputState.oldestEvent).count());
+    const auto average = averageLatency.load(std::memory_order_relaxed);
+    lastLatency.store(latency, std::memory_order_relaxed);
+    averageLatency.store(average ? (average*7+latency)/8 : latency, std::memory_order_relaxed);
+    if (latency>maxLatency.load(std::memory_order_relaxed))
+        maxLatency.store(latency, std::memory_order_relaxed);
+}
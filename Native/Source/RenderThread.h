@@ -0,0 +1,93 @@
+#pragma once
+
+#include "SpscQueue.h"
+#include "SDL2/SDL.h"
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+
+class Application;
+class CommandStream;
+
+using RenderClock = std::chrono::steady_clock;
+
+struct InputEvent {
+    SDL_Event event;
+    RenderClock::time_point received;
+};
+
+// Input gathered from the event thread since the previous frame, sampled right before the frame is recorded
+struct InputState {
+    std::vector<SDL_Event> events;
+    int32_t mouseX = 0, mouseY = 0;
+    uint32_t mouseButtons = 0;
+    RenderClock::time_point oldestEvent;
+};
+
+// Implemented by the presentation backend. BeginFrame sees the input gathered so far, may block on frame pacing and
+// returns false when there is nothing to draw, in which case the render thread sleeps until new input or commands
+// arrive. Input is sampled once more after BeginFrame returns so RecordFrame sees the latest state.
+class FrameHandler {
+public:
+    virtual ~FrameHandler() = default;
+    virtual bool BeginFrame(const InputState& input) noexcept = 0;
+    virtual void RecordFrame(const InputState& input) noexcept = 0;
+    virtual void PresentFrame() noexcept = 0;
+};
+
+struct RenderThreadStats {
+    uint64_t frames;
+    uint64_t lastLatencyMicroseconds;
+    uint64_t averageLatencyMicroseconds;
+    uint64_t maxLatencyMicroseconds;
+    uint64_t droppedInputs;
+};
+
+// Records and presents frames on its own thread so a blocking present never holds up SDL event processing.
+// The event thread is the single producer of input; command streams may be submitted from any thread.
+class RenderThread {
+public:
+    explicit RenderThread(Application& application);
+    ~RenderThread();
+    void PushInput(const SDL_Event& event) noexcept;
+    void Submit(const CommandStream& stream, uint32_t size);
+    // Returns once the previous handler is no longer inside a frame
+    void SetFrameHandler(FrameHandler* handler) noexcept;
+    RenderThreadStats GetStats() const noexcept;
+    void Wake() noexcept;
+    // Makes the next wait end at `time` at the latest, for frame handlers that have work scheduled in the future
+    void WakeAt(RenderClock::time_point time) noexcept;
+private:
+    struct QueuedStream {
+        CommandStream* stream;
+        uint32_t size;
+    };
+
+    void Run() noexcept;
+    bool RunFrame() noexcept;
+    void WaitForWork() noexcept;
+    void SampleInput() noexcept;
+    void ClearInput() noexcept;
+    void ExecuteCommands() noexcept;
+    void RecordLatency() noexcept;
+
+    Application& application;
+    SpscQueue<InputEvent, 1024> input;
+    SpscQueue<QueuedStream, 64> commands;
+    SpscQueue<CommandStream*, 64> recycled;
+    std::mutex submitMutex;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    std::atomic_bool running {true};
+    bool wakeRequested = false;
+    RenderClock::time_point wakeDeadline = RenderClock::time_point::max();
+    std::mutex frameMutex;
+    FrameHandler* frameHandler = nullptr;
+    InputState inputState;
+    std::atomic<uint64_t> frames {0}, lastLatency {0}, averageLatency {0}, maxLatency {0}, droppedInputs {0};
+    std::thread thread;
+};
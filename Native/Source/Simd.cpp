@@ -0,0 +1,58 @@
+#include "Simd.h"
+#include "Config.h"
+
+#if defined(AK_SIMD_SSE2) && defined(_MSC_VER) && !defined(__clang__)
+#  include <intrin.h>
+#endif
+
+namespace {
+    SimdLevel Detect() noexcept {
+#if defined(AK_SIMD_SSE2)
+#  if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0]<7)
+            return SimdLevel::SSE2;
+        __cpuid(info, 1);
+        const auto fma = (info[2] & (1 << 12))!=0;
+        // The OS has to save the upper halves of the ymm registers
+        const auto osxsave = (info[2] & (1 << 27))!=0;
+        __cpuidex(info, 7, 0);
+        const auto avx2 = (info[1] & (1 << 5))!=0;
+        if (fma && osxsave && avx2 && (_xgetbv(0) & 6)==6)
+            return SimdLevel::AVX2;
+        return SimdLevel::SSE2;
+#  else
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return SimdLevel::AVX2;
+        return SimdLevel::SSE2;
+#  endif
+#elif defined(AK_SIMD_NEON)
+        return SimdLevel::NEON;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+}
+
+SimdLevel GetSimdLevel() noexcept {
+    static const auto level = Detect();
+    return level;
+}
+
+bool SupportsSimdLevel(SimdLevel level) noexcept {
+    const auto best = GetSimdLevel();
+    switch (level) {
+    case SimdLevel::Scalar:
+        return true;
+    case SimdLevel::SSE2:
+        return best==SimdLevel::SSE2 || best==SimdLevel::AVX2;
+    default:
+        return level==best;
+    }
+}
+
+AK_PUBLIC uint32_t AK_CALL akGetSimdLevel() noexcept {
+    return static_cast<uint32_t>(GetSimdLevel());
+}
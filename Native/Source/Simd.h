@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+// SSE2 is part of x86-64, AVX2 kernels are compiled per function and only called after runtime detection
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#  define AK_SIMD_SSE2 1
+#  include <immintrin.h>
+#  if defined(__GNUC__) || defined(__clang__)
+#    define AK_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#  else
+#    define AK_TARGET_AVX2
+#  endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#  define AK_SIMD_NEON 1
+#  include <arm_neon.h>
+#endif
+
+enum class SimdLevel : uint32_t {
+    Scalar = 0,
+    SSE2,
+    AVX2,
+    NEON
+};
+
+// Best level of this CPU, detected once
+SimdLevel GetSimdLevel() noexcept;
+bool SupportsSimdLevel(SimdLevel level) noexcept;
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded single-producer single-consumer ring. Each side caches the other side's index so the common case touches
+// only its own cache line.
+template <class T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity && (Capacity & (Capacity-1))==0, "capacity must be a power of two");
+    static constexpr size_t CacheLine = 64;
+public:
+    bool TryPush(T value) noexcept {
+        const auto tail = writeIndex.load(std::memory_order_relaxed);
+        if (tail-cachedRead==Capacity) {
+            cachedRead = readIndex.load(std::memory_order_acquire);
+            if (tail-cachedRead==Capacity)
+                return false;
+        }
+        items[tail & (Capacity-1)] = std::move(value);
+        writeIndex.store(tail+1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& out) noexcept {
+        const auto head = readIndex.load(std::memory_order_relaxed);
+        if (head==cachedWrite) {
+            cachedWrite = writeIndex.load(std::memory_order_acquire);
+            if (head==cachedWrite)
+                return false;
+        }
+        out = std::move(items[head & (Capacity-1)]);
+        readIndex.store(head+1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const noexcept {
+        return readIndex.load(std::memory_order_acquire)==writeIndex.load(std::memory_order_acquire);
+    }
+private:
+    alignas(CacheLine) std::atomic<size_t> readIndex {0};
+    size_t cachedWrite = 0;
+    alignas(CacheLine) std::atomic<size_t> writeIndex {0};
+    size_t cachedRead = 0;
+    alignas(CacheLine) T items[Capacity];
+};
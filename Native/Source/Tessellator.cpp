@@ -0,0 +1,629 @@
+#include "Tessellator.h"
+#include "Config.h"
+#include "JobSystem.h"
+#include "Trace.h"
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+    constexpr uint32_t Ring = Tessellator::RingVertices;
+    constexpr uint32_t FanIndexCount = 3*Ring;
+    constexpr uint32_t BorderIndexCount = 6*Ring;
+    // Path segments are offset in blocks so the index template stays small
+    constexpr uint32_t StrokeBlock = 64;
+
+    struct Tables {
+        // Ring points go clockwise from the left end of the top left corner; ux and uy select the corner
+        alignas(32) float cos[Ring];
+        alignas(32) float sin[Ring];
+        alignas(32) float ux[Ring];
+        alignas(32) float uy[Ring];
+        alignas(32) uint32_t fan[FanIndexCount];
+        alignas(32) uint32_t border[BorderIndexCount];
+        alignas(32) uint32_t stroke[6*StrokeBlock];
+
+        Tables() noexcept {
+            constexpr auto Quarter = 1.57079632679489661923;
+            constexpr auto Points = Tessellator::CornerSegments+1;
+            constexpr float CornerX[] = {0.0f, 1.0f, 1.0f, 0.0f};
+            constexpr float CornerY[] = {0.0f, 0.0f, 1.0f, 1.0f};
+            for (uint32_t corner = 0; corner<4; ++corner) {
+                for (uint32_t j = 0; j<Points; ++j) {
+                    const auto i = corner*Points+j;
+                    const auto angle = Quarter*(2+corner) + Quarter*j/Tessellator::CornerSegments;
+                    cos[i] = static_cast<float>(std::cos(angle));
+                    sin[i] = static_cast<float>(std::sin(angle));
+                    ux[i] = CornerX[corner];
+                    uy[i] = CornerY[corner];
+                }
+            }
+            for (uint32_t i = 0; i<Ring; ++i) {
+                const auto next = (i+1)%Ring;
+                const uint32_t triangle[] = {0, 1+i, 1+next};
+                std::copy(triangle, triangle+3, fan+3*i);
+                const uint32_t quad[] = {i, next, Ring+i, Ring+i, next, Ring+next};
+                std::copy(quad, quad+6, border+6*i);
+            }
+            for (uint32_t i = 0; i<StrokeBlock; ++i) {
+                const uint32_t quad[] = {4*i, 4*i+1, 4*i+2, 4*i+2, 4*i+1, 4*i+3};
+                std::copy(quad, quad+6, stroke+6*i);
+            }
+        }
+    };
+
+    const Tables& GetTables() noexcept {
+        static const Tables tables;
+        return tables;
+    }
+
+    struct Kernels {
+        // Writes the Ring vertices around a rounded rectangle, (left, top) is the center of the top left corner
+        void (*ring)(float left, float top, float dx, float dy, float r, uint32_t color, TessellateVertex* out);
+        void (*offset)(const uint32_t* table, size_t count, uint32_t base, uint32_t* out);
+        // Writes one quad per segment of a polyline of segments+1 points
+        void (*stroke)(const float* points, size_t segments, float halfWidth, uint32_t color, TessellateVertex* out);
+    };
+
+    void RingScalar(float left, float top, float dx, float dy, float r, uint32_t color,
+            TessellateVertex* out) noexcept {
+        const auto& tables = GetTables();
+        for (uint32_t i = 0; i<Ring; ++i)
+            out[i] = {left + tables.ux[i]*dx + r*tables.cos[i], top + tables.uy[i]*dy + r*tables.sin[i], color};
+    }
+
+    void OffsetScalar(const uint32_t* table, size_t count, uint32_t base, uint32_t* out) noexcept {
+        for (size_t i = 0; i<count; ++i)
+            out[i] = table[i]+base;
+    }
+
+    void StrokeScalar(const float* points, size_t segments, float halfWidth, uint32_t color,
+            TessellateVertex* out) noexcept {
+        for (size_t i = 0; i<segments; ++i, points += 2, out += 4) {
+            const auto dx = points[2]-points[0], dy = points[3]-points[1];
+            const auto length = std::sqrt(dx*dx + dy*dy);
+            const auto scale = length>0.0f ? halfWidth/length : 0.0f;
+            const auto nx = -dy*scale, ny = dx*scale;
+            out[0] = {points[0]+nx, points[1]+ny, color};
+            out[1] = {points[0]-nx, points[1]-ny, color};
+            out[2] = {points[2]+nx, points[3]+ny, color};
+            out[3] = {points[2]-nx, points[3]-ny, color};
+        }
+    }
+
+    constexpr Kernels ScalarKernels {RingScalar, OffsetScalar, StrokeScalar};
+
+#if defined(AK_SIMD_SSE2)
+    // Interleaves four x, y and color lanes into four 12 byte vertices
+    inline void Store(float* out, __m128 x, __m128 y, __m128 c) noexcept {
+        const auto lo = _mm_unpacklo_ps(x, y);
+        const auto hi = _mm_unpackhi_ps(x, y);
+        const auto t = _mm_shuffle_ps(c, lo, _MM_SHUFFLE(2, 2, 0, 0));
+        const auto u = _mm_shuffle_ps(lo, c, _MM_SHUFFLE(1, 1, 3, 3));
+        const auto v = _mm_shuffle_ps(c, hi, _MM_SHUFFLE(2, 2, 2, 2));
+        const auto w = _mm_shuffle_ps(hi, c, _MM_SHUFFLE(3, 3, 3, 3));
+        _mm_storeu_ps(out, _mm_shuffle_ps(lo, t, _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_storeu_ps(out+4, _mm_shuffle_ps(u, hi, _MM_SHUFFLE(1, 0, 2, 0)));
+        _mm_storeu_ps(out+8, _mm_shuffle_ps(v, w, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+
+    void RingSSE2(float left, float top, float dx, float dy, float r, uint32_t color,
+            TessellateVertex* out) noexcept {
+        const auto& tables = GetTables();
+        const auto vl = _mm_set1_ps(left), vt = _mm_set1_ps(top), vdx = _mm_set1_ps(dx), vdy = _mm_set1_ps(dy);
+        const auto vr = _mm_set1_ps(r);
+        const auto c = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(color)));
+        for (uint32_t i = 0; i<Ring; i += 4) {
+            const auto x = _mm_add_ps(_mm_add_ps(vl, _mm_mul_ps(_mm_load_ps(tables.ux+i), vdx)),
+                    _mm_mul_ps(_mm_load_ps(tables.cos+i), vr));
+            const auto y = _mm_add_ps(_mm_add_ps(vt, _mm_mul_ps(_mm_load_ps(tables.uy+i), vdy)),
+                    _mm_mul_ps(_mm_load_ps(tables.sin+i), vr));
+            Store(reinterpret_cast<float*>(out+i), x, y, c);
+        }
+    }
+
+    void OffsetSSE2(const uint32_t* table, size_t count, uint32_t base, uint32_t* out) noexcept {
+        const auto b = _mm_set1_epi32(static_cast<int>(base));
+        size_t i = 0;
+        for (; i+4<=count; i += 4) {
+            const auto value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table+i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), _mm_add_epi32(value, b));
+        }
+        OffsetScalar(table+i, count-i, base, out+i);
+    }
+
+    void StrokeSSE2(const float* points, size_t segments, float halfWidth, uint32_t color,
+            TessellateVertex* out) noexcept {
+        const auto half = _mm_set1_ps(halfWidth);
+        const auto zero = _mm_setzero_ps();
+        const auto c = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(color)));
+        size_t i = 0;
+        // Four segments at a time, the rest goes through the scalar loop
+        for (; i+4<=segments; i += 4, points += 8, out += 16) {
+            const auto p0 = _mm_loadu_ps(points), p1 = _mm_loadu_ps(points+4);
+            const auto q0 = _mm_loadu_ps(points+2), q1 = _mm_loadu_ps(points+6);
+            const auto px = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0));
+            const auto py = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1));
+            const auto qx = _mm_shuffle_ps(q0, q1, _MM_SHUFFLE(2, 0, 2, 0));
+            const auto qy = _mm_shuffle_ps(q0, q1, _MM_SHUFFLE(3, 1, 3, 1));
+            const auto dx = _mm_sub_ps(qx, px), dy = _mm_sub_ps(qy, py);
+            const auto length2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+            const auto scale = _mm_and_ps(_mm_div_ps(half, _mm_sqrt_ps(length2)), _mm_cmpgt_ps(length2, zero));
+            const auto nx = _mm_mul_ps(_mm_sub_ps(zero, dy), scale), ny = _mm_mul_ps(dx, scale);
+            auto x0 = _mm_add_ps(px, nx), x1 = _mm_sub_ps(px, nx), x2 = _mm_add_ps(qx, nx), x3 = _mm_sub_ps(qx, nx);
+            auto y0 = _mm_add_ps(py, ny), y1 = _mm_sub_ps(py, ny), y2 = _mm_add_ps(qy, ny), y3 = _mm_sub_ps(qy, ny);
+            // Lanes hold segments, after the transpose every register holds the four corners of one segment
+            _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+            _MM_TRANSPOSE4_PS(y0, y1, y2, y3);
+            const auto target = reinterpret_cast<float*>(out);
+            Store(target, x0, y0, c);
+            Store(target+12, x1, y1, c);
+            Store(target+24, x2, y2, c);
+            Store(target+36, x3, y3, c);
+        }
+        StrokeScalar(points, segments-i, halfWidth, color, out);
+    }
+
+    constexpr Kernels SSE2Kernels {RingSSE2, OffsetSSE2, StrokeSSE2};
+
+    AK_TARGET_AVX2 void RingAVX2(float left, float top, float dx, float dy, float r, uint32_t color,
+            TessellateVertex* out) noexcept {
+        const auto& tables = GetTables();
+        const auto vl = _mm256_set1_ps(left), vt = _mm256_set1_ps(top);
+        const auto vdx = _mm256_set1_ps(dx), vdy = _mm256_set1_ps(dy), vr = _mm256_set1_ps(r);
+        const auto c = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(color)));
+        uint32_t i = 0;
+        for (; i+8<=Ring; i += 8) {
+            const auto x = _mm256_fmadd_ps(_mm256_load_ps(tables.ux+i), vdx,
+                    _mm256_fmadd_ps(_mm256_load_ps(tables.cos+i), vr, vl));
+            const auto y = _mm256_fmadd_ps(_mm256_load_ps(tables.uy+i), vdy,
+                    _mm256_fmadd_ps(_mm256_load_ps(tables.sin+i), vr, vt));
+            const auto target = reinterpret_cast<float*>(out+i);
+            Store(target, _mm256_castps256_ps128(x), _mm256_castps256_ps128(y), c);
+            Store(target+12, _mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1), c);
+        }
+        for (; i<Ring; i += 4) {
+            const auto x = _mm_fmadd_ps(_mm_load_ps(tables.ux+i), _mm256_castps256_ps128(vdx),
+                    _mm_fmadd_ps(_mm_load_ps(tables.cos+i), _mm256_castps256_ps128(vr), _mm256_castps256_ps128(vl)));
+            const auto y = _mm_fmadd_ps(_mm_load_ps(tables.uy+i), _mm256_castps256_ps128(vdy),
+                    _mm_fmadd_ps(_mm_load_ps(tables.sin+i), _mm256_castps256_ps128(vr), _mm256_castps256_ps128(vt)));
+            Store(reinterpret_cast<float*>(out+i), x, y, c);
+        }
+    }
+
+    AK_TARGET_AVX2 void OffsetAVX2(const uint32_t* table, size_t count, uint32_t base, uint32_t* out) noexcept {
+        const auto b = _mm256_set1_epi32(static_cast<int>(base));
+        size_t i = 0;
+        for (; i+8<=count; i += 8) {
+            const auto value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table+i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i), _mm256_add_epi32(value, b));
+        }
+        // Kept in this function, calling into the SSE2 kernel would pay for the switch back to legacy encoding
+        for (; i+4<=count; i += 4) {
+            const auto value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table+i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), _mm_add_epi32(value, _mm256_castsi256_si128(b)));
+        }
+        OffsetScalar(table+i, count-i, base, out+i);
+    }
+
+    // Strokes are bound by the vertex shuffles, which gain nothing from the wider registers
+    constexpr Kernels AVX2Kernels {RingAVX2, OffsetAVX2, StrokeSSE2};
+#endif
+
+#if defined(AK_SIMD_NEON)
+    void RingNEON(float left, float top, float dx, float dy, float r, uint32_t color,
+            TessellateVertex* out) noexcept {
+        const auto& tables = GetTables();
+        const auto vl = vdupq_n_f32(left), vt = vdupq_n_f32(top);
+        const auto vdx = vdupq_n_f32(dx), vdy = vdupq_n_f32(dy), vr = vdupq_n_f32(r);
+        float32x4x3_t vertex;
+        vertex.val[2] = vreinterpretq_f32_u32(vdupq_n_u32(color));
+        for (uint32_t i = 0; i<Ring; i += 4) {
+            vertex.val[0] = vfmaq_f32(vfmaq_f32(vl, vld1q_f32(tables.cos+i), vr), vld1q_f32(tables.ux+i), vdx);
+            vertex.val[1] = vfmaq_f32(vfmaq_f32(vt, vld1q_f32(tables.sin+i), vr), vld1q_f32(tables.uy+i), vdy);
+            vst3q_f32(reinterpret_cast<float*>(out+i), vertex);
+        }
+    }
+
+    void OffsetNEON(const uint32_t* table, size_t count, uint32_t base, uint32_t* out) noexcept {
+        const auto b = vdupq_n_u32(base);
+        size_t i = 0;
+        for (; i+4<=count; i += 4)
+            vst1q_u32(out+i, vaddq_u32(vld1q_u32(table+i), b));
+        OffsetScalar(table+i, count-i, base, out+i);
+    }
+
+    void StrokeNEON(const float* points, size_t segments, float halfWidth, uint32_t color,
+            TessellateVertex* out) noexcept {
+        const auto half = vdupq_n_f32(halfWidth);
+        const auto zero = vdupq_n_f32(0.0f);
+        float32x4x3_t vertex;
+        vertex.val[2] = vreinterpretq_f32_u32(vdupq_n_u32(color));
+        size_t i = 0;
+        for (; i+4<=segments; i += 4, points += 8, out += 16) {
+            const auto p = vld2q_f32(points), q = vld2q_f32(points+2);
+            const auto dx = vsubq_f32(q.val[0], p.val[0]), dy = vsubq_f32(q.val[1], p.val[1]);
+            const auto length2 = vfmaq_f32(vmulq_f32(dx, dx), dy, dy);
+            const auto scale = vbslq_f32(vcgtq_f32(length2, zero), vdivq_f32(half, vsqrtq_f32(length2)), zero);
+            const auto nx = vnegq_f32(vmulq_f32(dy, scale)), ny = vmulq_f32(dx, scale);
+            const float32x4_t x[] = {vaddq_f32(p.val[0], nx), vsubq_f32(p.val[0], nx),
+                    vaddq_f32(q.val[0], nx), vsubq_f32(q.val[0], nx)};
+            const float32x4_t y[] = {vaddq_f32(p.val[1], ny), vsubq_f32(p.val[1], ny),
+                    vaddq_f32(q.val[1], ny), vsubq_f32(q.val[1], ny)};
+            // Transpose so that every register holds the four corners of one segment
+            const auto x01 = vtrnq_f32(x[0], x[1]), x23 = vtrnq_f32(x[2], x[3]);
+            const auto y01 = vtrnq_f32(y[0], y[1]), y23 = vtrnq_f32(y[2], y[3]);
+            const float32x4_t tx[] = {
+                    vcombine_f32(vget_low_f32(x01.val[0]), vget_low_f32(x23.val[0])),
+                    vcombine_f32(vget_low_f32(x01.val[1]), vget_low_f32(x23.val[1])),
+                    vcombine_f32(vget_high_f32(x01.val[0]), vget_high_f32(x23.val[0])),
+                    vcombine_f32(vget_high_f32(x01.val[1]), vget_high_f32(x23.val[1]))};
+            const float32x4_t ty[] = {
+                    vcombine_f32(vget_low_f32(y01.val[0]), vget_low_f32(y23.val[0])),
+                    vcombine_f32(vget_low_f32(y01.val[1]), vget_low_f32(y23.val[1])),
+                    vcombine_f32(vget_high_f32(y01.val[0]), vget_high_f32(y23.val[0])),
+                    vcombine_f32(vget_high_f32(y01.val[1]), vget_high_f32(y23.val[1]))};
+            for (int segment = 0; segment<4; ++segment) {
+                vertex.val[0] = tx[segment];
+                vertex.val[1] = ty[segment];
+                vst3q_f32(reinterpret_cast<float*>(out+4*segment), vertex);
+            }
+        }
+        StrokeScalar(points, segments-i, halfWidth, color, out);
+    }
+
+    constexpr Kernels NEONKernels {RingNEON, OffsetNEON, StrokeNEON};
+#endif
+
+    const Kernels& GetKernels(SimdLevel level) noexcept {
+        switch (level) {
+#if defined(AK_SIMD_SSE2)
+        case SimdLevel::SSE2:
+            return SSE2Kernels;
+        case SimdLevel::AVX2:
+            return AVX2Kernels;
+#endif
+#if defined(AK_SIMD_NEON)
+        case SimdLevel::NEON:
+            return NEONKernels;
+#endif
+        default:
+            return ScalarKernels;
+        }
+    }
+
+    TessellateResult MeasurePrimitive(const TessellatePrimitive& primitive) noexcept {
+        switch (primitive.type) {
+        case TessellateRoundedRect:
+            return {Ring+1, FanIndexCount};
+        case TessellateBorder:
+            return {2*Ring, BorderIndexCount};
+        case TessellateLine:
+            return {4, 6};
+        case TessellatePath: {
+            const uint64_t segments = primitive.pointCount>1 ? primitive.pointCount-1 : 0;
+            return {4*segments, 6*segments};
+        }
+        default:
+            return {0, 0};
+        }
+    }
+
+    void EmitRoundedRect(const Kernels& kernels, float x, float y, float w, float h, float radius, uint32_t color,
+            TessellateVertex* out) noexcept {
+        const auto r = std::max(0.0f, std::min(radius, 0.5f*std::min(w, h)));
+        kernels.ring(x+r, y+r, w-2*r, h-2*r, r, color, out);
+    }
+}
+
+HandleTable<Tessellator*, HandleType::Tessellator> TessellatorHandles;
+
+Tessellator::Tessellator(uint32_t threads) :level(GetSimdLevel()), threads(threads) {
+    GetTables();
+}
+
+uint32_t Tessellator::GetThreadCount() const noexcept {
+    const auto available = Jobs.GetWorkerCount()+1;
+    return threads ? std::min(threads, available) : available;
+}
+
+bool Tessellator::SetLevel(SimdLevel level) noexcept {
+    if (!SupportsSimdLevel(level))
+        return false;
+    this->level = level;
+    return true;
+}
+
+TessellateResult Tessellator::Measure(const TessellatePrimitive* primitives, size_t count) noexcept {
+    TessellateResult result {0, 0};
+    for (size_t i = 0; i<count; ++i) {
+        const auto size = MeasurePrimitive(primitives[i]);
+        result.vertices += size.vertices;
+        result.indices += size.indices;
+    }
+    return result;
+}
+
+bool Tessellator::Tessellate(const TessellatePrimitive* primitives, size_t count, const float* points,
+        size_t pointCount, TessellateVertex* vertices, size_t vertexCapacity, uint32_t* indices,
+        size_t indexCapacity, uint32_t baseVertex, TessellateResult& result) {
+    return Tessellate(primitives, count, points, pointCount, vertices, vertexCapacity, indices, indexCapacity,
+            baseVertex, result, true);
+}
+
+bool Tessellator::Tessellate(const TessellatePrimitive* primitives, size_t count, const float* points,
+        size_t pointCount, TessellateVertex* vertices, size_t vertexCapacity, uint32_t* indices,
+        size_t indexCapacity, uint32_t baseVertex, TessellateResult& result, bool parallel) {
+    result = {0, 0};
+    const auto chunkCount = (count+ChunkSize-1)/ChunkSize;
+    chunks.resize(chunkCount);
+    struct MeasureContext {
+        const TessellatePrimitive* primitives;
+        size_t count, pointCount;
+        Chunk* chunks;
+    } measure {primitives, count, pointCount, chunks.data()};
+    // Sizes are measured per chunk so workers know where to write without waiting on each other
+    Run(chunkCount, [](void* context, size_t chunk) {
+        const auto& measure = *static_cast<MeasureContext*>(context);
+        const auto end = std::min(measure.count, (chunk+1)*ChunkSize);
+        Chunk size {0, 0, true};
+        for (auto i = chunk*ChunkSize; i<end; ++i) {
+            const auto& primitive = measure.primitives[i];
+            if (primitive.type>TessellatePath || (primitive.type==TessellatePath &&
+                    uint64_t(primitive.firstPoint)+primitive.pointCount>measure.pointCount))
+                size.valid = false;
+            const auto primitiveSize = MeasurePrimitive(primitive);
+            size.vertices += primitiveSize.vertices;
+            size.indices += primitiveSize.indices;
+        }
+        measure.chunks[chunk] = size;
+    }, &measure, parallel);
+    for (auto& chunk : chunks) {
+        if (!chunk.valid)
+            return false;
+        const auto size = chunk;
+        chunk.vertices = result.vertices;
+        chunk.indices = result.indices;
+        result.vertices += size.vertices;
+        result.indices += size.indices;
+    }
+    if (result.vertices>vertexCapacity || result.indices>indexCapacity ||
+            result.vertices+baseVertex>uint64_t(UINT32_MAX)+1)
+        return false;
+    struct EmitContext {
+        const Kernels& kernels;
+        const TessellatePrimitive* primitives;
+        size_t count;
+        const float* points;
+        const Chunk* chunks;
+        TessellateVertex* vertices;
+        uint32_t* indices;
+        uint32_t baseVertex;
+    } emit {GetKernels(level), primitives, count, points, chunks.data(), vertices, indices, baseVertex};
+    Run(chunkCount, [](void* context, size_t chunk) {
+        const auto& emit = *static_cast<EmitContext*>(context);
+        const auto& kernels = emit.kernels;
+        const auto& tables = GetTables();
+        const auto& offsets = emit.chunks[chunk];
+        auto vertex = emit.vertices+offsets.vertices;
+        auto index = emit.indices+offsets.indices;
+        const auto end = std::min(emit.count, (chunk+1)*ChunkSize);
+        for (auto i = chunk*ChunkSize; i<end; ++i) {
+            const auto& p = emit.primitives[i];
+            const auto base = emit.baseVertex+static_cast<uint32_t>(vertex-emit.vertices);
+            switch (p.type) {
+            case TessellateRoundedRect:
+                vertex[0] = {p.x0 + 0.5f*p.x1, p.y0 + 0.5f*p.y1, p.color};
+                EmitRoundedRect(kernels, p.x0, p.y0, p.x1, p.y1, p.radius, p.color, vertex+1);
+                kernels.offset(tables.fan, FanIndexCount, base, index);
+                break;
+            case TessellateBorder: {
+                const auto t = std::max(0.0f, std::min(p.width, 0.5f*std::min(p.x1, p.y1)));
+                EmitRoundedRect(kernels, p.x0, p.y0, p.x1, p.y1, p.radius, p.color, vertex);
+                EmitRoundedRect(kernels, p.x0+t, p.y0+t, p.x1-2*t, p.y1-2*t, p.radius-t, p.color, vertex+Ring);
+                kernels.offset(tables.border, BorderIndexCount, base, index);
+                break;
+            }
+            case TessellateLine: {
+                const float line[] = {p.x0, p.y0, p.x1, p.y1};
+                StrokeScalar(line, 1, 0.5f*p.width, p.color, vertex);
+                kernels.offset(tables.stroke, 6, base, index);
+                break;
+            }
+            case TessellatePath: {
+                const size_t segments = p.pointCount>1 ? p.pointCount-1 : 0;
+                kernels.stroke(emit.points+2*size_t(p.firstPoint), segments, 0.5f*p.width, p.color, vertex);
+                for (size_t s = 0; s<segments; s += StrokeBlock) {
+                    const auto block = std::min<size_t>(StrokeBlock, segments-s);
+                    kernels.offset(tables.stroke, 6*block, base+static_cast<uint32_t>(4*s), index+6*s);
+                }
+                break;
+            }
+            default:
+                break;
+            }
+            const auto size = MeasurePrimitive(p);
+            vertex += size.vertices;
+            index += size.indices;
+        }
+    }, &emit, parallel);
+    return true;
+}
+
+TessellateBenchmark Tessellator::Benchmark(size_t primitiveCount, uint32_t iterations) {
+    constexpr uint32_t PathPoints = 8;
+    std::vector<TessellatePrimitive> primitives(primitiveCount);
+    std::vector<float> points;
+    // Fixed seed so runs are comparable: mostly rectangles and borders, some lines and short paths
+    uint32_t seed = 0x2545F491;
+    const auto random = [&seed]() noexcept {
+        seed = seed*1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / float(1u << 24);
+    };
+    for (auto& primitive : primitives) {
+        const auto kind = random();
+        primitive = {};
+        primitive.color = seed;
+        primitive.x0 = 1920*random();
+        primitive.y0 = 1080*random();
+        primitive.x1 = 8 + 400*random();
+        primitive.y1 = 8 + 200*random();
+        primitive.radius = 12*random();
+        primitive.width = 1 + 3*random();
+        if (kind<0.4f)
+            primitive.type = TessellateRoundedRect;
+        else if (kind<0.7f)
+            primitive.type = TessellateBorder;
+        else if (kind<0.9f)
+            primitive.type = TessellateLine;
+        else {
+            primitive.type = TessellatePath;
+            primitive.firstPoint = static_cast<uint32_t>(points.size()/2);
+            primitive.pointCount = PathPoints;
+            for (uint32_t i = 0; i<PathPoints; ++i) {
+                points.push_back(primitive.x0 + 40*i);
+                points.push_back(primitive.y0 + 40*random());
+            }
+        }
+    }
+    const auto size = Measure(primitives.data(), primitives.size());
+    std::vector<TessellateVertex> vertices(size.vertices);
+    std::vector<uint32_t> indices(size.indices);
+    const auto run = [&](bool parallel) {
+        auto best = std::chrono::steady_clock::duration::max();
+        for (uint32_t i = 0; i<std::max(iterations, 1u); ++i) {
+            TessellateResult result;
+            const auto start = std::chrono::steady_clock::now();
+            Tessellate(primitives.data(), primitives.size(), points.data(), points.size()/2, vertices.data(),
+                    vertices.size(), indices.data(), indices.size(), 0, result, parallel);
+            best = std::min(best, std::chrono::steady_clock::now()-start);
+        }
+        const auto milliseconds = std::chrono::duration<double, std::milli>(best).count();
+        return milliseconds>0 ? primitives.size()/milliseconds : 0.0;
+    };
+    TessellateBenchmark benchmark {primitives.size(), 0, static_cast<uint32_t>(level), 0, 0, 0};
+    const auto selected = level;
+    level = SimdLevel::Scalar;
+    benchmark.scalarPerMillisecond = run(false);
+    level = selected;
+    benchmark.simdPerMillisecond = run(false);
+    benchmark.parallelPerMillisecond = run(true);
+    // The parallel run started the job system if nothing else did
+    benchmark.threads = GetThreadCount();
+    return benchmark;
+}
+
+// Chunks are handed out through nextChunk, so only as many jobs are queued as threads may take part; each drains
+// chunks until none are left
+void Tessellator::Run(size_t count, Job job, void* context, bool parallel) {
+    if (parallel && count>1 && !Jobs.IsRunning())
+        Jobs.Start(0, false);
+    const auto helpers = parallel ? std::min<size_t>(count, GetThreadCount())-1 : 0;
+    if (!helpers) {
+        for (size_t i = 0; i<count; ++i)
+            job(context, i);
+        return;
+    }
+    this->job = job;
+    this->context = context;
+    chunkCount = count;
+    nextChunk.store(0, std::memory_order_relaxed);
+    JobCounter counter;
+    Jobs.Run(DrainJob, this, static_cast<uint32_t>(helpers), &counter);
+    Drain();
+    Jobs.Wait(counter);
+}
+
+void AK_CALL Tessellator::DrainJob(void* context, uint32_t) noexcept {
+    static_cast<Tessellator*>(context)->Drain();
+}
+
+void Tessellator::Drain() noexcept {
+    for (;;) {
+        const auto chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk>=chunkCount)
+            return;
+        job(context, chunk);
+    }
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateTessellator(uint32_t threads) noexcept {
+    AK_TRACE(akCreateTessellator, threads);
+    try {
+        const auto tessellator = new Tessellator(threads);
+        const auto handle = TessellatorHandles.Insert(tessellator);
+        if (!handle)
+            delete tessellator;
+        return handle;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "tessellator: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+AK_PUBLIC void AK_CALL akDestroyTessellator(uint64_t handle) noexcept {
+    AK_TRACE(akDestroyTessellator, handle);
+    Tessellator* tessellator;
+    if (TessellatorHandles.Erase(handle, &tessellator))
+        delete tessellator;
+}
+
+AK_PUBLIC uint32_t AK_CALL akTessellatorGetLevel(uint64_t handle) noexcept {
+    const auto tessellator = TessellatorHandles.Lookup(handle);
+    return tessellator ? static_cast<uint32_t>(tessellator->GetLevel()) : 0;
+}
+
+AK_PUBLIC bool AK_CALL akTessellatorSetLevel(uint64_t handle, uint32_t level) noexcept {
+    AK_TRACE(akTessellatorSetLevel, handle, level);
+    const auto tessellator = TessellatorHandles.Lookup(handle);
+    return tessellator && tessellator->SetLevel(static_cast<SimdLevel>(level));
+}
+
+AK_PUBLIC void AK_CALL akTessellateMeasure(const TessellatePrimitive* primitives, uint64_t count,
+        TessellateResult* result) noexcept {
+    if (!result)
+        return;
+    *result = Tessellator::Measure(primitives, count);
+}
+
+AK_PUBLIC bool AK_CALL akTessellate(uint64_t handle, const TessellatePrimitive* primitives, uint64_t count,
+        const float* points, uint64_t pointCount, TessellateVertex* vertices, uint64_t vertexCapacity,
+        uint32_t* indices, uint64_t indexCapacity, uint32_t baseVertex, TessellateResult* result) noexcept {
+    AK_TRACE(akTessellate, handle, TraceIn(primitives, count), count, TraceIn(points, 2*pointCount), pointCount,
+            TraceOut(vertices, vertexCapacity), vertexCapacity, TraceOut(indices, indexCapacity), indexCapacity,
+            baseVertex, TraceOut(result));
+    if (!result)
+        return false;
+    *result = {0, 0};
+    const auto tessellator = TessellatorHandles.Lookup(handle);
+    if (!tessellator)
+        return false;
+    try {
+        return tessellator->Tessellate(primitives, count, points, pointCount, vertices, vertexCapacity, indices,
+                indexCapacity, baseVertex, *result);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "tessellator: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+AK_PUBLIC bool AK_CALL akTessellatorBenchmark(uint64_t handle, uint64_t primitiveCount, uint32_t iterations,
+        TessellateBenchmark* result) noexcept {
+    if (!result)
+        return false;
+    *result = {};
+    const auto tessellator = TessellatorHandles.Lookup(handle);
+    if (!tessellator)
+        return false;
+    try {
+        *result = tessellator->Benchmark(primitiveCount, iterations);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "tessellator: " << e.what() << std::endl;
+        return false;
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Simd.h"
+#include "Config.h"
+#include "HandleTable.h"
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+enum TessellatePrimitiveType : uint32_t {
+    TessellateRoundedRect = 0,
+    TessellateBorder,
+    TessellateLine,
+    TessellatePath
+};
+
+struct TessellatePrimitive {
+    uint32_t type;
+    // RGBA8, copied into every vertex
+    uint32_t color;
+    // Rectangles and borders: x, y, width, height. Lines: both end points. Paths: unused
+    float x0, y0, x1, y1;
+    float radius;
+    // Border thickness, stroke width of lines and paths
+    float width;
+    // Paths: polyline points, pairs of floats in the point array passed along
+    uint32_t firstPoint;
+    uint32_t pointCount;
+};
+
+struct TessellateVertex {
+    float x, y;
+    uint32_t color;
+};
+
+struct TessellateResult {
+    uint64_t vertices;
+    uint64_t indices;
+};
+
+struct TessellateBenchmark {
+    uint64_t primitives;
+    uint32_t threads;
+    uint32_t level;
+    double scalarPerMillisecond;
+    double simdPerMillisecond;
+    double parallelPerMillisecond;
+};
+
+// Turns UI primitives into triangle lists. Rounded rectangles are a fan around their center, borders a strip between
+// two rings, lines and path segments one quad each; every corner has CornerSegments segments so the output size of
+// a primitive is known up front. That lets large batches be split into chunks that the shared job system writes in
+// parallel, and the output is only written, never read back, so it can be write-combined mapped memory.
+// The kernels are picked at runtime. Not thread safe, a tessellator is driven by a single thread at a time.
+class Tessellator {
+public:
+    static constexpr uint32_t CornerSegments = 8;
+    static constexpr uint32_t RingVertices = 4*(CornerSegments+1);
+    static constexpr size_t ChunkSize = 256;
+
+    // Caps how many threads work on one batch, the calling thread included; 0 uses every job system worker
+    explicit Tessellator(uint32_t threads);
+    Tessellator(const Tessellator&) = delete;
+    Tessellator& operator=(const Tessellator&) = delete;
+    SimdLevel GetLevel() const noexcept { return level; }
+    // Returns false if the CPU does not support `level`
+    bool SetLevel(SimdLevel level) noexcept;
+    uint32_t GetThreadCount() const noexcept;
+    static TessellateResult Measure(const TessellatePrimitive* primitives, size_t count) noexcept;
+    // Indices are offset by baseVertex. Returns false if the output does not fit or a path is out of range.
+    bool Tessellate(const TessellatePrimitive* primitives, size_t count, const float* points, size_t pointCount,
+            TessellateVertex* vertices, size_t vertexCapacity, uint32_t* indices, size_t indexCapacity,
+            uint32_t baseVertex, TessellateResult& result);
+    // Best of `iterations` runs over a generated mix of primitives, written to host memory
+    TessellateBenchmark Benchmark(size_t primitiveCount, uint32_t iterations);
+private:
+    struct Chunk {
+        size_t vertices, indices;
+        bool valid;
+    };
+
+    using Job = void (*)(void* context, size_t chunk);
+
+    bool Tessellate(const TessellatePrimitive* primitives, size_t count, const float* points, size_t pointCount,
+            TessellateVertex* vertices, size_t vertexCapacity, uint32_t* indices, size_t indexCapacity,
+            uint32_t baseVertex, TessellateResult& result, bool parallel);
+    // Runs job(context, 0..count-1) on the job system and the calling thread, returns once every chunk is done
+    void Run(size_t count, Job job, void* context, bool parallel);
+    void Drain() noexcept;
+    static void AK_CALL DrainJob(void* context, uint32_t index) noexcept;
+
+    SimdLevel level;
+    uint32_t threads;
+    std::vector<Chunk> chunks;
+    Job job = nullptr;
+    void* context = nullptr;
+    size_t chunkCount = 0;
+    std::atomic<size_t> nextChunk {0};
+};
+
+extern HandleTable<Tessellator*, HandleType::Tessellator> TessellatorHandles;
@@ -0,0 +1,481 @@
+#include "Trace.h"
+#include "Vulkan.h"
+#include "MappedFile.h"
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+
+AK_PUBLIC void AK_CALL akCloseDevice(uint64_t handle) noexcept;
+AK_PUBLIC void AK_CALL akAppFinalize(uint64_t handle) noexcept;
+
+std::atomic_bool TraceRecording {false};
+std::atomic_bool HandleTracing {false};
+
+namespace {
+    using TraceClock = std::chrono::steady_clock;
+
+    constexpr char TraceMagic[8] = {'A', 'K', 'T', 'R', 'A', 'C', 'E', '\0'};
+    constexpr uint32_t TraceVersion = 1;
+    constexpr size_t TraceFlushSize = 1 << 20;
+
+    enum class TraceRecordKind : uint8_t {
+        Call = 1,
+        Event,
+        Frame
+    };
+
+    struct TraceFileHeader {
+        char magic[8];
+        uint32_t version;
+        // Events are stored raw, a trace only replays against the SDL it was recorded with
+        uint32_t eventSize;
+    };
+
+    struct TraceRecordHeader {
+        uint8_t kind;
+        uint8_t reserved;
+        uint16_t call;
+        uint32_t size;
+        // Nanoseconds since the trace started
+        uint64_t time;
+    };
+
+    // A call is encoded on its own thread and appended to the file in one piece once it returns
+    struct TraceThread {
+        bool recording = false;
+        // Collects the handles created on this thread, while recording or replaying a call
+        bool capturing = false;
+        TraceCall call = TraceCall::Invalid;
+        TraceClock::time_point begin;
+        std::vector<uint8_t> record;
+        std::vector<uint64_t> created;
+    };
+
+    struct TraceWriter {
+        std::mutex mutex;
+        std::FILE* file = nullptr;
+        std::vector<uint8_t> buffer;
+        TraceClock::time_point start;
+        uint64_t records = 0;
+        bool failed = false;
+    };
+
+    thread_local TraceThread CurrentThread;
+    TraceWriter Writer;
+
+    std::atomic_bool replaying {false}, replayHeadless {false};
+    std::mutex replayFrameMutex;
+    std::vector<TraceClock::time_point> replayFrames;
+
+    auto& Invokers() noexcept {
+        static std::array<TraceInvoker, static_cast<size_t>(TraceCall::Count)> invokers {};
+        return invokers;
+    }
+
+    void Append(std::vector<uint8_t>& out, const void* data, size_t size) {
+        const auto bytes = static_cast<const uint8_t*>(data);
+        out.insert(out.end(), bytes, bytes+size);
+    }
+
+    uint64_t Nanoseconds(TraceClock::duration duration) noexcept {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    void FlushLocked() noexcept {
+        if (!Writer.buffer.empty() && std::fwrite(Writer.buffer.data(), 1, Writer.buffer.size(), Writer.file)!=
+                Writer.buffer.size())
+            Writer.failed = true;
+        Writer.buffer.clear();
+    }
+
+    void WriteRecord(TraceRecordKind kind, TraceCall call, TraceClock::time_point time, const void* payload,
+            size_t size) noexcept {
+        std::lock_guard<std::mutex> lock(Writer.mutex);
+        if (!Writer.file)
+            return;
+        TraceRecordHeader header {};
+        header.kind = static_cast<uint8_t>(kind);
+        header.call = static_cast<uint16_t>(call);
+        header.size = static_cast<uint32_t>(size);
+        header.time = time>Writer.start ? Nanoseconds(time-Writer.start) : 0;
+        Append(Writer.buffer, &header, sizeof(header));
+        Append(Writer.buffer, payload, size);
+        ++Writer.records;
+        if (Writer.buffer.size()>=TraceFlushSize)
+            FlushLocked();
+    }
+
+    void ReplayCall(TraceCall call, const uint8_t* payload, size_t size, TraceHandleMap& handles) {
+        TraceReader reader(payload, size, handles);
+        auto& thread = CurrentThread;
+        thread.created.clear();
+        thread.capturing = true;
+        try {
+            Invokers()[static_cast<size_t>(call)](reader);
+        }
+        catch (...) {
+            thread.capturing = false;
+            throw;
+        }
+        thread.capturing = false;
+        // Created in the same order as while recording, unless the call failed in one run only
+        const auto count = reader.ReadUInt32();
+        for (uint32_t i = 0; i<count; ++i) {
+            const auto recorded = reader.ReadUInt64();
+            if (i<thread.created.size())
+                handles.Add(recorded, thread.created[i]);
+        }
+    }
+
+    void ReplayEvent(const uint8_t* payload, size_t size) {
+        SDL_Event event;
+        if (size!=sizeof(event))
+            throw std::runtime_error("malformed trace event!");
+        std::memcpy(&event, payload, sizeof(event));
+        if (event.type==SDL_DROPFILE || event.type==SDL_DROPTEXT)
+            event.drop.file = nullptr;
+        // Windows are created in the recorded order, so SDL hands out the same ids
+        if (event.type==SDL_WINDOWEVENT && (event.window.event==SDL_WINDOWEVENT_RESIZED ||
+                event.window.event==SDL_WINDOWEVENT_SIZE_CHANGED)) {
+            if (const auto window = SDL_GetWindowFromID(event.window.windowID))
+                SDL_SetWindowSize(window, event.window.data1, event.window.data2);
+        }
+        // The real events of the replay windows are not part of the trace
+        SDL_PumpEvents();
+        SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+        std::vector<VulkanApplication*> applications;
+        ApplicationHandles.ForEach([&applications](VulkanApplication* x) { applications.push_back(x); });
+        for (auto application : applications)
+            application->ProcessEvent(event);
+    }
+
+    // Closes what a trace that was stopped early left open
+    void FinishReplay(const TraceHandleMap& handles) noexcept {
+        std::vector<uint64_t> devices, applications;
+        handles.ForEach([&devices, &applications](uint64_t, uint64_t replayed) {
+            const auto type = static_cast<HandleType>(replayed >> 56);
+            if (type==HandleType::Device)
+                devices.push_back(replayed);
+            else if (type==HandleType::Application)
+                applications.push_back(replayed);
+        });
+        for (auto device : devices)
+            akCloseDevice(device);
+        for (auto application : applications)
+            akAppFinalize(application);
+    }
+
+    uint64_t Percentile(const std::vector<uint64_t>& sorted, uint32_t percent) noexcept {
+        const auto rank = (sorted.size()*percent+99)/100;
+        return sorted[rank ? rank-1 : 0];
+    }
+
+    void ComputeFrameStats(TraceClock::time_point start, TraceReplayStats& stats) {
+        std::vector<uint64_t> frameTimes;
+        {
+            std::lock_guard<std::mutex> lock(replayFrameMutex);
+            auto previous = start;
+            for (auto time : replayFrames) {
+                frameTimes.push_back(Nanoseconds(time-previous)/1000);
+                previous = time;
+            }
+            replayFrames.clear();
+        }
+        stats.frames = frameTimes.size();
+        if (frameTimes.empty())
+            return;
+        std::sort(frameTimes.begin(), frameTimes.end());
+        uint64_t total = 0;
+        for (auto time : frameTimes)
+            total += time;
+        stats.minFrameMicroseconds = frameTimes.front();
+        stats.averageFrameMicroseconds = total/frameTimes.size();
+        stats.p50FrameMicroseconds = Percentile(frameTimes, 50);
+        stats.p95FrameMicroseconds = Percentile(frameTimes, 95);
+        stats.p99FrameMicroseconds = Percentile(frameTimes, 99);
+        stats.maxFrameMicroseconds = frameTimes.back();
+    }
+
+    TraceReplayStats Replay(const MappedFile& file, uint32_t flags, const char* driverFiles, const char* videoDriver) {
+        auto data = file.GetData();
+        const auto end = data+file.GetSize();
+        TraceFileHeader fileHeader;
+        if (file.GetSize()<sizeof(fileHeader))
+            throw std::runtime_error("failed to read trace header!");
+        std::memcpy(&fileHeader, data, sizeof(fileHeader));
+        if (std::memcmp(fileHeader.magic, TraceMagic, sizeof(TraceMagic))!=0 || fileHeader.version!=TraceVersion ||
+                fileHeader.eventSize!=sizeof(SDL_Event))
+            throw std::runtime_error("failed to read trace header!");
+        data += sizeof(fileHeader);
+
+        // Read when akAppInit is replayed, which creates the instance
+        if (driverFiles) {
+            SDL_setenv("VK_DRIVER_FILES", driverFiles, 1);
+            SDL_setenv("VK_ICD_FILENAMES", driverFiles, 1);
+        }
+        if (videoDriver)
+            SDL_SetHint(SDL_HINT_VIDEODRIVER, videoDriver);
+        replayHeadless = !(flags & TraceReplayVisible);
+        const auto realTime = (flags & TraceReplayRealTime)!=0;
+
+        TraceHandleMap handles;
+        TraceReplayStats stats {};
+        {
+            std::lock_guard<std::mutex> lock(replayFrameMutex);
+            replayFrames.clear();
+        }
+        const auto start = TraceClock::now();
+        try {
+            while (end-data>=static_cast<ptrdiff_t>(sizeof(TraceRecordHeader))) {
+                TraceRecordHeader header;
+                std::memcpy(&header, data, sizeof(header));
+                data += sizeof(header);
+                if (static_cast<size_t>(end-data)<header.size)
+                    throw std::runtime_error("truncated trace record!");
+                if (realTime)
+                    std::this_thread::sleep_until(start+std::chrono::nanoseconds(header.time));
+                stats.recordedDurationMicroseconds = header.time/1000;
+                switch (static_cast<TraceRecordKind>(header.kind)) {
+                case TraceRecordKind::Call:
+                    if (header.call<static_cast<uint16_t>(TraceCall::Count) && Invokers()[header.call]) {
+                        ReplayCall(static_cast<TraceCall>(header.call), data, header.size, handles);
+                        ++stats.calls;
+                    }
+                    else
+                        ++stats.skipped;
+                    break;
+                case TraceRecordKind::Event:
+                    ReplayEvent(data, header.size);
+                    ++stats.events;
+                    break;
+                case TraceRecordKind::Frame:
+                    ++stats.recordedFrames;
+                    break;
+                default:
+                    ++stats.skipped;
+                    break;
+                }
+                data += header.size;
+                // Done by the event loop while recording
+                DeferredDeletions.Collect();
+            }
+        }
+        catch (...) {
+            FinishReplay(handles);
+            throw;
+        }
+        stats.durationMicroseconds = Nanoseconds(TraceClock::now()-start)/1000;
+        FinishReplay(handles);
+        ComputeFrameStats(start, stats);
+        return stats;
+    }
+}
+
+void TraceHandleCreated(uint64_t handle) noexcept {
+    auto& thread = CurrentThread;
+    if (thread.capturing)
+        thread.created.push_back(handle);
+}
+
+TraceCall RegisterTraceCall(TraceCall call, TraceInvoker invoker) noexcept {
+    Invokers()[static_cast<size_t>(call)] = invoker;
+    return call;
+}
+
+bool TraceScope::Begin(TraceCall call) noexcept {
+    auto& thread = CurrentThread;
+    if (thread.recording)
+        return false;
+    thread.recording = thread.capturing = true;
+    thread.call = call;
+    thread.begin = TraceClock::now();
+    thread.record.clear();
+    thread.created.clear();
+    return true;
+}
+
+void TraceScope::End() noexcept {
+    auto& thread = CurrentThread;
+    const auto count = static_cast<uint32_t>(thread.created.size());
+    Append(thread.record, &count, sizeof(count));
+    Append(thread.record, thread.created.data(), thread.created.size()*sizeof(uint64_t));
+    thread.recording = thread.capturing = false;
+    WriteRecord(TraceRecordKind::Call, thread.call, thread.begin, thread.record.data(), thread.record.size());
+}
+
+void TraceScope::WriteTag(TraceTag tag) noexcept {
+    CurrentThread.record.push_back(static_cast<uint8_t>(tag));
+}
+
+void TraceScope::WriteValue(const void* data, size_t size) noexcept {
+    WriteTag(TraceTag::Value);
+    Append(CurrentThread.record, data, size);
+}
+
+void TraceScope::WriteInput(const void* data, size_t size) noexcept {
+    const auto length = static_cast<uint64_t>(size);
+    WriteTag(TraceTag::Input);
+    Append(CurrentThread.record, &length, sizeof(length));
+    Append(CurrentThread.record, data, size);
+}
+
+void TraceScope::WriteOutput(size_t size) noexcept {
+    const auto length = static_cast<uint64_t>(size);
+    WriteTag(TraceTag::Output);
+    Append(CurrentThread.record, &length, sizeof(length));
+}
+
+void TraceScope::WriteString(const char* string) noexcept {
+    const auto length = static_cast<uint32_t>(std::strlen(string));
+    WriteTag(TraceTag::String);
+    Append(CurrentThread.record, &length, sizeof(length));
+    Append(CurrentThread.record, string, length);
+}
+
+void TraceReader::ReadBytes(void* out, size_t size) {
+    if (static_cast<size_t>(end-data)<size)
+        throw std::runtime_error("malformed trace call!");
+    std::memcpy(out, data, size);
+    data += size;
+}
+
+uint32_t TraceReader::ReadUInt32() {
+    uint32_t value;
+    ReadBytes(&value, sizeof(value));
+    return value;
+}
+
+uint64_t TraceReader::ReadUInt64() {
+    uint64_t value;
+    ReadBytes(&value, sizeof(value));
+    return value;
+}
+
+TraceTag TraceReader::ReadTag() {
+    uint8_t tag;
+    ReadBytes(&tag, sizeof(tag));
+    if (tag>static_cast<uint8_t>(TraceTag::String))
+        throw std::runtime_error("malformed trace call!");
+    return static_cast<TraceTag>(tag);
+}
+
+const char* TraceReader::ReadString() {
+    const auto length = ReadUInt32();
+    const auto string = static_cast<char*>(Allocate(length+1));
+    ReadBytes(string, length);
+    return string;
+}
+
+void* TraceReader::ReadInput(size_t& size) {
+    size = static_cast<size_t>(ReadUInt64());
+    const auto input = Allocate(size);
+    ReadBytes(input, size);
+    return input;
+}
+
+void* TraceReader::ReadOutput(size_t& size) {
+    size = static_cast<size_t>(ReadUInt64());
+    return Allocate(size);
+}
+
+void* TraceReader::Allocate(size_t size) {
+    scratch.push_back(std::make_unique<uint64_t[]>(std::max<size_t>((size+7)/8, 1)));
+    return scratch.back().get();
+}
+
+void TraceEvent(const SDL_Event& event) noexcept {
+    // Wake ups and other events of our own are not input
+    if (TraceRecording.load(std::memory_order_relaxed) && event.type<SDL_USEREVENT)
+        WriteRecord(TraceRecordKind::Event, TraceCall::Invalid, TraceClock::now(), &event, sizeof(event));
+}
+
+void TraceFrame() noexcept {
+    const auto now = TraceClock::now();
+    if (TraceRecording.load(std::memory_order_relaxed))
+        WriteRecord(TraceRecordKind::Frame, TraceCall::Invalid, now, nullptr, 0);
+    if (replaying.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(replayFrameMutex);
+        replayFrames.push_back(now);
+    }
+}
+
+bool TraceIsHeadless() noexcept {
+    return replaying.load(std::memory_order_relaxed) && replayHeadless.load(std::memory_order_relaxed);
+}
+
+// Start before akAppInit, handles created before the trace can not be mapped on replay
+AK_PUBLIC bool AK_CALL akTraceStart(const char* path) noexcept {
+    if (!path)
+        return false;
+    std::lock_guard<std::mutex> lock(Writer.mutex);
+    if (Writer.file || replaying)
+        return false;
+    const auto file = std::fopen(path, "wb");
+    TraceFileHeader header {};
+    std::memcpy(header.magic, TraceMagic, sizeof(TraceMagic));
+    header.version = TraceVersion;
+    header.eventSize = sizeof(SDL_Event);
+    if (!file || std::fwrite(&header, sizeof(header), 1, file)!=1) {
+        if (file)
+            std::fclose(file);
+        std::cerr << "trace: failed to open trace file!" << std::endl;
+        return false;
+    }
+    Writer.file = file;
+    Writer.start = TraceClock::now();
+    Writer.records = 0;
+    Writer.failed = false;
+    Writer.buffer.reserve(TraceFlushSize+4096);
+    HandleTracing = true;
+    TraceRecording = true;
+    return true;
+}
+
+// Returns the number of records written, calls still running are dropped
+AK_PUBLIC uint64_t AK_CALL akTraceStop() noexcept {
+    TraceRecording = false;
+    std::lock_guard<std::mutex> lock(Writer.mutex);
+    if (!Writer.file)
+        return 0;
+    FlushLocked();
+    if (std::fclose(Writer.file)!=0)
+        Writer.failed = true;
+    Writer.file = nullptr;
+    HandleTracing = false;
+    if (Writer.failed)
+        std::cerr << "trace: failed to write trace file!" << std::endl;
+    return Writer.records;
+}
+
+// Runs on the calling thread, which becomes the event thread of the replayed application. `driverFiles` are Vulkan
+// driver manifests loaded instead of the installed ones, e.g. a software rasterizer, `videoDriver` an SDL video driver
+// such as "offscreen" for machines without a display; both are optional.
+AK_PUBLIC bool AK_CALL akReplayTrace(const char* path, uint32_t flags, const char* driverFiles, const char* videoDriver,
+        TraceReplayStats* stats) noexcept {
+    if (!path)
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(Writer.mutex);
+        if (Writer.file || replaying.exchange(true))
+            return false;
+    }
+    HandleTracing = true;
+    auto succeeded = true;
+    try {
+        MappedFile file(path);
+        const auto result = Replay(file, flags, driverFiles, videoDriver);
+        if (stats)
+            *stats = result;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "trace: " << e.what() << std::endl;
+        succeeded = false;
+    }
+    HandleTracing = false;
+    replaying = false;
+    return succeeded;
+}
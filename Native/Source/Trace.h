@@ -0,0 +1,333 @@
+#pragma once
+
+#include "Config.h"
+#include <tuple>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+union SDL_Event;
+
+// Ids are stored in trace files, new calls are only ever appended
+enum class TraceCall : uint16_t {
+    Invalid = 0,
+    akAppInit,
+    akAppStartRenderThread,
+    akAppStopRenderThread,
+    akAppFinalize,
+    akCreateWindow,
+    akShowWindow,
+    akHideWindow,
+    akMinimizeWindow,
+    akMaximizeWindow,
+    akDestroyWindow,
+    akDestroyWindows,
+    akCreateCommandStream,
+    WriteCommandStream,
+    akSubmitCommandStream,
+    akDestroyCommandStream,
+    akCreateDisplaySurface,
+    akDestroyDisplaySurface,
+    akDestroyDisplaySurfaces,
+    akCreateDeviceSelectorFilter,
+    akDeviceSelectorFilterSetBool,
+    akDeviceSelectorFilterSetUInt,
+    akDeviceSelectorFilterSetUInt64,
+    akDeviceSelectorFilterSetDouble,
+    akDeviceSelectorFilterSetHandle,
+    akDestroyDeviceSelectorFilter,
+    akFilterDevices,
+    akOpenDevice,
+    akReleaseDeviceFilterResults,
+    akCloseDevice,
+    akDeviceRenderFrame,
+    akDeviceSetRenderOnDemand,
+    akDeviceSetMemoryThresholds,
+    akDeviceTrimShaders,
+    akCreateDisplayContext,
+    akDestroyDisplayContext,
+    akDisplayContextAddDamage,
+    akCreateTexturePool,
+    akDestroyTexturePool,
+    akTexturePoolSetBudget,
+    akCreateTextureRGBA8,
+    akCreateTextureKTX2,
+    akDestroyTexture,
+    akTextureRequestSize,
+    akCreateScene,
+    akLoadScene,
+    akDestroyScene,
+    akSceneCreateNodes,
+    akSceneUpdateNode,
+    akSceneDestroyNodes,
+    akCreateComputeContext,
+    akDestroyComputeContext,
+    akCreateComputePipeline,
+    akLoadComputePipeline,
+    akDestroyComputePipeline,
+    akCreateComputeBuffer,
+    akDestroyComputeBuffer,
+    akComputeBufferWrite,
+    akComputeBufferRead,
+    akComputeRecord,
+    akComputeSubmit,
+    akComputeSyncGraphics,
+    akComputeWait,
+    akCreateTessellator,
+    akDestroyTessellator,
+    akTessellatorSetLevel,
+    akTessellate,
+    akTessellateToComputeBuffers,
+    akCreateCapture,
+    akDestroyCapture,
+    akCaptureAcquireFrame,
+    akCaptureReleaseFrame,
+    akCreateTextureRGBA8Converted,
+    akComputeBufferWritePixels,
+    akDeviceTrimPipelines,
+    akDeviceTrim,
+    akSceneSetNodeBounds,
+    Count
+};
+
+enum class TraceTag : uint8_t {
+    // Pointers that mean nothing in another process: callbacks, user data
+    Null = 0,
+    Value,
+    Input,
+    Output,
+    String
+};
+
+template <class T>
+struct TraceInput {
+    const T* data;
+    size_t size;
+};
+
+struct TraceOutput {
+    size_t size;
+};
+
+// Arrays read by a call are stored in the trace, arrays it writes only by size
+template <class T>
+TraceInput<T> TraceIn(const T* data, size_t count = 1) noexcept {
+    if constexpr (std::is_void_v<T>)
+        return {data, count};
+    else
+        return {data, count*sizeof(T)};
+}
+
+template <class T>
+TraceOutput TraceOut(T* data, size_t count = 1) noexcept {
+    if constexpr (std::is_void_v<T>)
+        return {data ? count : 0};
+    else
+        return {data ? count*sizeof(T) : 0};
+}
+
+// Recorded handles mapped onto the ones the replay created in their place
+class TraceHandleMap {
+public:
+    void Add(uint64_t recorded, uint64_t replayed) { handles[recorded] = replayed; }
+    uint64_t Remap(uint64_t handle) const noexcept {
+        const auto found = handles.find(handle);
+        return found!=handles.end() ? found->second : handle;
+    }
+    template <class Fn>
+    void ForEach(Fn&& fn) const {
+        for (auto&& x : handles)
+            fn(x.first, x.second);
+    }
+private:
+    std::unordered_map<uint64_t, uint64_t> handles;
+};
+
+// Handles are recognized by value: every 64 bit integer that matches a recorded handle is replaced. Structs that
+// carry handles specialize this.
+template <class T>
+void TraceRemapHandles(T* values, size_t count, const TraceHandleMap& handles) noexcept {
+    if constexpr (std::is_same_v<T, uint64_t>) {
+        for (size_t i = 0; i<count; ++i)
+            values[i] = handles.Remap(values[i]);
+    }
+}
+
+// Decodes the arguments of one recorded call. Inputs are copied into aligned scratch memory that lives until the
+// next call, outputs get zeroed scratch memory of the recorded size.
+class TraceReader {
+public:
+    TraceReader(const uint8_t* data, size_t size, const TraceHandleMap& handles) noexcept
+            :data(data), end(data+size), handles(handles) {}
+
+    template <class T>
+    T Read() {
+        const auto tag = ReadTag();
+        if (tag==TraceTag::Null)
+            return T {};
+        if constexpr (std::is_pointer_v<T>) {
+            using Element = std::remove_cv_t<std::remove_pointer_t<T>>;
+            if constexpr (std::is_same_v<T, const char*>) {
+                if (tag==TraceTag::String)
+                    return ReadString();
+            }
+            if constexpr (!std::is_function_v<Element>) {
+                size_t size;
+                if (tag==TraceTag::Input && std::is_const_v<std::remove_pointer_t<T>>) {
+                    const auto data = ReadInput(size);
+                    if constexpr (!std::is_void_v<Element>)
+                        TraceRemapHandles(static_cast<Element*>(data), size/sizeof(Element), handles);
+                    return static_cast<T>(data);
+                }
+                if (tag==TraceTag::Output)
+                    return static_cast<T>(ReadOutput(size));
+            }
+        }
+        else if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+            if (tag==TraceTag::Value) {
+                T value;
+                ReadBytes(&value, sizeof(value));
+                if constexpr (std::is_same_v<T, uint64_t>)
+                    value = handles.Remap(value);
+                return value;
+            }
+        }
+        throw std::runtime_error("malformed trace call!");
+    }
+
+    void ReadBytes(void* out, size_t size);
+    uint32_t ReadUInt32();
+    uint64_t ReadUInt64();
+private:
+    TraceTag ReadTag();
+    const char* ReadString();
+    void* ReadInput(size_t& size);
+    void* ReadOutput(size_t& size);
+    void* Allocate(size_t size);
+
+    const uint8_t* data;
+    const uint8_t* end;
+    const TraceHandleMap& handles;
+    std::vector<std::unique_ptr<uint64_t[]>> scratch;
+};
+
+using TraceInvoker = void (*)(TraceReader& reader);
+
+template <class R, class... Args>
+void TraceApply(R (*function)(Args...), TraceReader& reader) {
+    // Braced initialization reads the arguments left to right
+    std::tuple<std::decay_t<Args>...> args {reader.Read<std::decay_t<Args>>()...};
+    std::apply(function, args);
+}
+
+template <auto Function>
+void TraceInvoke(TraceReader& reader) {
+    TraceApply(Function, reader);
+}
+
+TraceCall RegisterTraceCall(TraceCall call, TraceInvoker invoker) noexcept;
+
+// Instantiated by the AK_TRACE in the body of `Function`, which registers it for replay when the library loads
+template <TraceCall Call, auto Function>
+struct TraceReplayer {
+    static const TraceCall call;
+};
+
+template <TraceCall Call, auto Function>
+const TraceCall TraceReplayer<Call, Function>::call = RegisterTraceCall(Call, &TraceInvoke<Function>);
+
+extern std::atomic_bool TraceRecording;
+
+// Records one call with its arguments when it returns, together with every handle it created. Calls made from
+// inside a recorded call are not recorded again.
+class TraceScope {
+public:
+    template <class... Args>
+    TraceScope(TraceCall call, const Args&... args) noexcept {
+        if (!TraceRecording.load(std::memory_order_relaxed) || !Begin(call))
+            return;
+        (Write(args), ...);
+        active = true;
+    }
+
+    ~TraceScope() {
+        if (active)
+            End();
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+private:
+    template <class T>
+    static void Write(const T& value) noexcept {
+        if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>) {
+            if (value)
+                WriteString(value);
+            else
+                WriteTag(TraceTag::Null);
+        }
+        else if constexpr (std::is_pointer_v<T>)
+            WriteTag(TraceTag::Null);
+        else if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>)
+            WriteValue(&value, sizeof(value));
+        else if constexpr (std::is_same_v<T, TraceOutput>)
+            WriteOutput(value.size);
+        else {
+            if (value.data)
+                WriteInput(value.data, value.size);
+            else
+                WriteTag(TraceTag::Null);
+        }
+    }
+
+    static bool Begin(TraceCall call) noexcept;
+    static void End() noexcept;
+    static void WriteTag(TraceTag tag) noexcept;
+    static void WriteValue(const void* data, size_t size) noexcept;
+    static void WriteInput(const void* data, size_t size) noexcept;
+    static void WriteOutput(size_t size) noexcept;
+    static void WriteString(const char* string) noexcept;
+
+    bool active = false;
+};
+
+#define AK_TRACE(function, ...) \
+    TraceScope traceScope(TraceReplayer<TraceCall::function, function>::call, ##__VA_ARGS__)
+
+// Event thread, for events that reached the application
+void TraceEvent(const SDL_Event& event) noexcept;
+// After every presented frame, timestamps frames while recording and while replaying
+void TraceFrame() noexcept;
+// Windows stay hidden while a trace is replayed headless
+bool TraceIsHeadless() noexcept;
+
+enum TraceReplayFlags : uint32_t {
+    // Keeps the recorded timing instead of replaying as fast as possible
+    TraceReplayRealTime = 1,
+    // Shows windows like the recorded session did
+    TraceReplayVisible = 2
+};
+
+struct TraceReplayStats {
+    uint64_t calls;
+    uint64_t events;
+    // Calls this build does not know
+    uint64_t skipped;
+    uint64_t frames;
+    uint64_t recordedFrames;
+    uint64_t durationMicroseconds;
+    uint64_t recordedDurationMicroseconds;
+    // Time between consecutive presents, the first frame counts from the start of the replay
+    uint64_t minFrameMicroseconds;
+    uint64_t averageFrameMicroseconds;
+    uint64_t p50FrameMicroseconds;
+    uint64_t p95FrameMicroseconds;
+    uint64_t p99FrameMicroseconds;
+    uint64_t maxFrameMicroseconds;
+};
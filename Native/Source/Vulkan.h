@@ -6,6 +6,9 @@
 #include "SDL2/SDL_vulkan.h"
 #include <vulkan/vulkan.h>
 #include "Application.h"
+#include "Handles.h"
+#include "DeletionQueue.h"
+#include "Vulkan/HostAllocator.h"
 
 #ifdef NDEBUG
 constexpr bool enableValidationLayers = false;
@@ -22,7 +25,11 @@ public:
     void Setup();
     void TearDown();
     VkInstance GetInstance() const noexcept { return instance; }
+    bool SupportsPhysicalDeviceProperties2() const noexcept { return physicalDeviceProperties2; }
+    // Highest version both the loader and this library know, devices may support less
+    uint32_t GetApiVersion() const noexcept { return apiVersion; }
 private:
+    static uint32_t NegotiateApiVersion() noexcept;
     void CreateInstance();
     void SetupDebugCallback();
     std::vector<const char*> GetInstanceRequiredExtensions();
@@ -32,6 +39,9 @@ private:
     void DestroyDebugUtilsMessengerEXT(const VkAllocationCallbacks* pAllocator) noexcept;
     VkInstance instance;
     VkDebugUtilsMessengerEXT callback;
+    bool physicalDeviceProperties2 = false;
+    uint32_t apiVersion = VK_API_VERSION_1_0;
 };
 
 // NOTE VkSurface is a 64 type
+extern HandleTable<VkSurfaceKHR, HandleType::Surface> SurfaceHandles;
@@ -1,8 +1,11 @@
 #include "../Vulkan.h"
+#include "../RenderThread.h"
+#include "../Trace.h"
 
 #include <array>
 #include <vector>
 #include <iostream>
+#include <algorithm>
 
 namespace {
     VKAPI_ATTR VkBool32 VKAPI_CALL
@@ -12,6 +15,21 @@ namespace {
         return VK_FALSE;
     }
 
+    bool HasInstanceExtension(const char* name) {
+        uint32_t extensionCount;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+        for (const auto& extension : availableExtensions) {
+            if (strcmp(extension.extensionName, name)==0)
+                return true;
+        }
+        return false;
+    }
+
+    // Newest version whose features the device code knows how to enable
+    constexpr uint32_t MaxApiVersion = VK_API_VERSION_1_3;
+
     constexpr std::array<const char*, 1> ValidationLayers = {
             "VK_LAYER_LUNARG_standard_validation"
     };
@@ -69,6 +87,7 @@ void VulkanApplication::Setup() {
 void VulkanApplication::CreateInstance() {
     SDL_Vulkan_LoadLibrary(nullptr);
     Validation::CheckValidationLayer();
+    apiVersion = NegotiateApiVersion();
     const auto appInfo = GetAppInfo();
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -77,7 +96,7 @@ void VulkanApplication::CreateInstance() {
     createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     createInfo.ppEnabledExtensionNames = extensions.data();
     Validation::FillInstanceCreateOption(createInfo);
-    if (vkCreateInstance(&createInfo, nullptr, &instance)!=VK_SUCCESS) {
+    if (vkCreateInstance(&createInfo, HostAllocator(), &instance)!=VK_SUCCESS) {
         throw std::runtime_error("failed to create instance!");
     }
 }
@@ -94,7 +113,7 @@ void VulkanApplication::SetupDebugCallback() {
                         | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
         createInfo.pfnUserCallback = DebugCallback;
 
-        if (CreateDebugUtilsMessengerEXT(&createInfo, nullptr)!=VK_SUCCESS) {
+        if (CreateDebugUtilsMessengerEXT(&createInfo, HostAllocator())!=VK_SUCCESS) {
             throw std::runtime_error("failed to set up debug callback!");
         }
     }
@@ -115,9 +134,24 @@ std::vector<const char*> VulkanApplication::GetInstanceRequiredExtensions() {
             extensions.data()+additional_extension_count))
         VulkanHandleSDLError();
 
+    // Optional, needed for memory budget queries
+    physicalDeviceProperties2 = HasInstanceExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    if (physicalDeviceProperties2)
+        extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
     return extensions;
 }
 
+// vkEnumerateInstanceVersion only exists in 1.1 loaders and later, an older loader is 1.0
+uint32_t VulkanApplication::NegotiateApiVersion() noexcept {
+    const auto enumerateVersion = (PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr(nullptr,
+            "vkEnumerateInstanceVersion");
+    uint32_t version = VK_API_VERSION_1_0;
+    if (!enumerateVersion || enumerateVersion(&version)!=VK_SUCCESS)
+        return VK_API_VERSION_1_0;
+    return std::min(VK_MAKE_VERSION(VK_VERSION_MAJOR(version), VK_VERSION_MINOR(version), 0), MaxApiVersion);
+}
+
 VkApplicationInfo VulkanApplication::GetAppInfo() noexcept {
     VkApplicationInfo appInfo = {};
     const auto version = VK_MAKE_VERSION(VersionMajor, VersionMinor, VersionRevision);
@@ -126,7 +160,7 @@ VkApplicationInfo VulkanApplication::GetAppInfo() noexcept {
     appInfo.applicationVersion = version;
     appInfo.pEngineName = "Akarin Native";
     appInfo.engineVersion = version;
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = apiVersion;
     return appInfo;
 }
 
@@ -151,33 +185,66 @@ void VulkanApplication::DestroyDebugUtilsMessengerEXT(const VkAllocationCallback
 }
 
 void VulkanApplication::TearDown() {
+    DeferredDeletions.Flush();
     if constexpr(enableValidationLayers) {
-        DestroyDebugUtilsMessengerEXT(nullptr);
+        DestroyDebugUtilsMessengerEXT(HostAllocator());
     }
-    vkDestroyInstance(instance, nullptr);
+    vkDestroyInstance(instance, HostAllocator());
 
 }
 
 
-AK_PUBLIC uintptr_t AK_CALL akAppInit() noexcept{
+HandleTable<VulkanApplication*, HandleType::Application> ApplicationHandles;
+
+AK_PUBLIC uint64_t AK_CALL akAppInit() noexcept{
+    AK_TRACE(akAppInit);
     auto handle = new VulkanApplication();
     handle->Init();
     handle->Setup();
-    return reinterpret_cast<uintptr_t>(handle);
+    const auto result = ApplicationHandles.Insert(handle);
+    if (!result) {
+        handle->TearDown();
+        handle->Finalize();
+        delete handle;
+    }
+    return result;
+}
+
+AK_PUBLIC void AK_CALL akAppControlHandOver(uint64_t handle) noexcept {
+    if (const auto hdc = ApplicationHandles.Lookup(handle))
+        hdc->ControlHandOver();
+}
+
+AK_PUBLIC void AK_CALL akAppStop(uint64_t handle) noexcept {
+    if (const auto hdc = ApplicationHandles.Lookup(handle))
+        hdc->Stop();
+}
+
+AK_PUBLIC void AK_CALL akAppStartRenderThread(uint64_t handle) noexcept {
+    AK_TRACE(akAppStartRenderThread, handle);
+    if (const auto hdc = ApplicationHandles.Lookup(handle))
+        hdc->StartRenderThread();
 }
 
-AK_PUBLIC void AK_CALL akAppControlHandOver(uintptr_t handle) noexcept {
-    auto hdc = reinterpret_cast<VulkanApplication*>(handle);
-    hdc->ControlHandOver();
+AK_PUBLIC void AK_CALL akAppStopRenderThread(uint64_t handle) noexcept {
+    AK_TRACE(akAppStopRenderThread, handle);
+    if (const auto hdc = ApplicationHandles.Lookup(handle))
+        hdc->StopRenderThread();
 }
 
-AK_PUBLIC void AK_CALL akAppStop(uintptr_t handle) noexcept {
-    auto hdc = reinterpret_cast<VulkanApplication*>(handle);
-    hdc->Stop();
+AK_PUBLIC void AK_CALL akAppGetRenderThreadStats(uint64_t handle, RenderThreadStats* stats) noexcept {
+    if (!stats)
+        return;
+    const auto hdc = ApplicationHandles.Lookup(handle);
+    const auto renderThread = hdc ? hdc->GetRenderThread() : nullptr;
+    *stats = renderThread ? renderThread->GetStats() : RenderThreadStats {};
 }
 
-AK_PUBLIC void AK_CALL akAppFinalize(uintptr_t handle) noexcept {
-    auto hdc = reinterpret_cast<VulkanApplication*>(handle);
+AK_PUBLIC void AK_CALL akAppFinalize(uint64_t handle) noexcept {
+    AK_TRACE(akAppFinalize, handle);
+    VulkanApplication* hdc;
+    if (!ApplicationHandles.Erase(handle, &hdc))
+        return;
     hdc->TearDown();
     hdc->Finalize();
     delete hdc;
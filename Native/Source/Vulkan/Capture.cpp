@@ -0,0 +1,402 @@
+#include "Capture.h"
+#include "Device.h"
+#include "Swapchain.h"
+#include "../Trace.h"
+
+#include <iostream>
+#include <algorithm>
+
+HandleTable<Capture*, HandleType::Capture> CaptureHandles;
+
+Capture::Capture(VulkanDevice& device, uint64_t displayContext, const CaptureCreateInfo& info)
+        :device(device), displayContext(displayContext), maxWidth(info.maxWidth), maxHeight(info.maxHeight),
+        format(static_cast<VkFormat>(info.format)), callback(info.callback), user(info.user),
+        slots(info.slots ? info.slots : DefaultSlots) {
+    if (slots.size()>MaxSlots) {
+        throw std::runtime_error("capture ring exceeds the supported size!");
+    }
+    if (format!=VK_FORMAT_UNDEFINED && !PixelSize(format)) {
+        throw std::runtime_error("capture format is not supported!");
+    }
+}
+
+// Deleted through the deletion queue, the frames that recorded copies have retired
+Capture::~Capture() {
+    const auto native = device.GetNative();
+    for (auto& slot : slots) {
+        vkDestroyBuffer(native, slot.buffer, HostAllocator());
+        if (slot.buffer)
+            device.GetAllocator().Free(slot.memory);
+    }
+    Release(target);
+}
+
+uint32_t Capture::PixelSize(VkFormat format) noexcept {
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        return 4;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+bool Capture::CanBlit(VkFormat source, VkFormat destination, bool scaled, VkFilter& filter) const noexcept {
+    VkFormatProperties sourceProperties, destinationProperties;
+    vkGetPhysicalDeviceFormatProperties(device.GetPhysicalDevice(), source, &sourceProperties);
+    vkGetPhysicalDeviceFormatProperties(device.GetPhysicalDevice(), destination, &destinationProperties);
+    if (!(sourceProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) ||
+            !(destinationProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT))
+        return false;
+    const auto linear = sourceProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    filter = scaled && linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    return true;
+}
+
+// Slots are only resized while free, their last copy has completed
+void Capture::EnsureBuffer(Slot& slot, VkDeviceSize size) {
+    if (slot.capacity>=size)
+        return;
+    const auto native = device.GetNative();
+    vkDestroyBuffer(native, slot.buffer, HostAllocator());
+    if (slot.buffer)
+        device.GetAllocator().Free(slot.memory);
+    slot.buffer = VK_NULL_HANDLE;
+    slot.capacity = 0;
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(native, &bufferInfo, HostAllocator(), &slot.buffer)!=VK_SUCCESS) {
+        slot.buffer = VK_NULL_HANDLE;
+        throw std::runtime_error("failed to create capture buffer!");
+    }
+    try {
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(native, slot.buffer, &requirements);
+        // Read back by the host, cached memory makes that a lot faster
+        slot.memory = device.GetAllocator().Allocate(requirements,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    }
+    catch (const std::exception&) {
+        vkDestroyBuffer(native, slot.buffer, HostAllocator());
+        slot.buffer = VK_NULL_HANDLE;
+        throw;
+    }
+    vkBindBufferMemory(native, slot.buffer, slot.memory.memory, slot.memory.offset);
+    slot.capacity = size;
+}
+
+// A new size or format replaces the image, frames in flight may still blit into the old one
+void Capture::EnsureTarget(VkExtent2D extent, VkFormat targetFormat) {
+    if (target.image && target.extent.width==extent.width && target.extent.height==extent.height &&
+            target.format==targetFormat)
+        return;
+    if (target.image) {
+        DeferredDeletions.Enqueue([native = device.GetNative(), allocator = &device.GetAllocator(),
+                retired = target]() {
+            vkDestroyImage(native, retired.image, HostAllocator());
+            allocator->Free(retired.memory);
+        });
+        target = Target {};
+    }
+    const auto native = device.GetNative();
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = targetFormat;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    Target created;
+    if (vkCreateImage(native, &imageInfo, HostAllocator(), &created.image)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create capture image!");
+    }
+    try {
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(native, created.image, &requirements);
+        created.memory = device.GetAllocator().Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    catch (const std::exception&) {
+        vkDestroyImage(native, created.image, HostAllocator());
+        throw;
+    }
+    vkBindImageMemory(native, created.image, created.memory.memory, created.memory.offset);
+    created.extent = extent;
+    created.format = targetFormat;
+    target = created;
+}
+
+void Capture::Release(Target& released) noexcept {
+    vkDestroyImage(device.GetNative(), released.image, HostAllocator());
+    if (released.image)
+        device.GetAllocator().Free(released.memory);
+    released = Target {};
+}
+
+void Capture::Record(VkCommandBuffer commandBuffer, VkImage image, VkFormat sourceFormat,
+        VkExtent2D extent) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto frameNumber = sequence++;
+    const auto free = std::find_if(slots.begin(), slots.end(),
+            [](const Slot& slot) noexcept { return slot.state==SlotState::Free; });
+    if (free==slots.end()) {
+        ++dropped;
+        return;
+    }
+    auto& slot = *free;
+
+    // Fit into the limits keeping the aspect ratio, never scale up
+    auto scale = 1.0;
+    if (maxWidth && extent.width>maxWidth)
+        scale = std::min(scale, double(maxWidth)/extent.width);
+    if (maxHeight && extent.height>maxHeight)
+        scale = std::min(scale, double(maxHeight)/extent.height);
+    VkExtent2D size = {std::max(1u, uint32_t(extent.width*scale)), std::max(1u, uint32_t(extent.height*scale))};
+    auto targetFormat = format!=VK_FORMAT_UNDEFINED ? format : sourceFormat;
+    const auto scaled = size.width!=extent.width || size.height!=extent.height;
+    auto filter = VK_FILTER_NEAREST;
+    auto blit = scaled || targetFormat!=sourceFormat;
+    if (blit && !CanBlit(sourceFormat, targetFormat, scaled, filter)) {
+        // Hand out the image as it is rather than nothing
+        blit = false;
+        size = extent;
+        targetFormat = sourceFormat;
+    }
+    const auto pixelSize = PixelSize(targetFormat);
+    if (!pixelSize) {
+        ++dropped;
+        return;
+    }
+    try {
+        EnsureBuffer(slot, VkDeviceSize(size.width)*size.height*pixelSize);
+        if (blit)
+            EnsureTarget(size, targetFormat);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "capture: " << e.what() << std::endl;
+        ++dropped;
+        return;
+    }
+
+    const VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    VkImageMemoryBarrier barriers[2] = {};
+    for (auto& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = range;
+    }
+    barriers[0].image = image;
+    barriers[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    // The target is shared by every slot, the previous frame may still be copying out of it
+    barriers[1].image = target.image;
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, blit ? 2 : 1, barriers);
+
+    auto copySource = image;
+    if (blit) {
+        VkImageBlit region = {};
+        region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.srcOffsets[1] = {int32_t(extent.width), int32_t(extent.height), 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.dstOffsets[1] = {int32_t(size.width), int32_t(size.height), 1};
+        vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, filter);
+        barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                0, nullptr, 0, nullptr, 1, barriers+1);
+        copySource = target.image;
+    }
+    VkBufferImageCopy copy = {};
+    copy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    copy.imageExtent = {size.width, size.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, copySource, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &copy);
+
+    // Back to the layout the present expects, and make the copy visible to the host once the submit completed
+    barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[0].dstAccessMask = 0;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    VkBufferMemoryBarrier bufferBarrier = {};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = slot.buffer;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 1,
+            barriers);
+
+    slot.state = SlotState::Recorded;
+    slot.frame.frame = frameNumber;
+    slot.frame.data = slot.memory.mapped;
+    slot.frame.size = VkDeviceSize(size.width)*size.height*pixelSize;
+    slot.frame.slot = static_cast<uint32_t>(free-slots.begin());
+    slot.frame.width = size.width;
+    slot.frame.height = size.height;
+    slot.frame.rowPitch = size.width*pixelSize;
+    slot.frame.format = targetFormat;
+    ++captured;
+}
+
+void Capture::Resolve(uint64_t value) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& slot : slots) {
+        if (slot.state!=SlotState::Recorded)
+            continue;
+        slot.state = value ? SlotState::InFlight : SlotState::Free;
+        slot.value = value;
+    }
+}
+
+bool Capture::Poll() noexcept {
+    const auto completed = device.GetGraphicsQueue().GetCompletedValue();
+    std::unique_lock<std::mutex> lock(mutex);
+    auto inFlight = false;
+    for (;;) {
+        // Oldest first, so consumers see frames in order
+        Slot* next = nullptr;
+        for (auto& slot : slots) {
+            if (slot.state!=SlotState::InFlight)
+                continue;
+            if (slot.value>completed)
+                inFlight = true;
+            else if (!next || slot.frame.frame<next->frame.frame)
+                next = &slot;
+        }
+        if (!next)
+            return inFlight;
+        ++delivered;
+        if (!callback) {
+            next->state = SlotState::Ready;
+            continue;
+        }
+        // Taken while the callback runs, it may well call back into the capture
+        next->state = SlotState::Acquired;
+        const auto frame = next->frame;
+        lock.unlock();
+        callback(&frame, user);
+        lock.lock();
+        next->state = SlotState::Free;
+    }
+}
+
+bool Capture::Acquire(CaptureFrame& frame) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    Slot* oldest = nullptr;
+    for (auto& slot : slots) {
+        if (slot.state==SlotState::Ready && (!oldest || slot.frame.frame<oldest->frame.frame))
+            oldest = &slot;
+    }
+    if (!oldest)
+        return false;
+    oldest->state = SlotState::Acquired;
+    frame = oldest->frame;
+    return true;
+}
+
+void Capture::Release(uint32_t slot) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (slot<slots.size() && slots[slot].state==SlotState::Acquired)
+        slots[slot].state = SlotState::Free;
+}
+
+CaptureStats Capture::GetStats() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    CaptureStats stats = {captured, delivered, dropped, static_cast<uint32_t>(slots.size()), 0, 0};
+    for (const auto& slot : slots) {
+        if (slot.state==SlotState::Recorded || slot.state==SlotState::InFlight)
+            ++stats.inFlight;
+        else if (slot.state==SlotState::Ready)
+            ++stats.ready;
+    }
+    return stats;
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateCapture(uint64_t contextHandle, const CaptureCreateInfo* info) noexcept {
+    if (!info)
+        return 0;
+    // A replay has no callback to deliver to, its frames queue up instead
+    auto traced = *info;
+    traced.callback = nullptr;
+    traced.user = nullptr;
+    AK_TRACE(akCreateCapture, contextHandle, TraceIn(&traced));
+    const auto swapchain = DisplayContextHandles.Lookup(contextHandle);
+    if (!swapchain)
+        return 0;
+    try {
+        if (!swapchain->CanCapture()) {
+            throw std::runtime_error("swapchain images can not be copied from!");
+        }
+        const auto capture = new Capture(swapchain->GetDevice(), contextHandle, *info);
+        const auto handle = CaptureHandles.Insert(capture);
+        if (!handle) {
+            delete capture;
+            return 0;
+        }
+        // A capture created later replaces the running one
+        swapchain->SetCapture(capture);
+        return handle;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "capture: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+AK_PUBLIC void AK_CALL akDestroyCapture(uint64_t handle) noexcept {
+    AK_TRACE(akDestroyCapture, handle);
+    Capture* capture;
+    if (!CaptureHandles.Erase(handle, &capture))
+        return;
+    if (const auto swapchain = DisplayContextHandles.Lookup(capture->GetDisplayContext()))
+        swapchain->DetachCapture(capture);
+    // A frame being recorded may still copy into it
+    DeferredDeletions.Enqueue([capture]() { delete capture; });
+}
+
+AK_PUBLIC bool AK_CALL akCaptureAcquireFrame(uint64_t handle, CaptureFrame* frame) noexcept {
+    AK_TRACE(akCaptureAcquireFrame, handle, TraceOut(frame));
+    const auto capture = CaptureHandles.Lookup(handle);
+    return capture && frame && capture->Acquire(*frame);
+}
+
+AK_PUBLIC void AK_CALL akCaptureReleaseFrame(uint64_t handle, uint32_t slot) noexcept {
+    AK_TRACE(akCaptureReleaseFrame, handle, slot);
+    if (const auto capture = CaptureHandles.Lookup(handle))
+        capture->Release(slot);
+}
+
+AK_PUBLIC void AK_CALL akCaptureGetStats(uint64_t handle, CaptureStats* stats) noexcept {
+    if (!stats)
+        return;
+    const auto capture = CaptureHandles.Lookup(handle);
+    *stats = capture ? capture->GetStats() : CaptureStats {};
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include "Memory.h"
+#include "Presenter.h"
+#include <mutex>
+#include <vector>
+
+class VulkanDevice;
+
+struct CaptureFrame {
+    // Counts every capture attempt, gaps are dropped frames
+    uint64_t frame;
+    const void* data;
+    uint64_t size;
+    uint32_t slot;
+    uint32_t width;
+    uint32_t height;
+    // Rows are tightly packed
+    uint32_t rowPitch;
+    // VkFormat of the pixels, the requested one unless the device can not convert to it
+    uint32_t format;
+};
+
+// Called on the render thread, `frame` and its data are only valid during the call
+using CaptureCallback = void (*)(const CaptureFrame* frame, void* user);
+
+struct CaptureCreateInfo {
+    // Ring size, 0 picks Capture::DefaultSlots
+    uint32_t slots;
+    // Frames larger than this are downscaled on the GPU keeping their aspect ratio, 0 means no limit
+    uint32_t maxWidth;
+    uint32_t maxHeight;
+    // VkFormat to convert to on the GPU, VK_FORMAT_UNDEFINED keeps the swapchain format
+    uint32_t format;
+    // Without a callback finished frames are queued for akCaptureAcquireFrame
+    CaptureCallback callback;
+    void* user;
+};
+
+struct CaptureStats {
+    uint64_t captured;
+    uint64_t delivered;
+    // No free slot, or a format the device can not copy out
+    uint64_t dropped;
+    uint32_t slots;
+    uint32_t inFlight;
+    uint32_t ready;
+};
+
+// Copies every presented image of one display context into a ring of host visible buffers. The copy is recorded
+// into the frame's own command buffer after the render pass, optionally blitted to a smaller size or another format
+// first, and tagged with the graphics queue value of the frame's submit. Copies are only picked up once that value
+// completed, so nothing ever waits on the GPU; while every slot is busy new frames are dropped instead.
+//
+// In render on demand mode only frames that redraw the display context are captured.
+class Capture {
+public:
+    static constexpr uint32_t DefaultSlots = Presenter::FramesInFlight+2;
+    static constexpr uint32_t MaxSlots = 16;
+
+    Capture(VulkanDevice& device, uint64_t displayContext, const CaptureCreateInfo& info);
+    ~Capture();
+    Capture(const Capture&) = delete;
+    Capture& operator=(const Capture&) = delete;
+    uint64_t GetDisplayContext() const noexcept { return displayContext; }
+    // Called by the presenter after the render pass, `image` is in the present layout and is left there
+    void Record(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkExtent2D extent) noexcept;
+    // Tags the copies recorded since the last call with the value of their submit, 0 if the submit failed
+    void Resolve(uint64_t value) noexcept;
+    // Hands out the copies that completed, returns whether copies are still in flight
+    bool Poll() noexcept;
+    // Oldest finished frame, its slot stays taken until released
+    bool Acquire(CaptureFrame& frame) noexcept;
+    void Release(uint32_t slot) noexcept;
+    CaptureStats GetStats() noexcept;
+private:
+    enum class SlotState {
+        Free,
+        Recorded,
+        InFlight,
+        Ready,
+        Acquired
+    };
+
+    struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        Allocation memory;
+        VkDeviceSize capacity = 0;
+        SlotState state = SlotState::Free;
+        uint64_t value = 0;
+        CaptureFrame frame = {};
+    };
+
+    // Blit destination for downscaling and format conversion
+    struct Target {
+        VkImage image = VK_NULL_HANDLE;
+        Allocation memory;
+        VkExtent2D extent = {};
+        VkFormat format = VK_FORMAT_UNDEFINED;
+    };
+
+    bool CanBlit(VkFormat source, VkFormat destination, bool scaled, VkFilter& filter) const noexcept;
+    void EnsureBuffer(Slot& slot, VkDeviceSize size);
+    void EnsureTarget(VkExtent2D extent, VkFormat format);
+    void Release(Target& target) noexcept;
+    static uint32_t PixelSize(VkFormat format) noexcept;
+
+    VulkanDevice& device;
+    uint64_t displayContext;
+    uint32_t maxWidth, maxHeight;
+    VkFormat format;
+    CaptureCallback callback;
+    void* user;
+    Target target;
+    uint64_t sequence = 0;
+    // Guards everything below
+    std::mutex mutex;
+    std::vector<Slot> slots;
+    uint64_t captured = 0, delivered = 0, dropped = 0;
+};
+
+extern HandleTable<Capture*, HandleType::Capture> CaptureHandles;
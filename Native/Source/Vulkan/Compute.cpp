@@ -0,0 +1,650 @@
+#include "Compute.h"
+#include "Device.h"
+#include "Presenter.h"
+#include "ShaderRegistry.h"
+#include "../Tessellator.h"
+#include "../Trace.h"
+#include "../PixelConvert.h"
+
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+    void DestroyPipeline(VkDevice device, VkPipeline pipeline, VkPipelineLayout layout,
+            VkDescriptorSetLayout setLayout) noexcept {
+        vkDestroyPipeline(device, pipeline, HostAllocator());
+        vkDestroyPipelineLayout(device, layout, HostAllocator());
+        vkDestroyDescriptorSetLayout(device, setLayout, HostAllocator());
+    }
+}
+
+HandleTable<ComputeContext*, HandleType::ComputeContext> ComputeContextHandles;
+HandleTable<ComputePipeline*, HandleType::ComputePipeline> ComputePipelineHandles;
+HandleTable<ComputeBuffer*, HandleType::ComputeBuffer> ComputeBufferHandles;
+
+ComputeContext::ComputeContext(VulkanDevice& device) : device(device), queue(device.GetComputeQueue()) {
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queue.GetFamily();
+    if (vkCreateCommandPool(device.GetNative(), &poolInfo, HostAllocator(), &commandPool)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create command pool!");
+    }
+}
+
+ComputeContext::~ComputeContext() {
+    const auto native = device.GetNative();
+    queue.Wait(submittedValue, UINT64_MAX);
+    completedValue = submittedValue;
+    if (open) {
+        vkEndCommandBuffer(current.commandBuffer);
+        freeBatches.push_back(std::move(current));
+        open = false;
+        Resolve(submittedValue);
+    }
+    while (!pipelines.empty()) {
+        ComputePipelineHandles.Erase(pipelines.back()->handle);
+        Destroy(pipelines.back());
+    }
+    while (!buffers.empty()) {
+        ComputeBufferHandles.Erase(buffers.back()->handle);
+        Destroy(buffers.back());
+    }
+    Collect();
+    for (auto& batch : inFlight)
+        freeBatches.push_back(std::move(batch));
+    for (auto& batch : freeBatches) {
+        for (auto pool : batch.pools)
+            vkDestroyDescriptorPool(native, pool, HostAllocator());
+    }
+    vkDestroyCommandPool(native, commandPool, HostAllocator());
+}
+
+ComputePipeline* ComputeContext::CreatePipeline(const uint32_t* code, size_t size, uint32_t bufferCount,
+        uint32_t constantSize) {
+    return CreatePipeline(device.GetShaders().Acquire(code, size), bufferCount, constantSize);
+}
+
+ComputePipeline* ComputeContext::LoadPipeline(const char* path, uint32_t bufferCount, uint32_t constantSize) {
+    return CreatePipeline(device.GetShaders().Load(path), bufferCount, constantSize);
+}
+
+// The module is only needed while the pipeline is built, the registry keeps it cached for the next one
+ComputePipeline* ComputeContext::CreatePipeline(ShaderModule* module, uint32_t bufferCount, uint32_t constantSize) {
+    const auto native = device.GetNative();
+    std::unique_ptr<ComputePipeline> pipeline(new ComputePipeline(*this));
+    try {
+        if (bufferCount>MaxBuffers || constantSize>MaxConstantSize || constantSize%4) {
+            throw std::runtime_error("compute pipeline layout exceeds the supported limits!");
+        }
+        pipeline->bufferCount = bufferCount;
+        pipeline->constantSize = constantSize;
+
+        VkDescriptorSetLayoutBinding bindings[MaxBuffers] = {};
+        for (uint32_t i = 0; i<bufferCount; ++i) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+        setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutInfo.bindingCount = bufferCount;
+        setLayoutInfo.pBindings = bindings;
+        if (vkCreateDescriptorSetLayout(native, &setLayoutInfo, HostAllocator(), &pipeline->setLayout)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+
+        VkPushConstantRange constantRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, constantSize};
+        VkPipelineLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &pipeline->setLayout;
+        layoutInfo.pushConstantRangeCount = constantSize ? 1 : 0;
+        layoutInfo.pPushConstantRanges = &constantRange;
+        if (vkCreatePipelineLayout(native, &layoutInfo, HostAllocator(), &pipeline->layout)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = module->CreateStageInfo(VK_SHADER_STAGE_COMPUTE_BIT);
+        pipelineInfo.layout = pipeline->layout;
+        if (vkCreateComputePipelines(native, VK_NULL_HANDLE, 1, &pipelineInfo, HostAllocator(),
+                &pipeline->pipeline)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+    }
+    catch (const std::exception&) {
+        device.GetShaders().Release(module);
+        DestroyPipeline(native, pipeline->pipeline, pipeline->layout, pipeline->setLayout);
+        throw;
+    }
+    device.GetShaders().Release(module);
+    pipeline->handle = ComputePipelineHandles.Insert(pipeline.get());
+    if (!pipeline->handle) {
+        DestroyPipeline(native, pipeline->pipeline, pipeline->layout, pipeline->setLayout);
+        throw std::runtime_error("failed to register compute pipeline!");
+    }
+    pipelines.push_back(pipeline.get());
+    return pipeline.release();
+}
+
+ComputeBuffer* ComputeContext::CreateBuffer(VkDeviceSize size, uint32_t flags) {
+    const auto native = device.GetNative();
+    std::unique_ptr<ComputeBuffer> buffer(new ComputeBuffer(*this));
+    buffer->size = size;
+    // Written here and read by graphics, without ownership transfers between the two families
+    const uint32_t families[] = {device.GetGraphicsFamily(), device.GetComputeQueue().GetFamily()};
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (families[0]!=families[1]) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = families;
+    }
+    else {
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    if (vkCreateBuffer(native, &bufferInfo, HostAllocator(), &buffer->buffer)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute buffer!");
+    }
+    try {
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(native, buffer->buffer, &requirements);
+        if (flags & ComputeBufferHostVisible) {
+            buffer->memory = device.GetAllocator().Allocate(requirements,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        }
+        else {
+            buffer->memory = device.GetAllocator().Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+    }
+    catch (const std::exception&) {
+        vkDestroyBuffer(native, buffer->buffer, HostAllocator());
+        throw;
+    }
+    vkBindBufferMemory(native, buffer->buffer, buffer->memory.memory, buffer->memory.offset);
+    buffer->handle = ComputeBufferHandles.Insert(buffer.get());
+    if (!buffer->handle) {
+        vkDestroyBuffer(native, buffer->buffer, HostAllocator());
+        device.GetAllocator().Free(buffer->memory);
+        throw std::runtime_error("failed to register compute buffer!");
+    }
+    buffers.push_back(buffer.get());
+    return buffer.release();
+}
+
+void ComputeContext::Destroy(ComputePipeline* pipeline) noexcept {
+    pipelines.erase(std::find(pipelines.begin(), pipelines.end(), pipeline));
+    Retire([native = device.GetNative(), pipeline = pipeline->pipeline, layout = pipeline->layout,
+            setLayout = pipeline->setLayout]() {
+        DestroyPipeline(native, pipeline, layout, setLayout);
+    });
+    delete pipeline;
+}
+
+void ComputeContext::Destroy(ComputeBuffer* buffer) noexcept {
+    buffers.erase(std::find(buffers.begin(), buffers.end(), buffer));
+    Retire([native = device.GetNative(), &allocator = device.GetAllocator(), buffer = buffer->buffer,
+            memory = buffer->memory]() {
+        vkDestroyBuffer(native, buffer, HostAllocator());
+        allocator.Free(memory);
+    });
+    delete buffer;
+}
+
+void ComputeContext::Record(const ComputeDispatch* dispatches, uint32_t count, const uint64_t* bufferHandles,
+        uint32_t bufferCount, const void* constants, uint32_t constantSize) {
+    // Everything is validated up front so a rejected batch leaves nothing half recorded
+    for (uint32_t i = 0; i<count; ++i) {
+        const auto& dispatch = dispatches[i];
+        const auto pipeline = ComputePipelineHandles.Lookup(dispatch.pipeline);
+        if (!pipeline || &pipeline->context!=this) {
+            throw std::runtime_error("dispatch uses an invalid compute pipeline!");
+        }
+        if (dispatch.bufferCount!=pipeline->bufferCount || dispatch.firstBuffer>bufferCount ||
+                bufferCount-dispatch.firstBuffer<dispatch.bufferCount ||
+                dispatch.constantSize!=pipeline->constantSize || dispatch.constantOffset>constantSize ||
+                constantSize-dispatch.constantOffset<dispatch.constantSize) {
+            throw std::runtime_error("dispatch does not match its pipeline layout!");
+        }
+        for (uint32_t j = 0; j<dispatch.bufferCount; ++j) {
+            const auto buffer = ComputeBufferHandles.Lookup(bufferHandles[dispatch.firstBuffer+j]);
+            if (!buffer || &buffer->context!=this) {
+                throw std::runtime_error("dispatch uses an invalid compute buffer!");
+            }
+        }
+    }
+    Collect();
+    if (!open)
+        Begin();
+
+    const auto commandBuffer = current.commandBuffer;
+    VkDescriptorBufferInfo bufferInfos[MaxBuffers];
+    VkWriteDescriptorSet writes[MaxBuffers];
+    for (uint32_t i = 0; i<count; ++i) {
+        const auto& dispatch = dispatches[i];
+        const auto pipeline = ComputePipelineHandles.Lookup(dispatch.pipeline);
+        // Batches run in submission order on one queue, so the first dispatch of a batch waits for the last batch
+        const bool follows = current.dispatches || submittedValue;
+        if (follows && !(dispatch.flags & ComputeDispatchConcurrent)) {
+            VkMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+        if (current.bound!=pipeline->pipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+            current.bound = pipeline->pipeline;
+        }
+        if (dispatch.bufferCount) {
+            const auto set = AllocateSet(pipeline->setLayout);
+            for (uint32_t j = 0; j<dispatch.bufferCount; ++j) {
+                const auto buffer = ComputeBufferHandles.Lookup(bufferHandles[dispatch.firstBuffer+j]);
+                bufferInfos[j] = {buffer->buffer, 0, VK_WHOLE_SIZE};
+                writes[j] = {};
+                writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[j].dstSet = set;
+                writes[j].dstBinding = j;
+                writes[j].descriptorCount = 1;
+                writes[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[j].pBufferInfo = &bufferInfos[j];
+            }
+            vkUpdateDescriptorSets(device.GetNative(), dispatch.bufferCount, writes, 0, nullptr);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->layout, 0, 1, &set,
+                    0, nullptr);
+        }
+        if (dispatch.constantSize) {
+            vkCmdPushConstants(commandBuffer, pipeline->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                    dispatch.constantSize, static_cast<const uint8_t*>(constants)+dispatch.constantOffset);
+        }
+        vkCmdDispatch(commandBuffer, dispatch.groupCountX, dispatch.groupCountY, dispatch.groupCountZ);
+        ++current.dispatches;
+    }
+    recordedDispatches += count;
+}
+
+void ComputeContext::Begin() {
+    if (!freeBatches.empty()) {
+        current = std::move(freeBatches.back());
+        freeBatches.pop_back();
+    }
+    else {
+        current = {};
+    }
+    if (!current.commandBuffer) {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device.GetNative(), &allocInfo, &current.commandBuffer)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+    }
+    vkResetCommandBuffer(current.commandBuffer, 0);
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(current.commandBuffer, &beginInfo)!=VK_SUCCESS) {
+        freeBatches.push_back(std::move(current));
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+    current.dispatches = 0;
+    current.bound = VK_NULL_HANDLE;
+    open = true;
+}
+
+// Sets live as long as the batch, the pools are reset all at once when it completed
+VkDescriptorSet ComputeContext::AllocateSet(VkDescriptorSetLayout layout) {
+    for (;; ++current.poolIndex) {
+        const auto created = current.poolIndex==current.pools.size();
+        if (created) {
+            const VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SetsPerPool*MaxBuffers};
+            VkDescriptorPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            poolInfo.maxSets = SetsPerPool;
+            poolInfo.poolSizeCount = 1;
+            poolInfo.pPoolSizes = &poolSize;
+            VkDescriptorPool pool;
+            if (vkCreateDescriptorPool(device.GetNative(), &poolInfo, HostAllocator(), &pool)!=VK_SUCCESS) {
+                throw std::runtime_error("failed to create descriptor pool!");
+            }
+            current.pools.push_back(pool);
+        }
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = current.pools[current.poolIndex];
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+        VkDescriptorSet set;
+        const auto result = vkAllocateDescriptorSets(device.GetNative(), &allocInfo, &set);
+        if (result==VK_SUCCESS)
+            return set;
+        if (created) {
+            throw std::runtime_error("failed to allocate descriptor set!");
+        }
+    }
+}
+
+uint64_t ComputeContext::Submit() {
+    if (!open)
+        return submittedValue;
+    open = false;
+    const auto commandBuffer = current.commandBuffer;
+    // Results read back by the host become visible once the timeline value was reached
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+    if (vkEndCommandBuffer(commandBuffer)!=VK_SUCCESS) {
+        freeBatches.push_back(std::move(current));
+        Resolve(submittedValue);
+        throw std::runtime_error("failed to record command buffer!");
+    }
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    uint64_t value;
+    if (queue.Submit(submitInfo, value)!=VK_SUCCESS) {
+        freeBatches.push_back(std::move(current));
+        Resolve(submittedValue);
+        throw std::runtime_error("failed to submit compute batch!");
+    }
+    Resolve(value);
+    submittedValue = value;
+    current.value = value;
+    inFlight.push_back(std::move(current));
+    ++batches;
+    return value;
+}
+
+void ComputeContext::SyncGraphics(uint64_t value) noexcept {
+    device.GetPresenter().WaitQueue(queue, std::min(value, submittedValue));
+}
+
+VkResult ComputeContext::Wait(uint64_t value, uint64_t timeout) noexcept {
+    // A value never submitted would never be reached
+    const auto result = queue.Wait(std::min(value, submittedValue), timeout);
+    Collect();
+    return result;
+}
+
+uint64_t ComputeContext::GetCompletedValue() noexcept {
+    Collect();
+    return completedValue;
+}
+
+ComputeStats ComputeContext::GetStats() noexcept {
+    Collect();
+    ComputeStats stats = {};
+    stats.submittedValue = submittedValue;
+    stats.completedValue = completedValue;
+    stats.batches = batches;
+    stats.dispatches = recordedDispatches;
+    stats.pipelines = pipelines.size();
+    stats.buffers = buffers.size();
+    stats.dedicatedQueue = &device.GetComputeQueue()!=&device.GetGraphicsQueue();
+    return stats;
+}
+
+// Anything recorded so far is in a submitted batch or in the open one, whose value is known once it is submitted
+void ComputeContext::Retire(DeletionQueue::Release release) {
+    garbage.push_back({open ? PendingValue : submittedValue, std::move(release)});
+    Collect();
+}
+
+void ComputeContext::Resolve(uint64_t value) noexcept {
+    for (auto& entry : garbage) {
+        if (entry.value==PendingValue)
+            entry.value = value;
+    }
+}
+
+// Graphics may also have used what the completed batches released, so it still goes through the deletion queue
+void ComputeContext::Collect() noexcept {
+    if (submittedValue>completedValue)
+        completedValue = std::min(queue.GetCompletedValue(), submittedValue);
+    while (!inFlight.empty() && inFlight.front().value<=completedValue) {
+        auto& batch = inFlight.front();
+        for (auto pool : batch.pools)
+            vkResetDescriptorPool(device.GetNative(), pool, 0);
+        batch.poolIndex = 0;
+        freeBatches.push_back(std::move(batch));
+        inFlight.pop_front();
+    }
+    const auto end = std::partition(garbage.begin(), garbage.end(),
+            [this](const Garbage& entry) noexcept { return entry.value>completedValue; });
+    for (auto it = end; it!=garbage.end(); ++it)
+        DeferredDeletions.Enqueue(std::move(it->release));
+    garbage.erase(end, garbage.end());
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateComputeContext(uint64_t deviceHandle) noexcept {
+    AK_TRACE(akCreateComputeContext, deviceHandle);
+    const auto device = DeviceHandles.Lookup(deviceHandle);
+    if (!device)
+        return 0;
+    try {
+        const auto context = new ComputeContext(*device);
+        const auto handle = ComputeContextHandles.Insert(context);
+        if (!handle)
+            delete context;
+        return handle;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "compute: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+AK_PUBLIC void AK_CALL akDestroyComputeContext(uint64_t handle) noexcept {
+    AK_TRACE(akDestroyComputeContext, handle);
+    ComputeContext* context;
+    if (ComputeContextHandles.Erase(handle, &context))
+        delete context;
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateComputePipeline(uint64_t contextHandle, const uint32_t* code, size_t size,
+        uint32_t bufferCount, uint32_t constantSize) noexcept {
+    AK_TRACE(akCreateComputePipeline, contextHandle, TraceIn(code, size/4), size, bufferCount, constantSize);
+    const auto context = ComputeContextHandles.Lookup(contextHandle);
+    if (!context || !code)
+        return 0;
+    try {
+        return context->CreatePipeline(code, size, bufferCount, constantSize)->GetHandle();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "compute: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+AK_PUBLIC uint64_t AK_CALL akLoadComputePipeline(uint64_t contextHandle, const char* path, uint32_t bufferCount,
+        uint32_t constantSize) noexcept {
+    AK_TRACE(akLoadComputePipeline, contextHandle, path, bufferCount, constantSize);
+    const auto context = ComputeContextHandles.Lookup(contextHandle);
+    if (!context || !path)
+        return 0;
+    try {
+        return context->LoadPipeline(path, bufferCount, constantSize)->GetHandle();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "compute: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+AK_PUBLIC void AK_CALL akDestroyComputePipeline(uint64_t handle) noexcept {
+    AK_TRACE(akDestroyComputePipeline, handle);
+    ComputePipeline* pipeline;
+    if (ComputePipelineHandles.Erase(handle, &pipeline))
+        pipeline->GetContext().Destroy(pipeline);
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateComputeBuffer(uint64_t contextHandle, uint64_t size, uint32_t flags) noexcept {
+    AK_TRACE(akCreateComputeBuffer, contextHandle, size, flags);
+    const auto context = ComputeContextHandles.Lookup(contextHandle);
+    if (!context || !size)
+        return 0;
+    try {
+        return context->CreateBuffer(size, flags)->GetHandle();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "compute: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+AK_PUBLIC void AK_CALL akDestroyComputeBuffer(uint64_t handle) noexcept {
+    AK_TRACE(akDestroyComputeBuffer, handle);
+    ComputeBuffer* buffer;
+    if (ComputeBufferHandles.Erase(handle, &buffer))
+        buffer->GetContext().Destroy(buffer);
+}
+
+void ComputeCommandSink::UpdateBuffer(uint64_t handle, uint64_t offset, const void* data, uint32_t size) noexcept {
+    const auto buffer = ComputeBufferHandles.Lookup(handle);
+    if (!buffer || &buffer->GetContext().GetDevice()!=&device || !buffer->GetMapped() ||
+            offset>buffer->GetSize() || buffer->GetSize()-offset<size)
+        return;
+    memcpy(static_cast<uint8_t*>(buffer->GetMapped())+offset, data, size);
+}
+
+// Host visible buffers only. Writes must not overlap batches still running, reads follow a wait for their batch.
+AK_PUBLIC bool AK_CALL akComputeBufferWrite(uint64_t handle, uint64_t offset, const void* data,
+        uint64_t size) noexcept {
+    AK_TRACE(akComputeBufferWrite, handle, offset, TraceIn(data, size), size);
+    const auto buffer = ComputeBufferHandles.Lookup(handle);
+    if (!buffer || !buffer->GetMapped() || offset>buffer->GetSize() || buffer->GetSize()-offset<size)
+        return false;
+    memcpy(static_cast<uint8_t*>(buffer->GetMapped())+offset, data, size);
+    return true;
+}
+
+// Converts 8 bit pixels straight into the mapped buffer, see ConvertPixels
+AK_PUBLIC bool AK_CALL akComputeBufferWritePixels(uint64_t handle, uint64_t offset, const void* pixels,
+        uint64_t count, uint32_t conversion) noexcept {
+    AK_TRACE(akComputeBufferWritePixels, handle, offset, TraceIn(pixels, 4*count), count, conversion);
+    const auto buffer = ComputeBufferHandles.Lookup(handle);
+    if (!buffer || !buffer->GetMapped() || offset>buffer->GetSize() || (buffer->GetSize()-offset)/4<count)
+        return false;
+    ConvertPixels(pixels, static_cast<uint8_t*>(buffer->GetMapped())+offset, count, conversion);
+    return true;
+}
+
+AK_PUBLIC bool AK_CALL akComputeBufferRead(uint64_t handle, uint64_t offset, void* data, uint64_t size) noexcept {
+    AK_TRACE(akComputeBufferRead, handle, offset, TraceOut(data, size), size);
+    const auto buffer = ComputeBufferHandles.Lookup(handle);
+    if (!buffer || !buffer->GetMapped() || offset>buffer->GetSize() || buffer->GetSize()-offset<size)
+        return false;
+    memcpy(data, static_cast<const uint8_t*>(buffer->GetMapped())+offset, size);
+    return true;
+}
+
+// Tessellates straight into host visible buffers, which are write combined and never read back by the kernels.
+// Same rules as akComputeBufferWrite; indices are offset by baseVertex.
+AK_PUBLIC bool AK_CALL akTessellateToComputeBuffers(uint64_t tessellatorHandle, const TessellatePrimitive* primitives,
+        uint64_t count, const float* points, uint64_t pointCount, uint64_t vertexHandle, uint64_t vertexOffset,
+        uint64_t indexHandle, uint64_t indexOffset, uint32_t baseVertex, TessellateResult* result) noexcept {
+    AK_TRACE(akTessellateToComputeBuffers, tessellatorHandle, TraceIn(primitives, count), count,
+            TraceIn(points, 2*pointCount), pointCount, vertexHandle, vertexOffset, indexHandle, indexOffset, baseVertex,
+            TraceOut(result));
+    if (!result)
+        return false;
+    *result = {0, 0};
+    const auto tessellator = TessellatorHandles.Lookup(tessellatorHandle);
+    const auto vertexBuffer = ComputeBufferHandles.Lookup(vertexHandle);
+    const auto indexBuffer = ComputeBufferHandles.Lookup(indexHandle);
+    if (!tessellator || !vertexBuffer || !indexBuffer || !vertexBuffer->GetMapped() || !indexBuffer->GetMapped() ||
+            vertexOffset>vertexBuffer->GetSize() || indexOffset>indexBuffer->GetSize() ||
+            vertexOffset%alignof(TessellateVertex) || indexOffset%alignof(uint32_t))
+        return false;
+    try {
+        return tessellator->Tessellate(primitives, count, points, pointCount,
+                reinterpret_cast<TessellateVertex*>(static_cast<uint8_t*>(vertexBuffer->GetMapped())+vertexOffset),
+                (vertexBuffer->GetSize()-vertexOffset)/sizeof(TessellateVertex),
+                reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(indexBuffer->GetMapped())+indexOffset),
+                (indexBuffer->GetSize()-indexOffset)/sizeof(uint32_t), baseVertex, *result);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "compute: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+template <>
+void TraceRemapHandles<ComputeDispatch>(ComputeDispatch* dispatches, size_t count,
+        const TraceHandleMap& handles) noexcept {
+    for (size_t i = 0; i<count; ++i)
+        dispatches[i].pipeline = handles.Remap(dispatches[i].pipeline);
+}
+
+AK_PUBLIC bool AK_CALL akComputeRecord(uint64_t handle, const ComputeDispatch* dispatches, uint32_t count,
+        const uint64_t* buffers, uint32_t bufferCount, const void* constants, uint32_t constantSize) noexcept {
+    AK_TRACE(akComputeRecord, handle, TraceIn(dispatches, count), count, TraceIn(buffers, bufferCount), bufferCount,
+            TraceIn(constants, constantSize), constantSize);
+    const auto context = ComputeContextHandles.Lookup(handle);
+    if (!context)
+        return false;
+    try {
+        context->Record(dispatches, count, buffers, bufferCount, constants, constantSize);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "compute: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+AK_PUBLIC bool AK_CALL akComputeSubmit(uint64_t handle, uint64_t* value) noexcept {
+    AK_TRACE(akComputeSubmit, handle, TraceOut(value));
+    const auto context = ComputeContextHandles.Lookup(handle);
+    if (!context || !value)
+        return false;
+    try {
+        *value = context->Submit();
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "compute: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+AK_PUBLIC void AK_CALL akComputeSyncGraphics(uint64_t handle, uint64_t value) noexcept {
+    AK_TRACE(akComputeSyncGraphics, handle, value);
+    if (const auto context = ComputeContextHandles.Lookup(handle))
+        context->SyncGraphics(value);
+}
+
+AK_PUBLIC bool AK_CALL akComputeWait(uint64_t handle, uint64_t value, uint64_t timeout) noexcept {
+    AK_TRACE(akComputeWait, handle, value, timeout);
+    const auto context = ComputeContextHandles.Lookup(handle);
+    return context && context->Wait(value, timeout)==VK_SUCCESS;
+}
+
+AK_PUBLIC uint64_t AK_CALL akComputeGetCompletedValue(uint64_t handle) noexcept {
+    const auto context = ComputeContextHandles.Lookup(handle);
+    return context ? context->GetCompletedValue() : 0;
+}
+
+AK_PUBLIC void AK_CALL akComputeGetStats(uint64_t handle, ComputeStats* stats) noexcept {
+    if (!stats)
+        return;
+    const auto context = ComputeContextHandles.Lookup(handle);
+    *stats = context ? context->GetStats() : ComputeStats {};
+}
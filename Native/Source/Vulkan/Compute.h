@@ -0,0 +1,166 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include "Memory.h"
+#include "../CommandStream.h"
+#include <deque>
+#include <vector>
+
+class VulkanDevice;
+class DeviceQueue;
+class ShaderModule;
+class ComputeContext;
+
+enum ComputeBufferFlags : uint32_t {
+    // Mapped for its whole lifetime so it can be written before and read back after dispatches
+    ComputeBufferHostVisible = 1
+};
+
+enum ComputeDispatchFlags : uint32_t {
+    // Runs without waiting for the dispatch recorded before it, for dispatches that touch disjoint data
+    ComputeDispatchConcurrent = 1
+};
+
+// One dispatch of a batch. Buffers and push constants are slices of the arrays passed along with the batch.
+struct ComputeDispatch {
+    uint64_t pipeline;
+    uint32_t firstBuffer;
+    uint32_t bufferCount;
+    uint32_t constantOffset;
+    uint32_t constantSize;
+    uint32_t groupCountX;
+    uint32_t groupCountY;
+    uint32_t groupCountZ;
+    uint32_t flags;
+};
+
+struct ComputeStats {
+    uint64_t submittedValue;
+    uint64_t completedValue;
+    uint64_t batches;
+    uint64_t dispatches;
+    uint64_t pipelines;
+    uint64_t buffers;
+    uint32_t dedicatedQueue;
+};
+
+// A compute shader with its buffers bound as storage buffers 0..bufferCount-1 of set 0
+class ComputePipeline {
+public:
+    ComputeContext& GetContext() const noexcept { return context; }
+    uint64_t GetHandle() const noexcept { return handle; }
+private:
+    friend class ComputeContext;
+    explicit ComputePipeline(ComputeContext& context) noexcept : context(context) {}
+
+    ComputeContext& context;
+    uint64_t handle = 0;
+    uint32_t bufferCount = 0, constantSize = 0;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+};
+
+class ComputeBuffer {
+public:
+    ComputeContext& GetContext() const noexcept { return context; }
+    uint64_t GetHandle() const noexcept { return handle; }
+    VkBuffer GetNative() const noexcept { return buffer; }
+    VkDeviceSize GetSize() const noexcept { return size; }
+    void* GetMapped() const noexcept { return memory.mapped; }
+private:
+    friend class ComputeContext;
+    explicit ComputeBuffer(ComputeContext& context) noexcept : context(context) {}
+
+    ComputeContext& context;
+    uint64_t handle = 0;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    Allocation memory;
+};
+
+// Records dispatches into batches for the device's compute queue, the async compute family when there is one.
+// Batches are identified by the compute queue value they signal: graphics waits on it through the presenter, the host
+// only waits to read results back. Pipelines and buffers belong to the context and are destroyed once the batches
+// that may use them completed, and the frames in flight retired.
+// Not thread safe, a context is driven by a single thread.
+class ComputeContext {
+public:
+    static constexpr uint32_t MaxBuffers = 16;
+    static constexpr uint32_t MaxConstantSize = 128;
+    static constexpr uint32_t SetsPerPool = 256;
+
+    explicit ComputeContext(VulkanDevice& device);
+    ~ComputeContext();
+    ComputeContext(const ComputeContext&) = delete;
+    ComputeContext& operator=(const ComputeContext&) = delete;
+    VulkanDevice& GetDevice() const noexcept { return device; }
+    // Also register the object in its handle table
+    ComputePipeline* CreatePipeline(const uint32_t* code, size_t size, uint32_t bufferCount, uint32_t constantSize);
+    ComputePipeline* LoadPipeline(const char* path, uint32_t bufferCount, uint32_t constantSize);
+    ComputeBuffer* CreateBuffer(VkDeviceSize size, uint32_t flags);
+    void Destroy(ComputePipeline* pipeline) noexcept;
+    void Destroy(ComputeBuffer* buffer) noexcept;
+    // Appends the dispatches to the open batch, starting one if needed
+    void Record(const ComputeDispatch* dispatches, uint32_t count, const uint64_t* buffers, uint32_t bufferCount,
+            const void* constants, uint32_t constantSize);
+    // Submits the open batch and returns the queue value it signals, the last submitted value if nothing is open
+    uint64_t Submit();
+    // Makes the next graphics frame wait for `value` before reading what the batches wrote
+    void SyncGraphics(uint64_t value) noexcept;
+    VkResult Wait(uint64_t value, uint64_t timeout) noexcept;
+    uint64_t GetCompletedValue() noexcept;
+    ComputeStats GetStats() noexcept;
+private:
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        std::vector<VkDescriptorPool> pools;
+        uint32_t poolIndex = 0;
+        uint32_t dispatches = 0;
+        VkPipeline bound = VK_NULL_HANDLE;
+        uint64_t value = 0;
+    };
+
+    // Garbage released while a batch is open, until the batch gets its value
+    static constexpr uint64_t PendingValue = UINT64_MAX;
+
+    struct Garbage {
+        uint64_t value;
+        DeletionQueue::Release release;
+    };
+
+    ComputePipeline* CreatePipeline(ShaderModule* module, uint32_t bufferCount, uint32_t constantSize);
+    void Begin();
+    VkDescriptorSet AllocateSet(VkDescriptorSetLayout layout);
+    void Retire(DeletionQueue::Release release);
+    // Ties the garbage released into the open batch to the value that batch ended with
+    void Resolve(uint64_t value) noexcept;
+    void Collect() noexcept;
+
+    VulkanDevice& device;
+    DeviceQueue& queue;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    bool open = false;
+    Batch current;
+    std::deque<Batch> inFlight;
+    std::vector<Batch> freeBatches;
+    uint64_t submittedValue = 0, completedValue = 0;
+    uint64_t batches = 0, recordedDispatches = 0;
+    std::vector<ComputePipeline*> pipelines;
+    std::vector<ComputeBuffer*> buffers;
+    std::vector<Garbage> garbage;
+};
+
+// Runs the buffer update records of command streams against the host visible compute buffers of one device, with
+// the same rules as akComputeBufferWrite. Updates of other buffers are dropped.
+class ComputeCommandSink : public CommandSink {
+public:
+    explicit ComputeCommandSink(VulkanDevice& device) noexcept : device(device) {}
+    void UpdateBuffer(uint64_t buffer, uint64_t offset, const void* data, uint32_t size) noexcept override;
+private:
+    VulkanDevice& device;
+};
+
+extern HandleTable<ComputeContext*, HandleType::ComputeContext> ComputeContextHandles;
+extern HandleTable<ComputePipeline*, HandleType::ComputePipeline> ComputePipelineHandles;
+extern HandleTable<ComputeBuffer*, HandleType::ComputeBuffer> ComputeBufferHandles;
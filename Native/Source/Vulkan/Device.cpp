@@ -0,0 +1,619 @@
+#include "Device.h"
+#include "Memory.h"
+#include "Presenter.h"
+#include "ShaderRegistry.h"
+#include "PipelineRegistry.h"
+#include "TextureTable.h"
+#include "RenderPassCache.h"
+#include "Compute.h"
+#include "../RenderThread.h"
+#include "../Trace.h"
+
+#include <array>
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    constexpr std::array<const char*, 1> DeviceExtensions = {
+            VK_KHR_SWAPCHAIN_EXTENSION_NAME
+    };
+
+    std::vector<VkQueueFamilyProperties> GetQueueFamilies(VkPhysicalDevice device) {
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+        return queueFamilies;
+    }
+
+    bool HasExtension(VkPhysicalDevice device, const char* name) {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+        for (const auto& extension : availableExtensions) {
+            if (strcmp(extension.extensionName, name)==0)
+                return true;
+        }
+        return false;
+    }
+
+    // Every optional feature structure the device code knows, which of them are linked depends on the API version
+    struct FeatureChain {
+        VkPhysicalDeviceFeatures2KHR features2 = {};
+        VkPhysicalDeviceVulkan12Features vulkan12 = {};
+        VkPhysicalDeviceVulkan13Features vulkan13 = {};
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline = {};
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexing = {};
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRendering = {};
+
+        FeatureChain() noexcept { features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR; }
+        FeatureChain(const FeatureChain&) = delete;
+        FeatureChain& operator=(const FeatureChain&) = delete;
+
+        template <class T>
+        void Link(T& feature, VkStructureType type) noexcept {
+            feature.sType = type;
+            feature.pNext = features2.pNext;
+            features2.pNext = &feature;
+        }
+    };
+
+    // What a bindless sampled image table needs, in VkPhysicalDeviceVulkan12Features or the extension structure
+    template <class T>
+    bool SupportsBindlessIndexing(const T& features) noexcept {
+        return features.shaderSampledImageArrayNonUniformIndexing && features.descriptorBindingPartiallyBound &&
+                features.descriptorBindingSampledImageUpdateAfterBind &&
+                features.descriptorBindingVariableDescriptorCount && features.runtimeDescriptorArray;
+    }
+
+    template <class T>
+    void EnableBindlessIndexing(T& features) noexcept {
+        features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        features.descriptorBindingPartiallyBound = VK_TRUE;
+        features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+        features.runtimeDescriptorArray = VK_TRUE;
+    }
+}
+
+HandleTable<VulkanDevice*, HandleType::Device> DeviceHandles;
+
+VulkanDevice::VulkanDevice(VulkanApplication& application, VkPhysicalDevice physicalDevice)
+        :application(application), physicalDevice(physicalDevice) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    apiVersion = std::min(VK_MAKE_VERSION(VK_VERSION_MAJOR(properties.apiVersion),
+            VK_VERSION_MINOR(properties.apiVersion), 0), application.GetApiVersion());
+    SelectQueueFamilies();
+    CreateLogicalDevice();
+    LoadTimelineFunctions();
+    try {
+        graphicsQueue.Init(*this, graphicsQueue.family, 0);
+        if (transferQueue==&dedicatedTransferQueue)
+            dedicatedTransferQueue.Init(*this, transferFamily, transferIndex);
+        if (computeQueue==&dedicatedComputeQueue)
+            dedicatedComputeQueue.Init(*this, computeFamily, computeIndex);
+        allocator = std::make_unique<MemoryAllocator>(*this);
+        shaders = std::make_unique<ShaderRegistry>(*this);
+        // Layouts of the pipeline registry may reference the table, so it outlives the registry
+        if (features.descriptorIndexing) {
+            try {
+                textures = std::make_unique<TextureTable>(*this);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "texture table: " << e.what() << std::endl;
+            }
+        }
+        pipelines = std::make_unique<PipelineRegistry>(*this);
+        renderPasses = std::make_unique<RenderPassCache>(*this);
+        presenter = std::make_unique<Presenter>(*this);
+        commandSink = std::make_unique<ComputeCommandSink>(*this);
+    }
+    catch (const std::exception&) {
+        Destroy();
+        throw;
+    }
+}
+
+VulkanDevice::~VulkanDevice() {
+    Destroy();
+}
+
+// In the reverse order of creation, also after a failed constructor where the later parts were never created
+void VulkanDevice::Destroy() noexcept {
+    vkDeviceWaitIdle(device);
+    commandSink.reset();
+    presenter.reset();
+    renderPasses.reset();
+    pipelines.reset();
+    textures.reset();
+    shaders.reset();
+    allocator.reset();
+    DestroyQueues();
+    vkDestroyDevice(device, HostAllocator());
+}
+
+void VulkanDevice::DestroyQueues() noexcept {
+    graphicsQueue.Destroy();
+    dedicatedTransferQueue.Destroy();
+    dedicatedComputeQueue.Destroy();
+}
+
+void DeviceQueue::Init(VulkanDevice& owner, uint32_t queueFamily, uint32_t index) {
+    device = &owner;
+    family = queueFamily;
+    vkGetDeviceQueue(owner.GetNative(), family, index, &queue);
+    if (!owner.SupportsTimelineSemaphores())
+        return;
+    VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    if (vkCreateSemaphore(owner.GetNative(), &semaphoreInfo, HostAllocator(), &timeline)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore!");
+    }
+}
+
+void DeviceQueue::Destroy() noexcept {
+    if (!device)
+        return;
+    const auto native = device->GetNative();
+    vkDestroySemaphore(native, timeline, HostAllocator());
+    for (auto& pending : pendingFences)
+        vkDestroyFence(native, pending.second, HostAllocator());
+    for (auto fence : freeFences)
+        vkDestroyFence(native, fence, HostAllocator());
+    pendingFences.clear();
+    freeFences.clear();
+    timeline = VK_NULL_HANDLE;
+    device = nullptr;
+}
+
+VkResult DeviceQueue::Submit(const VkSubmitInfo& submit, uint64_t& value, const QueueWait* waits,
+        uint32_t waitCount) noexcept {
+    if (!timeline) {
+        for (uint32_t i = 0; i<waitCount; ++i) {
+            if (waits[i].queue!=this)
+                waits[i].queue->Wait(waits[i].value, UINT64_MAX);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // Taken under the lock so values are signalled in submission order
+    const auto next = submitted.load(std::memory_order_relaxed)+1;
+    VkSubmitInfo submitInfo = submit;
+    VkResult result;
+    if (timeline) {
+        waitSemaphores.assign(submit.pWaitSemaphores, submit.pWaitSemaphores+submit.waitSemaphoreCount);
+        waitStages.assign(submit.pWaitDstStageMask, submit.pWaitDstStageMask+submit.waitSemaphoreCount);
+        waitValues.assign(submit.waitSemaphoreCount, 0);
+        for (uint32_t i = 0; i<waitCount; ++i) {
+            if (!waits[i].value)
+                continue;
+            waitSemaphores.push_back(waits[i].queue->timeline);
+            waitStages.push_back(waits[i].stages);
+            waitValues.push_back(waits[i].value);
+        }
+        signalSemaphores.assign(submit.pSignalSemaphores, submit.pSignalSemaphores+submit.signalSemaphoreCount);
+        signalSemaphores.push_back(timeline);
+        signalValues.assign(submit.signalSemaphoreCount, 0);
+        signalValues.push_back(next);
+
+        // Binary semaphores ignore their value, the arrays only have to cover them
+        VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timelineInfo.pNext = submit.pNext;
+        timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+        timelineInfo.pSignalSemaphoreValues = signalValues.data();
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+        submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+        submitInfo.pSignalSemaphores = signalSemaphores.data();
+        result = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+    }
+    else {
+        const auto fence = AcquireFence();
+        if (!fence)
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        result = vkQueueSubmit(queue, 1, &submitInfo, fence);
+        if (result==VK_SUCCESS)
+            pendingFences.emplace_back(next, fence);
+        else
+            freeFences.push_back(fence);
+    }
+    if (result==VK_SUCCESS) {
+        submitted.store(next, std::memory_order_release);
+        value = next;
+    }
+    return result;
+}
+
+// Reuses a fence that already signalled, retiring everything submitted before it
+VkFence DeviceQueue::AcquireFence() noexcept {
+    const auto native = device->GetNative();
+    while (!pendingFences.empty() && vkGetFenceStatus(native, pendingFences.front().second)==VK_SUCCESS) {
+        completed.store(pendingFences.front().first, std::memory_order_release);
+        freeFences.push_back(pendingFences.front().second);
+        pendingFences.pop_front();
+    }
+    VkFence fence = VK_NULL_HANDLE;
+    if (!freeFences.empty()) {
+        fence = freeFences.back();
+        freeFences.pop_back();
+        vkResetFences(native, 1, &fence);
+        return fence;
+    }
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    vkCreateFence(native, &fenceInfo, HostAllocator(), &fence);
+    return fence;
+}
+
+uint64_t DeviceQueue::GetCompletedValue() noexcept {
+    if (timeline) {
+        const auto value = device->GetSemaphoreValue(timeline);
+        completed.store(value, std::memory_order_release);
+        return value;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!pendingFences.empty() &&
+            vkGetFenceStatus(device->GetNative(), pendingFences.front().second)==VK_SUCCESS) {
+        completed.store(pendingFences.front().first, std::memory_order_release);
+        freeFences.push_back(pendingFences.front().second);
+        pendingFences.pop_front();
+    }
+    return completed.load(std::memory_order_relaxed);
+}
+
+VkResult DeviceQueue::Wait(uint64_t value, uint64_t timeout) noexcept {
+    if (IsComplete(value))
+        return VK_SUCCESS;
+    if (timeline)
+        return device->WaitSemaphore(timeline, value, timeout);
+    VkFence fence = VK_NULL_HANDLE;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& pending : pendingFences) {
+            if (pending.first>=value) {
+                fence = pending.second;
+                break;
+            }
+        }
+    }
+    // Not submitted yet, or retired in the meantime
+    if (!fence)
+        return IsComplete(value) ? VK_SUCCESS : VK_TIMEOUT;
+    // A fence recycled while waiting belongs to a later submission, which only makes the wait longer
+    const auto result = vkWaitForFences(device->GetNative(), 1, &fence, VK_TRUE, timeout);
+    if (result!=VK_SUCCESS)
+        return result;
+    GetCompletedValue();
+    return VK_SUCCESS;
+}
+
+bool VulkanDevice::CanPresent(VkSurfaceKHR surface) const noexcept {
+    VkBool32 presentSupport = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, graphicsQueue.family, surface, &presentSupport);
+    return presentSupport==VK_TRUE;
+}
+
+bool VulkanDevice::SupportsSampledFormat(VkFormat format) const noexcept {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+    return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)!=0;
+}
+
+VkResult VulkanDevice::WaitSemaphore(VkSemaphore semaphore, uint64_t value, uint64_t timeout) const noexcept {
+    VkSemaphoreWaitInfoKHR waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &semaphore;
+    waitInfo.pValues = &value;
+    return waitSemaphores(device, &waitInfo, timeout);
+}
+
+uint64_t VulkanDevice::GetSemaphoreValue(VkSemaphore semaphore) const noexcept {
+    uint64_t value = 0;
+    getSemaphoreCounterValue(device, semaphore, &value);
+    return value;
+}
+
+void VulkanDevice::LoadTimelineFunctions() noexcept {
+    if (!features.timelineSemaphore)
+        return;
+    const auto core = apiVersion>=VK_API_VERSION_1_2;
+    waitSemaphores = (PFN_vkWaitSemaphoresKHR) vkGetDeviceProcAddr(device,
+            core ? "vkWaitSemaphores" : "vkWaitSemaphoresKHR");
+    getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR) vkGetDeviceProcAddr(device,
+            core ? "vkGetSemaphoreCounterValue" : "vkGetSemaphoreCounterValueKHR");
+}
+
+void VulkanDevice::SelectQueueFamilies() {
+    const auto queueFamilies = GetQueueFamilies(physicalDevice);
+    auto graphicsFound = false;
+    for (uint32_t i = 0; i<queueFamilies.size(); ++i) {
+        if (queueFamilies[i].queueCount>0 && (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            graphicsQueue.family = i;
+            graphicsFound = true;
+            break;
+        }
+    }
+    if (!graphicsFound) {
+        throw std::runtime_error("failed to find a graphics queue family!");
+    }
+
+    queueCounts.assign(queueFamilies.size(), 0);
+    queueCounts[graphicsQueue.family] = 1;
+    // Takes the next unused queue of `family`, if it has one left
+    const auto reserve = [&](uint32_t family, uint32_t& selectedFamily, uint32_t& index) noexcept {
+        if (queueCounts[family]>=queueFamilies[family].queueCount)
+            return false;
+        selectedFamily = family;
+        index = queueCounts[family]++;
+        return true;
+    };
+
+    // Prefer a transfer-only family (the copy engine), then a second queue of the graphics family
+    auto transferFound = false;
+    for (uint32_t i = 0; i<queueFamilies.size() && !transferFound; ++i) {
+        const auto flags = queueFamilies[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            transferFound = reserve(i, transferFamily, transferIndex);
+    }
+    if (transferFound || reserve(graphicsQueue.family, transferFamily, transferIndex))
+        transferQueue = &dedicatedTransferQueue;
+
+    // Same for compute: a family without graphics is the async compute engine
+    auto computeFound = false;
+    for (uint32_t i = 0; i<queueFamilies.size() && !computeFound; ++i) {
+        const auto flags = queueFamilies[i].queueFlags;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+            computeFound = reserve(i, computeFamily, computeIndex);
+    }
+    if (computeFound || reserve(graphicsQueue.family, computeFamily, computeIndex))
+        computeQueue = &dedicatedComputeQueue;
+}
+
+void VulkanDevice::CreateLogicalDevice() {
+    const std::vector<float> queuePriorities(*std::max_element(queueCounts.begin(), queueCounts.end()), 1.0f);
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    for (uint32_t i = 0; i<queueCounts.size(); ++i) {
+        if (!queueCounts[i])
+            continue;
+        VkDeviceQueueCreateInfo queueCreateInfo = {};
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.queueFamilyIndex = i;
+        queueCreateInfo.queueCount = queueCounts[i];
+        queueCreateInfo.pQueuePriorities = queuePriorities.data();
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
+
+    // Block compressed families are negotiated per format when textures are loaded
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    enabledFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    enabledFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+    enabledFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+
+    std::vector<const char*> extensions(DeviceExtensions.begin(), DeviceExtensions.end());
+    incrementalPresent = HasExtension(physicalDevice, VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+    if (incrementalPresent)
+        extensions.push_back(VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+    // The budget is queried through vkGetPhysicalDeviceMemoryProperties2, which needs the instance extension
+    memoryBudget = application.SupportsPhysicalDeviceProperties2() &&
+            HasExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memoryBudget)
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    // Optional features are queried and enabled through pNext chains: the core 1.2/1.3 structures when the device is
+    // that new, the extension structures before
+    const auto core12 = apiVersion>=VK_API_VERSION_1_2, core13 = apiVersion>=VK_API_VERSION_1_3;
+    const auto timelineExtension = !core12 && HasExtension(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    // Needs VK_KHR_maintenance3, core in 1.1
+    const auto indexingExtension = !core12 && apiVersion>=VK_API_VERSION_1_1 &&
+            HasExtension(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    // Needs VK_KHR_depth_stencil_resolve and VK_KHR_create_renderpass2, core in 1.2
+    const auto renderingExtension = !core13 && core12 &&
+            HasExtension(physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    FeatureChain supported;
+    if (core12)
+        supported.Link(supported.vulkan12, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES);
+    if (core13)
+        supported.Link(supported.vulkan13, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES);
+    if (timelineExtension)
+        supported.Link(supported.timeline, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR);
+    if (indexingExtension)
+        supported.Link(supported.descriptorIndexing,
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT);
+    if (renderingExtension)
+        supported.Link(supported.dynamicRendering, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR);
+    PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2 = nullptr;
+    if (apiVersion>=VK_API_VERSION_1_1) {
+        getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(application.GetInstance(),
+                "vkGetPhysicalDeviceFeatures2");
+    }
+    else if (application.SupportsPhysicalDeviceProperties2()) {
+        getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(application.GetInstance(),
+                "vkGetPhysicalDeviceFeatures2KHR");
+    }
+
+    FeatureChain enabled;
+    enabled.features2.features = enabledFeatures;
+    if (getFeatures2) {
+        getFeatures2(physicalDevice, &supported.features2);
+        if (core12) {
+            features.timelineSemaphore = supported.vulkan12.timelineSemaphore==VK_TRUE;
+            features.descriptorIndexing = SupportsBindlessIndexing(supported.vulkan12);
+            enabled.vulkan12.timelineSemaphore = supported.vulkan12.timelineSemaphore;
+            if (features.descriptorIndexing)
+                EnableBindlessIndexing(enabled.vulkan12);
+            enabled.Link(enabled.vulkan12, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES);
+        }
+        features.timelineSemaphore |= timelineExtension && supported.timeline.timelineSemaphore==VK_TRUE;
+        if (timelineExtension && features.timelineSemaphore) {
+            enabled.timeline.timelineSemaphore = VK_TRUE;
+            enabled.Link(enabled.timeline, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR);
+            extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        }
+        if (indexingExtension && SupportsBindlessIndexing(supported.descriptorIndexing)) {
+            features.descriptorIndexing = true;
+            EnableBindlessIndexing(enabled.descriptorIndexing);
+            enabled.Link(enabled.descriptorIndexing,
+                    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT);
+            extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        }
+        if (core13 && supported.vulkan13.dynamicRendering) {
+            features.dynamicRendering = true;
+            enabled.vulkan13.dynamicRendering = VK_TRUE;
+            enabled.Link(enabled.vulkan13, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES);
+        }
+        if (renderingExtension && supported.dynamicRendering.dynamicRendering) {
+            features.dynamicRendering = true;
+            enabled.dynamicRendering.dynamicRendering = VK_TRUE;
+            enabled.Link(enabled.dynamicRendering, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR);
+            extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        }
+    }
+
+    VkDeviceCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+    createInfo.pQueueCreateInfos = queueCreateInfos.data();
+    // The base features travel in the chain when there is one
+    if (getFeatures2)
+        createInfo.pNext = &enabled.features2;
+    else
+        createInfo.pEnabledFeatures = &enabledFeatures;
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
+
+    if (vkCreateDevice(physicalDevice, &createInfo, HostAllocator(), &device)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create logical device!");
+    }
+}
+
+void VulkanDevice::AddTrimListener(TrimListener* listener) {
+    std::lock_guard<std::mutex> lock(trimMutex);
+    trimListeners.push_back(listener);
+}
+
+void VulkanDevice::RemoveTrimListener(TrimListener* listener) noexcept {
+    std::lock_guard<std::mutex> lock(trimMutex);
+    trimListeners.erase(std::remove(trimListeners.begin(), trimListeners.end(), listener), trimListeners.end());
+}
+
+DeviceTrimStats VulkanDevice::Trim() noexcept {
+    std::lock_guard<std::mutex> lock(trimMutex);
+    DeviceTrimStats stats = {};
+    stats.trims = ++trimmed.trims;
+    stats.framebuffers = renderPasses->Trim();
+    // Pipelines hold on to their shaders, so they go first
+    stats.pipelines = pipelines->Trim();
+    stats.shaders = shaders->Trim();
+    for (auto listener : trimListeners)
+        listener->OnTrim(stats);
+    trimmed.shaders += stats.shaders;
+    trimmed.pipelines += stats.pipelines;
+    trimmed.framebuffers += stats.framebuffers;
+    trimmed.scheduledTextureBytes += stats.scheduledTextureBytes;
+    trimmed.scheduledStagingBytes += stats.scheduledStagingBytes;
+    return stats;
+}
+
+DeviceTrimStats VulkanDevice::GetTrimStats() noexcept {
+    std::lock_guard<std::mutex> lock(trimMutex);
+    return trimmed;
+}
+
+AK_PUBLIC void AK_CALL akCloseDevice(uint64_t handle) noexcept {
+    AK_TRACE(akCloseDevice, handle);
+    VulkanDevice* device;
+    if (!DeviceHandles.Erase(handle, &device))
+        return;
+    auto& application = device->GetApplication();
+    if (application.GetFrameHandler()==&device->GetPresenter())
+        application.SetFrameHandler(nullptr);
+    if (application.GetCommandSink()==&device->GetCommandSink())
+        application.SetCommandSink(nullptr);
+    device->GetPresenter().WaitIdle();
+    // The managed callback may be collected once the device is closed
+    device->GetAllocator().SetThresholds(nullptr, 0, nullptr, nullptr);
+    // Queued behind the display contexts released earlier, so they are gone before the device is
+    DeferredDeletions.Enqueue([device]() { delete device; });
+}
+
+AK_PUBLIC bool AK_CALL akDeviceRenderFrame(uint64_t handle) noexcept {
+    AK_TRACE(akDeviceRenderFrame, handle);
+    const auto device = DeviceHandles.Lookup(handle);
+    if (!device || device->GetApplication().GetRenderThread())
+        return false;
+    InputState input;
+    auto& presenter = device->GetPresenter();
+    if (!presenter.BeginFrame(input))
+        return false;
+    presenter.RecordFrame(input);
+    presenter.PresentFrame();
+    TraceFrame();
+    return true;
+}
+
+AK_PUBLIC void AK_CALL akDeviceSetRenderOnDemand(uint64_t handle, bool enable) noexcept {
+    AK_TRACE(akDeviceSetRenderOnDemand, handle, enable);
+    if (const auto device = DeviceHandles.Lookup(handle))
+        device->GetPresenter().SetRenderOnDemand(enable);
+}
+
+AK_PUBLIC bool AK_CALL akDeviceGetRenderOnDemand(uint64_t handle) noexcept {
+    const auto device = DeviceHandles.Lookup(handle);
+    return device && device->GetPresenter().GetRenderOnDemand();
+}
+
+// Bit 0 BCn, bit 1 ETC2/EAC, bit 2 ASTC LDR, for picking which texture variant to load
+AK_PUBLIC uint32_t AK_CALL akDeviceGetTextureCompression(uint64_t handle) noexcept {
+    const auto device = DeviceHandles.Lookup(handle);
+    if (!device)
+        return 0;
+    const auto& features = device->GetEnabledFeatures();
+    return (features.textureCompressionBC ? 1u : 0u) | (features.textureCompressionETC2 ? 2u : 0u) |
+            (features.textureCompressionASTC_LDR ? 4u : 0u);
+}
+
+// The negotiated version, VK_MAKE_VERSION encoded
+AK_PUBLIC uint32_t AK_CALL akDeviceGetApiVersion(uint64_t handle) noexcept {
+    const auto device = DeviceHandles.Lookup(handle);
+    return device ? device->GetApiVersion() : 0;
+}
+
+// Bit 0 timeline semaphores, bit 1 descriptor indexing, bit 2 dynamic rendering
+AK_PUBLIC uint32_t AK_CALL akDeviceGetFeatures(uint64_t handle) noexcept {
+    const auto device = DeviceHandles.Lookup(handle);
+    if (!device)
+        return 0;
+    const auto& features = device->GetFeatures();
+    return (features.timelineSemaphore ? 1u : 0u) | (features.descriptorIndexing ? 2u : 0u) |
+            (features.dynamicRendering ? 4u : 0u);
+}
+
+AK_PUBLIC void AK_CALL akDeviceTrim(uint64_t handle, DeviceTrimStats* stats) noexcept {
+    AK_TRACE(akDeviceTrim, handle, TraceOut(stats));
+    const auto device = DeviceHandles.Lookup(handle);
+    const auto trimmed = device ? device->Trim() : DeviceTrimStats {};
+    if (stats)
+        *stats = trimmed;
+}
+
+AK_PUBLIC void AK_CALL akDeviceGetTrimStats(uint64_t handle, DeviceTrimStats* stats) noexcept {
+    if (!stats)
+        return;
+    const auto device = DeviceHandles.Lookup(handle);
+    *stats = device ? device->GetTrimStats() : DeviceTrimStats {};
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class Presenter;
+class MemoryAllocator;
+class ShaderRegistry;
+class PipelineRegistry;
+class TextureTable;
+class RenderPassCache;
+class ComputeCommandSink;
+class VulkanDevice;
+class DeviceQueue;
+
+// A point on another queue's timeline that a submission waits for before `stages` run
+struct QueueWait {
+    DeviceQueue* queue;
+    uint64_t value;
+    VkPipelineStageFlags stages;
+};
+
+// Queues are externally synchronized, so every submission and present goes through the queue's lock.
+// Several roles may share one queue when the device exposes fewer queues than roles.
+// Each submission signals the next value of the queue's timeline. With timeline semaphores that is one semaphore per
+// queue, which other queues wait on directly on the GPU. Without them every submission gets a fence from a pool
+// and waits on other queues happen on the host before submitting.
+class DeviceQueue {
+public:
+    VkQueue GetNative() const noexcept { return queue; }
+    uint32_t GetFamily() const noexcept { return family; }
+    // Null without timeline semaphore support
+    VkSemaphore GetTimeline() const noexcept { return timeline; }
+    // Stores the value the submission signals in `value`, binary semaphores of `submit` are kept as they are
+    VkResult Submit(const VkSubmitInfo& submit, uint64_t& value, const QueueWait* waits = nullptr,
+            uint32_t waitCount = 0) noexcept;
+    VkResult Present(const VkPresentInfoKHR* presentInfo) noexcept {
+        std::lock_guard<std::mutex> lock(mutex);
+        return vkQueuePresentKHR(queue, presentInfo);
+    }
+    uint64_t GetSubmittedValue() const noexcept { return submitted.load(std::memory_order_acquire); }
+    uint64_t GetCompletedValue() noexcept;
+    bool IsComplete(uint64_t value) noexcept {
+        return value<=completed.load(std::memory_order_acquire) || GetCompletedValue()>=value;
+    }
+    VkResult Wait(uint64_t value, uint64_t timeout) noexcept;
+private:
+    friend class VulkanDevice;
+    void Init(VulkanDevice& owner, uint32_t queueFamily, uint32_t index);
+    void Destroy() noexcept;
+    VkFence AcquireFence() noexcept;
+
+    VulkanDevice* device = nullptr;
+    VkQueue queue = VK_NULL_HANDLE;
+    uint32_t family = 0;
+    VkSemaphore timeline = VK_NULL_HANDLE;
+    std::atomic<uint64_t> submitted {0}, completed {0};
+    std::mutex mutex;
+    // Fence fallback, guarded by the queue's lock
+    std::deque<std::pair<uint64_t, VkFence>> pendingFences;
+    std::vector<VkFence> freeFences;
+    // Arrays of the submission being assembled, kept around to avoid per-submit allocations
+    std::vector<VkSemaphore> waitSemaphores, signalSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    std::vector<uint64_t> waitValues, signalValues;
+};
+
+// Optional features beyond VkPhysicalDeviceFeatures, enabled through the pNext chain when the device has them
+struct DeviceFeatures {
+    bool timelineSemaphore = false;
+    // Partially bound, update-after-bind, variably sized and non-uniformly indexed sampled image arrays
+    bool descriptorIndexing = false;
+    bool dynamicRendering = false;
+};
+
+// What trims released: cached objects by count, device memory in bytes. Memory still used by frames in flight goes
+// back once they retired.
+struct DeviceTrimStats {
+    // Trims so far, this one included
+    uint64_t trims;
+    uint64_t shaders;
+    uint64_t pipelines;
+    uint64_t framebuffers;
+    // Handed to the texture pool's thread, which frees it shortly after; a texture used again before that keeps
+    // its levels
+    uint64_t scheduledTextureBytes;
+    uint64_t scheduledStagingBytes;
+};
+
+// A cache living outside the device that can give memory back, see VulkanDevice::Trim
+class TrimListener {
+public:
+    virtual ~TrimListener() = default;
+    // Adds what it released to `stats`
+    virtual void OnTrim(DeviceTrimStats& stats) noexcept = 0;
+};
+
+class VulkanDevice {
+public:
+    VulkanDevice(VulkanApplication& application, VkPhysicalDevice physicalDevice);
+    ~VulkanDevice();
+    VulkanDevice(const VulkanDevice&) = delete;
+    VulkanDevice& operator=(const VulkanDevice&) = delete;
+    VulkanApplication& GetApplication() const noexcept { return application; }
+    VkPhysicalDevice GetPhysicalDevice() const noexcept { return physicalDevice; }
+    VkDevice GetNative() const noexcept { return device; }
+    // What the instance and the device both support
+    uint32_t GetApiVersion() const noexcept { return apiVersion; }
+    uint32_t GetGraphicsFamily() const noexcept { return graphicsQueue.family; }
+    DeviceQueue& GetGraphicsQueue() noexcept { return graphicsQueue; }
+    // A dedicated DMA queue when the device has one, the graphics queue otherwise
+    DeviceQueue& GetTransferQueue() noexcept { return *transferQueue; }
+    // A compute family without graphics when there is one, so dispatches overlap rendering; shares a queue otherwise
+    DeviceQueue& GetComputeQueue() noexcept { return *computeQueue; }
+    bool CanPresent(VkSurfaceKHR surface) const noexcept;
+    bool SupportsIncrementalPresent() const noexcept { return incrementalPresent; }
+    bool SupportsMemoryBudget() const noexcept { return memoryBudget; }
+    bool SupportsTimelineSemaphores() const noexcept { return features.timelineSemaphore; }
+    const DeviceFeatures& GetFeatures() const noexcept { return features; }
+    // Core in 1.2, VK_KHR_timeline_semaphore before; only valid when timeline semaphores are supported
+    VkResult WaitSemaphore(VkSemaphore semaphore, uint64_t value, uint64_t timeout) const noexcept;
+    uint64_t GetSemaphoreValue(VkSemaphore semaphore) const noexcept;
+    const VkPhysicalDeviceFeatures& GetEnabledFeatures() const noexcept { return enabledFeatures; }
+    // Whether images of `format` can be sampled with optimal tiling
+    bool SupportsSampledFormat(VkFormat format) const noexcept;
+    Presenter& GetPresenter() const noexcept { return *presenter; }
+    MemoryAllocator& GetAllocator() const noexcept { return *allocator; }
+    ShaderRegistry& GetShaders() const noexcept { return *shaders; }
+    PipelineRegistry& GetPipelines() const noexcept { return *pipelines; }
+    // Null without descriptor indexing
+    TextureTable* GetTextureTable() const noexcept { return textures.get(); }
+    RenderPassCache& GetRenderPasses() const noexcept { return *renderPasses; }
+    ComputeCommandSink& GetCommandSink() const noexcept { return *commandSink; }
+    void AddTrimListener(TrimListener* listener);
+    void RemoveTrimListener(TrimListener* listener) noexcept;
+    // Drops every unreferenced cached object and the memory of the registered caches, called on low memory.
+    // Returns what this trim released.
+    DeviceTrimStats Trim() noexcept;
+    // Summed over every trim so far
+    DeviceTrimStats GetTrimStats() noexcept;
+private:
+    void SelectQueueFamilies();
+    void CreateLogicalDevice();
+    void LoadTimelineFunctions() noexcept;
+    void DestroyQueues() noexcept;
+    void Destroy() noexcept;
+    VulkanApplication& application;
+    VkPhysicalDevice physicalDevice;
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t apiVersion = VK_API_VERSION_1_0;
+    DeviceQueue graphicsQueue;
+    DeviceQueue dedicatedTransferQueue;
+    DeviceQueue dedicatedComputeQueue;
+    DeviceQueue* transferQueue = &graphicsQueue;
+    DeviceQueue* computeQueue = &graphicsQueue;
+    uint32_t transferFamily = 0, transferIndex = 0;
+    uint32_t computeFamily = 0, computeIndex = 0;
+    // Queues created per family
+    std::vector<uint32_t> queueCounts;
+    bool incrementalPresent = false;
+    bool memoryBudget = false;
+    DeviceFeatures features;
+    PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+    PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
+    VkPhysicalDeviceFeatures enabledFeatures {};
+    std::unique_ptr<MemoryAllocator> allocator;
+    std::unique_ptr<ShaderRegistry> shaders;
+    std::unique_ptr<PipelineRegistry> pipelines;
+    std::unique_ptr<TextureTable> textures;
+    std::unique_ptr<RenderPassCache> renderPasses;
+    std::unique_ptr<Presenter> presenter;
+    std::unique_ptr<ComputeCommandSink> commandSink;
+    std::mutex trimMutex;
+    std::vector<TrimListener*> trimListeners;
+    DeviceTrimStats trimmed {};
+};
+
+extern HandleTable<VulkanDevice*, HandleType::Device> DeviceHandles;
@@ -3,12 +3,17 @@
 //
 
 #include "../Vulkan.h"
+#include "Device.h"
+#include "Presenter.h"
+#include "Compute.h"
+#include "../Trace.h"
 #include <set>
 #include <map>
 #include <any>
 #include <string>
 #include <vector>
 #include <optional>
+#include <iostream>
 
 namespace {
     enum class FilterNames : int {
@@ -34,13 +39,11 @@ namespace {
         uint64_t UInt64;
         double Double;
         float Float;
-        uintptr_t Handle;
         constexpr FilterContent(bool val) noexcept : Bool(val) {}
         constexpr FilterContent(uint32_t val) noexcept : UInt(val) {}
         constexpr FilterContent(uint64_t val) noexcept : UInt64(val) {}
         constexpr FilterContent(float val) noexcept : Float(val) {}
         constexpr FilterContent(double val) noexcept : Double(val) {}
-        constexpr FilterContent(uintptr_t val) noexcept : Handle(val) {}
     };
 
     using FiltersT = std::map<FilterNames, FilterContent>;
@@ -77,7 +80,7 @@ namespace {
         void Init(const FiltersT& filters) noexcept override {
             if (filters.find(FilterNames::RequireSwapChainAndPresent)->second.Bool) {
                 bypass = false;
-                surface = reinterpret_cast<VkSurfaceKHR>(filters.find(FilterNames::SurfaceAttachment)->second.UInt64);
+                surface = SurfaceHandles.Lookup(filters.find(FilterNames::SurfaceAttachment)->second.UInt64);
             }
             else {
                 bypass = true;
@@ -133,7 +136,7 @@ namespace {
             demandGraphics = filters.find(FilterNames::RequireGraphics) != filters.end();
             demandCompute = filters.find(FilterNames::RequireCompute) != filters.end();
             if (demandPresent) {
-                surface = reinterpret_cast<VkSurfaceKHR>(filters.find(FilterNames::SurfaceAttachment)->second.UInt64);
+                surface = SurfaceHandles.Lookup(filters.find(FilterNames::SurfaceAttachment)->second.UInt64);
             }
             mask = 0;
             if (demandPresent)
@@ -236,6 +239,10 @@ namespace {
                 throw std::runtime_error("failed to find a suitable GPU!");
         }
 
+        VkPhysicalDevice GetPreferredDevice() const noexcept {
+            return compatableDevices.front().first;
+        }
+
     private:
         std::vector<std::pair<VkPhysicalDevice, MetaT>> compatableDevices;
 
@@ -270,68 +277,138 @@ namespace {
             return array;
         }
     };
-}
 
-AK_PUBLIC uintptr_t AK_CALL akCreateDeviceSelectorFilter() {
-    return reinterpret_cast<uintptr_t>(new FiltersT());
+    HandleTable<FiltersT*, HandleType::DeviceFilter> FilterHandles;
+    HandleTable<DeviceSelector*, HandleType::DeviceSelector> SelectorHandles;
 }
 
-AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetBool(uintptr_t handle, int name, bool value) {
-    reinterpret_cast<FiltersT*>(handle)->insert_or_assign(static_cast<FilterNames>(name), value);
+AK_PUBLIC uint64_t AK_CALL akCreateDeviceSelectorFilter() {
+    AK_TRACE(akCreateDeviceSelectorFilter);
+    const auto filters = new FiltersT();
+    const auto handle = FilterHandles.Insert(filters);
+    if (!handle)
+        delete filters;
+    return handle;
 }
 
-AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetUInt(uintptr_t handle, int name, uint32_t value) {
-    reinterpret_cast<FiltersT*>(handle)->insert_or_assign(static_cast<FilterNames>(name), value);
+AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetBool(uint64_t handle, int name, bool value) {
+    AK_TRACE(akDeviceSelectorFilterSetBool, handle, name, value);
+    if (const auto filters = FilterHandles.Lookup(handle))
+        filters->insert_or_assign(static_cast<FilterNames>(name), value);
 }
 
-AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetUInt64(uintptr_t handle, int name, uint64_t value) {
-    reinterpret_cast<FiltersT*>(handle)->insert_or_assign(static_cast<FilterNames>(name), value);
+AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetUInt(uint64_t handle, int name, uint32_t value) {
+    AK_TRACE(akDeviceSelectorFilterSetUInt, handle, name, value);
+    if (const auto filters = FilterHandles.Lookup(handle))
+        filters->insert_or_assign(static_cast<FilterNames>(name), value);
 }
 
-AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetDouble(uintptr_t handle, int name, double value) {
-    reinterpret_cast<FiltersT*>(handle)->insert_or_assign(static_cast<FilterNames>(name), value);
+AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetUInt64(uint64_t handle, int name, uint64_t value) {
+    AK_TRACE(akDeviceSelectorFilterSetUInt64, handle, name, value);
+    if (const auto filters = FilterHandles.Lookup(handle))
+        filters->insert_or_assign(static_cast<FilterNames>(name), value);
 }
 
-AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetHandle(uintptr_t handle, int name, uintptr_t value) {
-    reinterpret_cast<FiltersT*>(handle)->insert_or_assign(static_cast<FilterNames>(name), value);
+AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetDouble(uint64_t handle, int name, double value) {
+    AK_TRACE(akDeviceSelectorFilterSetDouble, handle, name, value);
+    if (const auto filters = FilterHandles.Lookup(handle))
+        filters->insert_or_assign(static_cast<FilterNames>(name), value);
 }
 
-AK_PUBLIC bool AK_CALL akDeviceSelectorFilterGetBool(uintptr_t handle, int name) {
-    return reinterpret_cast<FiltersT*>(handle)->find(static_cast<FilterNames>(name))->second.Bool;
+AK_PUBLIC void AK_CALL akDeviceSelectorFilterSetHandle(uint64_t handle, int name, uint64_t value) {
+    AK_TRACE(akDeviceSelectorFilterSetHandle, handle, name, value);
+    if (const auto filters = FilterHandles.Lookup(handle))
+        filters->insert_or_assign(static_cast<FilterNames>(name), value);
 }
 
-AK_PUBLIC uint32_t AK_CALL akDeviceSelectorFilterGetUInt(uintptr_t handle, int name) {
-    return reinterpret_cast<FiltersT*>(handle)->find(static_cast<FilterNames>(name))->second.UInt;
+AK_PUBLIC bool AK_CALL akDeviceSelectorFilterGetBool(uint64_t handle, int name) {
+    const auto filters = FilterHandles.Lookup(handle);
+    if (!filters)
+        return {};
+    const auto iter = filters->find(static_cast<FilterNames>(name));
+    return iter!=filters->end() ? iter->second.Bool : bool {};
 }
 
-AK_PUBLIC uint64_t AK_CALL akDeviceSelectorFilterGetUInt64(uintptr_t handle, int name) {
-    return reinterpret_cast<FiltersT*>(handle)->find(static_cast<FilterNames>(name))->second.UInt64;
+AK_PUBLIC uint32_t AK_CALL akDeviceSelectorFilterGetUInt(uint64_t handle, int name) {
+    const auto filters = FilterHandles.Lookup(handle);
+    if (!filters)
+        return {};
+    const auto iter = filters->find(static_cast<FilterNames>(name));
+    return iter!=filters->end() ? iter->second.UInt : uint32_t {};
 }
 
-AK_PUBLIC double AK_CALL akDeviceSelectorFilterGetDouble(uintptr_t handle, int name) {
-    return reinterpret_cast<FiltersT*>(handle)->find(static_cast<FilterNames>(name))->second.Double;
+AK_PUBLIC uint64_t AK_CALL akDeviceSelectorFilterGetUInt64(uint64_t handle, int name) {
+    const auto filters = FilterHandles.Lookup(handle);
+    if (!filters)
+        return {};
+    const auto iter = filters->find(static_cast<FilterNames>(name));
+    return iter!=filters->end() ? iter->second.UInt64 : uint64_t {};
 }
 
-AK_PUBLIC uintptr_t AK_CALL akDeviceSelectorFilterGetHandle(uintptr_t handle, int name) {
-    return reinterpret_cast<FiltersT*>(handle)->find(static_cast<FilterNames>(name))->second.Handle;
+AK_PUBLIC double AK_CALL akDeviceSelectorFilterGetDouble(uint64_t handle, int name) {
+    const auto filters = FilterHandles.Lookup(handle);
+    if (!filters)
+        return {};
+    const auto iter = filters->find(static_cast<FilterNames>(name));
+    return iter!=filters->end() ? iter->second.Double : double {};
 }
 
-AK_PUBLIC void AK_CALL akDestroyDeviceSelectorFilter(uintptr_t handle) {
-    delete reinterpret_cast<FiltersT*>(handle);
+AK_PUBLIC uint64_t AK_CALL akDeviceSelectorFilterGetHandle(uint64_t handle, int name) {
+    const auto filters = FilterHandles.Lookup(handle);
+    if (!filters)
+        return {};
+    const auto iter = filters->find(static_cast<FilterNames>(name));
+    return iter!=filters->end() ? iter->second.UInt64 : uint64_t {};
 }
 
-AK_PUBLIC uintptr_t AK_CALL akFilterDevices(uintptr_t appHandle, uintptr_t filter) {
-    return reinterpret_cast<uintptr_t>(
-            new DeviceSelector(
-                    *reinterpret_cast<VulkanApplication*>(appHandle),
-                    *reinterpret_cast<FiltersT*>(filter)
-            ));
+AK_PUBLIC void AK_CALL akDestroyDeviceSelectorFilter(uint64_t handle) {
+    AK_TRACE(akDestroyDeviceSelectorFilter, handle);
+    FiltersT* filters;
+    if (FilterHandles.Erase(handle, &filters))
+        delete filters;
 }
 
-AK_PUBLIC uintptr_t AK_CALL akOpenDevice(uintptr_t filter){
+AK_PUBLIC uint64_t AK_CALL akFilterDevices(uint64_t appHandle, uint64_t filter) {
+    AK_TRACE(akFilterDevices, appHandle, filter);
+    const auto application = ApplicationHandles.Lookup(appHandle);
+    const auto filters = FilterHandles.Lookup(filter);
+    if (!application || !filters)
+        return 0;
+    const auto selector = new DeviceSelector(*application, *filters);
+    const auto handle = SelectorHandles.Insert(selector);
+    if (!handle)
+        delete selector;
+    return handle;
+}
 
+AK_PUBLIC uint64_t AK_CALL akOpenDevice(uint64_t appHandle, uint64_t selectorHandle) noexcept {
+    AK_TRACE(akOpenDevice, appHandle, selectorHandle);
+    const auto application = ApplicationHandles.Lookup(appHandle);
+    const auto selector = SelectorHandles.Lookup(selectorHandle);
+    if (!application || !selector)
+        return 0;
+    try {
+        const auto device = new VulkanDevice(*application, selector->GetPreferredDevice());
+        const auto handle = DeviceHandles.Insert(device);
+        if (!handle) {
+            delete device;
+            return 0;
+        }
+        if (!application->GetFrameHandler())
+            application->SetFrameHandler(&device->GetPresenter());
+        if (!application->GetCommandSink())
+            application->SetCommandSink(&device->GetCommandSink());
+        return handle;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "open device: " << e.what() << std::endl;
+        return 0;
+    }
 }
 
-AK_PUBLIC void AK_CALL akReleaseDeviceFilterResults(uintptr_t handle) {
-    delete reinterpret_cast<DeviceSelector*>(handle);
+AK_PUBLIC void AK_CALL akReleaseDeviceFilterResults(uint64_t handle) {
+    AK_TRACE(akReleaseDeviceFilterResults, handle);
+    DeviceSelector* selector;
+    if (SelectorHandles.Erase(handle, &selector))
+        delete selector;
 }
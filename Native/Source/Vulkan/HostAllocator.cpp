@@ -0,0 +1,303 @@
+#include "HostAllocator.h"
+
+#include <mutex>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    constexpr size_t LargestPooledSize = 4096;
+    constexpr size_t HeaderSize = 16;
+    constexpr size_t SlabSize = 64*1024;
+    constexpr uint32_t CacheBatch = 32;
+    constexpr uint16_t LargeClass = UINT16_MAX;
+    constexpr uint32_t ScopeCount = 5;
+
+    // 16 byte steps up to 128, then four steps per power of two
+    constexpr std::array<uint32_t, 28> SizeClasses = {
+            16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512,
+            640, 768, 896, 1024, 1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096
+    };
+
+    // Precedes every block handed out, keeps blocks 16 byte aligned
+    struct Header {
+        uint64_t size;
+        uint16_t sizeClass;
+        uint16_t scope;
+        uint32_t offset; // from the system allocation to the block, large blocks only
+    };
+
+    static_assert(sizeof(Header)==HeaderSize, "header keeps the payload aligned");
+
+    struct FreeNode {
+        FreeNode* next;
+    };
+
+    struct ScopeCounters {
+        std::atomic<uint64_t> bytes {0}, peakBytes {0}, allocations {0}, totalAllocations {0}, internalBytes {0};
+    };
+
+    // Shared free lists, refilled from slabs that are never returned to the system
+    class Pools {
+    public:
+        FreeNode* Take(uint32_t sizeClass, uint32_t& count, uint32_t limit = CacheBatch) noexcept {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& list = lists[sizeClass];
+            if (!list && !Refill(sizeClass))
+                return nullptr;
+            auto head = list, tail = list;
+            count = 1;
+            while (count<limit && tail->next) {
+                tail = tail->next;
+                ++count;
+            }
+            list = tail->next;
+            tail->next = nullptr;
+            return head;
+        }
+
+        void Give(uint32_t sizeClass, FreeNode* head, FreeNode* tail) noexcept {
+            std::lock_guard<std::mutex> lock(mutex);
+            tail->next = lists[sizeClass];
+            lists[sizeClass] = head;
+        }
+
+        std::atomic<uint64_t> pooledAllocations {0}, systemAllocations {0}, reservedBytes {0};
+        std::array<ScopeCounters, ScopeCount> scopes;
+    private:
+        bool Refill(uint32_t sizeClass) noexcept {
+            const auto blockSize = SizeClasses[sizeClass]+HeaderSize;
+            const auto slab = static_cast<uint8_t*>(malloc(SlabSize));
+            if (!slab)
+                return false;
+            systemAllocations.fetch_add(1, std::memory_order_relaxed);
+            reservedBytes.fetch_add(SlabSize, std::memory_order_relaxed);
+            FreeNode* head = nullptr;
+            for (size_t offset = SlabSize/blockSize*blockSize; offset>=blockSize;) {
+                offset -= blockSize;
+                const auto node = reinterpret_cast<FreeNode*>(slab+offset);
+                node->next = head;
+                head = node;
+            }
+            lists[sizeClass] = head;
+            return true;
+        }
+
+        std::mutex mutex;
+        std::array<FreeNode*, SizeClasses.size()> lists {};
+    };
+
+    // Leaked on purpose: drivers may free from other threads' destructors during process teardown
+    Pools& GlobalPools() noexcept {
+        static auto pools = new Pools();
+        return *pools;
+    }
+
+    struct ThreadCache {
+        struct List {
+            FreeNode* head = nullptr;
+            uint32_t count = 0;
+        };
+
+        ~ThreadCache();
+
+        void* Pop(uint32_t sizeClass) noexcept {
+            auto& list = lists[sizeClass];
+            if (!list.head) {
+                list.head = GlobalPools().Take(sizeClass, list.count);
+                if (!list.head)
+                    return nullptr;
+            }
+            const auto node = list.head;
+            list.head = node->next;
+            --list.count;
+            return node;
+        }
+
+        void Push(uint32_t sizeClass, void* block) noexcept {
+            auto& list = lists[sizeClass];
+            const auto node = static_cast<FreeNode*>(block);
+            node->next = list.head;
+            list.head = node;
+            if (++list.count>2*CacheBatch)
+                Flush(sizeClass, CacheBatch);
+        }
+
+        void Flush(uint32_t sizeClass, uint32_t count) noexcept {
+            auto& list = lists[sizeClass];
+            if (!count)
+                return;
+            const auto head = list.head;
+            auto tail = head;
+            for (uint32_t i = 1; i<count; ++i)
+                tail = tail->next;
+            list.head = tail->next;
+            list.count -= count;
+            GlobalPools().Give(sizeClass, head, tail);
+        }
+
+        std::array<List, SizeClasses.size()> lists;
+    };
+
+    thread_local ThreadCache Cache;
+    // Trivially destructible, so it stays readable after Cache is gone: drivers may still allocate and free from
+    // later thread local destructors, those go straight to the global pools
+    thread_local bool CacheDestroyed = false;
+
+    ThreadCache::~ThreadCache() {
+        for (uint32_t i = 0; i<lists.size(); ++i)
+            Flush(i, lists[i].count);
+        CacheDestroyed = true;
+    }
+
+    void* PopBlock(uint32_t sizeClass) noexcept {
+        if (!CacheDestroyed)
+            return Cache.Pop(sizeClass);
+        uint32_t count;
+        return GlobalPools().Take(sizeClass, count, 1);
+    }
+
+    void PushBlock(uint32_t sizeClass, void* block) noexcept {
+        if (!CacheDestroyed) {
+            Cache.Push(sizeClass, block);
+            return;
+        }
+        const auto node = static_cast<FreeNode*>(block);
+        GlobalPools().Give(sizeClass, node, node);
+    }
+
+    uint16_t FindClass(size_t size) noexcept {
+        return static_cast<uint16_t>(std::lower_bound(SizeClasses.begin(), SizeClasses.end(), size)-
+                SizeClasses.begin());
+    }
+
+    void AddBytes(ScopeCounters& counters, uint64_t bytes) noexcept {
+        const auto current = counters.bytes.fetch_add(bytes, std::memory_order_relaxed)+bytes;
+        auto peak = counters.peakBytes.load(std::memory_order_relaxed);
+        while (current>peak && !counters.peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed));
+    }
+
+    void Account(uint32_t scope, uint64_t bytes) noexcept {
+        auto& counters = GlobalPools().scopes[scope];
+        AddBytes(counters, bytes);
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        counters.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Unaccount(uint32_t scope, uint64_t bytes) noexcept {
+        auto& counters = GlobalPools().scopes[scope];
+        counters.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        counters.allocations.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void* VKAPI_CALL Allocate(void*, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+        if (!size)
+            return nullptr;
+        auto& pools = GlobalPools();
+        Header* header;
+        if (size<=LargestPooledSize && alignment<=HeaderSize) {
+            const auto sizeClass = FindClass(size);
+            header = static_cast<Header*>(PopBlock(sizeClass));
+            if (!header)
+                return nullptr;
+            header->sizeClass = sizeClass;
+            header->offset = 0;
+            pools.pooledAllocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            alignment = std::max(alignment, HeaderSize);
+            const auto raw = static_cast<uint8_t*>(malloc(size+alignment+HeaderSize));
+            if (!raw)
+                return nullptr;
+            const auto address = reinterpret_cast<uintptr_t>(raw)+HeaderSize;
+            const auto block = reinterpret_cast<uint8_t*>((address+alignment-1)/alignment*alignment);
+            header = reinterpret_cast<Header*>(block-HeaderSize);
+            header->sizeClass = LargeClass;
+            header->offset = static_cast<uint32_t>(reinterpret_cast<uint8_t*>(header)-raw);
+            pools.systemAllocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        header->size = size;
+        header->scope = static_cast<uint16_t>(scope);
+        Account(scope, size);
+        return header+1;
+    }
+
+    void VKAPI_CALL Free(void*, void* memory) {
+        if (!memory)
+            return;
+        const auto header = static_cast<Header*>(memory)-1;
+        Unaccount(header->scope, header->size);
+        if (header->sizeClass==LargeClass) {
+            GlobalPools().systemAllocations.fetch_sub(1, std::memory_order_relaxed);
+            free(reinterpret_cast<uint8_t*>(header)-header->offset);
+        }
+        else {
+            GlobalPools().pooledAllocations.fetch_sub(1, std::memory_order_relaxed);
+            PushBlock(header->sizeClass, header);
+        }
+    }
+
+    void* VKAPI_CALL Reallocate(void* user, void* original, size_t size, size_t alignment,
+            VkSystemAllocationScope scope) {
+        if (!original)
+            return Allocate(user, size, alignment, scope);
+        if (!size) {
+            Free(user, original);
+            return nullptr;
+        }
+        const auto header = static_cast<Header*>(original)-1;
+        // Grows and shrinks within the size class stay in place
+        if (header->sizeClass!=LargeClass && size<=SizeClasses[header->sizeClass] && alignment<=HeaderSize) {
+            auto& counters = GlobalPools().scopes[header->scope];
+            counters.bytes.fetch_sub(header->size, std::memory_order_relaxed);
+            AddBytes(counters, size);
+            header->size = size;
+            return original;
+        }
+        const auto memory = Allocate(user, size, alignment, static_cast<VkSystemAllocationScope>(header->scope));
+        if (!memory)
+            return nullptr;
+        memcpy(memory, original, std::min<size_t>(size, header->size));
+        Free(user, original);
+        return memory;
+    }
+
+    void VKAPI_CALL InternalAllocate(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+        GlobalPools().scopes[scope].internalBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    void VKAPI_CALL InternalFree(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+        GlobalPools().scopes[scope].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+    }
+
+    const VkAllocationCallbacks Callbacks = {nullptr, Allocate, Reallocate, Free, InternalAllocate, InternalFree};
+}
+
+const VkAllocationCallbacks* HostAllocator() noexcept {
+    return &Callbacks;
+}
+
+HostAllocatorStats GetHostAllocatorStats() noexcept {
+    auto& pools = GlobalPools();
+    HostAllocatorStats stats = {};
+    for (uint32_t i = 0; i<ScopeCount; ++i) {
+        const auto& counters = pools.scopes[i];
+        stats.scopes[i].bytes = counters.bytes.load(std::memory_order_relaxed);
+        stats.scopes[i].peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+        stats.scopes[i].allocations = counters.allocations.load(std::memory_order_relaxed);
+        stats.scopes[i].totalAllocations = counters.totalAllocations.load(std::memory_order_relaxed);
+        stats.scopes[i].internalBytes = counters.internalBytes.load(std::memory_order_relaxed);
+    }
+    stats.pooledAllocations = pools.pooledAllocations.load(std::memory_order_relaxed);
+    stats.systemAllocations = pools.systemAllocations.load(std::memory_order_relaxed);
+    stats.reservedBytes = pools.reservedBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+AK_PUBLIC void AK_CALL akGetHostAllocatorStats(HostAllocatorStats* stats) noexcept {
+    if (!stats)
+        return;
+    *stats = GetHostAllocatorStats();
+}
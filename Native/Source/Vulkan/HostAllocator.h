@@ -0,0 +1,28 @@
+#pragma once
+
+#include "../Config.h"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+struct HostScopeStats {
+    uint64_t bytes;
+    uint64_t peakBytes;
+    uint64_t allocations;
+    uint64_t totalAllocations;
+    // Memory the driver allocated on its own and only reported through the internal notifications
+    uint64_t internalBytes;
+};
+
+struct HostAllocatorStats {
+    HostScopeStats scopes[5]; // indexed by VkSystemAllocationScope
+    uint64_t pooledAllocations;
+    uint64_t systemAllocations;
+    uint64_t reservedBytes;
+};
+
+// Host memory for the driver, passed to every create and destroy call. Requests of at most 4KB
+// are served from size class pools through per-thread caches, so object creation rarely reaches malloc; larger or
+// over-aligned requests go to the system allocator. Objects must be destroyed with the callbacks they were created
+// with, which is why surfaces created through SDL keep using the default allocator.
+const VkAllocationCallbacks* HostAllocator() noexcept;
+HostAllocatorStats GetHostAllocatorStats() noexcept;
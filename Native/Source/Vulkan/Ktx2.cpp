@@ -0,0 +1,168 @@
+#include "Ktx2.h"
+#include "Device.h"
+#include "../MappedFile.h"
+#include "../Trace.h"
+
+#include <iostream>
+
+namespace {
+    constexpr uint8_t Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    struct Header {
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct LevelIndex {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    static_assert(sizeof(Header)==80 && sizeof(LevelIndex)==24, "KTX2 layout");
+
+    struct Block {
+        uint32_t width, height, bytes;
+    };
+
+    // Texel block of the formats a KTX2 file may carry here, zero bytes for anything else
+    Block GetBlock(VkFormat format) noexcept {
+        constexpr Block Astc[] = {{4, 4, 16}, {5, 4, 16}, {5, 5, 16}, {6, 5, 16}, {6, 6, 16}, {8, 5, 16}, {8, 6, 16},
+                {8, 8, 16}, {10, 5, 16}, {10, 6, 16}, {10, 8, 16}, {10, 10, 16}, {12, 10, 16}, {12, 12, 16}};
+        if (format>=VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format<=VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+            return Astc[(format-VK_FORMAT_ASTC_4x4_UNORM_BLOCK)/2];
+        switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+        case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+        case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+            return {4, 4, 8};
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+        case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+        case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+            return {4, 4, 16};
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            return {1, 1, 4};
+        default:
+            return {0, 0, 0};
+        }
+    }
+
+    class Ktx2Source : public TextureSource {
+    public:
+        explicit Ktx2Source(const char* path) : file(path) {}
+
+        void Validate(const VulkanDevice& device) {
+            const auto size = file.GetSize();
+            if (size<sizeof(Header)) {
+                throw std::runtime_error("file is not a KTX2 container!");
+            }
+            memcpy(&header, file.GetData(), sizeof(Header));
+            if (memcmp(header.identifier, Identifier, sizeof(Identifier))!=0) {
+                throw std::runtime_error("file is not a KTX2 container!");
+            }
+            if (header.supercompressionScheme!=0) {
+                throw std::runtime_error("supercompressed KTX2 files are not supported!");
+            }
+            if (!header.pixelWidth || !header.pixelHeight || header.pixelDepth || header.layerCount>1 ||
+                    header.faceCount!=1) {
+                throw std::runtime_error("only 2D KTX2 textures are supported!");
+            }
+            const auto format = static_cast<VkFormat>(header.vkFormat);
+            const auto block = GetBlock(format);
+            if (!block.bytes) {
+                throw std::runtime_error("KTX2 format is not supported!");
+            }
+            if (!device.SupportsSampledFormat(format)) {
+                throw std::runtime_error("KTX2 format cannot be sampled on this device!");
+            }
+
+            // A level count of 0 asks the loader to generate mips, which would mean decoding, use the base level
+            const auto count = std::max(header.levelCount, 1u);
+            if (count>32 || (std::max(header.pixelWidth, header.pixelHeight) >> (count-1))==0 ||
+                    sizeof(Header)+count*sizeof(LevelIndex)>size) {
+                throw std::runtime_error("KTX2 level index is invalid!");
+            }
+            levels.resize(count);
+            memcpy(levels.data(), file.GetData()+sizeof(Header), count*sizeof(LevelIndex));
+            for (uint32_t level = 0; level<count; ++level) {
+                const auto width = std::max(header.pixelWidth >> level, 1u);
+                const auto height = std::max(header.pixelHeight >> level, 1u);
+                const auto expected = uint64_t((width+block.width-1)/block.width)*
+                        ((height+block.height-1)/block.height)*block.bytes;
+                const auto& index = levels[level];
+                if (index.byteLength!=expected || index.byteOffset>size || index.byteLength>size-index.byteOffset) {
+                    throw std::runtime_error("KTX2 level data is invalid!");
+                }
+            }
+        }
+
+        VkFormat GetFormat() const noexcept override { return static_cast<VkFormat>(header.vkFormat); }
+        VkExtent2D GetExtent() const noexcept override { return {header.pixelWidth, header.pixelHeight}; }
+        uint32_t GetLevelCount() const noexcept override { return static_cast<uint32_t>(levels.size()); }
+        VkDeviceSize GetLevelSize(uint32_t level) const noexcept override { return levels[level].byteLength; }
+        void ReadLevel(uint32_t level, void* destination) override {
+            memcpy(destination, file.GetData()+levels[level].byteOffset, levels[level].byteLength);
+        }
+    private:
+        MappedFile file;
+        Header header {};
+        std::vector<LevelIndex> levels;
+    };
+}
+
+std::unique_ptr<TextureSource> OpenKtx2(const VulkanDevice& device, const char* path) {
+    auto source = std::make_unique<Ktx2Source>(path);
+    source->Validate(device);
+    return source;
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateTextureKTX2(uint64_t poolHandle, const char* path) noexcept {
+    AK_TRACE(akCreateTextureKTX2, poolHandle, path);
+    const auto pool = TexturePoolHandles.Lookup(poolHandle);
+    if (!pool || !path)
+        return 0;
+    try {
+        return pool->Create(OpenKtx2(pool->GetDevice(), path))->GetHandle();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "texture " << path << ": " << e.what() << std::endl;
+        return 0;
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "TexturePool.h"
+
+// Opens a KTX2 container as a texture source. The file stays mapped for the lifetime of the source and levels are
+// copied from the mapping straight into staging memory, block compressed payloads are never decoded on the CPU.
+// Only 2D single layer, non supercompressed files in a format the device can sample are accepted.
+std::unique_ptr<TextureSource> OpenKtx2(const VulkanDevice& device, const char* path);
@@ -0,0 +1,418 @@
+#include "Memory.h"
+#include "Device.h"
+#include "../Trace.h"
+
+#include <algorithm>
+
+namespace {
+    uint32_t CountBits(uint32_t value) noexcept {
+        uint32_t count = 0;
+        for (; value; value &= value-1)
+            ++count;
+        return count;
+    }
+
+    // Vulkan alignments are powers of two
+    VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) noexcept {
+        return (value+alignment-1) & ~(alignment-1);
+    }
+
+    // Allocator whose callbacks this thread is delivering
+    thread_local const MemoryAllocator* Delivering = nullptr;
+}
+
+MemoryAllocator::MemoryAllocator(VulkanDevice& device) : device(device) {
+    vkGetPhysicalDeviceMemoryProperties(device.GetPhysicalDevice(), &properties);
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device.GetPhysicalDevice(), &deviceProperties);
+    granularity = std::max(deviceProperties.limits.bufferImageGranularity, VkDeviceSize(1));
+    VkDeviceSize largest = 0;
+    for (uint32_t i = 0; i<properties.memoryHeapCount; ++i) {
+        const auto& heap = properties.memoryHeaps[i];
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.size>largest) {
+            largest = heap.size;
+            deviceLocalHeap = i;
+        }
+    }
+    if (device.SupportsMemoryBudget()) {
+        getMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR) vkGetInstanceProcAddr(
+                device.GetApplication().GetInstance(), "vkGetPhysicalDeviceMemoryProperties2KHR");
+    }
+    RefreshBudget(true);
+}
+
+// Everything allocated from it was freed by now, only the kept empty blocks are left
+MemoryAllocator::~MemoryAllocator() {
+    Jobs.Wait(delivery);
+    for (uint32_t i = 0; i<properties.memoryTypeCount; ++i) {
+        auto& blocks = types[i].blockList;
+        while (!blocks.empty())
+            DestroyBlock(i, *blocks.back());
+    }
+}
+
+uint32_t MemoryAllocator::FindType(uint32_t typeBits, VkMemoryPropertyFlags required,
+        VkMemoryPropertyFlags preferred) const {
+    uint32_t best = UINT32_MAX, bestScore = 0;
+    for (uint32_t i = 0; i<properties.memoryTypeCount; ++i) {
+        const auto flags = properties.memoryTypes[i].propertyFlags;
+        if (!(typeBits & (1u << i)) || (flags & required)!=required)
+            continue;
+        const auto score = CountBits(flags & preferred)+1;
+        if (score>bestScore) {
+            best = i;
+            bestScore = score;
+        }
+    }
+    if (best==UINT32_MAX) {
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+    return best;
+}
+
+Allocation MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required,
+        VkMemoryPropertyFlags preferred) {
+    Allocation allocation;
+    allocation.type = FindType(requirements.memoryTypeBits, required, preferred);
+    const auto alignment = std::max(std::max(requirements.alignment, granularity), VkDeviceSize(1));
+    allocation.size = AlignUp(std::max(requirements.size, VkDeviceSize(1)), granularity);
+    const auto heap = properties.memoryTypes[allocation.type].heapIndex;
+    const auto blockSize = std::min(BlockSize, properties.memoryHeaps[heap].size/8);
+    auto& type = types[allocation.type];
+    {
+        std::lock_guard<std::mutex> lock(type.mutex);
+        MemoryBlock* block = nullptr;
+        if (allocation.size>blockSize/2) {
+            block = &CreateBlock(allocation.type, allocation.size, true);
+        }
+        else {
+            for (auto& candidate : type.blockList) {
+                if (!candidate->dedicated && candidate->size-candidate->used>=allocation.size &&
+                        Carve(*candidate, allocation.size, alignment, allocation.offset)) {
+                    block = candidate.get();
+                    break;
+                }
+            }
+            if (!block) {
+                auto& created = CreateBlock(allocation.type, blockSize, false);
+                if (!Carve(created, allocation.size, alignment, allocation.offset)) {
+                    DestroyBlock(allocation.type, created);
+                    throw std::runtime_error("failed to place allocation in a new memory block!");
+                }
+                block = &created;
+            }
+        }
+        ++block->allocations;
+        block->used += allocation.size;
+        allocation.block = block;
+        allocation.memory = block->memory;
+        allocation.mapped = block->mapped ? block->mapped+allocation.offset : nullptr;
+        type.used.fetch_add(allocation.size, std::memory_order_relaxed);
+        type.allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    RefreshBudget(false);
+    CheckThresholds(heap);
+    return allocation;
+}
+
+void MemoryAllocator::Free(const Allocation& allocation) noexcept {
+    if (allocation.memory==VK_NULL_HANDLE)
+        return;
+    auto& type = types[allocation.type];
+    {
+        std::lock_guard<std::mutex> lock(type.mutex);
+        auto& block = *allocation.block;
+        --block.allocations;
+        block.used -= allocation.size;
+        type.used.fetch_sub(allocation.size, std::memory_order_relaxed);
+        type.allocations.fetch_sub(1, std::memory_order_relaxed);
+        if (block.dedicated) {
+            DestroyBlock(allocation.type, block);
+        }
+        else {
+            Return(block, allocation.offset, allocation.size);
+            // One empty block stays around, so a type that is freed and allocated in turn does not thrash
+            if (!block.allocations) {
+                for (const auto& other : type.blockList) {
+                    if (other.get()!=&block && !other->dedicated && !other->allocations) {
+                        DestroyBlock(allocation.type, block);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    CheckThresholds(properties.memoryTypes[allocation.type].heapIndex);
+}
+
+// Called with the type's lock held
+MemoryBlock& MemoryAllocator::CreateBlock(uint32_t type, VkDeviceSize size, bool dedicated) {
+    auto& state = types[type];
+    auto block = std::make_unique<MemoryBlock>();
+    block->size = size;
+    block->dedicated = dedicated;
+    if (!dedicated)
+        block->free.push_back({0, size});
+    state.blockList.reserve(state.blockList.size()+1);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = type;
+    if (vkAllocateMemory(device.GetNative(), &allocInfo, HostAllocator(), &block->memory)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate device memory!");
+    }
+    if (properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void* mapped;
+        if (vkMapMemory(device.GetNative(), block->memory, 0, VK_WHOLE_SIZE, 0, &mapped)!=VK_SUCCESS) {
+            vkFreeMemory(device.GetNative(), block->memory, HostAllocator());
+            throw std::runtime_error("failed to map device memory!");
+        }
+        block->mapped = static_cast<uint8_t*>(mapped);
+    }
+    state.allocated.fetch_add(size, std::memory_order_relaxed);
+    state.blocks.fetch_add(1, std::memory_order_relaxed);
+    heaps[properties.memoryTypes[type].heapIndex].allocated.fetch_add(size, std::memory_order_relaxed);
+    state.blockList.push_back(std::move(block));
+    return *state.blockList.back();
+}
+
+// Called with the type's lock held, or once nothing allocates anymore
+void MemoryAllocator::DestroyBlock(uint32_t type, MemoryBlock& block) noexcept {
+    auto& state = types[type];
+    vkFreeMemory(device.GetNative(), block.memory, HostAllocator());
+    state.allocated.fetch_sub(block.size, std::memory_order_relaxed);
+    state.blocks.fetch_sub(1, std::memory_order_relaxed);
+    heaps[properties.memoryTypes[type].heapIndex].allocated.fetch_sub(block.size, std::memory_order_relaxed);
+    const auto found = std::find_if(state.blockList.begin(), state.blockList.end(),
+            [&block](const std::unique_ptr<MemoryBlock>& entry) noexcept { return entry.get()==&block; });
+    if (found!=state.blockList.end())
+        state.blockList.erase(found);
+}
+
+// First fit. Room for one more free range than there are allocations is reserved up front, so Return never
+// allocates.
+bool MemoryAllocator::Carve(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+    block.free.reserve(block.allocations+2);
+    for (auto i = block.free.begin(); i!=block.free.end(); ++i) {
+        const auto begin = AlignUp(i->offset, alignment);
+        const auto end = i->offset+i->size;
+        if (begin>end || end-begin<size)
+            continue;
+        const MemoryBlock::Range before = {i->offset, begin-i->offset}, after = {begin+size, end-begin-size};
+        if (before.size && after.size) {
+            *i = before;
+            block.free.insert(i+1, after);
+        }
+        else if (before.size) {
+            *i = before;
+        }
+        else if (after.size) {
+            *i = after;
+        }
+        else {
+            block.free.erase(i);
+        }
+        offset = begin;
+        return true;
+    }
+    return false;
+}
+
+void MemoryAllocator::Return(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size) noexcept {
+    auto& free = block.free;
+    const auto next = std::lower_bound(free.begin(), free.end(), offset,
+            [](const MemoryBlock::Range& range, VkDeviceSize value) noexcept { return range.offset<value; });
+    const auto joinsPrevious = next!=free.begin() && (next-1)->offset+(next-1)->size==offset;
+    const auto joinsNext = next!=free.end() && offset+size==next->offset;
+    if (joinsPrevious && joinsNext) {
+        (next-1)->size += size+next->size;
+        free.erase(next);
+    }
+    else if (joinsPrevious) {
+        (next-1)->size += size;
+    }
+    else if (joinsNext) {
+        next->offset = offset;
+        next->size += size;
+    }
+    else {
+        free.insert(next, {offset, size});
+    }
+}
+
+void MemoryAllocator::Poll() noexcept {
+    RefreshBudget(false);
+    for (uint32_t i = 0; i<properties.memoryHeapCount; ++i)
+        CheckThresholds(i);
+    // Poll runs under the render thread's frame lock, so the callbacks are left to a worker
+    if (!pendingHeaps.load(std::memory_order_acquire) || deliveryQueued.exchange(true))
+        return;
+    try {
+        Jobs.Run(DeliverJob, this, 1, &delivery);
+    }
+    catch (const std::exception&) {
+        // Stays pending for the next poll
+        deliveryQueued.store(false);
+    }
+}
+
+void MemoryAllocator::RefreshBudget(bool force) noexcept {
+    const auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(BudgetRefreshInterval);
+    auto last = lastRefresh.load(std::memory_order_relaxed);
+    if (force)
+        lastRefresh.store(now, std::memory_order_relaxed);
+    else if (now-last<interval.count() || !lastRefresh.compare_exchange_strong(last, now))
+        return;
+
+    std::lock_guard<std::mutex> lock(budgetMutex);
+    if (!getMemoryProperties2) {
+        for (uint32_t i = 0; i<properties.memoryHeapCount; ++i)
+            heaps[i].budget.store(properties.memoryHeaps[i].size, std::memory_order_relaxed);
+        return;
+    }
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2KHR memoryProperties = {};
+    memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties.pNext = &budget;
+    getMemoryProperties2(device.GetPhysicalDevice(), &memoryProperties);
+    for (uint32_t i = 0; i<properties.memoryHeapCount; ++i) {
+        auto& heap = heaps[i];
+        heap.budget.store(budget.heapBudget[i], std::memory_order_relaxed);
+        heap.allocatedAtReport.store(heap.allocated.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        heap.reportedUsage.store(budget.heapUsage[i], std::memory_order_relaxed);
+    }
+}
+
+// The OS figure lags behind, allocations made since it was queried are added on top
+VkDeviceSize MemoryAllocator::GetHeapUsage(uint32_t heap) const noexcept {
+    const auto& state = heaps[heap];
+    const auto allocated = state.allocated.load(std::memory_order_relaxed);
+    if (!getMemoryProperties2)
+        return allocated;
+    const auto usage = state.reportedUsage.load(std::memory_order_relaxed)+allocated-
+            state.allocatedAtReport.load(std::memory_order_relaxed);
+    return std::max(usage, allocated);
+}
+
+// Only records the change, Allocate and Free run under their callers' locks
+void MemoryAllocator::CheckThresholds(uint32_t heap) noexcept {
+    uint32_t level = 0;
+    const auto usage = GetHeapUsage(heap);
+    const auto budget = GetHeapBudget(heap);
+    std::lock_guard<std::mutex> lock(thresholdMutex);
+    if (!thresholdCallback)
+        return;
+    for (const auto fraction : thresholds) {
+        if (usage>=static_cast<VkDeviceSize>(fraction*budget))
+            ++level;
+    }
+    if (heaps[heap].level.exchange(level, std::memory_order_relaxed)!=level)
+        pendingHeaps.fetch_or(1u << heap, std::memory_order_release);
+}
+
+void MemoryAllocator::DeliverThresholds() noexcept {
+    // Cleared first, a change recorded from here on queues another delivery
+    deliveryQueued.store(false);
+    std::lock_guard<std::mutex> lock(deliveryMutex);
+    Delivering = this;
+    for (auto pending = pendingHeaps.exchange(0, std::memory_order_acquire); pending; pending &= pending-1) {
+        const auto heap = CountBits((pending & (0u-pending))-1);
+        MemoryThresholdCallback callback;
+        void* user;
+        uint32_t level;
+        {
+            std::lock_guard<std::mutex> thresholdLock(thresholdMutex);
+            callback = thresholdCallback;
+            user = thresholdUser;
+            level = heaps[heap].level.load(std::memory_order_relaxed);
+        }
+        if (!callback || reported[heap]==level)
+            continue;
+        reported[heap] = level;
+        callback(heap, level, GetHeapUsage(heap), GetHeapBudget(heap), user);
+    }
+    Delivering = nullptr;
+}
+
+void AK_CALL MemoryAllocator::DeliverJob(void* context, uint32_t) noexcept {
+    static_cast<MemoryAllocator*>(context)->DeliverThresholds();
+}
+
+uint32_t MemoryAllocator::GetHeapStats(MemoryHeapStats* stats, uint32_t capacity) const noexcept {
+    const auto count = std::min(capacity, properties.memoryHeapCount);
+    for (uint32_t i = 0; i<count; ++i) {
+        const auto& heap = heaps[i];
+        stats[i].size = properties.memoryHeaps[i].size;
+        stats[i].budget = heap.budget.load(std::memory_order_relaxed);
+        stats[i].usage = GetHeapUsage(i);
+        stats[i].allocated = heap.allocated.load(std::memory_order_relaxed);
+        stats[i].flags = properties.memoryHeaps[i].flags;
+        stats[i].thresholdLevel = heap.level.load(std::memory_order_relaxed);
+    }
+    return properties.memoryHeapCount;
+}
+
+uint32_t MemoryAllocator::GetTypeStats(MemoryTypeStats* stats, uint32_t capacity) const noexcept {
+    const auto count = std::min(capacity, properties.memoryTypeCount);
+    for (uint32_t i = 0; i<count; ++i) {
+        const auto& type = types[i];
+        stats[i].allocated = type.allocated.load(std::memory_order_relaxed);
+        stats[i].used = type.used.load(std::memory_order_relaxed);
+        stats[i].blocks = type.blocks.load(std::memory_order_relaxed);
+        stats[i].allocations = type.allocations.load(std::memory_order_relaxed);
+        stats[i].heap = properties.memoryTypes[i].heapIndex;
+        stats[i].flags = properties.memoryTypes[i].propertyFlags;
+    }
+    return properties.memoryTypeCount;
+}
+
+void MemoryAllocator::SetThresholds(const float* fractions, uint32_t count, MemoryThresholdCallback callback,
+        void* user) {
+    {
+        // Waits out a delivery in flight, unless a callback is replacing the thresholds and holds the lock already
+        std::unique_lock<std::mutex> deliveryLock(deliveryMutex, std::defer_lock);
+        if (Delivering!=this)
+            deliveryLock.lock();
+        {
+            std::lock_guard<std::mutex> lock(thresholdMutex);
+            thresholds.assign(fractions, fractions+count);
+            thresholdCallback = count ? callback : nullptr;
+            thresholdUser = user;
+            for (auto& heap : heaps)
+                heap.level.store(0, std::memory_order_relaxed);
+        }
+        reported.fill(0);
+    }
+    // Reports heaps that are already past a threshold without waiting for a frame
+    Poll();
+}
+
+AK_PUBLIC uint32_t AK_CALL akDeviceGetMemoryHeapStats(uint64_t handle, MemoryHeapStats* stats,
+        uint32_t capacity) noexcept {
+    const auto device = DeviceHandles.Lookup(handle);
+    return device && stats ? device->GetAllocator().GetHeapStats(stats, capacity) : 0;
+}
+
+AK_PUBLIC uint32_t AK_CALL akDeviceGetMemoryTypeStats(uint64_t handle, MemoryTypeStats* stats,
+        uint32_t capacity) noexcept {
+    const auto device = DeviceHandles.Lookup(handle);
+    return device && stats ? device->GetAllocator().GetTypeStats(stats, capacity) : 0;
+}
+
+AK_PUBLIC bool AK_CALL akDeviceSetMemoryThresholds(uint64_t handle, const float* fractions, uint32_t count,
+        MemoryThresholdCallback callback, void* user) noexcept {
+    AK_TRACE(akDeviceSetMemoryThresholds, handle, TraceIn(fractions, count), count, callback, user);
+    const auto device = DeviceHandles.Lookup(handle);
+    if (!device)
+        return false;
+    try {
+        device->GetAllocator().SetThresholds(fractions, count, callback, user);
+        return true;
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include "../JobSystem.h"
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+class VulkanDevice;
+
+// One vkAllocateMemory that allocations are carved from, mapped as a whole when it is host visible
+struct MemoryBlock {
+    struct Range {
+        VkDeviceSize offset, size;
+    };
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    VkDeviceSize used = 0;
+    uint8_t* mapped = nullptr;
+    uint32_t allocations = 0;
+    // Holds a single allocation too large to share a block
+    bool dedicated = false;
+    // Sorted by offset, neighbours are merged
+    std::vector<Range> free;
+};
+
+// `size` is what the allocation takes up in its block, at least what was requested
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    uint32_t type = 0;
+    void* mapped = nullptr;
+    MemoryBlock* block = nullptr;
+};
+
+struct MemoryHeapStats {
+    uint64_t size;
+    // What the OS lets the process use and what it reports the process uses, from VK_EXT_memory_budget when
+    // enabled. Without it the budget is the heap size and the usage is what this allocator holds.
+    uint64_t budget;
+    uint64_t usage;
+    uint64_t allocated;
+    uint32_t flags;
+    uint32_t thresholdLevel;
+};
+
+struct MemoryTypeStats {
+    uint64_t allocated;
+    uint64_t used;
+    uint64_t blocks;
+    uint64_t allocations;
+    uint32_t heap;
+    uint32_t flags;
+};
+
+// Called with the number of thresholds the heap usage is at or above whenever that number changes. Changes are
+// recorded where memory is allocated or freed and delivered after the next Poll on a job system worker, with none of
+// the allocator's or its callers' locks held; changes in between are coalesced, so a call carries the current level.
+// Calls are serialized, a callback may call back into the device.
+using MemoryThresholdCallback = void (*)(uint32_t heap, uint32_t level, uint64_t usage, uint64_t budget, void* user);
+
+// Device memory with per-heap and per-type accounting. Allocations of one type are carved first fit from shared
+// blocks, so the device sees few vkAllocateMemory calls; one larger than half a block gets a dedicated block. Every
+// allocation starts and ends on bufferImageGranularity, so buffers and images may share a block. One empty block per
+// type is kept for reuse. Host visible blocks are mapped for their whole lifetime.
+class MemoryAllocator {
+public:
+    static constexpr auto BudgetRefreshInterval = std::chrono::milliseconds(100);
+    // Shared block size, smaller on heaps below eight times this
+    static constexpr VkDeviceSize BlockSize = VkDeviceSize(64) << 20;
+
+    explicit MemoryAllocator(VulkanDevice& device);
+    ~MemoryAllocator();
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+    // Picks a type with all `required` and as many `preferred` properties as possible
+    Allocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required,
+            VkMemoryPropertyFlags preferred = 0);
+    void Free(const Allocation& allocation) noexcept;
+    const VkPhysicalDeviceMemoryProperties& GetProperties() const noexcept { return properties; }
+    VkDeviceSize GetAllocatedBytes(uint32_t type) const noexcept {
+        return types[type].allocated.load(std::memory_order_relaxed);
+    }
+    // Bytes the OS lets this process use on `heap`, refreshed at most every BudgetRefreshInterval
+    VkDeviceSize GetHeapBudget(uint32_t heap) const noexcept { return heaps[heap].budget.load(std::memory_order_relaxed); }
+    // Largest device local heap, the one textures and render targets live in
+    uint32_t GetDeviceLocalHeap() const noexcept { return deviceLocalHeap; }
+    // Refreshes the budget if it is due and queues the delivery of threshold crossings, called once per frame
+    void Poll() noexcept;
+    uint32_t GetHeapStats(MemoryHeapStats* stats, uint32_t capacity) const noexcept;
+    uint32_t GetTypeStats(MemoryTypeStats* stats, uint32_t capacity) const noexcept;
+    // Fractions of the heap budget, in any order; an empty list or a null callback turns notifications off. The
+    // previous callback is not called anymore once this returns.
+    void SetThresholds(const float* fractions, uint32_t count, MemoryThresholdCallback callback, void* user);
+private:
+    struct HeapState {
+        std::atomic<VkDeviceSize> allocated {0};
+        std::atomic<VkDeviceSize> budget {0};
+        // OS reported usage and what this allocator held when it was queried
+        std::atomic<VkDeviceSize> reportedUsage {0};
+        std::atomic<VkDeviceSize> allocatedAtReport {0};
+        std::atomic<uint32_t> level {0};
+    };
+
+    struct TypeState {
+        std::atomic<VkDeviceSize> allocated {0};
+        std::atomic<VkDeviceSize> used {0};
+        std::atomic<uint64_t> blocks {0};
+        std::atomic<uint64_t> allocations {0};
+        // Guards the blocks and everything in them
+        std::mutex mutex;
+        std::vector<std::unique_ptr<MemoryBlock>> blockList;
+    };
+
+    uint32_t FindType(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) const;
+    MemoryBlock& CreateBlock(uint32_t type, VkDeviceSize size, bool dedicated);
+    void DestroyBlock(uint32_t type, MemoryBlock& block) noexcept;
+    static bool Carve(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    static void Return(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size) noexcept;
+    void RefreshBudget(bool force) noexcept;
+    VkDeviceSize GetHeapUsage(uint32_t heap) const noexcept;
+    void CheckThresholds(uint32_t heap) noexcept;
+    void DeliverThresholds() noexcept;
+    static void AK_CALL DeliverJob(void* context, uint32_t index) noexcept;
+
+    VulkanDevice& device;
+    VkPhysicalDeviceMemoryProperties properties {};
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+    uint32_t deviceLocalHeap = 0;
+    VkDeviceSize granularity = 1;
+    std::array<HeapState, VK_MAX_MEMORY_HEAPS> heaps;
+    std::array<TypeState, VK_MAX_MEMORY_TYPES> types;
+    std::atomic<std::chrono::steady_clock::rep> lastRefresh {0};
+    std::mutex budgetMutex;
+    std::mutex thresholdMutex;
+    std::vector<float> thresholds;
+    MemoryThresholdCallback thresholdCallback = nullptr;
+    void* thresholdUser = nullptr;
+    // Heaps whose level changed since the last delivery, one bit each
+    std::atomic<uint32_t> pendingHeaps {0};
+    std::atomic<bool> deliveryQueued {false};
+    JobCounter delivery;
+    // Held while callbacks run, guards the levels last reported
+    std::mutex deliveryMutex;
+    std::array<uint32_t, VK_MAX_MEMORY_HEAPS> reported {};
+};
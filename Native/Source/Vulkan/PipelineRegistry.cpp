@@ -0,0 +1,310 @@
+#include "PipelineRegistry.h"
+#include "Device.h"
+#include "ShaderRegistry.h"
+#include "TextureTable.h"
+#include "../DeletionQueue.h"
+#include "../Trace.h"
+
+#include <cstring>
+
+namespace {
+    uint64_t HashBytes(const void* data, size_t size) noexcept {
+        const auto bytes = static_cast<const uint8_t*>(data);
+        auto hash = 14695981039346656037ull;
+        for (size_t i = 0; i<size; ++i)
+            hash = (hash ^ bytes[i])*1099511628211ull;
+        return hash;
+    }
+
+    // Non-dispatchable handles are pointers or 64 bit integers depending on the platform
+    template <class T>
+    uint64_t HandleBits(T handle) noexcept {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &handle, sizeof(handle));
+        return bits;
+    }
+
+    bool UsesConstantFactor(VkBlendFactor factor) noexcept {
+        return factor>=VK_BLEND_FACTOR_CONSTANT_COLOR && factor<=VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA;
+    }
+
+    bool UsesBlendConstants(const VkPipelineColorBlendAttachmentState& blend) noexcept {
+        return blend.blendEnable && (UsesConstantFactor(blend.srcColorBlendFactor) ||
+                UsesConstantFactor(blend.dstColorBlendFactor) || UsesConstantFactor(blend.srcAlphaBlendFactor) ||
+                UsesConstantFactor(blend.dstAlphaBlendFactor));
+    }
+
+    bool RasterizesLines(const GraphicsPipelineState& state) noexcept {
+        return state.polygonMode==VK_POLYGON_MODE_LINE || (state.topology>=VK_PRIMITIVE_TOPOLOGY_LINE_LIST &&
+                state.topology<=VK_PRIMITIVE_TOPOLOGY_LINE_STRIP) ||
+                state.topology==VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY ||
+                state.topology==VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY;
+    }
+}
+
+bool PipelineRegistry::Key::operator==(const Key& other) const noexcept {
+    return std::memcmp(this, &other, sizeof(Key))==0;
+}
+
+size_t PipelineRegistry::KeyHash::operator()(const Key& key) const noexcept {
+    return static_cast<size_t>(HashBytes(&key, sizeof(key)));
+}
+
+bool PipelineRegistry::LayoutKey::operator==(const LayoutKey& other) const noexcept {
+    return std::memcmp(this, &other, sizeof(LayoutKey))==0;
+}
+
+size_t PipelineRegistry::LayoutKeyHash::operator()(const LayoutKey& key) const noexcept {
+    return static_cast<size_t>(HashBytes(&key, sizeof(key)));
+}
+
+PipelineRegistry::~PipelineRegistry() {
+    const auto native = device.GetNative();
+    for (auto& pipeline : pipelines)
+        vkDestroyPipeline(native, pipeline.second->pipeline, HostAllocator());
+    for (auto& layout : layouts) {
+        vkDestroyPipelineLayout(native, layout.second.layout, HostAllocator());
+        vkDestroyDescriptorSetLayout(native, layout.second.setLayout, HostAllocator());
+    }
+}
+
+// Fields the rest of the state makes irrelevant are reset, so they do not split otherwise equal pipelines. The
+// pipeline is built from the normalized state too, so it always matches the key it is cached under.
+GraphicsPipelineState PipelineRegistry::Normalize(const GraphicsPipelineState& state) noexcept {
+    auto normalized = state;
+    const auto topology = state.topology;
+    const bool strip = topology==VK_PRIMITIVE_TOPOLOGY_LINE_STRIP || topology==VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP ||
+            topology==VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN || topology==VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY ||
+            topology==VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP_WITH_ADJACENCY;
+    normalized.primitiveRestart = strip && state.primitiveRestart;
+    if (state.cullMode==VK_CULL_MODE_NONE)
+        normalized.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    if (!state.blend.blendEnable) {
+        normalized.blend = {};
+        normalized.blend.colorWriteMask = state.blend.colorWriteMask;
+    }
+    return normalized;
+}
+
+PipelineRegistry::Key PipelineRegistry::MakeKey(const GraphicsPipelineState& state) noexcept {
+    Key key = {};
+    key.vertex = state.vertex->GetId();
+    key.fragment = state.fragment->GetId();
+    key.layout = HandleBits(state.layout);
+    const auto& blend = state.blend;
+    key.values[0] = state.colorFormat;
+    key.values[1] = state.topology;
+    key.values[2] = state.primitiveRestart ? 1 : 0;
+    key.values[3] = state.polygonMode;
+    key.values[4] = state.cullMode;
+    key.values[5] = state.frontFace;
+    key.values[6] = state.samples;
+    key.values[7] = blend.blendEnable ? 1 : 0;
+    key.values[8] = blend.srcColorBlendFactor;
+    key.values[9] = blend.dstColorBlendFactor;
+    key.values[10] = blend.colorBlendOp;
+    key.values[11] = blend.srcAlphaBlendFactor;
+    key.values[12] = blend.dstAlphaBlendFactor;
+    key.values[13] = blend.alphaBlendOp;
+    key.values[14] = blend.colorWriteMask;
+    return key;
+}
+
+const PipelineLayout& PipelineRegistry::GetLayout(const PipelineLayoutState& state) {
+    const auto table = state.textures ? device.GetTextureTable() : nullptr;
+    const LayoutKey key = {{state.storageBuffers, state.storageBuffers ? state.bufferStages : 0, state.constantSize,
+            state.constantSize ? state.constantStages : 0, table ? 1u : 0u}};
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto found = layouts.find(key);
+    if (found!=layouts.end())
+        return found->second;
+
+    const auto native = device.GetNative();
+    PipelineLayout created;
+    std::vector<VkDescriptorSetLayoutBinding> bindings(state.storageBuffers);
+    for (uint32_t i = 0; i<state.storageBuffers; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = state.bufferStages;
+    }
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = state.storageBuffers;
+    setLayoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(native, &setLayoutInfo, HostAllocator(), &created.setLayout)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    VkPushConstantRange constantRange = {state.constantStages, 0, state.constantSize};
+    const VkDescriptorSetLayout setLayouts[] = {created.setLayout, table ? table->GetLayout() : VK_NULL_HANDLE};
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = table ? 2 : 1;
+    layoutInfo.pSetLayouts = setLayouts;
+    layoutInfo.pushConstantRangeCount = state.constantSize ? 1 : 0;
+    layoutInfo.pPushConstantRanges = &constantRange;
+    if (vkCreatePipelineLayout(native, &layoutInfo, HostAllocator(), &created.layout)!=VK_SUCCESS) {
+        vkDestroyDescriptorSetLayout(native, created.setLayout, HostAllocator());
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+    return layouts.emplace(key, created).first->second;
+}
+
+GraphicsPipeline* PipelineRegistry::Acquire(const GraphicsPipelineState& state, VkRenderPass renderPass) {
+    const auto normalized = Normalize(state);
+    const auto key = MakeKey(normalized);
+    std::lock_guard<std::mutex> lock(mutex);
+    ++requests;
+    auto& slot = pipelines[key];
+    if (slot) {
+        ++hits;
+        ++slot->references;
+        return slot.get();
+    }
+    try {
+        slot = std::make_unique<GraphicsPipeline>();
+        slot->pipeline = Create(normalized, renderPass);
+    }
+    catch (const std::exception&) {
+        pipelines.erase(key);
+        throw;
+    }
+    slot->layout = state.layout;
+    slot->references = 1;
+    ++created;
+    return slot.get();
+}
+
+void PipelineRegistry::Release(GraphicsPipeline* pipeline) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    --pipeline->references;
+}
+
+void PipelineRegistry::Bind(VkCommandBuffer commandBuffer, const GraphicsPipeline& pipeline,
+        VkPipeline& bound) noexcept {
+    if (bound==pipeline.pipeline) {
+        skippedBinds.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+    bound = pipeline.pipeline;
+    binds.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t PipelineRegistry::Trim() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t trimmed = 0;
+    for (auto i = pipelines.begin(); i!=pipelines.end();) {
+        if (i->second->references) {
+            ++i;
+            continue;
+        }
+        // Released pipelines may still be drawn with by frames in flight
+        DeferredDeletions.Enqueue([native = device.GetNative(), retired = i->second->pipeline]() {
+            vkDestroyPipeline(native, retired, HostAllocator());
+        });
+        ++trimmed;
+        i = pipelines.erase(i);
+    }
+    return trimmed;
+}
+
+PipelineRegistryStats PipelineRegistry::GetStats() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    PipelineRegistryStats stats = {};
+    stats.pipelines = pipelines.size();
+    for (const auto& pipeline : pipelines) {
+        if (pipeline.second->references)
+            ++stats.referencedPipelines;
+    }
+    stats.layouts = layouts.size();
+    stats.requests = requests;
+    stats.hits = hits;
+    stats.created = created;
+    stats.binds = binds.load(std::memory_order_relaxed);
+    stats.skippedBinds = skippedBinds.load(std::memory_order_relaxed);
+    return stats;
+}
+
+VkPipeline PipelineRegistry::Create(const GraphicsPipelineState& state, VkRenderPass renderPass) {
+    const VkPipelineShaderStageCreateInfo stages[] = {
+            state.vertex->CreateStageInfo(VK_SHADER_STAGE_VERTEX_BIT),
+            state.fragment->CreateStageInfo(VK_SHADER_STAGE_FRAGMENT_BIT)
+    };
+    VkPipelineVertexInputStateCreateInfo vertexInput = {};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = state.topology;
+    inputAssembly.primitiveRestartEnable = state.primitiveRestart ? VK_TRUE : VK_FALSE;
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = state.polygonMode;
+    rasterizer.cullMode = state.cullMode;
+    rasterizer.frontFace = state.frontFace;
+    rasterizer.lineWidth = 1.0f;
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = state.samples;
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &state.blend;
+
+    VkDynamicState dynamicStates[4] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    uint32_t dynamicCount = 2;
+    if (RasterizesLines(state))
+        dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_LINE_WIDTH;
+    if (UsesBlendConstants(state.blend))
+        dynamicStates[dynamicCount++] = VK_DYNAMIC_STATE_BLEND_CONSTANTS;
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = dynamicCount;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = stages;
+    pipelineInfo.pVertexInputState = &vertexInput;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = state.layout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = 0;
+    VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+    if (!renderPass) {
+        renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachmentFormats = &state.colorFormat;
+        pipelineInfo.pNext = &renderingInfo;
+    }
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(device.GetNative(), VK_NULL_HANDLE, 1, &pipelineInfo, HostAllocator(),
+            &pipeline)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+    return pipeline;
+}
+
+AK_PUBLIC void AK_CALL akDeviceGetPipelineStats(uint64_t handle, PipelineRegistryStats* stats) noexcept {
+    if (!stats)
+        return;
+    const auto device = DeviceHandles.Lookup(handle);
+    *stats = device ? device->GetPipelines().GetStats() : PipelineRegistryStats {};
+}
+
+AK_PUBLIC uint64_t AK_CALL akDeviceTrimPipelines(uint64_t handle) noexcept {
+    AK_TRACE(akDeviceTrimPipelines, handle);
+    const auto device = DeviceHandles.Lookup(handle);
+    return device ? device->GetPipelines().Trim() : 0;
+}
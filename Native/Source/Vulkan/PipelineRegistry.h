@@ -0,0 +1,124 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+class VulkanDevice;
+class ShaderModule;
+
+struct PipelineRegistryStats {
+    uint64_t pipelines;
+    uint64_t referencedPipelines;
+    uint64_t layouts;
+    // Every Acquire, hits returned an existing pipeline
+    uint64_t requests;
+    uint64_t hits;
+    uint64_t created;
+    uint64_t binds;
+    // Binds skipped because the pipeline was still bound in the command buffer
+    uint64_t skippedBinds;
+};
+
+// Set 0 holds storage buffers at bindings 0..storageBuffers-1, followed by a single push constant range. With
+// `textures` set 1 is the device's texture table, ignored when the device has none.
+struct PipelineLayoutState {
+    uint32_t storageBuffers;
+    VkShaderStageFlags bufferStages;
+    uint32_t constantSize;
+    VkShaderStageFlags constantStages;
+    bool textures;
+};
+
+struct PipelineLayout {
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+};
+
+// What a graphics pipeline bakes in. Viewport and scissor are always dynamic; line width and blend constants are
+// dynamic whenever they matter, so callers set them after binding. Render passes count only by their color format,
+// a pipeline works with every compatible pass.
+struct GraphicsPipelineState {
+    ShaderModule* vertex = nullptr;
+    ShaderModule* fragment = nullptr;
+    // From the registry, so equal layouts are the same handle
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    bool primitiveRestart = false;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+    VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkPipelineColorBlendAttachmentState blend = {};
+};
+
+class GraphicsPipeline {
+public:
+    VkPipeline GetNative() const noexcept { return pipeline; }
+    VkPipelineLayout GetLayout() const noexcept { return layout; }
+private:
+    friend class PipelineRegistry;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    uint32_t references = 0;
+};
+
+// Hash-consed pipelines and layouts of one device. States are normalized before hashing, so requests that only
+// differ in ignored fields share a pipeline. Unreferenced pipelines stay cached until Trim, layouts live as long as
+// the device.
+class PipelineRegistry {
+public:
+    explicit PipelineRegistry(VulkanDevice& device) noexcept : device(device) {}
+    ~PipelineRegistry();
+    PipelineRegistry(const PipelineRegistry&) = delete;
+    PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+    const PipelineLayout& GetLayout(const PipelineLayoutState& state);
+    // Returns the pipeline with one reference added, to be given back through Release. `renderPass` only has to be
+    // compatible with the color format, null for dynamic rendering.
+    GraphicsPipeline* Acquire(const GraphicsPipelineState& state, VkRenderPass renderPass);
+    void Release(GraphicsPipeline* pipeline) noexcept;
+    // Binds unless `bound` already is the pipeline, `bound` tracks one command buffer
+    void Bind(VkCommandBuffer commandBuffer, const GraphicsPipeline& pipeline, VkPipeline& bound) noexcept;
+    // Destroys every unreferenced pipeline once the frames using it retired, returns how many
+    size_t Trim() noexcept;
+    PipelineRegistryStats GetStats() noexcept;
+private:
+    // Normalized state, compared and hashed as raw bytes
+    struct Key {
+        uint64_t vertex;
+        uint64_t fragment;
+        uint64_t layout;
+        uint32_t values[16];
+
+        bool operator==(const Key& other) const noexcept;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const noexcept;
+    };
+
+    struct LayoutKey {
+        uint32_t values[5];
+
+        bool operator==(const LayoutKey& other) const noexcept;
+    };
+
+    struct LayoutKeyHash {
+        size_t operator()(const LayoutKey& key) const noexcept;
+    };
+
+    static GraphicsPipelineState Normalize(const GraphicsPipelineState& state) noexcept;
+    static Key MakeKey(const GraphicsPipelineState& state) noexcept;
+    VkPipeline Create(const GraphicsPipelineState& state, VkRenderPass renderPass);
+
+    VulkanDevice& device;
+    std::mutex mutex;
+    std::unordered_map<Key, std::unique_ptr<GraphicsPipeline>, KeyHash> pipelines;
+    std::unordered_map<LayoutKey, PipelineLayout, LayoutKeyHash> layouts;
+    uint64_t requests = 0, hits = 0, created = 0;
+    std::atomic<uint64_t> binds {0}, skippedBinds {0};
+};
@@ -0,0 +1,527 @@
+#include "Presenter.h"
+#include "Device.h"
+#include "Memory.h"
+#include "Swapchain.h"
+#include "Scene.h"
+#include "Capture.h"
+#include "TextureTable.h"
+#include "RenderPassCache.h"
+
+#include <limits>
+#include <algorithm>
+
+namespace {
+    // Compute results are read as vertex data, indirect arguments or from shaders
+    constexpr VkPipelineStageFlags QueueWaitStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+}
+
+Presenter::Presenter(VulkanDevice& device) : device(device) {
+    try {
+        for (auto& frame : frames)
+            CreateFrame(frame);
+    }
+    catch (const std::exception&) {
+        // Null handles of the frames that were not created are skipped
+        for (auto& frame : frames)
+            DestroyFrame(frame);
+        throw;
+    }
+    DeferredDeletions.AddTimeline(this);
+    device.GetApplication().AddWindowListener(this);
+    device.GetApplication().AddApplicationListener(this);
+}
+
+Presenter::~Presenter() {
+    device.GetApplication().RemoveApplicationListener(this);
+    device.GetApplication().RemoveWindowListener(this);
+    WaitIdle();
+    DeferredDeletions.RemoveTimeline(this);
+    for (auto& frame : frames)
+        DestroyFrame(frame);
+}
+
+void Presenter::CreateFrame(Frame& frame) {
+    const auto native = device.GetNative();
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = device.GetGraphicsFamily();
+    if (vkCreateCommandPool(native, &poolInfo, HostAllocator(), &frame.commandPool)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create command pool!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = frame.commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(native, &allocInfo, &frame.commandBuffer)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers!");
+    }
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    if (vkCreateSemaphore(native, &semaphoreInfo, HostAllocator(), &frame.renderFinished)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create synchronization objects for a frame!");
+    }
+}
+
+void Presenter::DestroyFrame(Frame& frame) noexcept {
+    const auto native = device.GetNative();
+    for (auto semaphore : frame.imageAvailable)
+        vkDestroySemaphore(native, semaphore, HostAllocator());
+    vkDestroySemaphore(native, frame.renderFinished, HostAllocator());
+    vkDestroyCommandPool(native, frame.commandPool, HostAllocator());
+}
+
+void Presenter::EnsureSemaphores(Frame& frame, size_t count) {
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    while (frame.imageAvailable.size()<count) {
+        VkSemaphore semaphore;
+        if (vkCreateSemaphore(device.GetNative(), &semaphoreInfo, HostAllocator(), &semaphore)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create synchronization objects for a frame!");
+        }
+        frame.imageAvailable.push_back(semaphore);
+    }
+}
+
+void Presenter::BeginRendering(VkCommandBuffer commandBuffer, const Swapchain& swapchain, uint32_t image,
+        const VkRect2D& area, bool full, const VkClearValue& clearColor) noexcept {
+    // Waits for the acquire at color output like the subpass dependency of the render passes
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.oldLayout = full ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = swapchain.GetImage(image);
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkRenderingAttachmentInfoKHR colorAttachment = {};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    colorAttachment.imageView = swapchain.GetImageView(image);
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = full ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearColor;
+    VkRenderingInfoKHR renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.renderArea = area;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    device.GetRenderPasses().BeginRendering(commandBuffer, renderingInfo);
+}
+
+void Presenter::EndRendering(VkCommandBuffer commandBuffer, const Swapchain& swapchain, uint32_t image) noexcept {
+    device.GetRenderPasses().EndRendering(commandBuffer);
+    // Captures and presents expect the final layout of the render passes
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = swapchain.GetImage(image);
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void Presenter::Attach(Swapchain* swapchain) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        attached.push_back(swapchain);
+    }
+    if (const auto renderThread = device.GetApplication().GetRenderThread())
+        renderThread->Wake();
+}
+
+void Presenter::Detach(Swapchain* swapchain) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    attached.erase(std::remove(attached.begin(), attached.end(), swapchain), attached.end());
+}
+
+void Presenter::OnWindowEvent(const SDL_WindowEvent& event) noexcept {
+    switch (event.event) {
+    case SDL_WINDOWEVENT_SIZE_CHANGED:
+    case SDL_WINDOWEVENT_EXPOSED:
+    case SDL_WINDOWEVENT_SHOWN:
+    case SDL_WINDOWEVENT_HIDDEN:
+    case SDL_WINDOWEVENT_MINIMIZED:
+    case SDL_WINDOWEVENT_MAXIMIZED:
+    case SDL_WINDOWEVENT_RESTORED:
+        break;
+    default:
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto swapchain : attached) {
+            if (swapchain->GetWindowID()!=event.windowID)
+                continue;
+            switch (event.event) {
+            case SDL_WINDOWEVENT_SIZE_CHANGED:
+                swapchain->NotifyResized();
+                break;
+            case SDL_WINDOWEVENT_HIDDEN:
+            case SDL_WINDOWEVENT_MINIMIZED:
+                swapchain->SetHidden(true);
+                break;
+            case SDL_WINDOWEVENT_SHOWN:
+            case SDL_WINDOWEVENT_MAXIMIZED:
+            case SDL_WINDOWEVENT_RESTORED:
+                swapchain->SetHidden(false);
+                swapchain->DamageAll();
+                break;
+            default:
+                swapchain->DamageAll();
+                break;
+            }
+        }
+    }
+    if (const auto renderThread = device.GetApplication().GetRenderThread())
+        renderThread->Wake();
+}
+
+void Presenter::OnApplicationEvent(uint32_t type) noexcept {
+    switch (type) {
+    case SDL_APP_LOWMEMORY:
+        device.Trim();
+        return;
+    // Mobile systems may kill applications that keep submitting once they were told to go to the background
+    case SDL_APP_WILLENTERBACKGROUND:
+    case SDL_APP_DIDENTERBACKGROUND:
+        background.store(true, std::memory_order_release);
+        return;
+    case SDL_APP_DIDENTERFOREGROUND:
+        background.store(false, std::memory_order_release);
+        break;
+    default:
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto swapchain : attached)
+            swapchain->DamageAll();
+    }
+    if (const auto renderThread = device.GetApplication().GetRenderThread())
+        renderThread->Wake();
+}
+
+void Presenter::UpdateSwapchain(Swapchain* swapchain, VkResult result) noexcept {
+    swapchain->SetPresentResult(result);
+    if (result==VK_ERROR_OUT_OF_DATE_KHR)
+        swapchain->Invalidate();
+    else if (result==VK_SUBOPTIMAL_KHR)
+        swapchain->NotifyResized();
+}
+
+// The images acquired for a frame that was never submitted can not be presented, and nothing waits on their acquire
+// semaphores anymore. The swapchains are recreated, which releases the images, and the semaphores are replaced.
+void Presenter::DropAcquired(Frame& frame, VkResult result) noexcept {
+    for (auto swapchain : acquired) {
+        swapchain->SetPresentResult(result);
+        swapchain->Invalidate();
+        // The damage was taken while recording
+        swapchain->DamageAll();
+    }
+    // EnsureSemaphores creates fresh ones for the next frame that uses this slot
+    auto& available = frame.imageAvailable;
+    available.erase(std::remove_if(available.begin(), available.end(), [this](VkSemaphore semaphore) noexcept {
+        return std::find(waitSemaphores.begin(), waitSemaphores.end(), semaphore)!=waitSemaphores.end();
+    }), available.end());
+    const auto native = device.GetNative();
+    auto signaled = waitSemaphores;
+    DeferredDeletions.Enqueue([native, signaled]() {
+        for (auto semaphore : signaled)
+            vkDestroySemaphore(native, semaphore, HostAllocator());
+    });
+    acquired.clear();
+    if (const auto renderThread = device.GetApplication().GetRenderThread())
+        renderThread->Wake();
+}
+
+void Presenter::SetRenderOnDemand(bool enable) noexcept {
+    renderOnDemand.store(enable, std::memory_order_relaxed);
+    if (const auto renderThread = device.GetApplication().GetRenderThread())
+        renderThread->Wake();
+}
+
+void Presenter::WaitQueue(DeviceQueue& queue, uint64_t value) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& wait : queueWaits) {
+        if (wait.queue==&queue) {
+            wait.value = std::max(wait.value, value);
+            return;
+        }
+    }
+    queueWaits.push_back({&queue, value, QueueWaitStages});
+}
+
+bool Presenter::HasWork() noexcept {
+    // Paused until the foreground event or a window showing up wakes the render thread again
+    if (background.load(std::memory_order_acquire))
+        return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto onDemand = renderOnDemand.load(std::memory_order_relaxed);
+    auto visible = false, damaged = false;
+    auto due = Swapchain::Clock::time_point::max();
+    for (auto swapchain : attached) {
+        if (swapchain->IsHidden())
+            continue;
+        if (!onDemand)
+            return true;
+        visible = true;
+        damaged = damaged || swapchain->HasDamage();
+        due = std::min(due, swapchain->ResizeDue());
+    }
+    if (!visible)
+        return false;
+    if (due<=Swapchain::Clock::now())
+        return true;
+    // Nothing to draw yet, but a debounced resize has to be picked up once it settles
+    if (due!=Swapchain::Clock::time_point::max()) {
+        if (const auto renderThread = device.GetApplication().GetRenderThread())
+            renderThread->WakeAt(due);
+    }
+    return damaged;
+}
+
+void Presenter::WaitIdle() noexcept {
+    uint64_t submitted = 0;
+    for (const auto& frame : frames)
+        submitted = std::max(submitted, frame.submitted);
+    device.GetGraphicsQueue().Wait(submitted, std::numeric_limits<uint64_t>::max());
+    RetireIdle();
+}
+
+// Only while no frame is recorded. Once every submitted frame completed, whatever waits for the next one is not
+// referenced by the GPU either; that value is used up so the next frame takes a fresh one.
+void Presenter::RetireIdle() noexcept {
+    auto& queue = device.GetGraphicsQueue();
+    for (const auto& frame : frames) {
+        if (queue.IsComplete(frame.submitted))
+            continue;
+        if (DeferredDeletions.Pending()) {
+            if (const auto renderThread = device.GetApplication().GetRenderThread())
+                renderThread->WakeAt(RenderClock::now()+RetirePollInterval);
+        }
+        return;
+    }
+    DeferredDeletions.Retire(this, ++frameValue);
+}
+
+// Copies of earlier frames are handed out as soon as their submit completed, without waiting for it
+void Presenter::PollCaptures() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        active = attached;
+    }
+    auto inFlight = false;
+    for (auto swapchain : active) {
+        if (const auto capture = swapchain->GetCapture())
+            inFlight = capture->Poll() || inFlight;
+    }
+    // An idle presenter still has to come back for them
+    if (inFlight) {
+        if (const auto renderThread = device.GetApplication().GetRenderThread())
+            renderThread->WakeAt(RenderClock::now()+CapturePollInterval);
+    }
+}
+
+bool Presenter::BeginFrame(const InputState&) noexcept {
+    auto& frame = frames[currentFrame];
+    device.GetAllocator().Poll();
+    PollCaptures();
+    if (!HasWork()) {
+        RetireIdle();
+        return false;
+    }
+    device.GetGraphicsQueue().Wait(frame.submitted, std::numeric_limits<uint64_t>::max());
+    DeferredDeletions.Retire(this, frame.value);
+    // Swapchains detached from here on are released only after the next submitted frame retires
+    DeferredDeletions.BeginFrame(this, frameValue+1);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        active = attached;
+    }
+
+    try {
+        EnsureSemaphores(frame, active.size());
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+    acquired.clear();
+    imageIndices.clear();
+    waitSemaphores.clear();
+    const auto onDemand = renderOnDemand.load(std::memory_order_relaxed);
+    for (size_t i = 0; i<active.size(); ++i) {
+        const auto swapchain = active[i];
+        if (!swapchain->Refresh())
+            continue;
+        if (!onDemand)
+            swapchain->DamageAll();
+        else if (!swapchain->HasDamage())
+            continue;
+        uint32_t imageIndex;
+        const auto result = vkAcquireNextImageKHR(device.GetNative(), swapchain->GetNative(),
+                std::numeric_limits<uint64_t>::max(), frame.imageAvailable[i], VK_NULL_HANDLE, &imageIndex);
+        if (result==VK_SUCCESS || result==VK_SUBOPTIMAL_KHR) {
+            acquired.push_back(swapchain);
+            imageIndices.push_back(imageIndex);
+            waitSemaphores.push_back(frame.imageAvailable[i]);
+        }
+        if (result!=VK_SUCCESS)
+            UpdateSwapchain(swapchain, result);
+    }
+    if (acquired.empty()) {
+        RetireIdle();
+        return false;
+    }
+    return true;
+}
+
+void Presenter::RecordFrame(const InputState&) noexcept {
+    auto& frame = frames[currentFrame];
+    vkResetCommandPool(device.GetNative(), frame.commandPool, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(frame.commandBuffer, &beginInfo);
+
+    presentRects.clear();
+    presentRectCounts.clear();
+    captures.clear();
+    // Pipeline bindings carry over between render passes of one command buffer
+    VkPipeline bound = VK_NULL_HANDLE;
+    // Every scene of the frame draws from the same texture table set
+    const auto table = device.GetTextureTable();
+    const auto textures = table ? table->Prepare(frame.commandBuffer, currentFrame) : VK_NULL_HANDLE;
+    const auto dynamicRendering = device.GetRenderPasses().UsesDynamicRendering();
+    for (size_t i = 0; i<acquired.size(); ++i) {
+        const auto swapchain = acquired[i];
+        VkRect2D area;
+        const auto rectCount = presentRects.size();
+        const auto full = swapchain->TakeDamage(imageIndices[i], area, presentRects);
+        presentRectCounts.push_back(static_cast<uint32_t>(presentRects.size()-rectCount));
+        // Copies have to be recorded before the render pass begins
+        const auto scene = swapchain->GetScene();
+        if (scene)
+            scene->Upload(frame.commandBuffer, currentFrame);
+
+        VkClearValue clearColor = {};
+        clearColor.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        if (dynamicRendering) {
+            BeginRendering(frame.commandBuffer, *swapchain, imageIndices[i], area, full, clearColor);
+        }
+        else {
+            VkRenderPassBeginInfo renderPassInfo = {};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = swapchain->GetRenderPass(!full);
+            renderPassInfo.framebuffer = swapchain->GetFramebuffer(imageIndices[i]);
+            renderPassInfo.renderArea = area;
+            renderPassInfo.clearValueCount = 1;
+            renderPassInfo.pClearValues = &clearColor;
+            vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        }
+        // Everything drawn for this swapchain is clipped to the damaged area
+        vkCmdSetScissor(frame.commandBuffer, 0, 1, &area);
+        if (!full) {
+            // The load pass keeps the old content, repaint the background of the damaged area first
+            VkClearAttachment clearAttachment = {};
+            clearAttachment.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            clearAttachment.colorAttachment = 0;
+            clearAttachment.clearValue = clearColor;
+            VkClearRect clearRect = {area, 0, 1};
+            vkCmdClearAttachments(frame.commandBuffer, 1, &clearAttachment, 1, &clearRect);
+        }
+        if (scene) {
+            scene->Draw(frame.commandBuffer, swapchain->GetRenderPass(false), swapchain->GetFormat(),
+                    swapchain->GetExtent(), textures, bound);
+        }
+        if (dynamicRendering)
+            EndRendering(frame.commandBuffer, *swapchain, imageIndices[i]);
+        else
+            vkCmdEndRenderPass(frame.commandBuffer);
+        const auto capture = swapchain->GetCapture();
+        if (capture && swapchain->CanCapture()) {
+            capture->Record(frame.commandBuffer, swapchain->GetImage(imageIndices[i]), swapchain->GetFormat(),
+                    swapchain->GetExtent());
+            captures.push_back(capture);
+        }
+    }
+
+    vkEndCommandBuffer(frame.commandBuffer);
+}
+
+void Presenter::PresentFrame() noexcept {
+    auto& frame = frames[currentFrame];
+    currentFrame = (currentFrame+1)%FramesInFlight;
+
+    waitStages.assign(waitSemaphores.size(), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingWaits.swap(queueWaits);
+        queueWaits.clear();
+    }
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frame.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &frame.renderFinished;
+
+    const auto submitResult = device.GetGraphicsQueue().Submit(submitInfo, frame.submitted, pendingWaits.data(),
+            static_cast<uint32_t>(pendingWaits.size()));
+    for (auto capture : captures)
+        capture->Resolve(submitResult==VK_SUCCESS ? frame.submitted : 0);
+    // Without a submit the value stays with the next frame
+    if (submitResult!=VK_SUCCESS) {
+        DropAcquired(frame, submitResult);
+        return;
+    }
+    frame.value = ++frameValue;
+
+    presentSwapchains.clear();
+    for (auto swapchain : acquired)
+        presentSwapchains.push_back(swapchain->GetNative());
+    results.assign(acquired.size(), VK_SUCCESS);
+
+    VkPresentInfoKHR presentInfo = {};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &frame.renderFinished;
+    presentInfo.swapchainCount = static_cast<uint32_t>(presentSwapchains.size());
+    presentInfo.pSwapchains = presentSwapchains.data();
+    presentInfo.pImageIndices = imageIndices.data();
+    presentInfo.pResults = results.data();
+
+    // Tells the compositor which parts of each image changed, so it can skip copying the rest
+    VkPresentRegionsKHR regions = {};
+    if (device.SupportsIncrementalPresent()) {
+        presentRegions.clear();
+        for (size_t i = 0, offset = 0; i<acquired.size(); offset += presentRectCounts[i++])
+            presentRegions.push_back({presentRectCounts[i], presentRects.data()+offset});
+        regions.sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR;
+        regions.swapchainCount = presentInfo.swapchainCount;
+        regions.pRegions = presentRegions.data();
+        presentInfo.pNext = &regions;
+    }
+    device.GetGraphicsQueue().Present(&presentInfo);
+
+    for (size_t i = 0; i<acquired.size(); ++i)
+        UpdateSwapchain(acquired[i], results[i]);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include "../RenderThread.h"
+#include "Device.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+class Swapchain;
+class Capture;
+
+// Renders every attached swapchain as one frame: a single submit waits on all image acquires, and a single
+// vkQueuePresentKHR lists every swapchain. The per-swapchain results are stored back on each swapchain.
+// In render-on-demand mode only swapchains with damage are acquired, and an idle frame does no GPU work at all.
+// Nothing is rendered while the application is in the background, nor to hidden or minimized windows. Low memory
+// events trim the device.
+class Presenter : public FrameHandler, public WindowListener, public ApplicationListener {
+public:
+    static constexpr uint32_t FramesInFlight = 2;
+    // How often an idle presenter looks for finished captures
+    static constexpr auto CapturePollInterval = std::chrono::milliseconds(2);
+    // How often an idle presenter checks whether its last frames retired while releases wait for them
+    static constexpr auto RetirePollInterval = std::chrono::milliseconds(2);
+    explicit Presenter(VulkanDevice& device);
+    ~Presenter() override;
+    void Attach(Swapchain* swapchain);
+    void Detach(Swapchain* swapchain) noexcept;
+    // Waits for every frame in flight and retires them, used when the presenter stops being driven
+    void WaitIdle() noexcept;
+    // Continuous mode redraws every swapchain in full each frame, on demand only the damaged areas are redrawn
+    void SetRenderOnDemand(bool enable) noexcept;
+    bool GetRenderOnDemand() const noexcept { return renderOnDemand.load(std::memory_order_relaxed); }
+    // The next submitted frame waits until `queue` completed `value` before its shaders run
+    void WaitQueue(DeviceQueue& queue, uint64_t value) noexcept;
+    bool BeginFrame(const InputState& input) noexcept override;
+    void RecordFrame(const InputState& input) noexcept override;
+    void PresentFrame() noexcept override;
+    void OnWindowEvent(const SDL_WindowEvent& event) noexcept override;
+    void OnApplicationEvent(uint32_t type) noexcept override;
+private:
+    struct Frame {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkSemaphore renderFinished = VK_NULL_HANDLE;
+        std::vector<VkSemaphore> imageAvailable;
+        // Deletion queue value of its last submitted frame
+        uint64_t value = 0;
+        // Graphics queue value of its last submit
+        uint64_t submitted = 0;
+    };
+
+    void CreateFrame(Frame& frame);
+    void DestroyFrame(Frame& frame) noexcept;
+    void EnsureSemaphores(Frame& frame, size_t count);
+    // Stand-ins for the swapchain's render passes, including the layout transitions they make
+    void BeginRendering(VkCommandBuffer commandBuffer, const Swapchain& swapchain, uint32_t image,
+            const VkRect2D& area, bool full, const VkClearValue& clearColor) noexcept;
+    void EndRendering(VkCommandBuffer commandBuffer, const Swapchain& swapchain, uint32_t image) noexcept;
+    static void UpdateSwapchain(Swapchain* swapchain, VkResult result) noexcept;
+    void DropAcquired(Frame& frame, VkResult result) noexcept;
+    bool HasWork() noexcept;
+    void PollCaptures() noexcept;
+    void RetireIdle() noexcept;
+
+    VulkanDevice& device;
+    std::array<Frame, FramesInFlight> frames;
+    uint32_t currentFrame = 0;
+    // Value of the last submitted frame, the frame being recorded takes the next one once it is submitted
+    uint64_t frameValue = 0;
+    std::mutex mutex;
+    std::vector<Swapchain*> attached;
+    std::vector<Swapchain*> active;
+    std::vector<QueueWait> queueWaits;
+    std::atomic_bool renderOnDemand {false}, background {false};
+    // State of the frame being recorded, kept around to avoid per-frame allocations
+    std::vector<Swapchain*> acquired;
+    std::vector<Capture*> captures;
+    std::vector<VkSwapchainKHR> presentSwapchains;
+    std::vector<uint32_t> imageIndices;
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    std::vector<QueueWait> pendingWaits;
+    std::vector<VkResult> results;
+    std::vector<VkRectLayerKHR> presentRects;
+    std::vector<uint32_t> presentRectCounts;
+    std::vector<VkPresentRegionKHR> presentRegions;
+};
@@ -0,0 +1,229 @@
+#include "RenderPassCache.h"
+#include "Device.h"
+#include "../DeletionQueue.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) noexcept {
+        const auto bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i<size; ++i)
+            hash = (hash ^ bytes[i])*1099511628211ull;
+        return hash;
+    }
+
+    // Non-dispatchable handles are pointers or 64 bit integers depending on the platform
+    uint64_t HandleBits(VkImageView handle) noexcept {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &handle, sizeof(handle));
+        return bits;
+    }
+}
+
+size_t RenderPassCache::PassHash::operator()(const RenderPassKey& key) const noexcept {
+    return static_cast<size_t>(HashBytes(&key, sizeof(key)));
+}
+
+bool RenderPassCache::PassEqual::operator()(const RenderPassKey& a, const RenderPassKey& b) const noexcept {
+    return std::memcmp(&a, &b, sizeof(RenderPassKey))==0;
+}
+
+bool RenderPassCache::FramebufferKey::operator==(const FramebufferKey& other) const noexcept {
+    return count==other.count && width==other.width && height==other.height &&
+            std::equal(views, views+count, other.views);
+}
+
+size_t RenderPassCache::FramebufferHash::operator()(const FramebufferKey& key) const noexcept {
+    const uint32_t size[] = {key.count, key.width, key.height};
+    return static_cast<size_t>(HashBytes(key.views, key.count*sizeof(uint64_t), HashBytes(size, sizeof(size))));
+}
+
+RenderPassCache::RenderPassCache(VulkanDevice& device) noexcept : device(device) {
+    if (!device.GetFeatures().dynamicRendering)
+        return;
+    const auto core = device.GetApiVersion()>=VK_API_VERSION_1_3;
+    const auto begin = (PFN_vkCmdBeginRenderingKHR) vkGetDeviceProcAddr(device.GetNative(),
+            core ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR");
+    const auto end = (PFN_vkCmdEndRenderingKHR) vkGetDeviceProcAddr(device.GetNative(),
+            core ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR");
+    // Falls back to render passes rather than failing
+    if (begin && end) {
+        beginRendering = begin;
+        endRendering = end;
+    }
+}
+
+RenderPassCache::~RenderPassCache() {
+    const auto native = device.GetNative();
+    for (const auto& framebuffer : framebuffers)
+        vkDestroyFramebuffer(native, framebuffer.second.framebuffer, HostAllocator());
+    for (const auto& renderPass : renderPasses)
+        vkDestroyRenderPass(native, renderPass.second, HostAllocator());
+}
+
+VkRenderPass RenderPassCache::GetRenderPass(const RenderPassKey& key) {
+    if (!key.colorCount || key.colorCount>RenderPassKey::MaxAttachments) {
+        throw std::runtime_error("render pass attachment count exceeds the supported limits!");
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ++requests;
+    const auto found = renderPasses.find(key);
+    if (found!=renderPasses.end()) {
+        ++hits;
+        return found->second;
+    }
+
+    VkAttachmentDescription attachments[RenderPassKey::MaxAttachments] = {};
+    VkAttachmentReference references[RenderPassKey::MaxAttachments] = {};
+    for (uint32_t i = 0; i<key.colorCount; ++i) {
+        const auto& color = key.colors[i];
+        attachments[i].format = color.format;
+        attachments[i].samples = color.samples;
+        attachments[i].loadOp = color.loadOp;
+        attachments[i].storeOp = color.storeOp;
+        attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[i].initialLayout = color.initialLayout;
+        attachments[i].finalLayout = color.finalLayout;
+        references[i].attachment = i;
+        references[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = key.colorCount;
+    subpass.pColorAttachments = references;
+
+    // Waits for whatever was signalled at color output before, swapchain acquires included
+    VkSubpassDependency dependency = {};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = 0;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = key.colorCount;
+    renderPassInfo.pAttachments = attachments;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(device.GetNative(), &renderPassInfo, HostAllocator(), &renderPass)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
+    renderPasses.emplace(key, renderPass);
+    return renderPass;
+}
+
+VkFramebuffer RenderPassCache::AcquireFramebuffer(VkRenderPass renderPass, const VkImageView* views,
+        uint32_t count, VkExtent2D extent) {
+    if (!count || count>RenderPassKey::MaxAttachments) {
+        throw std::runtime_error("framebuffer attachment count exceeds the supported limits!");
+    }
+    FramebufferKey key = {};
+    for (uint32_t i = 0; i<count; ++i)
+        key.views[i] = HandleBits(views[i]);
+    key.count = count;
+    key.width = extent.width;
+    key.height = extent.height;
+    std::lock_guard<std::mutex> lock(mutex);
+    ++requests;
+    const auto found = framebuffers.find(key);
+    if (found!=framebuffers.end()) {
+        ++hits;
+        ++found->second.references;
+        return found->second.framebuffer;
+    }
+
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = renderPass;
+    framebufferInfo.attachmentCount = count;
+    framebufferInfo.pAttachments = views;
+    framebufferInfo.width = extent.width;
+    framebufferInfo.height = extent.height;
+    framebufferInfo.layers = 1;
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(device.GetNative(), &framebufferInfo, HostAllocator(), &framebuffer)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer!");
+    }
+    framebuffers.emplace(key, Framebuffer {framebuffer, 1});
+    return framebuffer;
+}
+
+void RenderPassCache::ReleaseFramebuffer(VkFramebuffer framebuffer) noexcept {
+    if (!framebuffer)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    // A handful of entries, one per swapchain image and offscreen target
+    for (auto& entry : framebuffers) {
+        if (entry.second.framebuffer==framebuffer) {
+            --entry.second.references;
+            return;
+        }
+    }
+}
+
+void RenderPassCache::Evict(VkImageView view) noexcept {
+    const auto bits = HandleBits(view);
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto i = framebuffers.begin(); i!=framebuffers.end();) {
+        const auto& key = i->first;
+        if (std::find(key.views, key.views+key.count, bits)==key.views+key.count) {
+            ++i;
+            continue;
+        }
+        Retire(i->second.framebuffer);
+        i = framebuffers.erase(i);
+    }
+}
+
+size_t RenderPassCache::Trim() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t trimmed = 0;
+    for (auto i = framebuffers.begin(); i!=framebuffers.end();) {
+        if (i->second.references) {
+            ++i;
+            continue;
+        }
+        Retire(i->second.framebuffer);
+        ++trimmed;
+        i = framebuffers.erase(i);
+    }
+    return trimmed;
+}
+
+RenderPassCacheStats RenderPassCache::GetStats() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    RenderPassCacheStats stats = {};
+    stats.renderPasses = renderPasses.size();
+    stats.framebuffers = framebuffers.size();
+    for (const auto& framebuffer : framebuffers) {
+        if (framebuffer.second.references)
+            ++stats.referencedFramebuffers;
+    }
+    stats.requests = requests;
+    stats.hits = hits;
+    stats.evictions = evictions;
+    return stats;
+}
+
+// Frames in flight may still render into it
+void RenderPassCache::Retire(VkFramebuffer framebuffer) noexcept {
+    DeferredDeletions.Enqueue([native = device.GetNative(), framebuffer]() {
+        vkDestroyFramebuffer(native, framebuffer, HostAllocator());
+    });
+    ++evictions;
+}
+
+AK_PUBLIC void AK_CALL akDeviceGetRenderPassStats(uint64_t handle, RenderPassCacheStats* stats) noexcept {
+    if (!stats)
+        return;
+    const auto device = DeviceHandles.Lookup(handle);
+    *stats = device ? device->GetRenderPasses().GetStats() : RenderPassCacheStats {};
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include <mutex>
+#include <unordered_map>
+
+class VulkanDevice;
+
+struct RenderPassCacheStats {
+    uint64_t renderPasses;
+    uint64_t framebuffers;
+    uint64_t referencedFramebuffers;
+    // Every GetRenderPass and AcquireFramebuffer, hits returned a cached object
+    uint64_t requests;
+    uint64_t hits;
+    // Framebuffers dropped because one of their views went away or the cache was trimmed
+    uint64_t evictions;
+};
+
+struct RenderPassAttachment {
+    VkFormat format;
+    VkSampleCountFlagBits samples;
+    VkAttachmentLoadOp loadOp;
+    VkAttachmentStoreOp storeOp;
+    VkImageLayout initialLayout;
+    VkImageLayout finalLayout;
+};
+
+// Color attachments of a single subpass pass. Compared as raw bytes, so start from a zeroed key.
+struct RenderPassKey {
+    static constexpr uint32_t MaxAttachments = 4;
+
+    uint32_t colorCount;
+    RenderPassAttachment colors[MaxAttachments];
+};
+
+// Render passes and framebuffers of one device, created on first use and shared by everything drawing with the same
+// signature. Render passes are tiny and live as long as the device. Framebuffers are keyed by their views and
+// extent and counted like the other registries, unreferenced ones stay cached until Trim. Whoever destroys a view
+// evicts it first, and the framebuffers using it go through the deletion queue.
+//
+// With dynamic rendering neither is needed: targets begin with vkCmdBeginRendering and pipelines are created
+// against their color format.
+class RenderPassCache {
+public:
+    explicit RenderPassCache(VulkanDevice& device) noexcept;
+    ~RenderPassCache();
+    RenderPassCache(const RenderPassCache&) = delete;
+    RenderPassCache& operator=(const RenderPassCache&) = delete;
+    bool UsesDynamicRendering() const noexcept { return beginRendering!=nullptr; }
+    VkRenderPass GetRenderPass(const RenderPassKey& key);
+    // Adds a reference to be given back through ReleaseFramebuffer. `renderPass` only has to be compatible, one
+    // framebuffer serves every pass compatible with it.
+    VkFramebuffer AcquireFramebuffer(VkRenderPass renderPass, const VkImageView* views, uint32_t count,
+            VkExtent2D extent);
+    void ReleaseFramebuffer(VkFramebuffer framebuffer) noexcept;
+    // Drops the framebuffers using `view` whether referenced or not
+    void Evict(VkImageView view) noexcept;
+    // Drops every unreferenced framebuffer once the frames using it retired, returns how many
+    size_t Trim() noexcept;
+    // Only valid with dynamic rendering
+    void BeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR& info) const noexcept {
+        beginRendering(commandBuffer, &info);
+    }
+    void EndRendering(VkCommandBuffer commandBuffer) const noexcept { endRendering(commandBuffer); }
+    RenderPassCacheStats GetStats() noexcept;
+private:
+    struct PassHash {
+        size_t operator()(const RenderPassKey& key) const noexcept;
+    };
+
+    struct PassEqual {
+        bool operator()(const RenderPassKey& a, const RenderPassKey& b) const noexcept;
+    };
+
+    struct FramebufferKey {
+        uint64_t views[RenderPassKey::MaxAttachments];
+        uint32_t count;
+        uint32_t width;
+        uint32_t height;
+
+        bool operator==(const FramebufferKey& other) const noexcept;
+    };
+
+    struct FramebufferHash {
+        size_t operator()(const FramebufferKey& key) const noexcept;
+    };
+
+    struct Framebuffer {
+        VkFramebuffer framebuffer;
+        uint32_t references;
+    };
+
+    void Retire(VkFramebuffer framebuffer) noexcept;
+
+    VulkanDevice& device;
+    PFN_vkCmdBeginRenderingKHR beginRendering = nullptr;
+    PFN_vkCmdEndRenderingKHR endRendering = nullptr;
+    std::mutex mutex;
+    std::unordered_map<RenderPassKey, VkRenderPass, PassHash, PassEqual> renderPasses;
+    std::unordered_map<FramebufferKey, Framebuffer, FramebufferHash> framebuffers;
+    uint64_t requests = 0, hits = 0, evictions = 0;
+};
@@ -0,0 +1,552 @@
+#include "Scene.h"
+#include "Device.h"
+#include "Swapchain.h"
+#include "ShaderRegistry.h"
+#include "PipelineRegistry.h"
+#include "../RenderThread.h"
+#include "../Trace.h"
+
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+HandleTable<Scene*, HandleType::Scene> SceneHandles;
+
+Scene::Scene(VulkanDevice& device, uint64_t displayContext, ShaderModule* vertex, ShaderModule* fragment,
+        uint32_t instanceSize)
+        :device(device), displayContext(displayContext), vertex(vertex), fragment(fragment),
+        instanceSize(instanceSize) {
+    try {
+        if (!instanceSize || instanceSize>MaxInstanceSize || instanceSize%4) {
+            throw std::runtime_error("scene instance size exceeds the supported limits!");
+        }
+        // Every scene has the same layout, so scenes with the same shaders share their pipeline
+        const auto& shared = device.GetPipelines().GetLayout({1, VK_SHADER_STAGE_VERTEX_BIT |
+                VK_SHADER_STAGE_FRAGMENT_BIT, 2*sizeof(float), VK_SHADER_STAGE_VERTEX_BIT, true});
+        setLayout = shared.setLayout;
+        layout = shared.layout;
+    }
+    catch (const std::exception&) {
+        device.GetShaders().Release(vertex);
+        device.GetShaders().Release(fragment);
+        throw;
+    }
+}
+
+// Deleted through the deletion queue, the frames that drew the scene have retired
+Scene::~Scene() {
+    const auto native = device.GetNative();
+    Release(storage);
+    for (auto& frame : staging) {
+        vkDestroyBuffer(native, frame.buffer, HostAllocator());
+        if (frame.buffer)
+            device.GetAllocator().Free(frame.memory);
+    }
+    if (pipeline)
+        device.GetPipelines().Release(pipeline);
+    device.GetShaders().Release(vertex);
+    device.GetShaders().Release(fragment);
+}
+
+void Scene::CreateNodes(const void* data, uint32_t count, uint32_t* created) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto source = static_cast<const uint8_t*>(data);
+    for (uint32_t i = 0; i<count; ++i) {
+        uint32_t slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else {
+            slot = static_cast<uint32_t>(live.size());
+            bounds.emplace_back();
+            bounded.push_back(false);
+            live.push_back(false);
+            shadow.resize(shadow.size()+instanceSize);
+        }
+        live[slot] = true;
+        bounded[slot] = false;
+        const VkDeviceSize offset = VkDeviceSize(slot)*instanceSize;
+        std::memcpy(shadow.data()+offset, source+VkDeviceSize(i)*instanceSize, instanceSize);
+        MarkDirty(offset, offset+instanceSize);
+        created[i] = slot;
+        ++nodes;
+    }
+    Damage(nullptr, 0);
+}
+
+bool Scene::UpdateNode(uint32_t node, uint32_t offset, const void* data, uint32_t size) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (node>=live.size() || !live[node] || offset>instanceSize || size>instanceSize-offset)
+        return false;
+    const auto begin = VkDeviceSize(node)*instanceSize+offset;
+    // Unchanged bytes are not worth a copy, setters called with the current value are common in UI code
+    if (!size || std::memcmp(shadow.data()+begin, data, size)==0)
+        return true;
+    std::memcpy(shadow.data()+begin, data, size);
+    try {
+        MarkDirty(begin, begin+size);
+    }
+    catch (const std::bad_alloc&) {
+        return false;
+    }
+    Damage(bounded[node] ? &bounds[node] : nullptr, 1);
+    return true;
+}
+
+void Scene::DestroyNodes(const uint32_t* destroyed, uint32_t count) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    destroyedBounds.clear();
+    auto changed = false, full = false;
+    for (uint32_t i = 0; i<count; ++i) {
+        const auto slot = destroyed[i];
+        if (slot>=live.size() || !live[slot])
+            continue;
+        live[slot] = false;
+        changed = true;
+        try {
+            if (bounded[slot])
+                destroyedBounds.push_back(bounds[slot]);
+            else
+                full = true;
+        }
+        catch (const std::bad_alloc&) {
+            full = true;
+        }
+        const auto offset = VkDeviceSize(slot)*instanceSize;
+        std::memset(shadow.data()+offset, 0, instanceSize);
+        try {
+            MarkDirty(offset, offset+instanceSize);
+            freeSlots.push_back(slot);
+        }
+        catch (const std::bad_alloc&) {
+            // Leaked rather than handed out again while the GPU copy may still hold the old instance
+        }
+        --nodes;
+    }
+    if (changed)
+        Damage(full ? nullptr : destroyedBounds.data(), static_cast<uint32_t>(destroyedBounds.size()));
+}
+
+bool Scene::SetNodeBounds(uint32_t node, const VkRect2D& rect) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (node>=live.size() || !live[node])
+        return false;
+    const VkRect2D changed[] = {bounds[node], rect};
+    const auto old = bounded[node];
+    bounds[node] = rect;
+    bounded[node] = true;
+    Damage(old ? changed : changed+1, old ? 2 : 1);
+    return true;
+}
+
+SceneStats Scene::GetStats() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    SceneStats stats = {};
+    stats.nodes = nodes;
+    stats.slots = live.size();
+    stats.capacity = storage.capacity;
+    stats.dirtyRanges = dirty.size();
+    stats.uploads = uploads;
+    stats.uploadedBytes = uploadedBytes;
+    stats.lastUploadedBytes = lastUploadedBytes;
+    stats.frames = frames;
+    return stats;
+}
+
+// Keeps the ranges sorted and apart by more than MergeGap
+void Scene::MarkDirty(VkDeviceSize begin, VkDeviceSize end) {
+    auto it = std::lower_bound(dirty.begin(), dirty.end(), begin,
+            [](const Range& range, VkDeviceSize value) noexcept { return range.end+MergeGap<value; });
+    if (it==dirty.end() || it->begin>end+MergeGap) {
+        dirty.insert(it, {begin, end});
+    }
+    else {
+        it->begin = std::min(it->begin, begin);
+        it->end = std::max(it->end, end);
+        auto next = it+1;
+        for (; next!=dirty.end() && next->begin<=it->end+MergeGap; ++next)
+            it->end = std::max(it->end, next->end);
+        dirty.erase(it+1, next);
+    }
+    if (dirty.size()<=MaxDirtyRanges)
+        return;
+    // Too scattered, fold the closest pair
+    size_t closest = 0;
+    for (size_t i = 1; i+1<dirty.size(); ++i) {
+        if (dirty[i+1].begin-dirty[i].end<dirty[closest+1].begin-dirty[closest].end)
+            closest = i;
+    }
+    dirty[closest].end = dirty[closest+1].end;
+    dirty.erase(dirty.begin()+closest+1);
+}
+
+void Scene::Upload(VkCommandBuffer commandBuffer, uint32_t frame) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++frames;
+    lastUploadedBytes = 0;
+    drawCount = static_cast<uint32_t>(live.size());
+    try {
+        if (storage.capacity<drawCount) {
+            Grow(drawCount);
+            // The new buffer starts out empty, everything up to the last used slot goes up once
+            dirty.assign(1, {0, VkDeviceSize(drawCount)*instanceSize});
+        }
+        if (dirty.empty())
+            return;
+        VkDeviceSize total = 0;
+        for (const auto& range : dirty)
+            total += range.end-range.begin;
+        auto& target = staging[frame];
+        EnsureStaging(target, total);
+
+        regions.clear();
+        VkDeviceSize offset = 0;
+        for (const auto& range : dirty) {
+            const auto size = range.end-range.begin;
+            std::memcpy(static_cast<uint8_t*>(target.memory.mapped)+offset, shadow.data()+range.begin, size);
+            regions.push_back({offset, range.begin, size});
+            offset += size;
+        }
+
+        // Frames in flight may still draw from the ranges about to be overwritten
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = storage.buffer;
+        barrier.size = VK_WHOLE_SIZE;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+        vkCmdCopyBuffer(commandBuffer, target.buffer, storage.buffer, static_cast<uint32_t>(regions.size()),
+                regions.data());
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1,
+                &barrier, 0, nullptr);
+
+        dirty.clear();
+        ++uploads;
+        uploadedBytes += total;
+        lastUploadedBytes = total;
+    }
+    catch (const std::exception& e) {
+        // Dirty ranges stay queued for the next frame, nothing is drawn from a buffer that is too small
+        std::cerr << "scene: " << e.what() << std::endl;
+        drawCount = std::min(drawCount, storage.capacity);
+    }
+}
+
+void Scene::Draw(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFormat format, VkExtent2D extent,
+        VkDescriptorSet textures, VkPipeline& bound) noexcept {
+    if (!drawCount)
+        return;
+    // The size is dynamic, only a swapchain that changed its format needs another pipeline
+    auto& pipelines = device.GetPipelines();
+    if (!pipeline || pipelineFormat!=format) {
+        GraphicsPipelineState state;
+        state.vertex = vertex;
+        state.fragment = fragment;
+        state.layout = layout;
+        state.colorFormat = format;
+        state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+        state.blend.blendEnable = VK_TRUE;
+        state.blend.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        state.blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        state.blend.colorBlendOp = VK_BLEND_OP_ADD;
+        state.blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        state.blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        state.blend.alphaBlendOp = VK_BLEND_OP_ADD;
+        state.blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        try {
+            const auto acquired = pipelines.Acquire(state, renderPass);
+            // Stays cached in the registry, frames in flight can keep drawing with it
+            if (pipeline)
+                pipelines.Release(pipeline);
+            pipeline = acquired;
+            pipelineFormat = format;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "scene: " << e.what() << std::endl;
+            return;
+        }
+    }
+    VkViewport viewport = {0.0f, 0.0f, float(extent.width), float(extent.height), 0.0f, 1.0f};
+    const float size[] = {viewport.width, viewport.height};
+    pipelines.Bind(commandBuffer, *pipeline, bound);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    const VkDescriptorSet sets[] = {storage.set, textures};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, textures ? 2 : 1, sets, 0,
+            nullptr);
+    vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(size), size);
+    vkCmdDraw(commandBuffer, 4, drawCount, 0, 0);
+}
+
+// Doubles until `slots` fit, the old buffer is released once the frames drawing from it retired
+void Scene::Grow(uint32_t slots) {
+    const auto native = device.GetNative();
+    auto capacity = std::max(storage.capacity, MinCapacity);
+    while (capacity<slots)
+        capacity *= 2;
+
+    Storage grown;
+    grown.capacity = capacity;
+    try {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = VkDeviceSize(capacity)*instanceSize;
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkCreateBuffer(native, &bufferInfo, HostAllocator(), &grown.buffer)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create instance buffer!");
+        }
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(native, grown.buffer, &requirements);
+        grown.memory = device.GetAllocator().Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        vkBindBufferMemory(native, grown.buffer, grown.memory.memory, grown.memory.offset);
+
+        VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1};
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        if (vkCreateDescriptorPool(native, &poolInfo, HostAllocator(), &grown.pool)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = grown.pool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &setLayout;
+        if (vkAllocateDescriptorSets(native, &allocInfo, &grown.set)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor set!");
+        }
+    }
+    catch (const std::exception&) {
+        Release(grown);
+        throw;
+    }
+
+    VkDescriptorBufferInfo bufferInfo = {grown.buffer, 0, VK_WHOLE_SIZE};
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = grown.set;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(native, 1, &write, 0, nullptr);
+
+    if (storage.buffer) {
+        DeferredDeletions.Enqueue([native, allocator = &device.GetAllocator(), retired = storage]() {
+            vkDestroyDescriptorPool(native, retired.pool, HostAllocator());
+            vkDestroyBuffer(native, retired.buffer, HostAllocator());
+            allocator->Free(retired.memory);
+        });
+    }
+    storage = grown;
+}
+
+// Only the frame that last used this staging buffer could still read it, and the presenter waited for it
+void Scene::EnsureStaging(Staging& target, VkDeviceSize size) {
+    if (target.capacity>=size)
+        return;
+    const auto native = device.GetNative();
+    auto capacity = std::max(target.capacity, VkDeviceSize(64*1024));
+    while (capacity<size)
+        capacity *= 2;
+    if (target.buffer) {
+        vkDestroyBuffer(native, target.buffer, HostAllocator());
+        device.GetAllocator().Free(target.memory);
+        target = Staging {};
+    }
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = capacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer buffer;
+    if (vkCreateBuffer(native, &bufferInfo, HostAllocator(), &buffer)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create staging buffer!");
+    }
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(native, buffer, &requirements);
+    try {
+        target.memory = device.GetAllocator().Allocate(requirements,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+    catch (const std::exception&) {
+        vkDestroyBuffer(native, buffer, HostAllocator());
+        throw;
+    }
+    vkBindBufferMemory(native, buffer, target.memory.memory, target.memory.offset);
+    target.buffer = buffer;
+    target.capacity = capacity;
+}
+
+void Scene::Release(Storage& target) noexcept {
+    const auto native = device.GetNative();
+    vkDestroyDescriptorPool(native, target.pool, HostAllocator());
+    vkDestroyBuffer(native, target.buffer, HostAllocator());
+    if (target.memory.memory)
+        device.GetAllocator().Free(target.memory);
+    target = Storage {};
+}
+
+void Scene::Damage(const VkRect2D* rects, uint32_t count) noexcept {
+    const auto swapchain = DisplayContextHandles.Lookup(displayContext);
+    if (!swapchain)
+        return;
+    if (rects)
+        swapchain->AddDamage(rects, count);
+    else
+        swapchain->DamageAll();
+    if (const auto renderThread = device.GetApplication().GetRenderThread())
+        renderThread->Wake();
+}
+
+namespace {
+    void Redraw(Swapchain& swapchain) noexcept {
+        swapchain.DamageAll();
+        if (const auto renderThread = swapchain.GetDevice().GetApplication().GetRenderThread())
+            renderThread->Wake();
+    }
+
+    uint64_t RegisterScene(uint64_t contextHandle, ShaderModule* vertex, ShaderModule* fragment,
+            uint32_t instanceSize) {
+        const auto swapchain = DisplayContextHandles.Lookup(contextHandle);
+        auto& shaders = swapchain->GetDevice().GetShaders();
+        if (!vertex || !fragment) {
+            if (vertex)
+                shaders.Release(vertex);
+            if (fragment)
+                shaders.Release(fragment);
+            throw std::runtime_error("failed to load scene shaders!");
+        }
+        // Takes over the module references, also on failure
+        const auto scene = new Scene(swapchain->GetDevice(), contextHandle, vertex, fragment, instanceSize);
+        const auto handle = SceneHandles.Insert(scene);
+        if (!handle) {
+            delete scene;
+            throw std::runtime_error("failed to register scene!");
+        }
+        // A scene created later replaces the one drawn so far
+        swapchain->SetScene(scene);
+        Redraw(*swapchain);
+        return handle;
+    }
+
+    ShaderModule* TryAcquire(ShaderRegistry& shaders, const uint32_t* code, size_t size) noexcept {
+        try {
+            return shaders.Acquire(code, size);
+        }
+        catch (const std::exception&) {
+            return nullptr;
+        }
+    }
+
+    ShaderModule* TryLoad(ShaderRegistry& shaders, const char* path) noexcept {
+        try {
+            return shaders.Load(path);
+        }
+        catch (const std::exception&) {
+            return nullptr;
+        }
+    }
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateScene(uint64_t contextHandle, const uint32_t* vertexCode, size_t vertexSize,
+        const uint32_t* fragmentCode, size_t fragmentSize, uint32_t instanceSize) noexcept {
+    AK_TRACE(akCreateScene, contextHandle, TraceIn(vertexCode, vertexSize/4), vertexSize,
+            TraceIn(fragmentCode, fragmentSize/4), fragmentSize, instanceSize);
+    const auto swapchain = DisplayContextHandles.Lookup(contextHandle);
+    if (!swapchain)
+        return 0;
+    try {
+        auto& shaders = swapchain->GetDevice().GetShaders();
+        return RegisterScene(contextHandle, TryAcquire(shaders, vertexCode, vertexSize),
+                TryAcquire(shaders, fragmentCode, fragmentSize), instanceSize);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "scene: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+AK_PUBLIC uint64_t AK_CALL akLoadScene(uint64_t contextHandle, const char* vertexPath, const char* fragmentPath,
+        uint32_t instanceSize) noexcept {
+    AK_TRACE(akLoadScene, contextHandle, vertexPath, fragmentPath, instanceSize);
+    const auto swapchain = DisplayContextHandles.Lookup(contextHandle);
+    if (!swapchain)
+        return 0;
+    try {
+        auto& shaders = swapchain->GetDevice().GetShaders();
+        return RegisterScene(contextHandle, TryLoad(shaders, vertexPath), TryLoad(shaders, fragmentPath),
+                instanceSize);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "scene: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+AK_PUBLIC void AK_CALL akDestroyScene(uint64_t handle) noexcept {
+    AK_TRACE(akDestroyScene, handle);
+    Scene* scene;
+    if (!SceneHandles.Erase(handle, &scene))
+        return;
+    if (const auto swapchain = DisplayContextHandles.Lookup(scene->GetDisplayContext())) {
+        if (swapchain->DetachScene(scene))
+            Redraw(*swapchain);
+    }
+    // A frame being recorded may still draw it
+    DeferredDeletions.Enqueue([scene]() { delete scene; });
+}
+
+AK_PUBLIC bool AK_CALL akSceneCreateNodes(uint64_t handle, const void* data, uint32_t count,
+        uint32_t* nodes) noexcept {
+    const auto scene = SceneHandles.Lookup(handle);
+    if (!scene)
+        return false;
+    AK_TRACE(akSceneCreateNodes, handle, TraceIn(data, size_t(count)*scene->GetInstanceSize()), count,
+            TraceOut(nodes, count));
+    try {
+        scene->CreateNodes(data, count, nodes);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "scene: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+AK_PUBLIC bool AK_CALL akSceneUpdateNode(uint64_t handle, uint32_t node, uint32_t offset, const void* data,
+        uint32_t size) noexcept {
+    AK_TRACE(akSceneUpdateNode, handle, node, offset, TraceIn(data, size), size);
+    const auto scene = SceneHandles.Lookup(handle);
+    return scene && scene->UpdateNode(node, offset, data, size);
+}
+
+AK_PUBLIC void AK_CALL akSceneDestroyNodes(uint64_t handle, const uint32_t* nodes, uint32_t count) noexcept {
+    AK_TRACE(akSceneDestroyNodes, handle, TraceIn(nodes, count), count);
+    if (const auto scene = SceneHandles.Lookup(handle))
+        scene->DestroyNodes(nodes, count);
+}
+
+AK_PUBLIC bool AK_CALL akSceneSetNodeBounds(uint64_t handle, uint32_t node, const VkRect2D* bounds) noexcept {
+    AK_TRACE(akSceneSetNodeBounds, handle, node, TraceIn(bounds));
+    const auto scene = SceneHandles.Lookup(handle);
+    return scene && bounds && scene->SetNodeBounds(node, *bounds);
+}
+
+AK_PUBLIC void AK_CALL akSceneGetStats(uint64_t handle, SceneStats* stats) noexcept {
+    if (!stats)
+        return;
+    const auto scene = SceneHandles.Lookup(handle);
+    *stats = scene ? scene->GetStats() : SceneStats {};
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include "Memory.h"
+#include "Presenter.h"
+#include <array>
+#include <mutex>
+#include <vector>
+
+class VulkanDevice;
+class ShaderModule;
+class GraphicsPipeline;
+
+struct SceneStats {
+    uint64_t nodes;
+    uint64_t slots;
+    // Slots the resident instance buffer has room for
+    uint64_t capacity;
+    uint64_t dirtyRanges;
+    uint64_t uploads;
+    uint64_t uploadedBytes;
+    uint64_t lastUploadedBytes;
+    uint64_t frames;
+};
+
+// Retained set of instances drawn into one display context. Every node owns a fixed slot of instanceSize bytes in a
+// device local instance buffer that stays resident across frames; changing a node only marks its bytes dirty, and
+// a frame copies just the dirty ranges before redrawing every slot from the resident buffer.
+//
+// The instance buffer is storage buffer 0 of set 0, the vertex shader indexes it with gl_InstanceIndex and expands
+// each instance into a 4 vertex triangle strip; the viewport size in pixels is a vec2 push constant. Released slots
+// are zero filled and reused, shaders should collapse a zeroed instance. Draw order is slot order. Blending expects
+// premultiplied alpha.
+//
+// With descriptor indexing, set 1 is the device's texture table: an immutable sampler at binding 0 and the sampled
+// images at binding 1, indexed with the texture indices carried in the instance data.
+//
+// Nodes are edited from any thread, the GPU side is only touched by the thread recording frames. Edits damage the
+// display context: a node with bounds only its bounds, a node without them the whole context.
+class Scene {
+public:
+    static constexpr uint32_t MaxInstanceSize = 256;
+    // Dirty ranges closer than this are copied as one, the extra bytes are cheaper than another copy region
+    static constexpr VkDeviceSize MergeGap = 256;
+    static constexpr size_t MaxDirtyRanges = 256;
+    static constexpr uint32_t MinCapacity = 1024;
+
+    // Takes over one reference of each module
+    Scene(VulkanDevice& device, uint64_t displayContext, ShaderModule* vertex, ShaderModule* fragment,
+            uint32_t instanceSize);
+    ~Scene();
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+    uint64_t GetDisplayContext() const noexcept { return displayContext; }
+    uint32_t GetInstanceSize() const noexcept { return instanceSize; }
+    // Writes the ids of `count` new nodes initialized from consecutive instances of `data`
+    void CreateNodes(const void* data, uint32_t count, uint32_t* nodes);
+    // Returns false for a dead node or a range outside the instance
+    bool UpdateNode(uint32_t node, uint32_t offset, const void* data, uint32_t size) noexcept;
+    void DestroyNodes(const uint32_t* nodes, uint32_t count) noexcept;
+    // Area in pixels the node's instance draws to, both the old and the new bounds are damaged. Returns false for a
+    // dead node.
+    bool SetNodeBounds(uint32_t node, const VkRect2D& rect) noexcept;
+    SceneStats GetStats() noexcept;
+    // Called by the presenter outside of the render pass, copies the dirty ranges into the instance buffer
+    void Upload(VkCommandBuffer commandBuffer, uint32_t frame) noexcept;
+    // `bound` is the pipeline bound in the command buffer so far, scenes sharing a pipeline bind it once.
+    // `textures` is the texture table set of the frame, null without descriptor indexing.
+    void Draw(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFormat format, VkExtent2D extent,
+            VkDescriptorSet textures, VkPipeline& bound) noexcept;
+private:
+    struct Range {
+        VkDeviceSize begin, end;
+    };
+
+    // Instance buffer with the descriptor set pointing at it, replaced as a whole when it grows
+    struct Storage {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        Allocation memory;
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        uint32_t capacity = 0;
+    };
+
+    // Per frame in flight, reused once the presenter waited for the frame
+    struct Staging {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        Allocation memory;
+        VkDeviceSize capacity = 0;
+    };
+
+    void MarkDirty(VkDeviceSize begin, VkDeviceSize end);
+    void Grow(uint32_t slots);
+    void EnsureStaging(Staging& staging, VkDeviceSize size);
+    void Release(Storage& target) noexcept;
+    // Null redraws the whole display context
+    void Damage(const VkRect2D* rects, uint32_t count) noexcept;
+
+    VulkanDevice& device;
+    uint64_t displayContext;
+    ShaderModule* vertex;
+    ShaderModule* fragment;
+    uint32_t instanceSize;
+    // Owned by the pipeline registry
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    GraphicsPipeline* pipeline = nullptr;
+    VkFormat pipelineFormat = VK_FORMAT_UNDEFINED;
+    Storage storage;
+    std::array<Staging, Presenter::FramesInFlight> staging;
+    std::vector<VkBufferCopy> regions;
+    uint32_t drawCount = 0;
+    // Guards everything below
+    std::mutex mutex;
+    std::vector<uint8_t> shadow;
+    std::vector<bool> live;
+    std::vector<bool> bounded;
+    std::vector<VkRect2D> bounds;
+    std::vector<VkRect2D> destroyedBounds;
+    std::vector<uint32_t> freeSlots;
+    std::vector<Range> dirty;
+    uint64_t nodes = 0, uploads = 0, uploadedBytes = 0, lastUploadedBytes = 0, frames = 0;
+};
+
+extern HandleTable<Scene*, HandleType::Scene> SceneHandles;
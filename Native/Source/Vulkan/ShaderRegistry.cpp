@@ -0,0 +1,181 @@
+#include "ShaderRegistry.h"
+#include "Device.h"
+#include "../MappedFile.h"
+#include "../Trace.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace {
+    constexpr uint32_t SpirvMagic = 0x07230203;
+
+    // FNV-1a over 32-bit words, SPIR-V is a word stream anyway
+    uint64_t HashCode(const uint32_t* code, size_t size) noexcept {
+        auto hash = 14695981039346656037ull ^ size;
+        for (size_t i = 0; i<size/4; ++i)
+            hash = (hash ^ code[i])*1099511628211ull;
+        return hash;
+    }
+
+    std::string NormalizePath(const char* path) {
+        std::string result(path);
+        for (auto& c : result) {
+            if (c=='\\')
+                c = '/';
+        }
+        while (result.compare(0, 2, "./")==0)
+            result.erase(0, 2);
+        return result;
+    }
+}
+
+#ifndef AK_EMBEDDED_SHADERS
+const EmbeddedShader EmbeddedShaders[] = {{nullptr, nullptr, 0}};
+const size_t EmbeddedShaderCount = 0;
+#endif
+
+VkPipelineShaderStageCreateInfo ShaderModule::CreateStageInfo(VkShaderStageFlagBits stage,
+        const char* entry) const noexcept {
+    VkPipelineShaderStageCreateInfo stageInfo = {};
+    stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stageInfo.stage = stage;
+    stageInfo.module = module;
+    stageInfo.pName = entry;
+    return stageInfo;
+}
+
+ShaderRegistry::~ShaderRegistry() {
+    for (auto& module : modules)
+        vkDestroyShaderModule(device.GetNative(), module.second->module, HostAllocator());
+}
+
+ShaderModule* ShaderRegistry::Acquire(const uint32_t* code, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++requests;
+    return AcquireLocked(code, size);
+}
+
+ShaderModule* ShaderRegistry::AcquireLocked(const uint32_t* code, size_t size) {
+    if (size<4 || size%4 || code[0]!=SpirvMagic) {
+        throw std::runtime_error("shader is not SPIR-V!");
+    }
+    const auto hash = HashCode(code, size);
+    const auto range = modules.equal_range(hash);
+    for (auto i = range.first; i!=range.second; ++i) {
+        const auto& cached = *i->second;
+        if (cached.size==size && std::memcmp(cached.code.data(), code, size)==0) {
+            ++hits;
+            ++i->second->references;
+            return i->second.get();
+        }
+    }
+
+    auto module = std::make_unique<ShaderModule>();
+    module->code.assign(code, code+size/4);
+
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = size;
+    createInfo.pCode = code;
+    VkShaderModule native;
+    if (vkCreateShaderModule(device.GetNative(), &createInfo, HostAllocator(), &native)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module!");
+    }
+    module->module = native;
+    module->hash = hash;
+    module->id = nextId++;
+    module->size = size;
+    module->references = 1;
+    try {
+        return modules.emplace(hash, std::move(module))->second.get();
+    }
+    catch (const std::exception&) {
+        vkDestroyShaderModule(device.GetNative(), native, HostAllocator());
+        throw;
+    }
+}
+
+ShaderModule* ShaderRegistry::Load(const char* path) {
+    auto name = NormalizePath(path);
+    std::lock_guard<std::mutex> lock(mutex);
+    ++requests;
+    const auto cached = paths.find(name);
+    if (cached!=paths.end()) {
+        ++hits;
+        ++cached->second->references;
+        return cached->second;
+    }
+
+    ShaderModule* module = nullptr;
+    for (size_t i = 0; i<EmbeddedShaderCount; ++i) {
+        if (name==EmbeddedShaders[i].name) {
+            module = AcquireLocked(reinterpret_cast<const uint32_t*>(EmbeddedShaders[i].code),
+                    EmbeddedShaders[i].size);
+            break;
+        }
+    }
+    if (!module) {
+        // Mappings are page aligned, which satisfies the word alignment pCode needs
+        MappedFile file(path);
+        ++fileMaps;
+        module = AcquireLocked(reinterpret_cast<const uint32_t*>(file.GetData()), file.GetSize());
+    }
+    module->paths.push_back(name);
+    paths.emplace(std::move(name), module);
+    return module;
+}
+
+void ShaderRegistry::Release(ShaderModule* module) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    --module->references;
+}
+
+size_t ShaderRegistry::Trim() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t freed = 0;
+    for (auto i = modules.begin(); i!=modules.end();) {
+        if (i->second->references) {
+            ++i;
+            continue;
+        }
+        freed += i->second->size;
+        Destroy(*i->second);
+        i = modules.erase(i);
+    }
+    return freed;
+}
+
+// Pipelines do not keep the module alive, so it can go right away
+void ShaderRegistry::Destroy(ShaderModule& module) noexcept {
+    for (const auto& path : module.paths)
+        paths.erase(path);
+    vkDestroyShaderModule(device.GetNative(), module.module, HostAllocator());
+}
+
+ShaderRegistryStats ShaderRegistry::GetStats() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    ShaderRegistryStats stats = {};
+    stats.modules = modules.size();
+    for (const auto& module : modules) {
+        if (module.second->references)
+            ++stats.referencedModules;
+        stats.codeBytes += module.second->size;
+    }
+    stats.requests = requests;
+    stats.hits = hits;
+    stats.fileMaps = fileMaps;
+    return stats;
+}
+
+AK_PUBLIC void AK_CALL akDeviceGetShaderStats(uint64_t handle, ShaderRegistryStats* stats) noexcept {
+    if (!stats)
+        return;
+    const auto device = DeviceHandles.Lookup(handle);
+    *stats = device ? device->GetShaders().GetStats() : ShaderRegistryStats {};
+}
+
+AK_PUBLIC uint64_t AK_CALL akDeviceTrimShaders(uint64_t handle) noexcept {
+    AK_TRACE(akDeviceTrimShaders, handle);
+    const auto device = DeviceHandles.Lookup(handle);
+    return device ? device->GetShaders().Trim() : 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class VulkanDevice;
+
+// SPIR-V compiled into the library with AKARIN_EMBED_SHADERS, named like the files they came from ("shaders/x.spv")
+struct EmbeddedShader {
+    const char* name;
+    const unsigned char* code;
+    size_t size;
+};
+
+extern const EmbeddedShader EmbeddedShaders[];
+extern const size_t EmbeddedShaderCount;
+
+struct ShaderRegistryStats {
+    uint64_t modules;
+    uint64_t referencedModules;
+    uint64_t codeBytes;
+    uint64_t requests;
+    uint64_t hits;
+    uint64_t fileMaps;
+};
+
+class ShaderModule {
+public:
+    VkShaderModule GetNative() const noexcept { return module; }
+    uint64_t GetHash() const noexcept { return hash; }
+    // Unique within the registry, unlike the hash two different bytecodes never share it
+    uint64_t GetId() const noexcept { return id; }
+    VkPipelineShaderStageCreateInfo CreateStageInfo(VkShaderStageFlagBits stage,
+            const char* entry = "main") const noexcept;
+private:
+    friend class ShaderRegistry;
+    VkShaderModule module = VK_NULL_HANDLE;
+    uint64_t hash = 0;
+    uint64_t id = 0;
+    size_t size = 0;
+    // Compared on a hash hit, so a collision does not hand out the wrong module
+    std::vector<uint32_t> code;
+    uint32_t references = 0;
+    std::vector<std::string> paths;
+};
+
+// Shares one VkShaderModule between every pipeline built from the same bytecode. Modules are found by a hash of
+// their content and then compared byte for byte, files additionally by path so a repeated load does not even touch
+// the file. Unreferenced modules stay cached until Trim.
+class ShaderRegistry {
+public:
+    explicit ShaderRegistry(VulkanDevice& device) noexcept : device(device) {}
+    ~ShaderRegistry();
+    ShaderRegistry(const ShaderRegistry&) = delete;
+    ShaderRegistry& operator=(const ShaderRegistry&) = delete;
+    // Each returns the module with one reference added, to be given back through Release
+    ShaderModule* Acquire(const uint32_t* code, size_t size);
+    // Embedded shaders are looked up before the file is mapped
+    ShaderModule* Load(const char* path);
+    void Release(ShaderModule* module) noexcept;
+    // Destroys every unreferenced module, returns the bytecode bytes they held
+    size_t Trim() noexcept;
+    ShaderRegistryStats GetStats() noexcept;
+private:
+    ShaderModule* AcquireLocked(const uint32_t* code, size_t size);
+    void Destroy(ShaderModule& module) noexcept;
+
+    VulkanDevice& device;
+    std::mutex mutex;
+    std::unordered_multimap<uint64_t, std::unique_ptr<ShaderModule>> modules;
+    std::unordered_map<std::string, ShaderModule*> paths;
+    uint64_t nextId = 1, requests = 0, hits = 0, fileMaps = 0;
+};
@@ -0,0 +1,66 @@
+#include "StagingRing.h"
+#include "Device.h"
+
+StagingRing::StagingRing(VulkanDevice& device, VkDeviceSize capacity) : device(device), capacity(capacity) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = capacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device.GetNative(), &bufferInfo, HostAllocator(), &buffer)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create staging buffer!");
+    }
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device.GetNative(), buffer, &requirements);
+    try {
+        memory = device.GetAllocator().Allocate(requirements,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+    catch (...) {
+        vkDestroyBuffer(device.GetNative(), buffer, HostAllocator());
+        throw;
+    }
+    vkBindBufferMemory(device.GetNative(), buffer, memory.memory, memory.offset);
+}
+
+StagingRing::~StagingRing() {
+    vkDestroyBuffer(device.GetNative(), buffer, HostAllocator());
+    device.GetAllocator().Free(memory);
+}
+
+bool StagingRing::Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) noexcept {
+    if (size>capacity)
+        return false;
+    if (Empty())
+        head = tail = 0;
+    auto start = (head+alignment-1)/alignment*alignment;
+    if (Empty() || head>tail) {
+        // Free space is [head, capacity) followed by [0, tail)
+        if (start+size>capacity) {
+            if (size>tail)
+                return false;
+            start = 0;
+        }
+    }
+    else if (head==tail || start+size>tail) {
+        return false;
+    }
+    offset = start;
+    head = start+size;
+    open = true;
+    return true;
+}
+
+void StagingRing::Close(uint64_t batch) {
+    if (!open)
+        return;
+    regions.push_back({batch, head});
+    open = false;
+}
+
+void StagingRing::Retire(uint64_t batch) noexcept {
+    while (!regions.empty() && regions.front().batch<=batch) {
+        tail = regions.front().end;
+        regions.pop_front();
+    }
+}
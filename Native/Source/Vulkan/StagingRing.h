@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include "Memory.h"
+#include <deque>
+
+class VulkanDevice;
+
+// Persistently mapped upload buffer handed out front to back. Space is reclaimed in submission order: everything
+// allocated before Close(batch) belongs to that batch and is released by Retire once the batch's copies completed.
+// Not thread safe, owned by a single uploading thread.
+class StagingRing {
+public:
+    StagingRing(VulkanDevice& device, VkDeviceSize capacity);
+    ~StagingRing();
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+    VkBuffer GetBuffer() const noexcept { return buffer; }
+    uint8_t* GetMapped() const noexcept { return static_cast<uint8_t*>(memory.mapped); }
+    VkDeviceSize GetCapacity() const noexcept { return capacity; }
+    // Returns false when there is no room left until earlier batches retire
+    bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) noexcept;
+    void Close(uint64_t batch);
+    void Retire(uint64_t batch) noexcept;
+private:
+    struct Region {
+        uint64_t batch;
+        VkDeviceSize end;
+    };
+
+    bool Empty() const noexcept { return regions.empty() && !open; }
+
+    VulkanDevice& device;
+    VkDeviceSize capacity;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    Allocation memory;
+    VkDeviceSize head = 0, tail = 0;
+    bool open = false;
+    std::deque<Region> regions;
+};
@@ -3,20 +3,45 @@
 //
 
 #include "../Vulkan.h"
+#include "../Trace.h"
 
-AK_PUBLIC uint64_t AK_CALL akCreateDisplaySurface(uintptr_t app, uintptr_t window) {
+HandleTable<VkSurfaceKHR, HandleType::Surface> SurfaceHandles;
+
+AK_PUBLIC uint64_t AK_CALL akCreateDisplaySurface(uint64_t app, uint64_t window) {
+    AK_TRACE(akCreateDisplaySurface, app, window);
+    const auto application = ApplicationHandles.Lookup(app);
+    const auto sdlWindow = WindowHandles.Lookup(window);
+    if (!application || !sdlWindow)
+        return 0;
     VkSurfaceKHR surface;
-    SDL_Vulkan_CreateSurface(
-            reinterpret_cast<SDL_Window*>(window),
-            reinterpret_cast<VulkanApplication*>(app)->GetInstance(),
-            &surface
-    );
-    return reinterpret_cast<uint64_t>(surface);
+    if (!SDL_Vulkan_CreateSurface(sdlWindow, application->GetInstance(), &surface))
+        return 0;
+    const auto handle = SurfaceHandles.Insert(surface);
+    if (!handle)
+        vkDestroySurfaceKHR(application->GetInstance(), surface, nullptr);
+    return handle;
+}
+
+AK_PUBLIC void AK_CALL akDestroyDisplaySurface(uint64_t app, uint64_t surface) {
+    AK_TRACE(akDestroyDisplaySurface, app, surface);
+    const auto application = ApplicationHandles.Lookup(app);
+    VkSurfaceKHR native;
+    if (application && SurfaceHandles.Erase(surface, &native))
+        DeferredDeletions.Enqueue([instance = application->GetInstance(), native]() {
+            vkDestroySurfaceKHR(instance, native, nullptr);
+        });
 }
 
-AK_PUBLIC void AK_CALL akDestroyDisplaySurface(uintptr_t app, uint64_t surface) {
-    vkDestroySurfaceKHR(
-            reinterpret_cast<VulkanApplication*>(app)->GetInstance(),
-            reinterpret_cast<VkSurfaceKHR>(surface), nullptr
-    );
+AK_PUBLIC void AK_CALL akDestroyDisplaySurfaces(uint64_t app, const uint64_t* surfaces, uint32_t count) {
+    AK_TRACE(akDestroyDisplaySurfaces, app, TraceIn(surfaces, count), count);
+    const auto application = ApplicationHandles.Lookup(app);
+    if (!application)
+        return;
+    std::vector<VkSurfaceKHR> natives;
+    SurfaceHandles.EraseBatch(surfaces, count, [&natives](VkSurfaceKHR surface) { natives.push_back(surface); });
+    if (!natives.empty())
+        DeferredDeletions.Enqueue([instance = application->GetInstance(), natives = std::move(natives)]() {
+            for (auto&& x : natives)
+                vkDestroySurfaceKHR(instance, x, nullptr);
+        });
 }
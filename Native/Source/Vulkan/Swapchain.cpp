@@ -0,0 +1,433 @@
+#include "Swapchain.h"
+#include "Device.h"
+#include "Presenter.h"
+#include "RenderPassCache.h"
+#include "../RenderThread.h"
+#include "../Trace.h"
+
+#include <limits>
+#include <iostream>
+#include <algorithm>
+
+HandleTable<Swapchain*, HandleType::DisplayContext> DisplayContextHandles;
+
+namespace {
+    bool IsEmpty(const VkRect2D& rect) noexcept {
+        return rect.extent.width==0 || rect.extent.height==0;
+    }
+
+    VkRect2D Union(const VkRect2D& a, const VkRect2D& b) noexcept {
+        if (IsEmpty(a))
+            return b;
+        if (IsEmpty(b))
+            return a;
+        const auto left = std::min(a.offset.x, b.offset.x);
+        const auto top = std::min(a.offset.y, b.offset.y);
+        const auto right = std::max(a.offset.x+int32_t(a.extent.width), b.offset.x+int32_t(b.extent.width));
+        const auto bottom = std::max(a.offset.y+int32_t(a.extent.height), b.offset.y+int32_t(b.extent.height));
+        return {{left, top}, {uint32_t(right-left), uint32_t(bottom-top)}};
+    }
+
+    VkRect2D Intersect(const VkRect2D& a, const VkRect2D& b) noexcept {
+        const auto left = std::max(a.offset.x, b.offset.x);
+        const auto top = std::max(a.offset.y, b.offset.y);
+        const auto right = std::min(a.offset.x+int32_t(a.extent.width), b.offset.x+int32_t(b.extent.width));
+        const auto bottom = std::min(a.offset.y+int32_t(a.extent.height), b.offset.y+int32_t(b.extent.height));
+        if (right<=left || bottom<=top)
+            return {};
+        return {{left, top}, {uint32_t(right-left), uint32_t(bottom-top)}};
+    }
+}
+
+Swapchain::Swapchain(VulkanDevice& device, SDL_Window* window, VkSurfaceKHR surface)
+        :device(device), window(window), windowID(SDL_GetWindowID(window)), surface(surface) {
+    hidden.store((SDL_GetWindowFlags(window) & (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED))!=0,
+            std::memory_order_relaxed);
+    try {
+        if (!device.CanPresent(surface)) {
+            throw std::runtime_error("device can not present to the window surface!");
+        }
+        CreateSwapchain(VK_NULL_HANDLE);
+        CreateImageViews();
+        CreateRenderPass();
+        CreateFramebuffers();
+        ResetDamage();
+    }
+    catch (...) {
+        Destroy();
+        throw;
+    }
+}
+
+Swapchain::~Swapchain() {
+    Destroy();
+}
+
+void Swapchain::Destroy() noexcept {
+    const auto native = device.GetNative();
+    ReleaseFramebuffers();
+    for (auto imageView : imageViews)
+        vkDestroyImageView(native, imageView, HostAllocator());
+    vkDestroySwapchainKHR(native, swapchain, HostAllocator());
+    vkDestroySurfaceKHR(device.GetApplication().GetInstance(), surface, nullptr);
+}
+
+void Swapchain::NotifyResized() noexcept {
+    const auto now = Clock::now().time_since_epoch().count();
+    lastResize.store(now, std::memory_order_relaxed);
+    if (!resizePending.exchange(true, std::memory_order_acq_rel))
+        firstResize.store(now, std::memory_order_relaxed);
+}
+
+bool Swapchain::NeedsRecreate() const noexcept {
+    if (outOfDate.load(std::memory_order_acquire))
+        return true;
+    if (!resizePending.load(std::memory_order_acquire))
+        return false;
+    const auto now = Clock::now();
+    const auto first = Clock::time_point(Clock::duration(firstResize.load(std::memory_order_relaxed)));
+    const auto last = Clock::time_point(Clock::duration(lastResize.load(std::memory_order_relaxed)));
+    return now-last>=ResizeSettle || now-first>=ResizeMaxDelay;
+}
+
+Swapchain::Clock::time_point Swapchain::ResizeDue() const noexcept {
+    if (outOfDate.load(std::memory_order_acquire))
+        return Clock::now();
+    if (!resizePending.load(std::memory_order_acquire))
+        return Clock::time_point::max();
+    const auto first = Clock::time_point(Clock::duration(firstResize.load(std::memory_order_relaxed)));
+    const auto last = Clock::time_point(Clock::duration(lastResize.load(std::memory_order_relaxed)));
+    return std::min(last+ResizeSettle, first+ResizeMaxDelay);
+}
+
+void Swapchain::AddDamage(const VkRect2D* rects, uint32_t count) noexcept {
+    std::lock_guard<std::mutex> lock(damageMutex);
+    if (!pendingFull) {
+        pendingDamage.insert(pendingDamage.end(), rects, rects+count);
+        // Long lists are collapsed into their bounds, the frame redraws the union anyway
+        if (pendingDamage.size()>MaxDamageRects) {
+            VkRect2D bounds = {};
+            for (const auto& rect : pendingDamage)
+                bounds = Union(bounds, rect);
+            pendingDamage.assign(1, bounds);
+        }
+    }
+    damaged.store(true, std::memory_order_release);
+}
+
+void Swapchain::DamageAll() noexcept {
+    std::lock_guard<std::mutex> lock(damageMutex);
+    pendingFull = true;
+    pendingDamage.clear();
+    damaged.store(true, std::memory_order_release);
+}
+
+void Swapchain::ResetDamage() noexcept {
+    std::lock_guard<std::mutex> lock(damageMutex);
+    staleAreas.assign(images.size(), {{0, 0}, extent});
+    pendingFull = true;
+    pendingDamage.clear();
+    damaged.store(true, std::memory_order_release);
+}
+
+bool Swapchain::TakeDamage(uint32_t image, VkRect2D& area, std::vector<VkRectLayerKHR>& changed) {
+    const VkRect2D whole = {{0, 0}, extent};
+    std::lock_guard<std::mutex> lock(damageMutex);
+    VkRect2D bounds = {};
+    if (pendingFull) {
+        bounds = whole;
+        changed.push_back({whole.offset, whole.extent, 0});
+    }
+    else {
+        for (const auto& rect : pendingDamage) {
+            const auto clipped = Intersect(rect, whole);
+            if (IsEmpty(clipped))
+                continue;
+            bounds = Union(bounds, clipped);
+            changed.push_back({clipped.offset, clipped.extent, 0});
+        }
+    }
+    pendingDamage.clear();
+    pendingFull = false;
+    damaged.store(false, std::memory_order_release);
+    for (auto& stale : staleAreas)
+        stale = Union(stale, bounds);
+    area = staleAreas[image];
+    staleAreas[image] = {};
+    return area.extent.width==extent.width && area.extent.height==extent.height;
+}
+
+bool Swapchain::Refresh() noexcept {
+    if (IsHidden())
+        return false;
+    if (!NeedsRecreate())
+        return swapchain!=VK_NULL_HANDLE;
+    try {
+        return Recreate();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "swapchain: " << e.what() << std::endl;
+        outOfDate.store(true, std::memory_order_release);
+        return false;
+    }
+}
+
+bool Swapchain::Recreate() {
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device.GetPhysicalDevice(), surface, &capabilities);
+    // A minimized window has no drawable area, keep the current swapchain until it comes back
+    const auto newExtent = ChooseExtent(capabilities);
+    if (newExtent.width==0 || newExtent.height==0)
+        return false;
+    resizePending.store(false, std::memory_order_release);
+    outOfDate.store(false, std::memory_order_release);
+
+    const auto native = device.GetNative();
+    const auto oldSwapchain = swapchain;
+    const auto oldFormat = format;
+    // The cache retires the framebuffers through the deletion queue as well
+    ReleaseFramebuffers();
+    auto oldImageViews = std::move(imageViews);
+    imageViews.clear();
+    swapchain = VK_NULL_HANDLE;
+    // Frames recorded before this point may still use the old images, they are released when those frames retire.
+    // The old swapchain is retired by vkCreateSwapchainKHR even if creating the new one fails.
+    DeferredDeletions.Enqueue([native, oldSwapchain, oldImageViews]() {
+        for (auto imageView : oldImageViews)
+            vkDestroyImageView(native, imageView, HostAllocator());
+        vkDestroySwapchainKHR(native, oldSwapchain, HostAllocator());
+    });
+
+    CreateSwapchain(oldSwapchain);
+    // Cached passes outlive the swapchain, a format seen before gets its passes back
+    if (format!=oldFormat)
+        CreateRenderPass();
+    CreateImageViews();
+    CreateFramebuffers();
+    // The new images have undefined content
+    ResetDamage();
+    presentResult.store(VK_SUCCESS, std::memory_order_relaxed);
+    return true;
+}
+
+VkSurfaceFormatKHR Swapchain::ChooseSurfaceFormat() const {
+    const auto physicalDevice = device.GetPhysicalDevice();
+    uint32_t formatCount;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, nullptr);
+    std::vector<VkSurfaceFormatKHR> availableFormats(formatCount);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, availableFormats.data());
+    if (availableFormats.empty()) {
+        throw std::runtime_error("surface reports no formats!");
+    }
+
+    if (availableFormats.size()==1 && availableFormats[0].format==VK_FORMAT_UNDEFINED) {
+        return {VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    }
+
+    for (const auto& availableFormat : availableFormats) {
+        if (availableFormat.format==VK_FORMAT_B8G8R8A8_UNORM &&
+                availableFormat.colorSpace==VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            return availableFormat;
+        }
+    }
+
+    return availableFormats[0];
+}
+
+VkPresentModeKHR Swapchain::ChoosePresentMode() const {
+    const auto physicalDevice = device.GetPhysicalDevice();
+    uint32_t presentModeCount;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, nullptr);
+    std::vector<VkPresentModeKHR> availablePresentModes(presentModeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount,
+            availablePresentModes.data());
+
+    for (const auto& availablePresentMode : availablePresentModes) {
+        if (availablePresentMode==VK_PRESENT_MODE_MAILBOX_KHR) {
+            return availablePresentMode;
+        }
+    }
+
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+VkExtent2D Swapchain::ChooseExtent(const VkSurfaceCapabilitiesKHR& capabilities) const noexcept {
+    if (capabilities.currentExtent.width!=std::numeric_limits<uint32_t>::max()) {
+        return capabilities.currentExtent;
+    }
+    int width, height;
+    SDL_Vulkan_GetDrawableSize(window, &width, &height);
+    VkExtent2D actualExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+    actualExtent.width = std::max(capabilities.minImageExtent.width,
+            std::min(capabilities.maxImageExtent.width, actualExtent.width));
+    actualExtent.height = std::max(capabilities.minImageExtent.height,
+            std::min(capabilities.maxImageExtent.height, actualExtent.height));
+    return actualExtent;
+}
+
+void Swapchain::CreateSwapchain(VkSwapchainKHR oldSwapchain) {
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device.GetPhysicalDevice(), surface, &capabilities);
+
+    const auto surfaceFormat = ChooseSurfaceFormat();
+    const auto presentMode = ChoosePresentMode();
+    extent = ChooseExtent(capabilities);
+    format = surfaceFormat.format;
+
+    uint32_t imageCount = capabilities.minImageCount+1;
+    if (capabilities.maxImageCount>0 && imageCount>capabilities.maxImageCount) {
+        imageCount = capabilities.maxImageCount;
+    }
+
+    VkSwapchainCreateInfoKHR createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    createInfo.surface = surface;
+    createInfo.minImageCount = imageCount;
+    createInfo.imageFormat = surfaceFormat.format;
+    createInfo.imageColorSpace = surfaceFormat.colorSpace;
+    createInfo.imageExtent = extent;
+    createInfo.imageArrayLayers = 1;
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // Lets captures copy the presented images, costs nothing when nobody captures
+    transferSource = (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)!=0;
+    if (transferSource)
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    // Presentation happens on the graphics queue, see VulkanDevice::CanPresent
+    createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    createInfo.preTransform = capabilities.currentTransform;
+    createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    createInfo.presentMode = presentMode;
+    createInfo.clipped = VK_TRUE;
+    createInfo.oldSwapchain = oldSwapchain;
+
+    if (vkCreateSwapchainKHR(device.GetNative(), &createInfo, HostAllocator(), &swapchain)!=VK_SUCCESS) {
+        swapchain = VK_NULL_HANDLE;
+        throw std::runtime_error("failed to create swap chain!");
+    }
+
+    vkGetSwapchainImagesKHR(device.GetNative(), swapchain, &imageCount, nullptr);
+    images.resize(imageCount);
+    vkGetSwapchainImagesKHR(device.GetNative(), swapchain, &imageCount, images.data());
+}
+
+void Swapchain::CreateImageViews() {
+    for (auto image : images) {
+        VkImageViewCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        createInfo.image = image;
+        createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        createInfo.format = format;
+        createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        createInfo.subresourceRange.baseMipLevel = 0;
+        createInfo.subresourceRange.levelCount = 1;
+        createInfo.subresourceRange.baseArrayLayer = 0;
+        createInfo.subresourceRange.layerCount = 1;
+
+        VkImageView imageView;
+        if (vkCreateImageView(device.GetNative(), &createInfo, HostAllocator(), &imageView)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create image views!");
+        }
+        imageViews.push_back(imageView);
+    }
+}
+
+void Swapchain::CreateRenderPass() {
+    auto& cache = device.GetRenderPasses();
+    if (cache.UsesDynamicRendering())
+        return;
+    RenderPassKey key = {};
+    key.colorCount = 1;
+    auto& color = key.colors[0];
+    color.format = format;
+    color.samples = VK_SAMPLE_COUNT_1_BIT;
+    color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    color.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    clearRenderPass = cache.GetRenderPass(key);
+
+    // Partial redraws keep what was presented last time outside of the damaged area
+    color.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    color.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    loadRenderPass = cache.GetRenderPass(key);
+}
+
+void Swapchain::CreateFramebuffers() {
+    auto& cache = device.GetRenderPasses();
+    if (cache.UsesDynamicRendering())
+        return;
+    for (auto imageView : imageViews)
+        framebuffers.push_back(cache.AcquireFramebuffer(clearRenderPass, &imageView, 1, extent));
+}
+
+void Swapchain::ReleaseFramebuffers() noexcept {
+    auto& cache = device.GetRenderPasses();
+    for (auto framebuffer : framebuffers)
+        cache.ReleaseFramebuffer(framebuffer);
+    framebuffers.clear();
+    for (auto imageView : imageViews)
+        cache.Evict(imageView);
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateDisplayContext(uint64_t deviceHandle, uint64_t windowHandle) noexcept {
+    AK_TRACE(akCreateDisplayContext, deviceHandle, windowHandle);
+    const auto device = DeviceHandles.Lookup(deviceHandle);
+    const auto window = WindowHandles.Lookup(windowHandle);
+    if (!device || !window)
+        return 0;
+    VkSurfaceKHR surface;
+    if (!SDL_Vulkan_CreateSurface(window, device->GetApplication().GetInstance(), &surface))
+        return 0;
+    try {
+        const auto swapchain = new Swapchain(*device, window, surface);
+        device->GetPresenter().Attach(swapchain);
+        const auto handle = DisplayContextHandles.Insert(swapchain);
+        if (!handle) {
+            device->GetPresenter().Detach(swapchain);
+            DeferredDeletions.Enqueue([swapchain]() { delete swapchain; });
+        }
+        return handle;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "display context: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+AK_PUBLIC void AK_CALL akDestroyDisplayContext(uint64_t deviceHandle, uint64_t handle) noexcept {
+    AK_TRACE(akDestroyDisplayContext, deviceHandle, handle);
+    const auto device = DeviceHandles.Lookup(deviceHandle);
+    Swapchain* swapchain;
+    if (!device || !DisplayContextHandles.Erase(handle, &swapchain))
+        return;
+    device->GetPresenter().Detach(swapchain);
+    DeferredDeletions.Enqueue([swapchain]() { delete swapchain; });
+}
+
+AK_PUBLIC void AK_CALL akDisplayContextAddDamage(uint64_t handle, const VkRect2D* rects, uint32_t count) noexcept {
+    AK_TRACE(akDisplayContextAddDamage, handle, TraceIn(rects, count), count);
+    const auto swapchain = DisplayContextHandles.Lookup(handle);
+    if (!swapchain)
+        return;
+    if (count)
+        swapchain->AddDamage(rects, count);
+    else
+        swapchain->DamageAll();
+    if (const auto renderThread = swapchain->GetDevice().GetApplication().GetRenderThread())
+        renderThread->Wake();
+}
+
+AK_PUBLIC int32_t AK_CALL akDisplayContextGetPresentResult(uint64_t handle) noexcept {
+    const auto swapchain = DisplayContextHandles.Lookup(handle);
+    return swapchain ? swapchain->GetPresentResult() : VK_ERROR_SURFACE_LOST_KHR;
+}
+
+AK_PUBLIC void AK_CALL akDisplayContextGetPresentResults(const uint64_t* handles, int32_t* results,
+        uint32_t count) noexcept {
+    for (uint32_t i = 0; i<count; ++i)
+        results[i] = akDisplayContextGetPresentResult(handles[i]);
+}
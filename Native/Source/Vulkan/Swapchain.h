@@ -0,0 +1,116 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+class VulkanDevice;
+class Scene;
+class Capture;
+
+// Swapchain of one window together with the surface it presents to. Owns the surface.
+// Resizes are debounced: a live drag produces a size event per mouse move, the swapchain is recreated once a burst
+// settles for ResizeSettle, but never lags behind the window for more than ResizeMaxDelay. Recreation passes the
+// current swapchain as oldSwapchain and retires the old images through the deletion queue, so frames still in
+// flight finish on them and the device never has to go idle.
+//
+// Damage is tracked per image: rectangles marked dirty are folded into the stale area of every image, and a frame
+// only redraws the stale area of the image it acquired. Images that were never drawn count as fully stale.
+class Swapchain {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t MaxDamageRects = 32;
+    static constexpr auto ResizeSettle = std::chrono::milliseconds(12);
+    static constexpr auto ResizeMaxDelay = std::chrono::milliseconds(50);
+
+    Swapchain(VulkanDevice& device, SDL_Window* window, VkSurfaceKHR surface);
+    ~Swapchain();
+    Swapchain(const Swapchain&) = delete;
+    Swapchain& operator=(const Swapchain&) = delete;
+    VkSwapchainKHR GetNative() const noexcept { return swapchain; }
+    VkFormat GetFormat() const noexcept { return format; }
+    VkExtent2D GetExtent() const noexcept { return extent; }
+    // The load pass keeps the image content and is used for partial redraws, both passes are compatible. Passes and
+    // framebuffers come from the device's cache and are null with dynamic rendering.
+    VkRenderPass GetRenderPass(bool load) const noexcept { return load ? loadRenderPass : clearRenderPass; }
+    VkFramebuffer GetFramebuffer(uint32_t image) const noexcept {
+        return framebuffers.empty() ? VK_NULL_HANDLE : framebuffers[image];
+    }
+    VkImage GetImage(uint32_t image) const noexcept { return images[image]; }
+    VkImageView GetImageView(uint32_t image) const noexcept { return imageViews[image]; }
+    // Whether the images can be copied from, which captures need
+    bool CanCapture() const noexcept { return transferSource; }
+    VulkanDevice& GetDevice() const noexcept { return device; }
+    uint32_t GetWindowID() const noexcept { return windowID; }
+    // Called for size events and suboptimal presents, recreation is debounced
+    void NotifyResized() noexcept;
+    // Called once the swapchain is out of date, recreation happens on the next frame
+    void Invalidate() noexcept { outOfDate.store(true, std::memory_order_release); }
+    // Hidden and minimized windows are skipped without acquiring, their surface may have no extent at all
+    void SetHidden(bool value) noexcept { hidden.store(value, std::memory_order_release); }
+    bool IsHidden() const noexcept { return hidden.load(std::memory_order_acquire); }
+    // Recreates the swapchain if due, returns whether an image can be acquired this frame
+    bool Refresh() noexcept;
+    // Time at which a pending resize becomes due, Clock::time_point::max() if there is none
+    Clock::time_point ResizeDue() const noexcept;
+    // Marks regions dirty, callable from any thread
+    void AddDamage(const VkRect2D* rects, uint32_t count) noexcept;
+    void DamageAll() noexcept;
+    bool HasDamage() const noexcept { return damaged.load(std::memory_order_acquire); }
+    // Folds the pending damage into every image and returns the area of `image` that has to be redrawn. The
+    // rectangles changed since the last present are appended to `changed`. Returns true for a full redraw.
+    bool TakeDamage(uint32_t image, VkRect2D& area, std::vector<VkRectLayerKHR>& changed);
+    VkResult GetPresentResult() const noexcept { return presentResult.load(std::memory_order_relaxed); }
+    void SetPresentResult(VkResult result) noexcept { presentResult.store(result, std::memory_order_relaxed); }
+    // Drawn after clearing the damaged area, deleting a scene goes through the deletion queue
+    Scene* GetScene() const noexcept { return scene.load(std::memory_order_acquire); }
+    void SetScene(Scene* attached) noexcept { scene.store(attached, std::memory_order_release); }
+    // Returns false if another scene replaced it in the meantime
+    bool DetachScene(Scene* attached) noexcept { return scene.compare_exchange_strong(attached, nullptr); }
+    // Copies out every image after it was drawn, deleting a capture goes through the deletion queue
+    Capture* GetCapture() const noexcept { return capture.load(std::memory_order_acquire); }
+    void SetCapture(Capture* attached) noexcept { capture.store(attached, std::memory_order_release); }
+    bool DetachCapture(Capture* attached) noexcept { return capture.compare_exchange_strong(attached, nullptr); }
+private:
+    bool NeedsRecreate() const noexcept;
+    bool Recreate();
+    void CreateSwapchain(VkSwapchainKHR oldSwapchain);
+    void CreateImageViews();
+    void CreateRenderPass();
+    void CreateFramebuffers();
+    // Hands the framebuffers back and evicts the views from the cache, before the views go away
+    void ReleaseFramebuffers() noexcept;
+    void ResetDamage() noexcept;
+    void Destroy() noexcept;
+    VkSurfaceFormatKHR ChooseSurfaceFormat() const;
+    VkPresentModeKHR ChoosePresentMode() const;
+    VkExtent2D ChooseExtent(const VkSurfaceCapabilitiesKHR& capabilities) const noexcept;
+
+    VulkanDevice& device;
+    SDL_Window* window;
+    uint32_t windowID;
+    VkSurfaceKHR surface;
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = {};
+    bool transferSource = false;
+    VkRenderPass clearRenderPass = VK_NULL_HANDLE;
+    VkRenderPass loadRenderPass = VK_NULL_HANDLE;
+    std::vector<VkImage> images;
+    std::vector<VkImageView> imageViews;
+    std::vector<VkFramebuffer> framebuffers;
+    std::atomic<VkResult> presentResult {VK_SUCCESS};
+    std::atomic_bool resizePending {false}, outOfDate {false}, hidden {false};
+    std::atomic<Clock::rep> firstResize {0}, lastResize {0};
+    std::mutex damageMutex;
+    std::vector<VkRect2D> pendingDamage;
+    std::vector<VkRect2D> staleAreas;
+    bool pendingFull = true;
+    std::atomic_bool damaged {true};
+    std::atomic<Scene*> scene {nullptr};
+    std::atomic<Capture*> capture {nullptr};
+};
+
+extern HandleTable<Swapchain*, HandleType::DisplayContext> DisplayContextHandles;
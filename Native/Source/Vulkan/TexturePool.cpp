@@ -0,0 +1,710 @@
+#include "TexturePool.h"
+#include "StagingRing.h"
+#include "Device.h"
+#include "TextureTable.h"
+#include "../Trace.h"
+#include "../PixelConvert.h"
+
+#include <iostream>
+#include <algorithm>
+
+namespace {
+    constexpr VkDeviceSize StagingAlignment = 16;
+    constexpr uint64_t PollTimeout = 2'000'000;
+
+    VkExtent3D LevelExtent(VkExtent2D extent, uint32_t level) noexcept {
+        return {std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), 1};
+    }
+
+    void DestroyImage(VkDevice device, MemoryAllocator& allocator, VkImageView view, VkImage image,
+            const Allocation& memory) noexcept {
+        vkDestroyImageView(device, view, HostAllocator());
+        vkDestroyImage(device, image, HostAllocator());
+        allocator.Free(memory);
+    }
+
+    // Mip chain built on the CPU with a box filter, kept around as the source for later re-uploads. Pixels are
+    // converted while they are copied in, so the mips are filtered from converted data.
+    class Rgba8Source : public TextureSource {
+    public:
+        Rgba8Source(uint32_t width, uint32_t height, const void* pixels, uint32_t conversion)
+                : extent {width, height} {
+            uint32_t count = 1;
+            while ((width | height) >> count)
+                ++count;
+            levels.resize(count);
+            levels[0].resize(size_t(width)*height*4);
+            ConvertPixels(pixels, levels[0].data(), size_t(width)*height, conversion);
+            for (uint32_t level = 1; level<count; ++level)
+                Downsample(level);
+        }
+
+        VkFormat GetFormat() const noexcept override { return VK_FORMAT_R8G8B8A8_UNORM; }
+        VkExtent2D GetExtent() const noexcept override { return extent; }
+        uint32_t GetLevelCount() const noexcept override { return static_cast<uint32_t>(levels.size()); }
+        VkDeviceSize GetLevelSize(uint32_t level) const noexcept override { return levels[level].size(); }
+        void ReadLevel(uint32_t level, void* destination) override {
+            memcpy(destination, levels[level].data(), levels[level].size());
+        }
+    private:
+        void Downsample(uint32_t level) {
+            const auto src = LevelExtent(extent, level-1), dst = LevelExtent(extent, level);
+            const auto& in = levels[level-1];
+            auto& out = levels[level];
+            out.resize(size_t(dst.width)*dst.height*4);
+            for (uint32_t y = 0; y<dst.height; ++y) {
+                const auto y0 = std::min(y*2, src.height-1), y1 = std::min(y*2+1, src.height-1);
+                for (uint32_t x = 0; x<dst.width; ++x) {
+                    const auto x0 = std::min(x*2, src.width-1), x1 = std::min(x*2+1, src.width-1);
+                    for (uint32_t c = 0; c<4; ++c) {
+                        const auto sum = in[(size_t(y0)*src.width+x0)*4+c]+in[(size_t(y0)*src.width+x1)*4+c]+
+                                in[(size_t(y1)*src.width+x0)*4+c]+in[(size_t(y1)*src.width+x1)*4+c];
+                        out[(size_t(y)*dst.width+x)*4+c] = static_cast<uint8_t>((sum+2)/4);
+                    }
+                }
+            }
+        }
+
+        VkExtent2D extent;
+        std::vector<std::vector<uint8_t>> levels;
+    };
+}
+
+HandleTable<TexturePool*, HandleType::TexturePool> TexturePoolHandles;
+HandleTable<Texture*, HandleType::Texture> TextureHandles;
+
+Texture::Texture(TexturePool& pool, std::unique_ptr<TextureSource> source) noexcept
+        :pool(pool), source(std::move(source)) {
+    levels = this->source->GetLevelCount();
+    const auto extent = this->source->GetExtent();
+    tailLevel = 0;
+    while (tailLevel+1<levels && std::max(extent.width, extent.height) >> tailLevel>TexturePool::TailExtent)
+        ++tailLevel;
+    residentLevel.store(levels, std::memory_order_relaxed);
+    requestedLevel.store(tailLevel, std::memory_order_relaxed);
+}
+
+TexturePool::TexturePool(VulkanDevice& device) : device(device) {
+    staging = std::make_unique<StagingRing>(device, StagingSize);
+    stagingBytes.store(StagingSize, std::memory_order_relaxed);
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = device.GetTransferQueue().GetFamily();
+    if (vkCreateCommandPool(device.GetNative(), &poolInfo, HostAllocator(), &commandPool)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create command pool!");
+    }
+    device.AddTrimListener(this);
+    try {
+        thread = std::thread(&TexturePool::Run, this);
+    }
+    catch (...) {
+        device.RemoveTrimListener(this);
+        vkDestroyCommandPool(device.GetNative(), commandPool, HostAllocator());
+        throw;
+    }
+}
+
+TexturePool::~TexturePool() {
+    device.RemoveTrimListener(this);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        wakeRequested = true;
+    }
+    wake.notify_one();
+    thread.join();
+
+    const auto native = device.GetNative();
+    auto& queue = device.GetTransferQueue();
+    for (auto& batch : inFlight) {
+        queue.Wait(batch.value, UINT64_MAX);
+        Complete(batch);
+        freeBatches.push_back(std::move(batch));
+    }
+    inFlight.clear();
+    const auto table = device.GetTextureTable();
+    for (auto texture : textures) {
+        TextureHandles.Erase(texture->handle);
+        RetireImage(*texture);
+        if (table)
+            table->Release(texture->tableIndex);
+        delete texture;
+    }
+    vkDestroyCommandPool(native, commandPool, HostAllocator());
+}
+
+Texture* TexturePool::Create(std::unique_ptr<TextureSource> source) {
+    const auto texture = new Texture(*this, std::move(source));
+    if (const auto table = device.GetTextureTable()) {
+        try {
+            texture->tableIndex = table->Allocate();
+        }
+        catch (const std::exception&) {
+            delete texture;
+            throw;
+        }
+    }
+    texture->lastUse.store(useClock.fetch_add(1, std::memory_order_relaxed)+1, std::memory_order_relaxed);
+    texture->handle = TextureHandles.Insert(texture);
+    if (!texture->handle) {
+        if (const auto table = device.GetTextureTable())
+            table->Release(texture->tableIndex);
+        delete texture;
+        throw std::runtime_error("failed to register texture!");
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        textures.push_back(texture);
+    }
+    Notify();
+    return texture;
+}
+
+void TexturePool::Destroy(Texture* texture) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    textures.erase(std::find(textures.begin(), textures.end(), texture));
+    residentBytes -= texture->bytes;
+    RetireImage(*texture);
+    if (const auto table = device.GetTextureTable())
+        table->Release(texture->tableIndex);
+    // An upload still running finishes first and deletes the texture on completion
+    if (texture->uploading)
+        texture->removed = true;
+    else
+        delete texture;
+}
+
+void TexturePool::RequestSize(Texture* texture, uint32_t width, uint32_t height) noexcept {
+    const auto extent = texture->source->GetExtent();
+    auto level = texture->levels-1;
+    while (level>0 && (LevelExtent(extent, level).width<width || LevelExtent(extent, level).height<height))
+        --level;
+    texture->lastUse.store(useClock.fetch_add(1, std::memory_order_relaxed)+1, std::memory_order_relaxed);
+    if (texture->requestedLevel.exchange(level, std::memory_order_relaxed)!=level &&
+            level<texture->GetResidentLevel())
+        Notify();
+}
+
+void TexturePool::SetBudget(VkDeviceSize bytes) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = bytes;
+        for (auto texture : textures)
+            texture->minLevel = 0;
+    }
+    Notify();
+}
+
+TexturePoolStats TexturePool::GetStats() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    TexturePoolStats stats = {};
+    stats.budget = GetBudget();
+    stats.residentBytes = residentBytes;
+    stats.textures = textures.size();
+    for (auto texture : textures) {
+        stats.residentLevels += texture->levels-texture->GetResidentLevel();
+        if (texture->uploading)
+            ++stats.pendingUploads;
+    }
+    stats.uploads = uploads;
+    stats.uploadedBytes = uploadedBytes;
+    stats.evictions = evictions;
+    stats.evictedBytes = evictedBytes;
+    return stats;
+}
+
+void TexturePool::OnTrim(DeviceTrimStats& stats) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        trimClock = useClock.load(std::memory_order_relaxed);
+        // Textures uploading right now are dropped once their upload completed, without being counted here
+        for (auto texture : textures) {
+            if (!texture->uploading && texture->GetResidentLevel()<texture->tailLevel)
+                stats.scheduledTextureBytes += texture->bytes-ChainBytes(*texture, texture->tailLevel);
+        }
+        stats.scheduledStagingBytes += stagingBytes.load(std::memory_order_relaxed);
+        releaseStaging = true;
+        wakeRequested = true;
+    }
+    wake.notify_one();
+}
+
+void TexturePool::Notify() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wakeRequested = true;
+    }
+    wake.notify_one();
+}
+
+VkDeviceSize TexturePool::GetBudget() const noexcept {
+    if (budget)
+        return budget;
+    auto& allocator = device.GetAllocator();
+    return allocator.GetHeapBudget(allocator.GetDeviceLocalHeap())/2;
+}
+
+VkDeviceSize TexturePool::ChainBytes(const Texture& texture, uint32_t level) noexcept {
+    VkDeviceSize bytes = 0;
+    for (; level<texture.levels; ++level)
+        bytes += texture.source->GetLevelSize(level);
+    return bytes;
+}
+
+void TexturePool::Run() noexcept {
+    auto& queue = device.GetTransferQueue();
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        while (!inFlight.empty() && queue.IsComplete(inFlight.front().value)) {
+            Complete(inFlight.front());
+            freeBatches.push_back(std::move(inFlight.front()));
+            inFlight.pop_front();
+        }
+        if (inFlight.size()<MaxBatchesInFlight) {
+            Batch batch;
+            if (!freeBatches.empty()) {
+                batch = std::move(freeBatches.back());
+                freeBatches.pop_back();
+            }
+            Schedule(batch.jobs);
+            if (!batch.jobs.empty()) {
+                lock.unlock();
+                const auto submitted = Upload(batch);
+                lock.lock();
+                if (submitted) {
+                    inFlight.push_back(std::move(batch));
+                }
+                else {
+                    Abort(batch);
+                    freeBatches.push_back(std::move(batch));
+                }
+                continue;
+            }
+            freeBatches.push_back(std::move(batch));
+        }
+        if (inFlight.empty()) {
+            // Nothing uses the ring once every batch retired, the next upload creates it again
+            if (releaseStaging) {
+                staging.reset();
+                stagingBytes.store(0, std::memory_order_relaxed);
+                releaseStaging = false;
+            }
+            wake.wait(lock, [this]() noexcept { return wakeRequested; });
+            wakeRequested = false;
+        }
+        else {
+            const auto value = inFlight.front().value;
+            lock.unlock();
+            queue.Wait(value, PollTimeout);
+            lock.lock();
+        }
+    }
+}
+
+void TexturePool::Schedule(std::vector<Job>& jobs) {
+    std::vector<Texture*> candidates;
+    for (auto texture : textures) {
+        if (texture->uploading)
+            continue;
+        const auto resident = texture->GetResidentLevel();
+        const auto trimmed = texture->lastUse.load(std::memory_order_relaxed)<=trimClock;
+        if (trimmed && resident<texture->tailLevel) {
+            Shrink(texture, texture->tailLevel, jobs);
+            continue;
+        }
+        auto target = std::max(std::min(texture->requestedLevel.load(std::memory_order_relaxed),
+                texture->tailLevel), texture->minLevel);
+        if (trimmed)
+            target = std::max(target, texture->tailLevel);
+        if (resident>target)
+            candidates.push_back(texture);
+    }
+    // Textures that show nothing yet go first, then the most recently used ones
+    std::sort(candidates.begin(), candidates.end(), [](Texture* a, Texture* b) noexcept {
+        const auto aEmpty = a->GetResidentLevel()==a->levels, bEmpty = b->GetResidentLevel()==b->levels;
+        if (aEmpty!=bEmpty)
+            return aEmpty;
+        return a->lastUse.load(std::memory_order_relaxed)>b->lastUse.load(std::memory_order_relaxed);
+    });
+
+    const auto limit = GetBudget();
+    VkDeviceSize batchBytes = 0;
+    for (auto texture : candidates) {
+        // Might have been picked for eviction by a texture ahead of it
+        if (texture->uploading)
+            continue;
+        const auto resident = texture->GetResidentLevel();
+        const auto level = resident==texture->levels ? texture->tailLevel : resident-1;
+        const auto bytes = ChainBytes(*texture, level);
+        if (!jobs.empty() && batchBytes+bytes>StagingSize/2)
+            break;
+        // The tail always gets in, it is what is shown while the rest streams
+        const auto total = residentBytes+bytes-texture->bytes;
+        if (level<texture->tailLevel && total>limit && !Evict(texture, total-limit, jobs))
+            continue;
+        jobs.push_back({texture, level, VK_NULL_HANDLE, {}, bytes, texture->bytes});
+        residentBytes = residentBytes+bytes-texture->bytes;
+        texture->bytes = bytes;
+        texture->uploading = true;
+        batchBytes += bytes;
+    }
+}
+
+bool TexturePool::Evict(Texture* texture, VkDeviceSize excess, std::vector<Job>& jobs) {
+    const auto lastUse = texture->lastUse.load(std::memory_order_relaxed);
+    std::vector<Texture*> victims;
+    VkDeviceSize available = 0;
+    for (auto victim : textures) {
+        if (victim==texture || victim->uploading || victim->GetResidentLevel()>=victim->tailLevel ||
+                victim->lastUse.load(std::memory_order_relaxed)>=lastUse)
+            continue;
+        victims.push_back(victim);
+        available += victim->bytes-ChainBytes(*victim, victim->tailLevel);
+    }
+    if (available<excess)
+        return false;
+    std::sort(victims.begin(), victims.end(), [](Texture* a, Texture* b) noexcept {
+        return a->lastUse.load(std::memory_order_relaxed)<b->lastUse.load(std::memory_order_relaxed);
+    });
+    for (auto victim : victims) {
+        if (!excess)
+            break;
+        auto level = victim->GetResidentLevel();
+        VkDeviceSize bytes;
+        do {
+            bytes = ChainBytes(*victim, ++level);
+        } while (level<victim->tailLevel && victim->bytes-bytes<excess);
+        const auto freed = victim->bytes-bytes;
+        Shrink(victim, level, jobs);
+        excess -= std::min(excess, freed);
+    }
+    return true;
+}
+
+// Rebuilds the texture with `level` as its finest level
+void TexturePool::Shrink(Texture* texture, uint32_t level, std::vector<Job>& jobs) {
+    const auto bytes = ChainBytes(*texture, level);
+    jobs.push_back({texture, level, VK_NULL_HANDLE, {}, bytes, texture->bytes});
+    residentBytes -= texture->bytes-bytes;
+    texture->bytes = bytes;
+    texture->uploading = true;
+}
+
+bool TexturePool::Upload(Batch& batch) {
+    const auto native = device.GetNative();
+    // Staging space taken by a failed batch is given back when a later batch retires
+    batch.id = ++batchId;
+    try {
+        if (!staging) {
+            staging = std::make_unique<StagingRing>(device, StagingSize);
+            stagingBytes.store(StagingSize, std::memory_order_relaxed);
+        }
+        if (!batch.commandBuffer) {
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(native, &allocInfo, &batch.commandBuffer)!=VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffers!");
+            }
+        }
+
+        const auto commandBuffer = batch.commandBuffer;
+        vkResetCommandBuffer(commandBuffer, 0);
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+        for (auto& job : batch.jobs) {
+            CreateImage(job);
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = job.image;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, job.texture->levels-job.level, 0, 1};
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    0, 0, nullptr, 0, nullptr, 1, &barrier);
+            for (auto level = job.level; level<job.texture->levels; ++level)
+                StageLevel(batch, job, level);
+            // The graphics queue only samples the image after the batch completed, the host wait orders the rest
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                    0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+        if (vkEndCommandBuffer(commandBuffer)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        if (device.GetTransferQueue().Submit(submitInfo, batch.value)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to submit texture upload!");
+        }
+        staging->Close(batch.id);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "texture pool: " << e.what() << std::endl;
+        if (staging)
+            staging->Close(batch.id);
+        return false;
+    }
+}
+
+void TexturePool::CreateImage(Job& job) {
+    const auto& source = *job.texture->source;
+    const uint32_t families[] = {device.GetGraphicsFamily(), device.GetTransferQueue().GetFamily()};
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = source.GetFormat();
+    imageInfo.extent = LevelExtent(source.GetExtent(), job.level);
+    imageInfo.mipLevels = job.texture->levels-job.level;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    // Written on the transfer queue and sampled on the graphics queue without ownership transfers
+    if (families[0]!=families[1]) {
+        imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = 2;
+        imageInfo.pQueueFamilyIndices = families;
+    }
+    else {
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device.GetNative(), &imageInfo, HostAllocator(), &job.image)!=VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture image!");
+    }
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device.GetNative(), job.image, &requirements);
+    job.memory = device.GetAllocator().Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    vkBindImageMemory(device.GetNative(), job.image, job.memory.memory, job.memory.offset);
+}
+
+void TexturePool::StageLevel(Batch& batch, const Job& job, uint32_t level) {
+    auto& source = *job.texture->source;
+    const auto size = source.GetLevelSize(level);
+    VkBuffer buffer = staging->GetBuffer();
+    VkDeviceSize offset;
+    uint8_t* destination;
+    if (staging->Allocate(size, StagingAlignment, offset)) {
+        destination = staging->GetMapped()+offset;
+    }
+    else {
+        // More than the ring has left, goes through a buffer of its own
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkCreateBuffer(device.GetNative(), &bufferInfo, HostAllocator(), &buffer)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create staging buffer!");
+        }
+        batch.scratch.emplace_back(buffer, Allocation {});
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(device.GetNative(), buffer, &requirements);
+        auto& memory = batch.scratch.back().second;
+        memory = device.GetAllocator().Allocate(requirements,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        vkBindBufferMemory(device.GetNative(), buffer, memory.memory, memory.offset);
+        offset = 0;
+        destination = static_cast<uint8_t*>(memory.mapped);
+    }
+    source.ReadLevel(level, destination);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = offset;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level-job.level, 0, 1};
+    region.imageExtent = LevelExtent(source.GetExtent(), level);
+    vkCmdCopyBufferToImage(batch.commandBuffer, buffer, job.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+void TexturePool::Complete(Batch& batch) noexcept {
+    const auto native = device.GetNative();
+    staging->Retire(batch.id);
+    FreeScratch(batch);
+    for (auto& job : batch.jobs) {
+        const auto texture = job.texture;
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = job.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = texture->source->GetFormat();
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture->levels-job.level, 0, 1};
+        VkImageView view = VK_NULL_HANDLE;
+        if (texture->removed || vkCreateImageView(native, &viewInfo, HostAllocator(), &view)!=VK_SUCCESS) {
+            DestroyImage(native, device.GetAllocator(), VK_NULL_HANDLE, job.image, job.memory);
+            Drop(job);
+            continue;
+        }
+        const auto previous = texture->GetResidentLevel();
+        RetireImage(*texture, view);
+        texture->image = job.image;
+        texture->memory = job.memory;
+        texture->view.store(view, std::memory_order_release);
+        texture->residentLevel.store(job.level, std::memory_order_release);
+        texture->uploading = false;
+        if (job.level<previous) {
+            ++uploads;
+            uploadedBytes += job.bytes;
+        }
+        else {
+            evictions += job.level-previous;
+            evictedBytes += job.previousBytes-job.bytes;
+        }
+    }
+    batch.jobs.clear();
+}
+
+void TexturePool::Abort(Batch& batch) noexcept {
+    FreeScratch(batch);
+    for (auto& job : batch.jobs) {
+        DestroyImage(device.GetNative(), device.GetAllocator(), VK_NULL_HANDLE, job.image, job.memory);
+        Drop(job);
+    }
+    batch.jobs.clear();
+}
+
+void TexturePool::Drop(const Job& job) noexcept {
+    const auto texture = job.texture;
+    texture->uploading = false;
+    if (texture->removed) {
+        delete texture;
+        return;
+    }
+    residentBytes = residentBytes+job.previousBytes-job.bytes;
+    texture->bytes = job.previousBytes;
+    // Most likely out of device memory, the texture stays at its current detail until the budget changes
+    if (job.level<texture->GetResidentLevel())
+        texture->minLevel = job.level+1;
+}
+
+void TexturePool::FreeScratch(Batch& batch) noexcept {
+    for (auto& scratch : batch.scratch) {
+        vkDestroyBuffer(device.GetNative(), scratch.first, HostAllocator());
+        device.GetAllocator().Free(scratch.second);
+    }
+    batch.scratch.clear();
+}
+
+// Frames in flight may still sample the image, it goes away once they retired. The table has to let go of the view
+// first, or a frame prepared after the deletion was queued could still pick it up.
+void TexturePool::RetireImage(Texture& texture, VkImageView replacement) noexcept {
+    if (const auto table = device.GetTextureTable())
+        table->Set(texture.tableIndex, replacement);
+    if (!texture.image)
+        return;
+    const auto native = device.GetNative();
+    const auto view = texture.view.exchange(VK_NULL_HANDLE, std::memory_order_acq_rel);
+    const auto image = texture.image;
+    const auto memory = texture.memory;
+    auto& allocator = device.GetAllocator();
+    DeferredDeletions.Enqueue([native, &allocator, view, image, memory]() {
+        DestroyImage(native, allocator, view, image, memory);
+    });
+    texture.image = VK_NULL_HANDLE;
+    texture.memory = {};
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateTexturePool(uint64_t deviceHandle) noexcept {
+    AK_TRACE(akCreateTexturePool, deviceHandle);
+    const auto device = DeviceHandles.Lookup(deviceHandle);
+    if (!device)
+        return 0;
+    try {
+        const auto pool = new TexturePool(*device);
+        const auto handle = TexturePoolHandles.Insert(pool);
+        if (!handle)
+            delete pool;
+        return handle;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "texture pool: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+AK_PUBLIC void AK_CALL akDestroyTexturePool(uint64_t handle) noexcept {
+    AK_TRACE(akDestroyTexturePool, handle);
+    TexturePool* pool;
+    if (TexturePoolHandles.Erase(handle, &pool))
+        delete pool;
+}
+
+AK_PUBLIC void AK_CALL akTexturePoolSetBudget(uint64_t handle, uint64_t bytes) noexcept {
+    AK_TRACE(akTexturePoolSetBudget, handle, bytes);
+    if (const auto pool = TexturePoolHandles.Lookup(handle))
+        pool->SetBudget(bytes);
+}
+
+AK_PUBLIC void AK_CALL akTexturePoolGetStats(uint64_t handle, TexturePoolStats* stats) noexcept {
+    if (!stats)
+        return;
+    const auto pool = TexturePoolHandles.Lookup(handle);
+    *stats = pool ? pool->GetStats() : TexturePoolStats {};
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateTextureRGBA8Converted(uint64_t poolHandle, uint32_t width, uint32_t height,
+        const void* pixels, uint32_t conversion) noexcept {
+    AK_TRACE(akCreateTextureRGBA8Converted, poolHandle, width, height, TraceIn(pixels, size_t(width)*height*4),
+            conversion);
+    const auto pool = TexturePoolHandles.Lookup(poolHandle);
+    if (!pool || !width || !height || !pixels)
+        return 0;
+    try {
+        return pool->Create(std::make_unique<Rgba8Source>(width, height, pixels, conversion))->GetHandle();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "texture: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+AK_PUBLIC uint64_t AK_CALL akCreateTextureRGBA8(uint64_t poolHandle, uint32_t width, uint32_t height,
+        const void* pixels) noexcept {
+    AK_TRACE(akCreateTextureRGBA8, poolHandle, width, height, TraceIn(pixels, size_t(width)*height*4));
+    return akCreateTextureRGBA8Converted(poolHandle, width, height, pixels, 0);
+}
+
+AK_PUBLIC void AK_CALL akDestroyTexture(uint64_t handle) noexcept {
+    AK_TRACE(akDestroyTexture, handle);
+    Texture* texture;
+    if (TextureHandles.Erase(handle, &texture))
+        texture->GetPool().Destroy(texture);
+}
+
+AK_PUBLIC void AK_CALL akTextureRequestSize(uint64_t handle, uint32_t width, uint32_t height) noexcept {
+    AK_TRACE(akTextureRequestSize, handle, width, height);
+    if (const auto texture = TextureHandles.Lookup(handle))
+        texture->GetPool().RequestSize(texture, width, height);
+}
+
+AK_PUBLIC uint32_t AK_CALL akTextureGetLevelCount(uint64_t handle) noexcept {
+    const auto texture = TextureHandles.Lookup(handle);
+    return texture ? texture->GetLevelCount() : 0;
+}
+
+AK_PUBLIC uint32_t AK_CALL akTextureGetResidentLevel(uint64_t handle) noexcept {
+    const auto texture = TextureHandles.Lookup(handle);
+    return texture ? texture->GetResidentLevel() : 0;
+}
+
+AK_PUBLIC uint32_t AK_CALL akTextureGetTableIndex(uint64_t handle) noexcept {
+    const auto texture = TextureHandles.Lookup(handle);
+    return texture ? texture->GetTableIndex() : TextureTable::NoIndex;
+}
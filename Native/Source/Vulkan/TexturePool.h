@@ -0,0 +1,158 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include "Memory.h"
+#include "Device.h"
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+class StagingRing;
+class TexturePool;
+
+// Pixel data a texture streams from. Level 0 is the finest. Levels are read on the streaming thread, possibly more
+// than once since a level that was evicted is read again when it becomes resident again.
+class TextureSource {
+public:
+    virtual ~TextureSource() = default;
+    virtual VkFormat GetFormat() const noexcept = 0;
+    virtual VkExtent2D GetExtent() const noexcept = 0;
+    virtual uint32_t GetLevelCount() const noexcept = 0;
+    // Tightly packed size of a level as copied into the staging buffer
+    virtual VkDeviceSize GetLevelSize(uint32_t level) const noexcept = 0;
+    virtual void ReadLevel(uint32_t level, void* destination) = 0;
+};
+
+struct TexturePoolStats {
+    uint64_t budget;
+    uint64_t residentBytes;
+    uint64_t textures;
+    uint64_t residentLevels;
+    uint64_t uploads;
+    uint64_t uploadedBytes;
+    uint64_t evictions;
+    uint64_t evictedBytes;
+    uint64_t pendingUploads;
+};
+
+class Texture {
+public:
+    TexturePool& GetPool() const noexcept { return pool; }
+    uint64_t GetHandle() const noexcept { return handle; }
+    uint32_t GetLevelCount() const noexcept { return levels; }
+    // Finest resident level, GetLevelCount() while nothing is resident yet
+    uint32_t GetResidentLevel() const noexcept { return residentLevel.load(std::memory_order_acquire); }
+    // Covers the resident levels only, so its first level is GetResidentLevel() of the full chain
+    VkImageView GetView() const noexcept { return view.load(std::memory_order_acquire); }
+    // Index in the device's texture table for as long as the texture lives, TextureTable::NoIndex without one
+    uint32_t GetTableIndex() const noexcept { return tableIndex; }
+private:
+    friend class TexturePool;
+    Texture(TexturePool& pool, std::unique_ptr<TextureSource> source) noexcept;
+
+    TexturePool& pool;
+    std::unique_ptr<TextureSource> source;
+    uint64_t handle = 0;
+    uint32_t tableIndex = UINT32_MAX;
+    uint32_t levels;
+    uint32_t tailLevel;
+    std::atomic<uint32_t> residentLevel;
+    std::atomic<uint32_t> requestedLevel;
+    std::atomic<uint64_t> lastUse {0};
+    std::atomic<VkImageView> view {VK_NULL_HANDLE};
+    // Guarded by the pool
+    VkImage image = VK_NULL_HANDLE;
+    Allocation memory;
+    VkDeviceSize bytes = 0;
+    uint32_t minLevel = 0;
+    bool uploading = false, removed = false;
+};
+
+// Streams textures on the transfer queue from a thread of its own. A new texture first gets its tail, the levels of
+// at most TailExtent texels, and then grows one finer level at a time while the size it is drawn at asks for it.
+// Each residency change builds a new image holding exactly the resident levels, uploads them through the staging
+// ring and swaps it in once the copies completed; the old image goes through the deletion queue.
+// Texel bytes are kept under a budget by dropping the finest levels of the least recently used textures. Only
+// textures used less recently than the one growing are evicted, so two textures never take turns evicting each other.
+// A device trim drops every texture to its tail until it is used again, and the staging ring once uploads went idle.
+class TexturePool : public TrimListener {
+public:
+    static constexpr VkDeviceSize StagingSize = 32ull << 20;
+    static constexpr uint32_t TailExtent = 64;
+    static constexpr size_t MaxBatchesInFlight = 4;
+
+    explicit TexturePool(VulkanDevice& device);
+    ~TexturePool() override;
+    TexturePool(const TexturePool&) = delete;
+    TexturePool& operator=(const TexturePool&) = delete;
+    VulkanDevice& GetDevice() const noexcept { return device; }
+    // Also registers the texture in TextureHandles
+    Texture* Create(std::unique_ptr<TextureSource> source);
+    void Destroy(Texture* texture) noexcept;
+    // Size in pixels the texture is drawn at, selects the finest level needed and marks the texture as used
+    void RequestSize(Texture* texture, uint32_t width, uint32_t height) noexcept;
+    // 0 selects half of what VK_EXT_memory_budget reports for the device local heap
+    void SetBudget(VkDeviceSize bytes) noexcept;
+    TexturePoolStats GetStats() noexcept;
+    void OnTrim(DeviceTrimStats& stats) noexcept override;
+private:
+    struct Job {
+        Texture* texture;
+        uint32_t level;
+        VkImage image;
+        Allocation memory;
+        VkDeviceSize bytes, previousBytes;
+    };
+
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        // Transfer queue value signalled once the copies finished
+        uint64_t value = 0;
+        uint64_t id = 0;
+        std::vector<Job> jobs;
+        std::vector<std::pair<VkBuffer, Allocation>> scratch;
+    };
+
+    void Run() noexcept;
+    void Notify() noexcept;
+    VkDeviceSize GetBudget() const noexcept;
+    static VkDeviceSize ChainBytes(const Texture& texture, uint32_t level) noexcept;
+    void Schedule(std::vector<Job>& jobs);
+    bool Evict(Texture* texture, VkDeviceSize excess, std::vector<Job>& jobs);
+    void Shrink(Texture* texture, uint32_t level, std::vector<Job>& jobs);
+    bool Upload(Batch& batch);
+    void CreateImage(Job& job);
+    void StageLevel(Batch& batch, const Job& job, uint32_t level);
+    void Complete(Batch& batch) noexcept;
+    void Abort(Batch& batch) noexcept;
+    void Drop(const Job& job) noexcept;
+    void FreeScratch(Batch& batch) noexcept;
+    // Points the texture's table index at `replacement` before the image goes
+    void RetireImage(Texture& texture, VkImageView replacement = VK_NULL_HANDLE) noexcept;
+
+    VulkanDevice& device;
+    // Only touched by the streaming thread, null after a trim released it
+    std::unique_ptr<StagingRing> staging;
+    std::atomic<VkDeviceSize> stagingBytes {0};
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::vector<Batch> freeBatches;
+    std::deque<Batch> inFlight;
+    uint64_t batchId = 0;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool wakeRequested = false, running = true, releaseStaging = false;
+    std::vector<Texture*> textures;
+    VkDeviceSize budget = 0, residentBytes = 0;
+    std::atomic<uint64_t> useClock {0};
+    // Textures not used since the last trim stay at their tails
+    uint64_t trimClock = 0;
+    uint64_t uploads = 0, uploadedBytes = 0, evictions = 0, evictedBytes = 0;
+    std::thread thread;
+};
+
+extern HandleTable<TexturePool*, HandleType::TexturePool> TexturePoolHandles;
+extern HandleTable<Texture*, HandleType::Texture> TextureHandles;
@@ -0,0 +1,278 @@
+#include "TextureTable.h"
+#include "Device.h"
+
+#include <algorithm>
+
+namespace {
+    // Update-after-bind arrays have limits of their own, usually far above the classic descriptor limits
+    uint32_t QueryCapacity(VulkanDevice& device) noexcept {
+        // Descriptor indexing is only enabled on 1.1 and later
+        const auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2) vkGetInstanceProcAddr(
+                device.GetApplication().GetInstance(), "vkGetPhysicalDeviceProperties2");
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing = {};
+        indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties = {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &indexing;
+        if (!getProperties2)
+            return 0;
+        getProperties2(device.GetPhysicalDevice(), &properties);
+        return std::min({TextureTable::MaxTextures, indexing.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                indexing.maxDescriptorSetUpdateAfterBindSampledImages});
+    }
+}
+
+TextureTable::TextureTable(VulkanDevice& device) : device(device) {
+    const auto native = device.GetNative();
+    capacity = QueryCapacity(device);
+    if (!capacity) {
+        throw std::runtime_error("failed to query descriptor indexing limits!");
+    }
+    try {
+        VkSamplerCreateInfo samplerInfo = {};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        if (vkCreateSampler(native, &samplerInfo, HostAllocator(), &sampler)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture sampler!");
+        }
+
+        VkDescriptorSetLayoutBinding bindings[2] = {};
+        bindings[0].binding = 0;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        bindings[0].descriptorCount = 1;
+        bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        bindings[0].pImmutableSamplers = &sampler;
+        bindings[1].binding = 1;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        bindings[1].descriptorCount = capacity;
+        bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        const VkDescriptorBindingFlagsEXT bindingFlags[2] = {0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT};
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {};
+        flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        flagsInfo.bindingCount = 2;
+        flagsInfo.pBindingFlags = bindingFlags;
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+        setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutInfo.pNext = &flagsInfo;
+        setLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        setLayoutInfo.bindingCount = 2;
+        setLayoutInfo.pBindings = bindings;
+        if (vkCreateDescriptorSetLayout(native, &setLayoutInfo, HostAllocator(), &setLayout)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture table layout!");
+        }
+
+        const VkDescriptorPoolSize poolSizes[] = {
+                {VK_DESCRIPTOR_TYPE_SAMPLER, Presenter::FramesInFlight},
+                {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, capacity*Presenter::FramesInFlight}
+        };
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+        poolInfo.maxSets = Presenter::FramesInFlight;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = poolSizes;
+        if (vkCreateDescriptorPool(native, &poolInfo, HostAllocator(), &pool)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture table pool!");
+        }
+        for (auto& frame : frames) {
+            VkDescriptorSetVariableDescriptorCountAllocateInfoEXT countInfo = {};
+            countInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+            countInfo.descriptorSetCount = 1;
+            countInfo.pDescriptorCounts = &capacity;
+            VkDescriptorSetAllocateInfo allocateInfo = {};
+            allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocateInfo.pNext = &countInfo;
+            allocateInfo.descriptorPool = pool;
+            allocateInfo.descriptorSetCount = 1;
+            allocateInfo.pSetLayouts = &setLayout;
+            if (vkAllocateDescriptorSets(native, &allocateInfo, &frame.set)!=VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate texture table!");
+            }
+        }
+
+        // Cleared by the first frame that is prepared
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        imageInfo.extent = {1, 1, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (vkCreateImage(native, &imageInfo, HostAllocator(), &fallback)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create fallback texture!");
+        }
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(native, fallback, &requirements);
+        fallbackMemory = device.GetAllocator().Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        vkBindImageMemory(native, fallback, fallbackMemory.memory, fallbackMemory.offset);
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = fallback;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = imageInfo.format;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        if (vkCreateImageView(native, &viewInfo, HostAllocator(), &fallbackView)!=VK_SUCCESS) {
+            throw std::runtime_error("failed to create fallback texture view!");
+        }
+    }
+    catch (const std::exception&) {
+        Destroy();
+        throw;
+    }
+}
+
+TextureTable::~TextureTable() {
+    Destroy();
+}
+
+void TextureTable::Destroy() noexcept {
+    const auto native = device.GetNative();
+    vkDestroyImageView(native, fallbackView, HostAllocator());
+    vkDestroyImage(native, fallback, HostAllocator());
+    if (fallbackMemory.memory)
+        device.GetAllocator().Free(fallbackMemory);
+    vkDestroyDescriptorPool(native, pool, HostAllocator());
+    vkDestroyDescriptorSetLayout(native, setLayout, HostAllocator());
+    vkDestroySampler(native, sampler, HostAllocator());
+}
+
+uint32_t TextureTable::Allocate() {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t index;
+    if (!freeIndices.empty()) {
+        index = freeIndices.back();
+        freeIndices.pop_back();
+    }
+    else if (views.size()<capacity) {
+        index = static_cast<uint32_t>(views.size());
+        views.push_back(VK_NULL_HANDLE);
+    }
+    else {
+        throw std::runtime_error("texture table is full!");
+    }
+    ++indices;
+    MarkDirty(index);
+    return index;
+}
+
+void TextureTable::Release(uint32_t index) noexcept {
+    if (index==NoIndex)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    // Frames in flight keep their own set, so the index can be handed out again right away
+    views[index] = VK_NULL_HANDLE;
+    MarkDirty(index);
+    freeIndices.push_back(index);
+    --indices;
+}
+
+void TextureTable::Set(uint32_t index, VkImageView view) noexcept {
+    if (index==NoIndex)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    views[index] = view;
+    MarkDirty(index);
+}
+
+VkDescriptorSet TextureTable::Prepare(VkCommandBuffer commandBuffer, uint32_t frame) noexcept {
+    if (!fallbackReady) {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = fallback;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                0, nullptr, 0, nullptr, 1, &barrier);
+        const VkClearColorValue transparent = {};
+        vkCmdClearColorImage(commandBuffer, fallback, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &transparent, 1,
+                &barrier.subresourceRange);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &barrier);
+        fallbackReady = true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& target = frames[frame];
+    if (target.written.size()<views.size())
+        target.written.resize(views.size(), VK_NULL_HANDLE);
+    // Both arrays are sized up front, writes point into imageInfos
+    imageInfos.clear();
+    imageInfos.reserve(target.dirty.size());
+    writes.clear();
+    for (const auto index : target.dirty) {
+        target.queued[index] = false;
+        const auto view = views[index] ? views[index] : fallbackView;
+        if (target.written[index]==view)
+            continue;
+        target.written[index] = view;
+        imageInfos.push_back({VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = target.set;
+        write.dstBinding = 1;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        write.pImageInfo = &imageInfos.back();
+        writes.push_back(write);
+    }
+    target.dirty.clear();
+    if (!writes.empty()) {
+        vkUpdateDescriptorSets(device.GetNative(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        written += writes.size();
+    }
+    return target.set;
+}
+
+TextureTableStats TextureTable::GetStats() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    TextureTableStats stats = {};
+    stats.capacity = capacity;
+    stats.indices = indices;
+    stats.writes = written;
+    return stats;
+}
+
+// Each frame's set catches up on its own, an index changed twice before a frame comes around is written once.
+// Only Allocate grows the lists, Set and Release never allocate.
+void TextureTable::MarkDirty(uint32_t index) {
+    for (auto& frame : frames) {
+        if (frame.queued.size()<views.size()) {
+            frame.queued.resize(views.size());
+            frame.dirty.reserve(views.size());
+        }
+        if (frame.queued[index])
+            continue;
+        frame.queued[index] = true;
+        frame.dirty.push_back(index);
+    }
+}
+
+AK_PUBLIC void AK_CALL akDeviceGetTextureTableStats(uint64_t handle, TextureTableStats* stats) noexcept {
+    if (!stats)
+        return;
+    const auto device = DeviceHandles.Lookup(handle);
+    const auto table = device ? device->GetTextureTable() : nullptr;
+    *stats = table ? table->GetStats() : TextureTableStats {};
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../Vulkan.h"
+#include "Memory.h"
+#include "Presenter.h"
+#include <array>
+#include <mutex>
+#include <vector>
+
+class VulkanDevice;
+
+struct TextureTableStats {
+    uint64_t capacity;
+    uint64_t indices;
+    // Descriptors written while preparing frames
+    uint64_t writes;
+};
+
+// One sampled image array every draw of a frame shares, only created with descriptor indexing. Binding 0 is an
+// immutable linear sampler, binding 1 the partially bound, update-after-bind image array; textures keep the index
+// they were given for their whole life and managed code passes it as instance data.
+//
+// Streaming swaps the view behind an index while frames are in flight, so there is one descriptor set per frame in
+// flight and changes reach a set only when its frame is prepared again. Indices without a resident view sample a
+// transparent black texel.
+class TextureTable {
+public:
+    static constexpr uint32_t MaxTextures = 65536;
+    static constexpr uint32_t NoIndex = UINT32_MAX;
+
+    explicit TextureTable(VulkanDevice& device);
+    ~TextureTable();
+    TextureTable(const TextureTable&) = delete;
+    TextureTable& operator=(const TextureTable&) = delete;
+    VkDescriptorSetLayout GetLayout() const noexcept { return setLayout; }
+    uint32_t GetCapacity() const noexcept { return capacity; }
+    uint32_t Allocate();
+    void Release(uint32_t index) noexcept;
+    // A null view falls back to the transparent texel
+    void Set(uint32_t index, VkImageView view) noexcept;
+    // Called by the presenter after `frame` retired, brings its set up to date and returns it
+    VkDescriptorSet Prepare(VkCommandBuffer commandBuffer, uint32_t frame) noexcept;
+    TextureTableStats GetStats() noexcept;
+private:
+    struct FrameSet {
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        std::vector<VkImageView> written;
+        // Indices changed since the set was last prepared, each listed once
+        std::vector<uint32_t> dirty;
+        std::vector<bool> queued;
+    };
+
+    void MarkDirty(uint32_t index);
+    void Destroy() noexcept;
+
+    VulkanDevice& device;
+    uint32_t capacity = 0;
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VkImage fallback = VK_NULL_HANDLE;
+    Allocation fallbackMemory;
+    VkImageView fallbackView = VK_NULL_HANDLE;
+    bool fallbackReady = false;
+    // Kept around to avoid per-frame allocations, only touched by Prepare
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    std::vector<VkWriteDescriptorSet> writes;
+    // Guards everything below
+    std::mutex mutex;
+    std::array<FrameSet, Presenter::FramesInFlight> frames;
+    std::vector<VkImageView> views;
+    std::vector<uint32_t> freeIndices;
+    uint64_t indices = 0, written = 0;
+};
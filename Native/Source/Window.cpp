@@ -3,31 +3,66 @@
 //
 
 #include "Config.h"
+#include "Handles.h"
+#include "DeletionQueue.h"
+#include "Trace.h"
 #include "SDL2/SDL.h"
 
-AK_PUBLIC uintptr_t AK_CALL akCreateWindow(
+HandleTable<SDL_Window*, HandleType::Window> WindowHandles;
+
+AK_PUBLIC uint64_t AK_CALL akCreateWindow(
         const char* caption,
         int32_t display, int32_t positionX, int32_t positionY, int32_t width, int32_t height
 ) noexcept {
-    return reinterpret_cast<uintptr_t>(SDL_CreateWindow(caption, positionX, positionY, width, height, SDL_WINDOW_VULKAN));
+    AK_TRACE(akCreateWindow, caption, display, positionX, positionY, width, height);
+    const auto flags = SDL_WINDOW_VULKAN | (TraceIsHeadless() ? SDL_WINDOW_HIDDEN : 0);
+    const auto window = SDL_CreateWindow(caption, positionX, positionY, width, height, flags);
+    if (!window)
+        return 0;
+    const auto handle = WindowHandles.Insert(window);
+    if (!handle)
+        SDL_DestroyWindow(window);
+    return handle;
+}
+
+AK_PUBLIC void AK_CALL akShowWindow(uint64_t handle) noexcept {
+    AK_TRACE(akShowWindow, handle);
+    if (const auto window = WindowHandles.Lookup(handle); window && !TraceIsHeadless())
+        SDL_ShowWindow(window);
 }
 
-AK_PUBLIC void AK_CALL akShowWindow(uintptr_t handle) noexcept {
-    SDL_ShowWindow(reinterpret_cast<SDL_Window*>(handle));
+AK_PUBLIC void AK_CALL akHideWindow(uint64_t handle) noexcept{
+    AK_TRACE(akHideWindow, handle);
+    if (const auto window = WindowHandles.Lookup(handle))
+        SDL_HideWindow(window);
 }
 
-AK_PUBLIC void AK_CALL akHideWindow(uintptr_t handle) noexcept{
-    SDL_HideWindow(reinterpret_cast<SDL_Window*>(handle));
+AK_PUBLIC void AK_CALL akMinimizeWindow(uint64_t handle) noexcept{
+    AK_TRACE(akMinimizeWindow, handle);
+    if (const auto window = WindowHandles.Lookup(handle))
+        SDL_MinimizeWindow(window);
 }
 
-AK_PUBLIC void AK_CALL akMinimizeWindow(uintptr_t handle) noexcept{
-    SDL_MinimizeWindow(reinterpret_cast<SDL_Window*>(handle));
+AK_PUBLIC void AK_CALL akMaximizeWindow(uint64_t handle) noexcept{
+    AK_TRACE(akMaximizeWindow, handle);
+    if (const auto window = WindowHandles.Lookup(handle); window && !TraceIsHeadless())
+        SDL_MaximizeWindow(window);
 }
 
-AK_PUBLIC void AK_CALL akMaximizeWindow(uintptr_t handle) noexcept{
-    SDL_MaximizeWindow(reinterpret_cast<SDL_Window*>(handle));
+AK_PUBLIC void AK_CALL akDestroyWindow(uint64_t handle) noexcept{
+    AK_TRACE(akDestroyWindow, handle);
+    SDL_Window* window;
+    if (WindowHandles.Erase(handle, &window))
+        DeferredDeletions.Enqueue([window]() { SDL_DestroyWindow(window); });
 }
 
-AK_PUBLIC void AK_CALL akDestroyWindow(uintptr_t handle) noexcept{
-    SDL_DestroyWindow(reinterpret_cast<SDL_Window*>(handle));
+AK_PUBLIC void AK_CALL akDestroyWindows(const uint64_t* handles, uint32_t count) noexcept{
+    AK_TRACE(akDestroyWindows, TraceIn(handles, count), count);
+    std::vector<SDL_Window*> windows;
+    WindowHandles.EraseBatch(handles, count, [&windows](SDL_Window* window) { windows.push_back(window); });
+    if (!windows.empty())
+        DeferredDeletions.Enqueue([windows = std::move(windows)]() {
+            for (auto&& x : windows)
+                SDL_DestroyWindow(x);
+        });
 }
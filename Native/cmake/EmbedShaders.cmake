@@ -0,0 +1,28 @@
+# Generates a source file holding every SPIR-V binary of `directory` and adds it to `target`.
+# The shader registry finds them under "shaders/<file name>" before looking on disk.
+function(akarin_embed_shaders target directory)
+    file(GLOB shaders "${directory}/*.spv")
+    set(output "${CMAKE_CURRENT_BINARY_DIR}/EmbeddedShaders.cpp")
+    set(content "#include \"Vulkan/ShaderRegistry.h\"\n\n")
+    set(entries "")
+    set(index 0)
+    foreach(shader ${shaders})
+        get_filename_component(name "${shader}" NAME)
+        file(READ "${shader}" hex HEX)
+        string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${hex}")
+        string(APPEND content "alignas(4) static const unsigned char Shader${index}[] = {${bytes}};\n")
+        string(APPEND entries "        {\"shaders/${name}\", Shader${index}, sizeof(Shader${index})},\n")
+        math(EXPR index "${index}+1")
+    endforeach()
+    if(index EQUAL 0)
+        set(entries "        {nullptr, nullptr, 0}\n")
+    endif()
+    string(APPEND content "\nconst EmbeddedShader EmbeddedShaders[] = {\n${entries}};\n")
+    string(APPEND content "const size_t EmbeddedShaderCount = ${index};\n")
+    # Only touch the output when it changed, so reconfiguring does not rebuild it
+    file(WRITE "${output}.tmp" "${content}")
+    configure_file("${output}.tmp" "${output}" COPYONLY)
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${shaders} "${directory}")
+    target_sources(${target} PRIVATE "${output}")
+    target_compile_definitions(${target} PRIVATE AK_EMBEDDED_SHADERS)
+endfunction()